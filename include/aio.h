@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#ifndef LIBNDS_AIO_H__
+#define LIBNDS_AIO_H__
+
+/// @file aio.h
+///
+/// @brief Asynchronous file reads.
+///
+/// This is a partial implementation of POSIX aio.h built on top of the
+/// cooperative multithreading system. Requests are queued and served in order
+/// by a storage worker thread, which is created the first time a request is
+/// submitted. The worker reads data in chunks of 2 KiB and yields to other
+/// threads between chunks, so the thread that submitted the request can keep
+/// running (rendering, playing music...) while the data is loaded.
+///
+/// The reads aren't really asynchronous: each chunk is read with a blocking
+/// read() in the worker thread, and threads are cooperative, so no other thread
+/// runs until the chunk has been read. Interrupt handlers still run. How long
+/// the other threads are stopped depends on the device and on the state of the
+/// filesystem: a chunk may also need to read FAT sectors, or to decompress a
+/// block of a compressed NitroFS file. Only the time between chunks is given to
+/// other threads, so a long request takes longer to complete than a single
+/// read().
+///
+/// It works with files in FAT filesystems and in NitroFS.
+///
+/// Only reads are supported. Notifications with signals aren't supported, use
+/// aio_error() to poll requests or aio_suspend() to wait for them.
+///
+/// Requests read from the offset specified in aio_offset. The file position of
+/// the file descriptor is undefined after a request has been served, and the
+/// file descriptor must not be used by other threads while a request is in
+/// progress.
+
+#ifndef ARM9
+#error aio.h is currently supported on the ARM9 only.
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <time.h>
+
+/// Returned by aio_cancel() if all requests have been cancelled.
+#define AIO_CANCELED    0
+/// Returned by aio_cancel() if some requests couldn't be cancelled.
+#define AIO_NOTCANCELED 1
+/// Returned by aio_cancel() if all requests had already been completed.
+#define AIO_ALLDONE     2
+
+/// Asynchronous I/O control block.
+struct aiocb
+{
+    int             aio_fildes;     ///< File descriptor.
+    off_t           aio_offset;     ///< File offset.
+    volatile void  *aio_buf;        ///< Destination buffer.
+    size_t          aio_nbytes;     ///< Number of bytes to read.
+    int             aio_reqprio;    ///< Request priority. Ignored.
+    int             aio_lio_opcode; ///< Operation to be performed. Ignored.
+
+    // Private fields
+    struct aiocb   *__next;
+    volatile int    __error;
+    ssize_t         __return;
+};
+
+/// Queues a read request.
+///
+/// The control block and the destination buffer must remain valid until the
+/// request has been completed.
+///
+/// @param aiocbp
+///     Control block of the request.
+///
+/// @return
+///     0 if the request has been queued. On error it returns -1 and sets errno
+///     (EINVAL for invalid arguments, EAGAIN if the worker thread couldn't be
+///     created).
+int aio_read(struct aiocb *aiocbp);
+
+/// Returns the status of a request.
+///
+/// @param aiocbp
+///     Control block of the request.
+///
+/// @return
+///     EINPROGRESS if the request hasn't been completed, ECANCELED if it has
+///     been cancelled, 0 if it has been completed successfully, or the errno
+///     code of the read if it has failed.
+int aio_error(const struct aiocb *aiocbp);
+
+/// Returns the final result of a request.
+///
+/// It must only be called once, after aio_error() returns something other than
+/// EINPROGRESS.
+///
+/// @param aiocbp
+///     Control block of the request.
+///
+/// @return
+///     The value that read() would have returned.
+ssize_t aio_return(struct aiocb *aiocbp);
+
+/// Waits until at least one of the requests of a list has been completed.
+///
+/// The calling thread yields to other threads while it waits.
+///
+/// @param list
+///     List of control blocks. NULL elements are ignored.
+/// @param nent
+///     Number of elements in the list.
+/// @param timeout
+///     If NULL, wait until a request is completed. If not, maximum time to
+///     wait. Timeouts are measured in frames (rounded up), so the list is only
+///     checked once per VBlank in that case. A timeout of zero checks the list
+///     without waiting.
+///
+/// @return
+///     0 if a request has been completed. If not, -1 with errno set to EAGAIN
+///     (or EINVAL if the timeout isn't valid).
+int aio_suspend(const struct aiocb *const list[], int nent,
+                const struct timespec *timeout);
+
+/// Cancels requests that haven't been started yet.
+///
+/// @param fildes
+///     File descriptor.
+/// @param aiocbp
+///     Request to cancel. If NULL, all requests of the file descriptor are
+///     cancelled.
+///
+/// @return
+///     AIO_CANCELED, AIO_NOTCANCELED or AIO_ALLDONE.
+int aio_cancel(int fildes, struct aiocb *aiocbp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_AIO_H__
@@ -72,6 +72,43 @@ bool fatInit(int32_t cache_size_pages, bool set_as_default_device);
 WARN_UNUSED_RESULT
 bool nandInit(bool read_only);
 
+/// Mounts a RAM disk as "ram:/".
+///
+/// A RAM disk is useful for temporary files, like decompressed or unpacked
+/// data, as accessing it is as fast as copying memory. The memory can be in
+/// main RAM, in the extended RAM of the DSi, or in a Slot-2 RAM expansion pak
+/// (which must be unlocked before calling this function).
+///
+/// Only one RAM disk can be mounted at a time. It doesn't require fatInit() to
+/// be called. The memory used by the filesystem is only allocated while the RAM
+/// disk is mounted, and it's freed by fatExitRamDisk().
+///
+/// @param buffer
+///     Word-aligned buffer to use as storage. If it's NULL, a buffer is
+///     allocated with malloc().
+/// @param size
+///     Size of the RAM disk in bytes.
+/// @param format
+///     If true and the buffer doesn't contain a FAT filesystem, it is
+///     formatted. If the buffer already contains a filesystem, it is kept, so
+///     the contents of memory that survives a reset can be used again.
+///
+/// @return
+///     0 on success, -1 on error (and errno is set).
+WARN_UNUSED_RESULT
+int fatInitRamDisk(void *buffer, size_t size, bool format);
+
+/// Unmounts the RAM disk mounted by fatInitRamDisk().
+///
+/// All files and directories opened in "ram:/" must be closed before calling
+/// this function. If the buffer of the RAM disk was allocated by
+/// fatInitRamDisk() it is freed, so all the data in the RAM disk is lost. If
+/// not, the buffer isn't modified, and it can be mounted again later.
+///
+/// @return
+///     0 on success, -1 on error (and errno is set).
+int fatExitRamDisk(void);
+
 /// This function returns the default current working directory.
 ///
 /// It is extracted from argv[0] if it has been provided by the loader. If the
@@ -103,6 +140,231 @@ char *fatGetDefaultCwd(void);
 ///     Returns a string with the path.
 const char *fatGetDefaultDrive(void);
 
+/// Enables or disables write-back mode in the FAT sector cache.
+///
+/// By default, all writes are sent to the storage device right away. In
+/// write-back mode, small writes (like updates to the FAT tables, directory
+/// entries or partial sectors of files) are kept in the cache, so that sectors
+/// that are modified many times are only written once. Modified sectors are
+/// written to the device when fsync() or fclose() are called, when
+/// fatFlushCache() is called, or when the cache needs space for other sectors.
+/// Runs of consecutive modified sectors are written with a single command.
+///
+/// Any data that hasn't been flushed is lost if the console is turned off or
+/// the storage device is removed, so make sure to close or sync files before
+/// that can happen.
+///
+/// Disabling write-back mode flushes the cache.
+///
+/// @param enable
+///     true to enable write-back mode, false to disable it.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno to EIO.
+int fatSetCacheWriteBack(bool enable);
+
+/// Writes all sectors modified in the cache to their storage devices.
+///
+/// This is only needed in write-back mode. @see fatSetCacheWriteBack
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno to EIO. Errors that
+///     happened while writing sectors evicted from the cache since the last
+///     flush are reported here too.
+int fatFlushCache(void);
+
+/// Configures the pool of bounce buffers used for unaligned transfers.
+///
+/// Storage drivers can't always access the buffers passed to read() and
+/// write(). For example, DLDI drivers need word-aligned buffers in main RAM,
+/// and the ARM7 can't access DTCM or ITCM. In those cases the data is moved
+/// through a bounce buffer in main RAM, as many sectors at a time as the
+/// buffer can hold. This is also used by NitroFS when reading from the
+/// cartridge into DTCM.
+///
+/// Buffers are allocated the first time they are needed. By default there is
+/// one buffer of 8 sectors (4 KB). If all buffers are in use, or they can't be
+/// allocated, transfers fall back to one sector at a time.
+///
+/// This function must not be called while a transfer is in progress.
+///
+/// @param num_buffers
+///     Number of buffers (up to 4). Use more than one if several threads
+///     access the filesystem at the same time.
+/// @param sectors_per_buffer
+///     Size of each buffer in sectors of 512 bytes. 0 disables the pool.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno to EINVAL.
+int fatInitBounceBuffers(uint32_t num_buffers, uint32_t sectors_per_buffer);
+
+/// Statistics of the FAT sector cache.
+typedef struct {
+    /// Number of sectors requested to the cache that were found in it.
+    uint32_t hits;
+    /// Number of sectors requested to the cache that had to be read from the
+    /// storage device.
+    uint32_t misses;
+    /// Number of read commands sent to the storage device to fill the cache.
+    uint32_t fill_reads;
+    /// Number of sectors read ahead of time because of sequential accesses.
+    uint32_t readahead_sectors;
+    /// Number of sectors read ahead of time that were used later.
+    uint32_t readahead_hits;
+} fat_cache_stats_t;
+
+/// Gets the statistics of the FAT sector cache.
+///
+/// The hit rate is hits / (hits + misses). The efficiency of read-ahead is
+/// readahead_hits / readahead_sectors.
+///
+/// @param stats
+///     Pointer to a struct to be filled with the statistics.
+void fatGetCacheStats(fat_cache_stats_t *stats);
+
+/// Resets the statistics of the FAT sector cache.
+void fatResetCacheStats(void);
+
+/// Statistics of the FAT stat cache.
+typedef struct {
+    /// Number of lookups that were found in the cache.
+    uint32_t hits;
+    /// Number of lookups that had to be resolved by the filesystem.
+    uint32_t misses;
+} fat_stat_cache_stats_t;
+
+/// Enables the stat cache of FAT filesystems.
+///
+/// stat(), access(), FAT_getAttr() and FAT_getShortNameFor() need to walk all
+/// the directories of a path to find it. This cache remembers the results of
+/// the most recent lookups (including files that don't exist), so that checking
+/// the same paths again is fast.
+///
+/// Any function that modifies the filesystem (writing, truncating, renaming or
+/// deleting files, creating directories...) invalidates the whole cache, and so
+/// does chdir(). Paths longer than 127 characters aren't cached.
+///
+/// Each entry uses around 440 bytes of RAM. The cache is disabled by default.
+///
+/// @param num_entries
+///     Number of entries of the cache. Set it to 0 to disable the cache.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno to ENOMEM.
+int fatInitStatCache(uint32_t num_entries);
+
+/// Gets the statistics of the FAT stat cache.
+///
+/// @param stats
+///     Pointer to a struct to be filled with the statistics.
+void fatGetStatCacheStats(fat_stat_cache_stats_t *stats);
+
+/// Resets the statistics of the FAT stat cache.
+void fatResetStatCacheStats(void);
+
+/// Storage devices used by FAT filesystems.
+typedef enum {
+    FAT_IO_DRIVE_DLDI = 0, ///< Flashcard (DLDI driver). Mounted as "fat:".
+    FAT_IO_DRIVE_SD = 1, ///< SD slot of the DSi. Mounted as "sd:".
+    FAT_IO_DRIVE_NAND = 2, ///< NAND of the DSi. Mounted as "nand:" and "nand2:".
+    FAT_IO_DRIVE_RAM = 3, ///< RAM disk. Mounted as "ram:".
+    FAT_IO_DRIVE_COUNT
+} fat_io_drive_t;
+
+/// I/O statistics of a storage device.
+///
+/// Timings are measured with cpuGetTiming(), so they are only valid if
+/// cpuStartTiming() has been called by the application. They are measured in
+/// timer ticks (see timerTicks2usec()).
+typedef struct {
+    /// Number of reads requested by the filesystem.
+    uint32_t read_requests;
+    /// Number of writes requested by the filesystem.
+    uint32_t write_requests;
+    /// Number of read commands sent to the device.
+    uint32_t device_reads;
+    /// Number of sectors read from the device.
+    uint32_t sectors_read;
+    /// Time spent reading from the device.
+    uint32_t read_ticks;
+    /// Number of write commands sent to the device.
+    uint32_t device_writes;
+    /// Number of sectors written to the device.
+    uint32_t sectors_written;
+    /// Time spent writing to the device.
+    uint32_t write_ticks;
+    /// Number of commands that the device has failed.
+    uint32_t errors;
+} fat_io_stats_t;
+
+/// Gets the I/O statistics of a storage device.
+///
+/// @param drive
+///     Storage device.
+/// @param stats
+///     Pointer to a struct to be filled with the statistics.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno to EINVAL.
+int fatGetIoStats(fat_io_drive_t drive, fat_io_stats_t *stats);
+
+/// Resets the I/O statistics of all storage devices.
+void fatResetIoStats(void);
+
+/// Operations recorded in the I/O trace.
+typedef enum {
+    FAT_IO_OP_READ = 0, ///< Read requested by the filesystem, not cacheable.
+    FAT_IO_OP_READ_CACHED = 1, ///< Read requested by the filesystem, cacheable.
+    FAT_IO_OP_WRITE = 2, ///< Write requested by the filesystem.
+    FAT_IO_OP_DEVICE_READ = 3, ///< Read command sent to the device.
+    FAT_IO_OP_DEVICE_WRITE = 4, ///< Write command sent to the device.
+    FAT_IO_OP_WRITEBACK = 5, ///< Dirty sectors flushed by the sector cache.
+} fat_io_op_t;
+
+/// Entry of the I/O trace.
+typedef struct {
+    uint32_t time; ///< Value of cpuGetTiming() when the operation ended.
+    uint32_t sector; ///< First sector.
+    uint32_t count; ///< Number of sectors.
+    uint32_t ticks; ///< Duration of device commands. 0 for other operations.
+    uint8_t drive; ///< Storage device (fat_io_drive_t).
+    uint8_t op; ///< Operation (fat_io_op_t).
+} fat_io_trace_entry_t;
+
+/// Starts recording a trace of all I/O operations of the FAT filesystems.
+///
+/// The trace is stored in a ring buffer. When it is full, the oldest entries
+/// are overwritten. Any previous trace is discarded.
+///
+/// Timings are only valid if cpuStartTiming() has been called.
+///
+/// @param num_entries
+///     Size of the ring buffer in entries.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno (EINVAL or ENOMEM).
+int fatStartIoTrace(uint32_t num_entries);
+
+/// Stops recording the I/O trace and frees the ring buffer.
+void fatStopIoTrace(void);
+
+/// Saves the I/O trace to a text file.
+///
+/// Each line of the file is an entry of the trace, from oldest to newest, with
+/// the format "time,drive,op,sector,count,ticks". The numeric values of drive
+/// and op are the ones of fat_io_drive_t and fat_io_op_t. The first line of
+/// the file is a header with the names of the fields.
+///
+/// Recording is paused while the file is written, so the accesses done to save
+/// the trace aren't recorded.
+///
+/// @param path
+///     Path of the file to create.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno.
+int fatSaveIoTrace(const char *path);
+
 /// This function initializes a lookup cache on a given FAT file.
 /// For NitroFS, use @see nitrofsInitLookupCache instead.
 ///
@@ -130,6 +392,55 @@ static inline int fatInitLookupCacheFile(FILE *file, uint32_t max_buffer_size)
 #define FAT_INIT_LOOKUP_CACHE_OUT_OF_MEMORY     -2
 #define FAT_INIT_LOOKUP_CACHE_ALREADY_ALLOCATED -3
 
+/// Reserves a contiguous area of the filesystem for an empty file.
+///
+/// This is meant for files that are written sequentially, like recordings.
+/// Normally, clusters are allocated one by one as the file grows, and the FAT
+/// is updated every time. After calling this function, writes go to the
+/// reserved clusters with no FAT updates, and big writes are sent straight to
+/// the storage device as multi-sector writes.
+///
+/// The size of the file isn't modified. When the file is closed, any reserved
+/// space that hasn't been used is released. If the file grows beyond the size
+/// of the reserved area, new clusters are allocated normally.
+///
+/// If the application crashes before closing the file the unused clusters
+/// remain allocated. The application can call posix_fallocate() instead to get
+/// a file of the requested size with its contents set to zero.
+///
+/// @param fd
+///     File descriptor of an empty FAT file opened with write access.
+/// @param size
+///     Size to reserve in bytes.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno (ENOSPC if there
+///     isn't enough contiguous free space).
+int fatPreallocate(int fd, off_t size);
+
+/// Enables or disables the automatic creation of look-up caches.
+///
+/// When it is enabled, files opened in read-only mode get a look-up cache
+/// (see fatInitLookupCache()) the first time that lseek() would need to follow
+/// a long section of their cluster chain: backward seeks to a different cluster
+/// or long forward seeks. The cache starts small and it grows to the size
+/// required by the file, up to the specified limit. If the file is too
+/// fragmented to fit in the limit it doesn't get a look-up cache. The cache is
+/// freed when the file is closed.
+///
+/// Files opened with write access never get an automatic look-up cache because
+/// the size of a file can't be increased while it has one.
+///
+/// @param min_file_size
+///     Files smaller than this size (in bytes) don't get a look-up cache.
+/// @param max_buffer_size
+///     Maximum size (in bytes) of a look-up cache. Set it to 0 to disable
+///     automatic look-up caches. If not, it must be at least 16.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno to EINVAL.
+int fatSetAutoLookupCache(uint32_t min_file_size, uint32_t max_buffer_size);
+
 // FAT file attributes
 #define ATTR_ARCHIVE    0x20 ///< Archive
 #define ATTR_DIRECTORY  0x10 ///< Directory
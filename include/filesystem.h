@@ -60,6 +60,123 @@ bool nitroFSExit(void);
 ///     0 if the initialization was successful, a non-zero value on error.
 int nitroFSInitLookupCache(uint32_t max_buffer_size);
 
+/// Sets the DMA channel used to read NitroFS from a slot-1 card on the ARM9.
+///
+/// By default, reads from the card are done by polling the card registers, so
+/// the CPU waits for all the data. If a DMA channel is set, reads are done with
+/// cardReadDma(), and other threads can run while the data is copied. The
+/// application must not use that DMA channel for anything else while NitroFS
+/// is reading from the card. The IRQ_CARD handler is replaced during each
+/// read, and the previous handler is restored after it.
+///
+/// This has no effect if NitroFS is read from a file or from slot-2, or if the
+/// ARM7 reads from the card.
+///
+/// @param channel
+///     DMA channel to use (0 to 3), or -1 to use polled reads.
+///
+/// @return
+///     0 on success, -1 if the channel isn't valid.
+int nitroFSSetCardDmaChannel(int channel);
+
+/// This function builds an index of all NitroFS paths in RAM.
+///
+/// By default, every time a path is resolved (by open(), stat(), etc) the file
+/// name table (FNT) of NitroFS is read from the storage device and each
+/// directory of the path is searched linearly. This function loads the FNT to
+/// RAM and builds a hash table of (directory, name) pairs, so that each
+/// component of a path is found in constant time without accessing the storage
+/// device. Directory listings also use the copy of the FNT in RAM.
+///
+/// The memory used is the size of the FNT plus 8 bytes per file and directory
+/// (with some extra space to keep the hash table efficient). If that is more
+/// than the limit, the index isn't built and NitroFS keeps working without it.
+///
+/// The index is freed by nitroFSExit().
+///
+/// @param max_memory
+///     The maximum amount of memory that the index can use, in bytes.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno: ENODEV if NitroFS
+///     hasn't been initialized or it doesn't have a FNT, ENOMEM if the index
+///     doesn't fit in the limit or there isn't enough memory, EIO if the FNT
+///     is corrupted.
+int nitroFSInitPathIndex(uint32_t max_memory);
+
+/// Statistics of the NitroFS block cache.
+typedef struct {
+    /// Number of blocks found in the cache.
+    uint32_t hits;
+    /// Number of blocks read from the storage device.
+    uint32_t misses;
+    /// Number of reads that were too big for the cache and were done directly.
+    uint32_t bypassed;
+} nitrofs_cache_stats_t;
+
+/// This function initializes the NitroFS block cache.
+///
+/// Every read from a NitroFS file is normally sent directly to the storage
+/// device. When reading from the cartridge this means sending a card command
+/// for every call to read() or fread(), and when reading from an NDS file in
+/// the SD card it means a fseek() and a fread(). This is very slow for parsers
+/// that read small records.
+///
+/// The block cache keeps a few aligned blocks of the ROM in RAM, shared by all
+/// NitroFS files, so that small reads that are close to each other only access
+/// the storage device once. Reads of one block or more bypass the cache. Reads
+/// from Slot-2 always bypass the cache, as it is memory-mapped.
+///
+/// The cache is disabled by default. It can be reconfigured at any point.
+///
+/// @param block_size
+///     Size of each block in bytes. It must be a power of two, 32 or bigger.
+///     Good values are 512 to 4096.
+/// @param num_blocks
+///     Number of blocks. 0 disables the cache and frees its memory.
+///
+/// @return
+///     0 on success. On error it returns -1 and sets errno to EINVAL (invalid
+///     block size) or ENOMEM.
+int nitroFSInitCache(uint32_t block_size, uint32_t num_blocks);
+
+/// Gets the statistics of the NitroFS block cache.
+///
+/// @param stats
+///     Pointer to a struct to be filled with the statistics.
+void nitroFSGetCacheStats(nitrofs_cache_stats_t *stats);
+
+/// Resets the statistics of the NitroFS block cache.
+void nitroFSResetCacheStats(void);
+
+/// Enables or disables transparent decompression of NitroFS files.
+///
+/// When it's enabled, files that start with a valid header of the compression
+/// formats supported by the BIOS (LZ77 with type 0x10, Huffman with type 0x24
+/// or 0x28, and RLE with type 0x30) are decompressed while they are read. LZ4
+/// is supported too, with type 0x60: the header is followed by a LZ4 block,
+/// as created by LZ4_compress_default(), without the LZ4 frame format. For
+/// those files, read() returns the decompressed data, and stat() and fstat()
+/// report the decompressed size. This saves storage bandwidth, and it avoids
+/// the need to load the compressed file in RAM before calling decompress().
+///
+/// Data is decompressed with a streaming decoder that uses a small input
+/// buffer, so the memory used doesn't depend on the size of the file. LZ77
+/// files also need 4 KiB for the window of previous data, and LZ4 files need
+/// 64 KiB. Seeking forwards is done by decompressing and discarding data.
+/// Seeking backwards requires decompressing the file from the start, so it is
+/// slow.
+///
+/// Files are only identified by their header, so uncompressed files that
+/// happen to start with a valid header will be decompressed as well. Only
+/// enable this if all files that are opened while it's enabled are known to be
+/// compressed, or known not to start with a compression header. It only
+/// affects files opened after calling this function.
+///
+/// @param enable
+///     True to enable decompression, false to disable it (default).
+void nitroFSSetDecompression(bool enable);
+
 /// Open a NitroFS file descriptor directly by its FAT offset ID.
 ///
 /// This FAT offset ID can be sourced from functions like @see stat,
@@ -93,6 +210,38 @@ int nitroFSOpenById(uint16_t id);
 WARN_UNUSED_RESULT
 FILE *nitroFSFopenById(uint16_t id, const char *mode);
 
+/// Gets a read-only pointer to the contents of an open NitroFS file.
+///
+/// If NitroFS is being read from Slot-2 the file is already mapped in the
+/// address space of the ARM9, so this returns a pointer to the file inside the
+/// Slot-2 cartridge without allocating or copying anything. The ARM9 must keep
+/// ownership of the Slot-2 bus while the pointer is used. Slot-2 memory can't
+/// be accessed with 8-bit writes, but it is read-only anyway.
+///
+/// In any other case (DS cartridge, NDS file in a SD card) the whole file is
+/// loaded into a buffer allocated with malloc().
+///
+/// The current position of the file descriptor isn't used or modified. The
+/// pointer remains valid after the file is closed, until it is released with
+/// nitroFSUnmapFile().
+///
+/// @param fd
+///     File descriptor of a NitroFS file.
+/// @param size
+///     Pointer to a variable to store the size of the file. It can be NULL.
+///
+/// @return
+///     A pointer to the contents of the file. On error it returns NULL and sets
+///     errno.
+WARN_UNUSED_RESULT
+const void *nitroFSMapFile(int fd, size_t *size);
+
+/// Releases a pointer returned by nitroFSMapFile().
+///
+/// @param ptr
+///     Pointer returned by nitroFSMapFile().
+void nitroFSUnmapFile(const void *ptr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -103,6 +103,48 @@ void glBegin2D(void);
 /// The compliment of glBegin2D().
 void glEnd2D(void);
 
+/// Enables batch mode for glSprite().
+///
+/// In batch mode glSprite() doesn't draw anything right away. Quads are stored
+/// in a buffer, and they are drawn when glEnd2D() is called, sorted by texture
+/// so that each texture is only bound once. Each group of quads that uses the
+/// same texture is sent to the GPU as a packed list by DMA.
+///
+/// Only glSprite() is batched. The other functions, like glSpriteScale(),
+/// glSpriteRotate() or glBoxFilled(), still draw right away, before the quads
+/// that are in the buffer.
+///
+/// Quads are only sorted by texture name. Palettes aren't part of the sort
+/// key: each run of quads is drawn with the palette that glBindTexture()
+/// selects for its texture, so changing the active palette between calls to
+/// glSprite() has no effect in batch mode.
+///
+/// The depth of each quad is kept, so opaque sprites look the same as when
+/// they are drawn right away. However, the color and polygon attributes active
+/// when the quads are drawn are used instead of the ones active when
+/// glSprite() was called. Translucent sprites may be blended in a different
+/// order.
+///
+/// If the buffer is full, the quads in it are drawn before recording more.
+///
+/// @param max_quads
+///     Number of quads that can be stored in the buffer.
+///
+/// @return
+///     0 on success, -1 if there isn't enough memory.
+int glBatch2DInit(size_t max_quads);
+
+/// Disables batch mode and frees its buffers.
+///
+/// Quads that haven't been drawn yet are drawn before disabling it.
+void glBatch2DFree(void);
+
+/// Draws all quads stored in the batch buffer.
+///
+/// This is useful to draw sprites before changing the color or the polygon
+/// attributes. It is called automatically by glEnd2D().
+void glBatch2DFlush(void);
+
 /// Returns the active texture. Use with care.
 ///
 /// Needed to achieve some effects since libnds 1.5.0.
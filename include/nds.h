@@ -25,6 +25,7 @@
 /// - @ref nds/arm9/videoGL.h "OpenGL (ish)"
 /// - @ref nds/arm9/boxtest.h "Box Test"
 /// - @ref nds/arm9/postest.h "Position test"
+/// - @ref nds/arm9/textureCache.h "Texture cache"
 /// - @ref gl2d.h "GL2D: 2D graphics using 3D"
 ///
 /// @section audio_api Audio API
@@ -183,6 +184,7 @@ extern "C" {
 #    include <nds/arm9/sdmmc.h>
 #    include <nds/arm9/sound.h>
 #    include <nds/arm9/sprite.h>
+#    include <nds/arm9/textureCache.h>
 #    include <nds/arm9/trig_lut.h>
 #    include <nds/arm9/video.h>
 #    include <nds/arm9/videoGL.h>
@@ -7,10 +7,11 @@
 
 /// @file nds/arm9/card.h
 ///
-/// @brief Slot-1 and Slot-2 ARM7 read functions.
+/// @brief Slot-1 ARM7 and asynchronous read functions.
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /// Function that asks the ARM7 to read from the slot-1 using card commands.
 ///
@@ -27,4 +28,97 @@
 ///     On error it returns true. On success, it returns false.
 bool cardReadArm7(void *dest, size_t offset, size_t size, uint32_t flags);
 
+/// Asynchronous card read request.
+///
+/// The fields are private, use cardReadAsyncSubmit() to fill them. The struct
+/// must remain valid until the request has finished.
+typedef struct card_read_async {
+    struct card_read_async *next;
+    uint8_t *dest;
+    uint32_t offset;
+    uint32_t remaining;
+    uint32_t flags;
+    uint8_t channel;
+    volatile bool done;
+} card_read_async_t;
+
+/// Queues a read from the slot-1 card ROM that is done by DMA in the background.
+///
+/// The read is split in 512-byte card commands. The DMA copies each block to
+/// the destination as the card provides it, and the card transfer completion
+/// interrupt starts the next command, so the CPU is free during the transfer.
+/// Requests are served in the order they are submitted.
+///
+/// The ARM9 must own the slot-1 bus. This function replaces the IRQ_CARD
+/// handler while there are requests in progress, so it can't be used by the
+/// application at the same time. The previous handler is restored when all
+/// requests have finished. Functions like cardRead() or cardParamCommand() must
+/// not be used while there are requests in progress.
+///
+/// The destination buffer is flushed from the data cache by this function. It
+/// must not be accessed until the request has finished.
+///
+/// @param req
+///     Request struct to use.
+/// @param dest
+///     Destination buffer. It must be in main RAM and aligned to a cache line.
+/// @param offset
+///     NDS ROM offset to read. It must be a multiple of 512.
+/// @param size
+///     Size in bytes to read. It must be a multiple of 512.
+/// @param flags
+///     The read flags.
+/// @param channel
+///     DMA channel to use (0 to 3).
+///
+/// @return
+///     It returns true if the request has been queued, false if the arguments
+///     aren't valid.
+bool cardReadAsyncSubmit(card_read_async_t *req, void *dest, size_t offset,
+                         size_t size, uint32_t flags, int channel);
+
+/// Checks if an asynchronous card read has finished.
+///
+/// @param req
+///     Request to check.
+///
+/// @return
+///     It returns true if the request has finished, false otherwise.
+static inline bool cardReadAsyncPoll(const card_read_async_t *req)
+{
+    return req->done;
+}
+
+/// Waits until an asynchronous card read has finished.
+///
+/// Other threads run while this thread waits. If there aren't other threads,
+/// the CPU is halted until the next card interrupt.
+///
+/// @param req
+///     Request to wait for.
+void cardReadAsyncWait(card_read_async_t *req);
+
+/// Reads from the slot-1 card ROM using DMA, waiting until the read is done.
+///
+/// This is a blocking version of cardReadAsyncSubmit() that accepts any offset,
+/// size and destination. The unaligned start and end of the read are done with
+/// cardRead(). If the destination can't be used for DMA (it isn't aligned to a
+/// cache line or it isn't in main RAM), the data is read by DMA into an 8 KiB
+/// buffer allocated the first time it's needed, and copied from there. Only if
+/// that buffer can't be allocated, or if the DMA channel isn't valid, the whole
+/// read is done with cardRead(). Other threads run while the DMA is active.
+///
+/// @param dest
+///     Destination buffer.
+/// @param offset
+///     NDS ROM offset to read.
+/// @param size
+///     Size in bytes to read.
+/// @param flags
+///     The read flags.
+/// @param channel
+///     DMA channel to use (0 to 3).
+void cardReadDma(void *dest, size_t offset, size_t size, uint32_t flags,
+                 int channel);
+
 #endif // LIBNDS_NDS_ARM9_CARD_H__
@@ -123,6 +123,86 @@ bool nand_WriteSectorsCrypt(sec_t sector, sec_t numSectors, const void *buffer);
 ///     Manually calling functions to write to the nand will still go through
 void nand_WriteProtect(bool protect);
 
+/// State of a streaming read from the SD card or the eMMC NAND.
+///
+/// All fields are private.
+typedef struct {
+    u8 *buffer;
+    sec_t chunkSectors;
+    sec_t nextSector;
+    sec_t remaining;
+    sec_t pendingSectors;
+    u32 result;
+    u8 pendingIndex;
+    u8 device;
+    volatile bool pending;
+    volatile bool waiting;
+} sdmmc_read_stream_t;
+
+/// Starts a streaming read from the SD card or the eMMC NAND.
+///
+/// The read is split in chunks. The ARM7 reads the next chunk into one half of
+/// the buffer while the ARM9 uses the data of the previous chunk in the other
+/// half, so the ARM9 doesn't need to wait for the whole transfer.
+///
+/// The first chunk is requested before this function returns. Call
+/// sdmmc_ReadStreamNext() to get chunks of data until it returns NULL.
+///
+/// While the ARM7 is reading a chunk, the storage FIFO channel is reserved by
+/// the stream. Other SD and NAND functions wait for the chunk to be finished
+/// before they send their own commands, but DLDI and DS cartridge functions
+/// don't: they must not be used by the thread that owns the stream until the
+/// stream has finished or sdmmc_ReadStreamEnd() has been called.
+///
+/// Streams don't use the encryption of the NAND. Only one stream can be
+/// active at a time.
+///
+/// @param stream
+///     Stream state.
+/// @param device
+///     SDMMC_DEVICE_SD or SDMMC_DEVICE_NAND.
+/// @param sector
+///     The start sector.
+/// @param numSectors
+///     The number of sectors to read.
+/// @param buffer
+///     Buffer with space for 2 * chunkSectors sectors. It must be in main RAM
+///     and aligned to the size of a cache line.
+/// @param chunkSectors
+///     Number of sectors of each chunk.
+///
+/// @return
+///     Returns true on success or false on failure.
+bool sdmmc_ReadStreamStart(sdmmc_read_stream_t *stream, int device,
+                           sec_t sector, sec_t numSectors,
+                           void *buffer, sec_t chunkSectors);
+
+/// Gets the next chunk of a streaming read.
+///
+/// It waits for the chunk to be read, and it asks the ARM7 to start reading
+/// the following chunk into the other half of the buffer. The data returned is
+/// valid until the next call to this function or to sdmmc_ReadStreamEnd().
+///
+/// @param stream
+///     Stream state.
+/// @param[out] numSectors
+///     Number of sectors in the returned chunk.
+///
+/// @return
+///     A pointer to the data of the chunk. It returns NULL when all sectors
+///     have been read, or on failure.
+const void *sdmmc_ReadStreamNext(sdmmc_read_stream_t *stream, sec_t *numSectors);
+
+/// Stops a streaming read.
+///
+/// It waits for the chunk that is being read (if any) and releases the storage
+/// FIFO channel. It's only needed if the stream is stopped before
+/// sdmmc_ReadStreamNext() has returned NULL.
+///
+/// @param stream
+///     Stream state.
+void sdmmc_ReadStreamEnd(sdmmc_read_stream_t *stream);
+
 // Compatibility macros.
 #define nand_GetSize nand_GetSectors
 
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+/// @file nds/arm9/textureCache.h
+///
+/// @brief Texture cache that keeps the most recently used textures in VRAM.
+///
+/// Textures are registered with a source in RAM or in the filesystem. When a
+/// texture that isn't in VRAM is bound, it is loaded to VRAM the next time
+/// glTexCacheUpdate() is called, evicting the least recently used textures if
+/// there isn't enough space. This lets a program use more textures than fit in
+/// VRAM at the same time.
+///
+/// Textures in the filesystem are read to RAM by glTexCachePrefetch(), which
+/// must be called outside of the VBlank period, before glTexCacheUpdate() can
+/// load them. A typical frame looks like this:
+///
+/// ```
+/// // Draw the scene with glTexCacheBind()
+/// glTexCachePrefetch();
+/// glFlush(0);
+/// swiWaitForVBlank();
+/// glTexCacheUpdate();
+/// ```
+///
+/// The cache uses glGenTextures(), glTexImageNtr2D() and glColorTableNtr()
+/// internally, so glResetTextures() must not be called while the cache is
+/// active.
+
+#ifndef LIBNDS_NDS_ARM9_TEXTURECACHE_H__
+#define LIBNDS_NDS_ARM9_TEXTURECACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nds/arm9/videoGL.h>
+
+/// Description of a texture and where to load it from.
+typedef struct {
+    GL_TEXTURE_TYPE_ENUM type; ///< Texture format
+    int sizeX; ///< Width, as accepted by glTexImageNtr2D()
+    int sizeY; ///< Height, as accepted by glTexImageNtr2D()
+    int param; ///< Parameters, as accepted by glTexImageNtr2D()
+
+    /// Texture data in RAM. It must remain valid while the texture is
+    /// registered. If it's NULL, the texture is loaded from "path".
+    const void *texture;
+    /// Path of the file with the texture data. It is copied by
+    /// glTexCacheRegister().
+    const char *path;
+    /// Offset of the texture data in the file. In GL_COMPRESSED textures the
+    /// extra data must follow the texture data.
+    size_t offset;
+
+    /// Palette in RAM (or NULL if the texture doesn't have a palette). It must
+    /// remain valid while the texture is registered.
+    const void *palette;
+    size_t num_colors; ///< Number of colors of the palette
+} gl_tex_cache_source_t;
+
+/// Statistics of the texture cache.
+typedef struct {
+    uint32_t hits; ///< Binds of textures that were in VRAM
+    uint32_t misses; ///< Binds of textures that weren't in VRAM
+    uint32_t evictions; ///< Textures removed from VRAM to make space
+    uint32_t uploads; ///< Textures loaded to VRAM
+    uint32_t bytes_uploaded; ///< Bytes of texture and palette data loaded
+    uint32_t resident_bytes; ///< Bytes of VRAM used by the cache right now
+} gl_tex_cache_stats_t;
+
+/// Initializes the texture cache.
+///
+/// glInit() must have been called before.
+///
+/// @param budget
+///     Maximum number of bytes of VRAM (textures and palettes) used by the
+///     cache. If it's 0, the cache uses as much VRAM as it can get.
+/// @param upload_limit
+///     Maximum number of bytes loaded to VRAM in each call to
+///     glTexCacheUpdate(), and read from files in each call to
+///     glTexCachePrefetch(). At least one texture is always loaded. If it's 0
+///     there is no limit.
+///
+/// @return
+///     0 on success, -1 on error.
+int glTexCacheInit(size_t budget, size_t upload_limit);
+
+/// Removes all textures of the cache from VRAM and frees all memory used by it.
+void glTexCacheExit(void);
+
+/// Registers a texture in the cache.
+///
+/// The texture isn't loaded to VRAM until it's used.
+///
+/// @param source
+///     Description of the texture.
+///
+/// @return
+///     Handle of the texture (greater than 0), or -1 on error.
+int glTexCacheRegister(const gl_tex_cache_source_t *source);
+
+/// Removes a texture from the cache, and from VRAM if it's loaded.
+///
+/// @param handle
+///     Handle returned by glTexCacheRegister().
+void glTexCacheUnregister(int handle);
+
+/// Binds a texture of the cache and marks it as used in this frame.
+///
+/// If the texture isn't in VRAM it is scheduled to be loaded in the next call
+/// to glTexCacheUpdate(), and no texture is bound. Textures in the filesystem
+/// need a call to glTexCachePrefetch() before that.
+///
+/// @param handle
+///     Handle returned by glTexCacheRegister().
+///
+/// @return
+///     1 if the texture has been bound, 0 if it isn't in VRAM yet.
+int glTexCacheBind(int handle);
+
+/// Loads a texture to VRAM right away if it isn't loaded already.
+///
+/// This is meant to be used during loading screens, as it changes the mapping
+/// of the VRAM banks. If there isn't enough free VRAM, it calls
+/// glCompactTextures() once before evicting textures, which may move textures
+/// that are already in VRAM.
+///
+/// @param handle
+///     Handle returned by glTexCacheRegister().
+///
+/// @return
+///     1 on success, 0 if it couldn't be loaded.
+int glTexCachePreload(int handle);
+
+/// Reads the data of scheduled textures in the filesystem to RAM.
+///
+/// It must be called once per frame, outside of the VBlank period, as reading
+/// files may take a long time. The data is kept in RAM until the texture is
+/// loaded to VRAM by glTexCacheUpdate(). It reads up to the upload limit of
+/// glTexCacheInit() in each call. Textures whose file can't be read aren't
+/// scheduled anymore.
+void glTexCachePrefetch(void);
+
+/// Loads all scheduled textures that are ready to VRAM and starts a new frame.
+///
+/// It must be called right after swiWaitForVBlank(), once per frame. It only
+/// copies data that is in RAM to VRAM: textures in the filesystem are skipped
+/// until glTexCachePrefetch() has read them. Textures are only evicted to make
+/// space for textures that are ready. Textures used in the frame that has just
+/// ended aren't evicted, as the GPU is still going to use them to render it.
+///
+/// This function never compacts VRAM because it would move textures that the
+/// GPU is going to use. If the free VRAM becomes too fragmented, call
+/// glCompactTextures() or glTexCachePreload() when nothing is being rendered.
+void glTexCacheUpdate(void);
+
+/// Gets the statistics of the texture cache.
+///
+/// @param stats
+///     Pointer to the struct to be filled.
+void glTexCacheGetStats(gl_tex_cache_stats_t *stats);
+
+/// Resets the statistics of the texture cache (except for resident_bytes).
+void glTexCacheResetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBNDS_NDS_ARM9_TEXTURECACHE_H__
@@ -421,6 +421,25 @@ enum GLFLUSH_ENUM
 #define FIFO_FLUSH              REG2ID(GFX_FLUSH)        ///< Flush the 3D context
 #define FIFO_VIEWPORT           REG2ID(GFX_VIEWPORT)     ///< Set the viewport
 
+#define FIFO_VERTEX_DIFF        REG2ID(GFX_VERTEX_DIFF)  ///< Vertex relative to the last one
+#define FIFO_BOX_TEST           REG2ID(GFX_BOX_TEST)     ///< Test if a box is in the view volume
+#define FIFO_POS_TEST           REG2ID(GFX_POS_TEST)     ///< Transform a position
+#define FIFO_VEC_TEST           REG2ID(GFX_VEC_TEST)     ///< Transform a direction vector
+
+#define FIFO_MATRIX_MODE        REG2ID(MATRIX_CONTROL)   ///< Set the current matrix mode
+#define FIFO_MATRIX_PUSH        REG2ID(MATRIX_PUSH)      ///< Push the current matrix
+#define FIFO_MATRIX_POP         REG2ID(MATRIX_POP)       ///< Pop matrices from the stack
+#define FIFO_MATRIX_STORE       REG2ID(MATRIX_STORE)     ///< Store the current matrix
+#define FIFO_MATRIX_RESTORE     REG2ID(MATRIX_RESTORE)   ///< Restore the current matrix
+#define FIFO_MATRIX_IDENTITY    REG2ID(MATRIX_IDENTITY)  ///< Load the identity matrix
+#define FIFO_MATRIX_LOAD4x4     REG2ID(MATRIX_LOAD4x4)   ///< Load a 4x4 matrix
+#define FIFO_MATRIX_LOAD4x3     REG2ID(MATRIX_LOAD4x3)   ///< Load a 4x3 matrix
+#define FIFO_MATRIX_MULT4x4     REG2ID(MATRIX_MULT4x4)   ///< Multiply by a 4x4 matrix
+#define FIFO_MATRIX_MULT4x3     REG2ID(MATRIX_MULT4x3)   ///< Multiply by a 4x3 matrix
+#define FIFO_MATRIX_MULT3x3     REG2ID(MATRIX_MULT3x3)   ///< Multiply by a 3x3 matrix
+#define FIFO_MATRIX_SCALE       REG2ID(MATRIX_SCALE)     ///< Multiply by a scale matrix
+#define FIFO_MATRIX_TRANSLATE   REG2ID(MATRIX_TRANSLATE) ///< Multiply by a translation matrix
+
 /// Rotates the model view matrix by angle about the specified unit vector.
 ///
 /// @param angle
@@ -827,6 +846,25 @@ int glDeleteTextures(int n, int *names);
 /// Resets the GL texture state freeing all texture and texture palette memory.
 void glResetTextures(void);
 
+/// Moves textures and palettes in VRAM to remove the free space between them.
+///
+/// After loading and deleting textures for a while, the free VRAM may be split
+/// in many small holes, and loading a big texture may fail even if there is
+/// enough free VRAM in total. This function moves all textures and palettes as
+/// low as possible in VRAM and updates their addresses, so that all the free
+/// space ends up together.
+///
+/// Compressed textures (GL_COMPRESSED) aren't moved.
+///
+/// The VRAM banks are set to LCD mode while the data is moved, so this should
+/// only be called when 3D graphics aren't being displayed (during a loading
+/// screen, for example). Pointers returned by glGetTexturePointer() and
+/// glGetColorTablePointer() become invalid.
+///
+/// @return
+///     1 on success, 0 on failure.
+int glCompactTextures(void);
+
 /// Locks a designated VRAM bank to prevent consideration of the bank when
 /// allocating textures.
 ///
@@ -872,6 +910,51 @@ void glMaterialf(GL_MATERIALS_ENUM mode, rgb color);
 ///     Pointer to the packed list.
 void glCallList(const void *list);
 
+/// Sends a packed list of commands into the graphics FIFO without waiting.
+///
+/// The list is added to a queue of lists that are sent one after the other by
+/// DMA channel 0, driven by the DMA interrupt, so the CPU can keep working
+/// while the lists are sent. This function only blocks if the queue is full.
+///
+/// A list can't be started while DMA channels 1 to 3 are active because of a
+/// hardware bug. In that case the start is retried in the next VBlank. The
+/// VBlank handler set by the user is still called, and it is restored after
+/// the retry.
+///
+/// The list must not be modified or freed until its fence has been signaled.
+/// No other commands can be sent to the GPU until then either, as they would
+/// be mixed with the commands of the list. glCallList() and glFlush() wait for
+/// all lists sent with this function before sending their own commands.
+///
+/// @note
+///     This function takes over the handler of IRQ_DMA0.
+///
+/// @param list
+///     Pointer to the packed list, in the same format as glCallList().
+///
+/// @return
+///     Fence to be used with glCallListAsyncDone() and glCallListAsyncWait().
+u32 glCallListAsync(const void *list);
+
+/// Checks if a list sent with glCallListAsync() has been sent to the GPU.
+///
+/// This also means that all lists sent before it have been sent.
+///
+/// @param fence
+///     Fence returned by glCallListAsync().
+///
+/// @return
+///     true if the list has been sent, false otherwise.
+bool glCallListAsyncDone(u32 fence);
+
+/// Waits until a list sent with glCallListAsync() has been sent to the GPU.
+///
+/// If called from a cothread, other threads run while it waits.
+///
+/// @param fence
+///     Fence returned by glCallListAsync().
+void glCallListAsyncWait(u32 fence);
+
 /// Used in glPolyFmt() to set the alpha level for the following polygons.
 ///
 /// Set to 0 for wireframe mode.
@@ -1167,13 +1250,12 @@ static inline void glViewport(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
 /// It lets you specify some 3D options: enabling Y-sorting of translucent
 /// polygons and W-Buffering of all vertices.
 ///
+/// Before swapping the buffers it waits until all lists sent with
+/// glCallListAsync() have been sent to the GPU.
+///
 /// @param mode
 ///     Flags from GLFLUSH_ENUM.
-static inline void glFlush(u32 mode)
-{
-    COMPILER_MEMORY_BARRIER();
-    GFX_FLUSH = mode;
-}
+void glFlush(u32 mode);
 
 /// Generate a linear table of values for GL_SPECULAR materials.
 ///
@@ -1952,6 +2034,189 @@ static inline void gluPerspective(float fovy, float aspect, float zNear, float z
 ///     Float version! Please, use glTexCoord2t16() instead.
 void glTexCoord2f(float s, float t);
 
+// Display lists
+// -------------
+
+/// Display list being recorded.
+///
+/// Commands are packed in groups of up to four commands per header word, and
+/// the result can be sent to the GPU with glCallList(). The fields of this
+/// struct must not be modified by the user.
+typedef struct {
+    u32 *buffer; ///< Packed list. The first word is reserved for its size.
+    u32 size; ///< Number of words used in the buffer.
+    u32 capacity; ///< Number of words allocated for the buffer.
+    u32 header; ///< Index of the header that is being filled (0 if none)
+    u8 header_commands; ///< Number of commands in the current header
+    u8 header_params; ///< Number of parameters of the current header
+    bool error; ///< Set if the buffer couldn't be enlarged
+} gl_list_t;
+
+/// Initializes a display list.
+///
+/// The buffer grows as needed, so the initial size is only a hint.
+///
+/// @param list
+///     List to initialize.
+/// @param initial_words
+///     Initial size of the buffer in words.
+///
+/// @return
+///     0 on success, -1 if there isn't enough memory.
+int glListInit(gl_list_t *list, size_t initial_words);
+
+/// Frees the buffer of a display list.
+///
+/// @param list
+///     List to free.
+void glListFree(gl_list_t *list);
+
+/// Removes all commands from a display list without freeing its buffer.
+///
+/// @param list
+///     List to reset.
+void glListReset(gl_list_t *list);
+
+/// Adds a command to a display list.
+///
+/// @param list
+///     List to add the command to.
+/// @param command
+///     Command ID (FIFO_BEGIN, FIFO_VERTEX16, etc).
+/// @param params
+///     Parameters of the command.
+/// @param num_params
+///     Number of parameters. It must match the number that the command uses.
+void glListCommand(gl_list_t *list, uint8_t command, const u32 *params,
+                   size_t num_params);
+
+/// Closes a display list so that it can be used with glCallList().
+///
+/// More commands can be added to the list after calling this function, but it
+/// needs to be called again before the list can be used.
+///
+/// Remember that glCallList() uses DMA, so the cache must be flushed before
+/// calling it (DC_FlushRange(list->buffer, list->size * 4)).
+///
+/// @param list
+///     List to close.
+///
+/// @return
+///     Pointer to the list to be passed to glCallList(), or NULL if the buffer
+///     couldn't be enlarged while recording commands.
+const void *glListFinish(gl_list_t *list);
+
+/// Adds a command without parameters to a display list.
+///
+/// @param list
+///     List to add the command to.
+/// @param command
+///     Command ID.
+static inline void glListCommand0(gl_list_t *list, uint8_t command)
+{
+    glListCommand(list, command, NULL, 0);
+}
+
+/// Adds a command with one parameter to a display list.
+///
+/// @param list
+///     List to add the command to.
+/// @param command
+///     Command ID.
+/// @param param
+///     Parameter of the command.
+static inline void glListCommand1(gl_list_t *list, uint8_t command, u32 param)
+{
+    glListCommand(list, command, &param, 1);
+}
+
+/// Records glBegin() in a display list.
+static inline void glListBegin(gl_list_t *list, GL_GLBEGIN_ENUM mode)
+{
+    glListCommand1(list, FIFO_BEGIN, mode);
+}
+
+/// Records glEnd() in a display list.
+static inline void glListEnd(gl_list_t *list)
+{
+    glListCommand0(list, FIFO_END);
+}
+
+/// Records glColor() in a display list.
+static inline void glListColor(gl_list_t *list, rgb color)
+{
+    glListCommand1(list, FIFO_COLOR, color);
+}
+
+/// Records glNormal() in a display list.
+static inline void glListNormal(gl_list_t *list, u32 normal)
+{
+    glListCommand1(list, FIFO_NORMAL, normal);
+}
+
+/// Records glTexCoord2t16() in a display list.
+static inline void glListTexCoord2t16(gl_list_t *list, t16 u, t16 v)
+{
+    glListCommand1(list, FIFO_TEX_COORD, TEXTURE_PACK(u, v));
+}
+
+/// Records glVertex3v16() in a display list.
+static inline void glListVertex3v16(gl_list_t *list, v16 x, v16 y, v16 z)
+{
+    u32 params[2] = { ((u32)(u16)y << 16) | (x & 0xFFFF), (u16)z };
+    glListCommand(list, FIFO_VERTEX16, params, 2);
+}
+
+/// Records glVertex2v16() in a display list.
+static inline void glListVertex2v16(gl_list_t *list, v16 x, v16 y)
+{
+    glListCommand1(list, FIFO_VERTEX_XY, ((u32)(u16)y << 16) | (x & 0xFFFF));
+}
+
+/// Records glPolyFmt() in a display list.
+static inline void glListPolyFmt(gl_list_t *list, u32 params)
+{
+    glListCommand1(list, FIFO_POLY_FORMAT, params);
+}
+
+/// Records glMatrixMode() in a display list.
+static inline void glListMatrixMode(gl_list_t *list, GL_MATRIX_MODE_ENUM mode)
+{
+    glListCommand1(list, FIFO_MATRIX_MODE, mode);
+}
+
+/// Records glPushMatrix() in a display list.
+static inline void glListPushMatrix(gl_list_t *list)
+{
+    glListCommand0(list, FIFO_MATRIX_PUSH);
+}
+
+/// Records glPopMatrix() in a display list.
+static inline void glListPopMatrix(gl_list_t *list, int num)
+{
+    glListCommand1(list, FIFO_MATRIX_POP, num);
+}
+
+/// Records glLoadIdentity() in a display list.
+static inline void glListLoadIdentity(gl_list_t *list)
+{
+    glListCommand0(list, FIFO_MATRIX_IDENTITY);
+}
+
+/// Records glTranslatef32() in a display list.
+static inline void glListTranslatef32(gl_list_t *list, int x, int y, int z)
+{
+    u32 params[3] = { x, y, z };
+    glListCommand(list, FIFO_MATRIX_TRANSLATE, params, 3);
+}
+
+/// Records glScalef32() in a display list.
+static inline void glListScalef32(gl_list_t *list, int x, int y, int z)
+{
+    u32 params[3] = { x, y, z };
+    glListCommand(list, FIFO_MATRIX_SCALE, params, 3);
+}
+
 #ifdef __cplusplus
 }
 #endif
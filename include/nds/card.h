@@ -289,6 +289,91 @@ void cardEepromChipErase(void);
 ///     The address to erase at.
 void cardEepromSectorErase(u32 address);
 
+/// Statistics of the card save manager.
+typedef struct {
+    uint32_t bytes_programmed; ///< Bytes sent to the chip to be programmed
+    uint32_t pages_programmed; ///< Pages sent to the chip to be programmed
+    uint32_t pages_unchanged; ///< Modified pages that matched the chip contents
+    uint32_t sectors_erased; ///< FLASH sectors erased
+    uint32_t pages_failed; ///< Pages that didn't match the data after programming them
+} card_save_stats_t;
+
+/// Initializes the card save manager.
+///
+/// The save manager keeps a copy of the save data in RAM. cardSaveRead() and
+/// cardSaveWrite() only access that copy, and cardSaveFlush() only programs
+/// the pages of the chip that have been modified, which is much faster than
+/// writing the whole save data with cardWriteEeprom().
+///
+/// The size is rounded up to a multiple of the page size of the chip. For FLASH
+/// chips it is rounded up to a multiple of 64 KiB (the size of a sector), as
+/// pages can only be reprogrammed by erasing the full sector.
+///
+/// @param size
+///     Size of the save data to manage, starting at address 0. If it's 0, the
+///     full size of the chip is used.
+///
+/// @return
+///     0 on success, -1 on error (and errno is set).
+int cardSaveInit(uint32_t size);
+
+/// Frees the copy of the save data without flushing it.
+void cardSaveExit(void);
+
+/// Reads data from the copy of the save data in RAM.
+///
+/// @param offset
+///     Offset to read from.
+/// @param data
+///     Destination buffer.
+/// @param length
+///     Number of bytes to read.
+///
+/// @return
+///     0 on success, -1 on error (and errno is set).
+int cardSaveRead(uint32_t offset, void *data, uint32_t length);
+
+/// Writes data to the copy of the save data in RAM.
+///
+/// Pages whose contents change are marked as dirty. They aren't written to the
+/// chip until cardSaveFlush() is called, so multiple writes to the same page
+/// only program it once.
+///
+/// @param offset
+///     Offset to write to.
+/// @param data
+///     Source buffer.
+/// @param length
+///     Number of bytes to write.
+///
+/// @return
+///     0 on success, -1 on error (and errno is set).
+int cardSaveWrite(uint32_t offset, const void *data, uint32_t length);
+
+/// Programs all dirty pages to the chip.
+///
+/// In EEPROM chips only dirty pages are programmed. In FLASH chips, pages are
+/// programmed directly if they only need to clear bits. If not, the sector is
+/// erased and all pages of the sector that aren't empty are programmed again.
+///
+/// All programmed pages are read back and compared with the copy in RAM. Pages
+/// that don't match stay dirty, so they are programmed again the next time
+/// cardSaveFlush() is called.
+///
+/// @return
+///     0 on success, -1 on error (and errno is set to EIO if any page couldn't
+///     be verified).
+int cardSaveFlush(void);
+
+/// Gets the statistics of the card save manager.
+///
+/// @param stats
+///     Pointer to the struct to be filled.
+void cardSaveGetStats(card_save_stats_t *stats);
+
+/// Resets the statistics of the card save manager.
+void cardSaveResetStats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,6 +21,7 @@ extern "C" {
 
 #define DEVICE_TYPE_DSI_SD          ('_') | ('S' << 8) | ('D' << 16) | ('_' << 24)
 #define DEVICE_TYPE_DSI_NAND        ('N') | ('A' << 8) | ('N' << 16) | ('D' << 24)
+#define DEVICE_TYPE_RAM_DISK        ('R') | ('A' << 8) | ('M' << 16) | ('D' << 24)
 
 typedef bool (*FN_MEDIUM_STARTUP)(void);
 typedef bool (*FN_MEDIUM_ISINSERTED)(void);
@@ -109,6 +110,30 @@ const DISC_INTERFACE *get_io_dsinand(void);
 /// Return the internal DSi SD card interface.
 const DISC_INTERFACE *get_io_dsisd(void);
 
+/// Sets the memory used by the RAM disk interface.
+///
+/// The memory can be in main RAM, in the extended RAM of the DSi, or in a
+/// Slot-2 RAM expansion pak (which must be unlocked by the caller).
+///
+/// @param buffer
+///     Word-aligned buffer that holds the contents of the disk. If it's NULL,
+///     the RAM disk is disabled.
+/// @param numSectors
+///     Size of the buffer in 512-byte sectors.
+///
+/// @return
+///     True on success, false if the buffer isn't aligned.
+bool ramdiskSetup(void *buffer, sec_t numSectors);
+
+/// Return the size of the RAM disk.
+///
+/// @return
+///     Size of the RAM disk in 512-byte sectors.
+sec_t ramdiskGetSectors(void);
+
+/// Return the RAM disk interface, or NULL if ramdiskSetup() hasn't been called.
+const DISC_INTERFACE *get_io_ramdisk(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -69,6 +69,25 @@ typedef struct
 #define DT_LNK 6
 #define DT_SOCK 7
 
+struct stat;
+
+/// Reads the next entry of a directory and its information.
+///
+/// This works like readdir(), but it also fills a stat struct with the same
+/// information that stat() would return for the entry. The information is
+/// taken from the directory entry that is being read, so it's much faster than
+/// calling stat() for each entry, which needs to look for the entry again.
+///
+/// @param dirp
+///     Directory to read.
+/// @param st
+///     Pointer to the struct to be filled.
+///
+/// @return
+///     A pointer to the directory entry, or NULL at the end of the directory or
+///     on error.
+struct dirent *readdir_plus(DIR *dirp, struct stat *st);
+
 #ifdef __cplusplus
 }
 #endif
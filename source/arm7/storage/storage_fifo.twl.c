@@ -54,51 +54,105 @@ static sec_t setupAesRegs(u32 sectorNum, sec_t totalSectors)
     return totalSectors - toReadSectors;
 }
 
-static void cryptSectorsRead(u32 fifo, void *buffer, u32 numBytes)
+// Number of words sent to the AES input FIFO at once. The FIFO holds 16 words,
+// so the engine always has data to work with while the CPU waits for space.
+#define AES_BURST_WORDS         8
+// Size of the AES output FIFO in words.
+#define AES_RDFIFO_WORDS        16
+
+static inline void aesWaitInputSpace(void)
 {
-    const bool word_aligned = IS_WORD_ALIGNED(buffer);
-    vu32 *inSdmcFifo32 = (vu32*)fifo;
-    if (word_aligned)
+    while ((REG_AES_CNT & 0x1F) > (16 - AES_BURST_WORDS));
+}
+
+static inline void aesWaitOutputFull(void)
+{
+    while (((REG_AES_CNT >> 0x5) & 0x1F) < AES_RDFIFO_WORDS);
+}
+
+static inline u32 readUnalignedWord(const vu8 *in8)
+{
+    return in8[0] | (in8[1] << 8) | (in8[2] << 16) | (in8[3] << 24);
+}
+
 #ifdef NDMA_CHANNEL
+// Feeds the AES engine from the TMIO FIFO. The NDMA channel copies the output
+// of the engine to the destination in parallel.
+static void aesFeedFromFifo(vu32 *inFifo32, u32 numWords)
+{
+    for (u32 i = 0; i < numWords; i += AES_BURST_WORDS)
+    {
+        aesWaitInputSpace();
+
+        for (int j = 0; j < AES_BURST_WORDS; j++)
+            REG_AES_WRFIFO = *inFifo32;
+    }
+}
+
+// Feeds the AES engine from a buffer. The NDMA channel copies the output of
+// the engine to the TMIO FIFO in parallel.
+static void aesFeedFromBuffer(const void *buffer, u32 numWords)
+{
+    if (IS_WORD_ALIGNED(buffer))
     {
-        for (unsigned int i = 0; i < numBytes / 4; ++i)
+        const vu32 *in32 = buffer;
+        for (u32 i = 0; i < numWords; i += AES_BURST_WORDS)
         {
-            while (((REG_AES_CNT) & 0x1F) == 16);
-            REG_AES_WRFIFO = *inSdmcFifo32;
+            aesWaitInputSpace();
+
+            for (int j = 0; j < AES_BURST_WORDS; j++)
+                REG_AES_WRFIFO = *in32++;
         }
     }
-#else
+    else
     {
-        vu32 *out32 = (vu32*)buffer;
-        for (unsigned int i = 0; i < numBytes / (4 * 16); ++i)
+        const vu8 *in8 = buffer;
+        for (u32 i = 0; i < numWords; i += AES_BURST_WORDS)
         {
-            for (int j = 0; j < 16; ++j)
-            {
-                REG_AES_WRFIFO = *inSdmcFifo32;
-            }
-
-            while (((REG_AES_CNT >> 0x5) & 0x1F) < 16);
+            aesWaitInputSpace();
 
-            for (int j = 0; j < 16; ++j)
+            for (int j = 0; j < AES_BURST_WORDS; j++)
             {
-                *out32++ = REG_AES_RDFIFO;
+                REG_AES_WRFIFO = readUnalignedWord(in8);
+                in8 += 4;
             }
         }
     }
+}
 #endif
-    else
+
+// Decrypts data from the TMIO FIFO with the CPU doing all the copies. The
+// output FIFO is emptied right after sending the next group of words to the
+// engine, so the engine decrypts that group while the CPU copies the previous
+// one to the destination.
+static void aesPipelineRead(vu32 *inFifo32, void *buffer, u32 numWords)
+{
+    const u32 groups = numWords / AES_RDFIFO_WORDS;
+    const bool word_aligned = IS_WORD_ALIGNED(buffer);
+    vu32 *out32 = buffer;
+    vu8 *out8 = buffer;
+
+    for (int j = 0; j < AES_RDFIFO_WORDS; j++)
+        REG_AES_WRFIFO = *inFifo32;
+
+    for (u32 g = 0; g < groups; g++)
     {
-        vu8 *out8 = (vu8*)buffer;
-        for (unsigned int i = 0; i < numBytes / (4 * 16); ++i)
-        {
-            for (int j = 0; j < 16; ++j)
-            {
-                REG_AES_WRFIFO = *inSdmcFifo32;
-            }
+        aesWaitOutputFull();
 
-            while (((REG_AES_CNT >> 0x5) & 0x1F) < 16);
+        if (g + 1 < groups)
+        {
+            for (int j = 0; j < AES_RDFIFO_WORDS; j++)
+                REG_AES_WRFIFO = *inFifo32;
+        }
 
-            for (int j = 0; j < 16; ++j)
+        if (word_aligned)
+        {
+            for (int j = 0; j < AES_RDFIFO_WORDS; j++)
+                *out32++ = REG_AES_RDFIFO;
+        }
+        else
+        {
+            for (int j = 0; j < AES_RDFIFO_WORDS; j++)
             {
                 const u32 tmp = REG_AES_RDFIFO;
                 *out8++ = tmp;
@@ -110,78 +164,70 @@ static void cryptSectorsRead(u32 fifo, void *buffer, u32 numBytes)
     }
 }
 
-static void cryptSectorsWrite(u32 fifo, void *buffer, u32 numBytes)
+#ifndef NDMA_CHANNEL
+// Encrypts data from a buffer into the TMIO FIFO with the CPU doing all the
+// copies. It works like aesPipelineRead().
+static void aesPipelineWrite(const void *buffer, vu32 *outFifo32, u32 numWords)
 {
-#ifdef NDMA_CHANNEL
-    (void)fifo;
-    if (IS_WORD_ALIGNED(buffer))
-    {
-        vu32 *in32 = (vu32*)buffer;
-        for (unsigned int i = 0; i < numBytes / 4; ++i)
-        {
-            while (((REG_AES_CNT) & 0x1F) == 16);
+    const u32 groups = numWords / AES_RDFIFO_WORDS;
+    const bool word_aligned = IS_WORD_ALIGNED(buffer);
+    const vu32 *in32 = buffer;
+    const vu8 *in8 = buffer;
 
-            REG_AES_WRFIFO = *in32++;
-        }
-    }
-    else
+    for (u32 g = 0; g <= groups; g++)
     {
-        vu8 *in8 = (vu8*)buffer;
-        for (unsigned int i = 0; i < numBytes / 4; ++i)
-        {
-            u32 tmp = *in8++;
-            tmp |= *in8++ << 8;
-            tmp |= *in8++ << 16;
-            tmp |= *in8++ << 24;
+        if (g > 0)
+            aesWaitOutputFull();
 
-            while (((REG_AES_CNT) & 0x1F) == 16);
-
-            REG_AES_WRFIFO = tmp;
-        }
-    }
-#else
-    vu32 *outSdmcFifo32 = (vu32*)fifo;
-    if (IS_WORD_ALIGNED(buffer))
-    {
-        vu32 *in32 = (vu32*)buffer;
-        for (unsigned int i = 0; i < numBytes / (4 * 16); ++i)
+        if (g < groups)
         {
-            for (int j = 0; j < 16; ++j)
+            for (int j = 0; j < AES_RDFIFO_WORDS; j++)
             {
-                REG_AES_WRFIFO = *in32++;
+                if (word_aligned)
+                {
+                    REG_AES_WRFIFO = *in32++;
+                }
+                else
+                {
+                    REG_AES_WRFIFO = readUnalignedWord(in8);
+                    in8 += 4;
+                }
             }
+        }
 
-            while (((REG_AES_CNT >> 0x5) & 0x1F) < 16);
-
-            for (int j = 0; j < 16; ++j)
-            {
-                *outSdmcFifo32 = REG_AES_RDFIFO;
-            }
+        if (g > 0)
+        {
+            for (int j = 0; j < AES_RDFIFO_WORDS; j++)
+                *outFifo32 = REG_AES_RDFIFO;
         }
     }
-    else
-    {
-        vu8 *in8 = (vu8*)buffer;
-        for (unsigned int i = 0; i < numBytes / (4 * 16); ++i)
-        {
-            for (int j = 0; j < 16; ++j)
-            {
-                u32 tmp = *in8++;
-                tmp |= *in8++ << 8;
-                tmp |= *in8++ << 16;
-                tmp |= *in8++ << 24;
-                REG_AES_WRFIFO = tmp;
-            }
+}
+#endif
 
-            while (((REG_AES_CNT >> 0x5) & 0x1F) < 16);
+static void cryptSectorsRead(u32 fifo, void *buffer, u32 numBytes)
+{
+    vu32 *inSdmcFifo32 = (vu32*)fifo;
 
-            for (int j = 0; j < 16; ++j)
-            {
-                *outSdmcFifo32 = REG_AES_RDFIFO;
-            }
-        }
+#ifdef NDMA_CHANNEL
+    // The NDMA channel is only set up for word-aligned destinations
+    if (IS_WORD_ALIGNED(buffer))
+    {
+        aesFeedFromFifo(inSdmcFifo32, numBytes / 4);
+        return;
     }
 #endif
+
+    aesPipelineRead(inSdmcFifo32, buffer, numBytes / 4);
+}
+
+static void cryptSectorsWrite(u32 fifo, void *buffer, u32 numBytes)
+{
+#ifdef NDMA_CHANNEL
+    (void)fifo;
+    aesFeedFromBuffer(buffer, numBytes / 4);
+#else
+    aesPipelineWrite(buffer, (vu32*)fifo, numBytes / 4);
+#endif
 }
 
 static void sector_crypt_callback(u32 fifo, void *buffer, u32 numBytes, bool read)
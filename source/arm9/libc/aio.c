@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <aio.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include <nds/cothread.h>
+#include <nds/interrupts.h>
+
+// Requests are read in chunks of this size. The worker thread yields to other
+// threads between chunks. Each chunk is a blocking read() that stops all other
+// threads, so it's kept to a few sectors.
+#define AIO_CHUNK_SIZE          (4 * 512)
+
+// The worker does filesystem accesses, so it needs a big stack.
+#define AIO_WORKER_STACK_SIZE   (8 * 1024)
+
+// Duration of a frame (59.8261 Hz) in microseconds. Timeouts of aio_suspend()
+// are counted in frames.
+#define AIO_FRAME_US            16715
+
+// Queue of pending requests, served in order.
+static struct aiocb *aio_queue_head = NULL;
+static struct aiocb *aio_queue_tail = NULL;
+
+// Request that is being served by the worker thread.
+static struct aiocb *aio_current = NULL;
+
+static bool aio_worker_running = false;
+
+static inline uint32_t aio_queue_signal_id(void)
+{
+    return BIT(31) | (uintptr_t)&aio_queue_head;
+}
+
+// Signal sent whenever any request is completed
+static inline uint32_t aio_completion_signal_id(void)
+{
+    return BIT(31) | (uintptr_t)&aio_current;
+}
+
+static void aio_complete(struct aiocb *aiocbp, ssize_t result, int error)
+{
+    aiocbp->__return = result;
+    aiocbp->__error = error;
+
+    cothread_send_signal(aio_completion_signal_id());
+}
+
+static void aio_serve_read(struct aiocb *aiocbp)
+{
+    volatile uint8_t *buf = aiocbp->aio_buf;
+    size_t done = 0;
+
+    while (done < aiocbp->aio_nbytes)
+    {
+        size_t size = aiocbp->aio_nbytes - done;
+        if (size > AIO_CHUNK_SIZE)
+            size = AIO_CHUNK_SIZE;
+
+        // Other threads may have moved the file pointer since the last chunk
+        if (lseek(aiocbp->aio_fildes, aiocbp->aio_offset + done, SEEK_SET) == -1)
+        {
+            aio_complete(aiocbp, -1, errno);
+            return;
+        }
+
+        ssize_t ret = read(aiocbp->aio_fildes, (void *)(buf + done), size);
+        if (ret < 0)
+        {
+            aio_complete(aiocbp, -1, errno);
+            return;
+        }
+
+        done += ret;
+
+        // End of file
+        if ((size_t)ret < size)
+            break;
+
+        // Let other threads run between chunks
+        cothread_yield();
+    }
+
+    aio_complete(aiocbp, done, 0);
+}
+
+static int aio_worker(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        while (aio_queue_head == NULL)
+            cothread_yield_signal(aio_queue_signal_id());
+
+        struct aiocb *aiocbp = aio_queue_head;
+        aio_queue_head = aiocbp->__next;
+        if (aio_queue_head == NULL)
+            aio_queue_tail = NULL;
+
+        aio_current = aiocbp;
+        aio_serve_read(aiocbp);
+        aio_current = NULL;
+    }
+
+    return 0;
+}
+
+int aio_read(struct aiocb *aiocbp)
+{
+    if ((aiocbp == NULL) || (aiocbp->aio_buf == NULL) || (aiocbp->aio_offset < 0))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!aio_worker_running)
+    {
+        if (cothread_create(aio_worker, NULL, AIO_WORKER_STACK_SIZE,
+                            COTHREAD_DETACHED) < 0)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        aio_worker_running = true;
+    }
+
+    aiocbp->__next = NULL;
+    aiocbp->__error = EINPROGRESS;
+    aiocbp->__return = -1;
+
+    if (aio_queue_tail == NULL)
+        aio_queue_head = aiocbp;
+    else
+        aio_queue_tail->__next = aiocbp;
+
+    aio_queue_tail = aiocbp;
+
+    cothread_send_signal(aio_queue_signal_id());
+
+    return 0;
+}
+
+int aio_error(const struct aiocb *aiocbp)
+{
+    if (aiocbp == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return aiocbp->__error;
+}
+
+ssize_t aio_return(struct aiocb *aiocbp)
+{
+    if ((aiocbp == NULL) || (aiocbp->__error == EINPROGRESS))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (aiocbp->__error != 0)
+        errno = aiocbp->__error;
+
+    return aiocbp->__return;
+}
+
+int aio_suspend(const struct aiocb *const list[], int nent,
+                const struct timespec *timeout)
+{
+    uint32_t frames = 0;
+
+    if (timeout != NULL)
+    {
+        if ((timeout->tv_sec < 0) || (timeout->tv_nsec < 0) ||
+            (timeout->tv_nsec >= 1000000000))
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        uint64_t us = (uint64_t)timeout->tv_sec * 1000000 + timeout->tv_nsec / 1000;
+        frames = (us + AIO_FRAME_US - 1) / AIO_FRAME_US;
+    }
+
+    while (1)
+    {
+        bool pending = false;
+
+        for (int i = 0; i < nent; i++)
+        {
+            if (list[i] == NULL)
+                continue;
+
+            if (list[i]->__error != EINPROGRESS)
+                return 0;
+
+            pending = true;
+        }
+
+        if (!pending)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        if (timeout == NULL)
+        {
+            // Any request may have been completed when this thread wakes up,
+            // so the whole list is checked again.
+            cothread_yield_signal(aio_completion_signal_id());
+        }
+        else
+        {
+            if (frames == 0)
+            {
+                errno = EAGAIN;
+                return -1;
+            }
+
+            cothread_yield_irq(IRQ_VBLANK);
+            frames--;
+        }
+    }
+}
+
+int aio_cancel(int fildes, struct aiocb *aiocbp)
+{
+    if ((aiocbp != NULL) && (aiocbp->__error != EINPROGRESS))
+        return AIO_ALLDONE;
+
+    int ret = AIO_ALLDONE;
+
+    struct aiocb *prev = NULL;
+    struct aiocb *curr = aio_queue_head;
+
+    while (curr != NULL)
+    {
+        struct aiocb *next = curr->__next;
+
+        if ((curr->aio_fildes == fildes) && ((aiocbp == NULL) || (curr == aiocbp)))
+        {
+            if (prev == NULL)
+                aio_queue_head = next;
+            else
+                prev->__next = next;
+
+            if (aio_queue_tail == curr)
+                aio_queue_tail = prev;
+
+            aio_complete(curr, -1, ECANCELED);
+            ret = AIO_CANCELED;
+        }
+        else
+        {
+            prev = curr;
+        }
+
+        curr = next;
+    }
+
+    // Requests that are being served right now can't be cancelled
+    if ((aio_current != NULL) && (aio_current->aio_fildes == fildes) &&
+        ((aiocbp == NULL) || (aio_current == aiocbp)))
+        return AIO_NOTCANCELED;
+
+    return ret;
+}
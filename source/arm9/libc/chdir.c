@@ -18,6 +18,9 @@ int chdir(const char *path)
     char *divide = strstr(path, ":/");
     FRESULT result;
 
+    // Relative paths will point to different files
+    fatfs_stat_cache_invalidate();
+
     if (divide == NULL)
     {
         // This path doesn't include a drive name
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 // "dirent.h" defines DIR, but "ff.h" defines a different non-standard one.
 // Functions in this file need to use their standard prototypes, so it is needed
@@ -113,7 +114,7 @@ int closedir(DIR *dirp)
     return -1;
 }
 
-struct dirent *readdir(DIR *dirp)
+static struct dirent *readdir_internal(DIR *dirp, struct stat *st)
 {
     if (dirp == NULL)
     {
@@ -144,6 +145,11 @@ struct dirent *readdir(DIR *dirp)
             dirp->index++;
             ent->d_off = dirp->index;
         }
+
+        // This only needs to read the entry of the file in the NitroFS FAT
+        if ((st != NULL) && (nitrofs_stat_by_id(ent->d_ino, st) != 0))
+            return NULL;
+
         return ent;
     }
 
@@ -176,9 +182,30 @@ struct dirent *readdir(DIR *dirp)
     else
         ent->d_type = DT_REG; // Regular file
 
+    // The directory entry has all the information, there is no need to look
+    // for the file again.
+    if (st != NULL)
+        fatfs_filinfo_to_stat(&fno, st);
+
     return ent;
 }
 
+struct dirent *readdir(DIR *dirp)
+{
+    return readdir_internal(dirp, NULL);
+}
+
+struct dirent *readdir_plus(DIR *dirp, struct stat *st)
+{
+    if (st == NULL)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return readdir_internal(dirp, st);
+}
+
 void rewinddir(DIR *dirp)
 {
     if (dirp == NULL)
@@ -4,17 +4,21 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 #include <nds/arm9/sdmmc.h>
+#include <nds/disc_io.h>
 #include <nds/memory.h>
 #include <nds/system.h>
 
 #include "fat.h"
 #include "ff.h"
 #include "fatfs/cache.h"
+#include "fatfs_internal.h"
 #include "filesystem_internal.h"
 
 #define DEFAULT_SECTORS_PER_PAGE    8 // Each sector is 512 bytes
@@ -24,7 +28,8 @@
 static FATFS fs_info[FF_NTR_VOLUMES] = { 0 };
 
 // Devices: "sd:/", "nand:/", "nand2:/"
-TWL_BSS static FATFS fs_info_twl[FF_VOLUMES - FF_NTR_VOLUMES] = { 0 };
+// The "ram:/" device is handled in fatfs_ramdisk.c
+TWL_BSS static FATFS fs_info_twl[FF_VOLUMES - FF_NTR_VOLUMES - 1] = { 0 };
 
 static inline FATFS* get_fs_info(size_t index)
 {
@@ -38,6 +43,7 @@ PARTITION VolToPart[FF_VOLUMES] = {
     {1, 0},    /* "1:" ==> Auto discover partition in physical drive 1 (DSi sd), "sd:" */
     {2, 1},    /* "2:" ==> 1st partition in physical drive 2 (DSi nand), "nand:" */
     {2, 2},    /* "3:" ==> 2nd partition in physical drive 2 (DSi nand photo partition), "nand2:" */
+    {3, 0},    /* "4:" ==> Auto discover partition in physical drive 3 (RAM disk), "ram:" */
 };
 
 static const char *fat_drive = "fat:/";
@@ -134,6 +140,33 @@ DWORD fatfs_timestamp_to_fattime(struct tm *stm)
            (DWORD)stm->tm_sec >> 1;
 }
 
+void fatfs_filinfo_to_stat(const FILINFO *fno, struct stat *st)
+{
+    // On FatFS, st_dev is either 0 (DLDI) or 1 (DSi SD),
+    // while st_ino is the file's starting cluster in FAT.
+    st->st_dev = fno->fpdrv;
+    st->st_ino = fno->fclust;
+
+    st->st_size = fno->fsize;
+
+#if FF_MAX_SS != FF_MIN_SS
+#error "Set the block size to the right value"
+#endif
+    st->st_blksize = FF_MAX_SS;
+    st->st_blocks = (fno->fsize + FF_MAX_SS - 1) / FF_MAX_SS;
+
+    st->st_mode = (fno->fattrib & AM_DIR) ?
+                   S_IFDIR : // Directory
+                   S_IFREG;  // Regular file
+
+    time_t time = fatfs_fattime_to_timestamp(fno->ftime, fno->fdate);
+    time_t crtime = fatfs_fattime_to_timestamp(fno->crtime, fno->crdate);
+
+    st->st_atim.tv_sec = time; // Time of last access
+    st->st_mtim.tv_sec = time; // Time of last modification
+    st->st_ctim.tv_sec = crtime; // Time of last file entry change (~= creation)
+}
+
 // It takes a full path to a NDS ROM and it creates a new string with the path
 // to the directory that contains it. It must be freed by the caller of
 // get_dirname().
@@ -457,6 +490,273 @@ bool fatInitDefault(void)
     return fatInit(-1, true);
 }
 
+int fatSetCacheWriteBack(bool enable)
+{
+    cache_set_writeback(enable);
+
+    // Make sure that nothing is left in the cache when write-back mode is
+    // disabled.
+    if (!enable)
+        return fatFlushCache();
+
+    return 0;
+}
+
+int fatFlushCache(void)
+{
+    if (cache_flush(0xFF) != 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+int fatInitBounceBuffers(uint32_t num_buffers, uint32_t sectors_per_buffer)
+{
+    if (cache_bounce_init(num_buffers, sectors_per_buffer) != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void fatGetCacheStats(fat_cache_stats_t *stats)
+{
+    if (stats == NULL)
+        return;
+
+    cache_get_stats(stats);
+}
+
+void fatResetCacheStats(void)
+{
+    cache_reset_stats();
+}
+
+int fatGetIoStats(fat_io_drive_t drive, fat_io_stats_t *stats)
+{
+    if ((drive < 0) || (drive >= FAT_IO_DRIVE_COUNT) || (stats == NULL))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    disk_get_io_stats(drive, stats);
+    return 0;
+}
+
+void fatResetIoStats(void)
+{
+    disk_reset_io_stats();
+}
+
+int fatStartIoTrace(uint32_t num_entries)
+{
+    if (num_entries == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (disk_io_trace_start(num_entries) != 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+void fatStopIoTrace(void)
+{
+    disk_io_trace_stop();
+}
+
+int fatSaveIoTrace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+        return -1;
+
+    int ret = disk_io_trace_save(file);
+
+    if (fclose(file) != 0)
+        ret = -1;
+
+    if (ret != 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Settings of the automatic look-up cache. It is disabled if the maximum size
+// is 0.
+static uint32_t auto_lookup_min_file_size = 0;
+static uint32_t auto_lookup_max_buffer_size = 0;
+
+// Initial size of automatic look-up caches. It is enough for files with up to
+// 31 fragments.
+#define AUTO_LOOKUP_INITIAL_SIZE    (64 * sizeof(DWORD))
+
+// Forward seeks shorter than this number of clusters are cheap enough without a
+// look-up cache.
+#define AUTO_LOOKUP_MIN_SEEK_CLUSTERS   16
+
+int fatSetAutoLookupCache(uint32_t min_file_size, uint32_t max_buffer_size)
+{
+    // The table needs at least 4 words: size, one fragment and terminator
+    if ((max_buffer_size != 0) && (max_buffer_size < 4 * sizeof(DWORD)))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    auto_lookup_min_file_size = min_file_size;
+    auto_lookup_max_buffer_size = max_buffer_size;
+
+    return 0;
+}
+
+void fat_lookup_cache_auto(fat_file_t *file, FSIZE_t offset)
+{
+    FIL *f = &file->fil;
+
+    if (auto_lookup_max_buffer_size == 0)
+        return;
+
+    if ((f->cltbl != NULL) || file->lookup_cache_failed)
+        return;
+
+    // The size of files in fast seek mode can't be increased, so only use it
+    // for files that can't be written.
+    if (f->flag & FA_WRITE)
+        return;
+
+    if (f_size(f) < auto_lookup_min_file_size)
+        return;
+
+    // Check if the seek would need to walk a long section of the cluster
+    // chain. Backward seeks that leave the current cluster walk the chain from
+    // the start of the file.
+    uint32_t cluster_size = f->obj.fs->csize * FF_MAX_SS;
+    FSIZE_t current = f_tell(f);
+
+    if (offset >= current)
+    {
+        if ((offset - current) / cluster_size < AUTO_LOOKUP_MIN_SEEK_CLUSTERS)
+            return;
+    }
+    else
+    {
+        if ((offset / cluster_size) == (current / cluster_size))
+            return;
+    }
+
+    // Start with a small table and grow it to the size reported by FatFs if
+    // the file is too fragmented.
+    uint32_t size = AUTO_LOOKUP_INITIAL_SIZE;
+    if (size > auto_lookup_max_buffer_size)
+        size = auto_lookup_max_buffer_size;
+
+    while (1)
+    {
+        DWORD *cltbl = realloc(f->cltbl, size);
+        if (cltbl == NULL)
+        {
+            // There may be enough free memory later, try again in the next
+            // long seek.
+            free(f->cltbl);
+            f->cltbl = NULL;
+            return;
+        }
+
+        f->cltbl = cltbl;
+        f->cltbl[0] = size / sizeof(DWORD);
+
+        FRESULT ret = f_lseek(f, CREATE_LINKMAP);
+        if (ret == FR_OK)
+        {
+            // Reduce allocation to match actual cache area size
+            cltbl = realloc(f->cltbl, f->cltbl[0] * sizeof(DWORD));
+            if (cltbl != NULL)
+                f->cltbl = cltbl;
+            return;
+        }
+
+        if (ret != FR_NOT_ENOUGH_CORE)
+            break;
+
+        // FatFs has stored the required number of words in the first entry
+        uint32_t required_size = f->cltbl[0] * sizeof(DWORD);
+        if ((required_size <= size) || (required_size > auto_lookup_max_buffer_size))
+            break;
+
+        size = required_size;
+    }
+
+    // The file is too fragmented for the maximum size of the cache, or FatFs
+    // has failed to walk the cluster chain. Don't try again for this file. The
+    // cluster chain would be walked again on every seek only to fail in the
+    // same way.
+    free(f->cltbl);
+    f->cltbl = NULL;
+    file->lookup_cache_failed = true;
+}
+
+int fat_preallocate(fat_file_t *file, FSIZE_t size)
+{
+    FIL *f = &file->fil;
+
+    if (!(f->flag & FA_WRITE))
+        return EBADF;
+
+    // f_expand() only works with empty files
+    if ((size == 0) || (f_size(f) != 0))
+        return EINVAL;
+
+    // This allocates a contiguous cluster chain and sets the size of the file
+    // to the size of the chain.
+    FRESULT result = f_expand(f, size, 1);
+    if (result != FR_OK)
+    {
+        // FR_DENIED means that there isn't enough contiguous free space
+        return (result == FR_DENIED) ? ENOSPC : fatfs_error_to_posix(result);
+    }
+
+    // Keep the original size of the file. Writes follow the existing cluster
+    // chain instead of allocating new clusters, so the FAT isn't modified
+    // until the file is closed and the unused clusters are released.
+    f->obj.objsize = 0;
+    file->reserved_size = size;
+
+    return 0;
+}
+
+int fatPreallocate(int fd, off_t size)
+{
+    if (!FD_IS_FAT(fd) || (size <= 0))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int ret = fat_preallocate((fat_file_t *)FD_FAT_UNPACK(fd), size);
+    if (ret != 0)
+    {
+        errno = ret;
+        return -1;
+    }
+
+    return 0;
+}
+
 int fatInitLookupCache(int fd, uint32_t max_buffer_size)
 {
     if (!FD_IS_FAT(fd))
@@ -2,19 +2,57 @@
 //
 // Copyright (C) 2023-2024 Antonio Niño Díaz
 
+#include <malloc.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <fat.h>
+#include <nds/arm9/cp15_asm.h>
+#include <nds/ndstypes.h>
+
 #include "ff.h"
+#include "cache.h"
+
+// The cache is indexed by a hash table of (pdrv, sector) pairs. Each bucket
+// holds the index of the first entry of a singly linked chain of entries. This
+// makes lookups O(1) on average regardless of the size of the cache.
+//
+// Entries are evicted with the CLOCK algorithm: every entry has a "referenced"
+// bit that is set whenever the entry is used. When a new entry is needed, the
+// clock hand sweeps the entries in order, clearing the bit of referenced
+// entries and stopping at the first entry that isn't referenced. This is a
+// cheap approximation of LRU that doesn't need to update any list on hits.
+//
+// In write-back mode, entries can be marked as dirty. Dirty entries are written
+// to the device when they are evicted or when the cache is flushed. Runs of
+// consecutive dirty sectors are written with a single multi-sector command.
+//
+// Because the clock hand moves through the entries in order, the entries that
+// follow an evicted entry are usually good candidates to be evicted as well.
+// This is used to fill several consecutive entries (which are consecutive in
+// memory too) with a single multi-sector read.
+
+#define CACHE_INDEX_NONE    UINT32_MAX
+
+// Maximum number of sectors written to the device with one command when
+// flushing dirty entries.
+#define CACHE_MAX_WRITEBACK_RUN     64
+
+// Maximum number of sectors read from the device with one command when filling
+// the cache.
+#define CACHE_MAX_FILL_RUN          64
 
 typedef struct
 {
     uint8_t  valid;
     uint8_t  pdrv;
+    uint8_t  referenced;
+    uint8_t  dirty;
+    uint8_t  prefetched; // Read ahead of time and not used yet
     LBA_t    sector;
-    uint32_t used_at;
+    uint32_t hash_next; // Next entry in the same hash bucket
 } cache_entry_t;
 
 #if FF_MAX_SS != FF_MIN_SS
@@ -22,10 +60,29 @@ typedef struct
 #endif
 
 static cache_entry_t *cache_entries = NULL;
+static uint32_t *cache_buckets = NULL;
+static uint32_t cache_bucket_shift;
 static uint8_t *cache_mem;
 static uint32_t cache_num_sectors = 0;
 static uint32_t dldi_stub_space_sectors;
-static uint32_t usage_counter = 0;
+static uint32_t clock_hand = 0;
+static bool cache_writeback = false;
+static uint32_t cache_num_dirty = 0;
+static bool cache_writeback_failed = false;
+static fat_cache_stats_t cache_stats;
+
+// Pool of multi-sector buffers in main RAM. They are used to transfer data
+// between the storage devices and buffers that the drivers can't access
+// directly (unaligned buffers or buffers in DTCM, for example). The buffers are
+// allocated the first time they are needed.
+
+#define CACHE_BOUNCE_MAX_BUFFERS        4
+#define CACHE_BOUNCE_DEFAULT_SECTORS    8
+
+static uint8_t *bounce_buffers[CACHE_BOUNCE_MAX_BUFFERS];
+static bool bounce_in_use[CACHE_BOUNCE_MAX_BUFFERS];
+static uint32_t bounce_num_buffers = 1;
+static uint32_t bounce_num_sectors = CACHE_BOUNCE_DEFAULT_SECTORS;
 
 extern uint8_t *dldiGetStubDataEnd(void);
 extern uint8_t *dldiGetStubEnd(void);
@@ -39,12 +96,21 @@ bool cache_initialized(void)
 
 void cache_deinit(void)
 {
+    // Don't lose any data that hasn't been written to the device yet
+    cache_flush(0xFF);
+
     if (cache_entries != NULL)
     {
         free(cache_entries);
         cache_entries = NULL;
     }
 
+    if (cache_buckets != NULL)
+    {
+        free(cache_buckets);
+        cache_buckets = NULL;
+    }
+
     if (cache_mem != NULL)
     {
         free(cache_mem);
@@ -52,6 +118,8 @@ void cache_deinit(void)
     }
 
     cache_num_sectors = 0;
+    cache_num_dirty = 0;
+    clock_hand = 0;
 }
 
 int cache_init(int32_t num_sectors)
@@ -75,6 +143,25 @@ int cache_init(int32_t num_sectors)
         if (cache_entries == NULL)
             return -1;
 
+        // Use a power of two number of buckets that is at least as big as the
+        // number of entries so that chains are short.
+        uint32_t bucket_bits = 1;
+        while ((1U << bucket_bits) < (uint32_t)num_sectors)
+            bucket_bits++;
+
+        cache_buckets = malloc(sizeof(uint32_t) << bucket_bits);
+        if (cache_buckets == NULL)
+        {
+            free(cache_entries);
+            cache_entries = NULL;
+            return -1;
+        }
+
+        for (uint32_t i = 0; i < (1U << bucket_bits); i++)
+            cache_buckets[i] = CACHE_INDEX_NONE;
+
+        cache_bucket_shift = 32 - bucket_bits;
+
 #if FF_MAX_SS != FF_MIN_SS
 #error "Set the block size to the right value"
 #endif
@@ -88,6 +175,9 @@ int cache_init(int32_t num_sectors)
             if (cache_mem == NULL)
             {
                 free(cache_entries);
+                cache_entries = NULL;
+                free(cache_buckets);
+                cache_buckets = NULL;
                 return -1;
             }
         }
@@ -102,81 +192,385 @@ int cache_init(int32_t num_sectors)
     return 0;
 }
 
+// Entries with consecutive indices are also consecutive in memory, as long as
+// they are both in the DLDI stub space or both in cache_mem.
 static void *cache_sector_address(uint32_t i)
 {
     if (i < dldi_stub_space_sectors)
-        return dldiGetStubEnd() - (i + 1) * FF_MAX_SS;
+        return dldiGetStubEnd() - (dldi_stub_space_sectors - i) * FF_MAX_SS;
     else
         return cache_mem + ((i - dldi_stub_space_sectors) * FF_MAX_SS);
 }
 
-void *cache_sector_get(uint8_t pdrv, uint32_t sector)
+// Fibonacci hashing. Consecutive sectors end up in different buckets.
+static inline uint32_t cache_hash(uint8_t pdrv, uint32_t sector)
 {
-    for (uint32_t i = 0; i < cache_num_sectors; i++)
+    return ((sector ^ ((uint32_t)pdrv << 24)) * 0x9E3779B1U) >> cache_bucket_shift;
+}
+
+static uint32_t cache_lookup(uint8_t pdrv, uint32_t sector)
+{
+    uint32_t i = cache_buckets[cache_hash(pdrv, sector)];
+
+    while (i != CACHE_INDEX_NONE)
     {
         cache_entry_t *entry = &(cache_entries[i]);
 
+        if ((entry->sector == sector) && (entry->pdrv == pdrv))
+            return i;
+
+        i = entry->hash_next;
+    }
+
+    return CACHE_INDEX_NONE;
+}
+
+static void cache_link(uint32_t i)
+{
+    cache_entry_t *entry = &(cache_entries[i]);
+    uint32_t *bucket = &(cache_buckets[cache_hash(entry->pdrv, entry->sector)]);
+
+    entry->hash_next = *bucket;
+    *bucket = i;
+}
+
+static void cache_unlink(uint32_t i)
+{
+    cache_entry_t *entry = &(cache_entries[i]);
+    uint32_t *next = &(cache_buckets[cache_hash(entry->pdrv, entry->sector)]);
+
+    while (*next != CACHE_INDEX_NONE)
+    {
+        if (*next == i)
+        {
+            *next = entry->hash_next;
+            break;
+        }
+
+        next = &(cache_entries[*next].hash_next);
+    }
+
+    // If the entry is dirty its contents are discarded. Only do this if the
+    // data has been written to the device, or if the sectors are going to be
+    // overwritten.
+    if (entry->dirty)
+    {
+        entry->dirty = 0;
+        cache_num_dirty--;
+    }
+
+    entry->valid = 0;
+}
+
+static bool cache_is_dirty(uint8_t pdrv, uint32_t sector)
+{
+    uint32_t i = cache_lookup(pdrv, sector);
+    if (i == CACHE_INDEX_NONE)
+        return false;
+
+    return cache_entries[i].dirty;
+}
+
+// Write a list of entries with consecutive sectors to the device.
+static bool cache_write_entries(uint8_t pdrv, uint32_t sector,
+                                const uint32_t *indices, uint32_t count)
+{
+    // If the entries are consecutive in memory they can be written directly.
+    uint32_t first = indices[0];
+    uint32_t last = indices[count - 1];
+    bool contiguous = (last == first + count - 1)
+                   && ((last < dldi_stub_space_sectors) || (first >= dldi_stub_space_sectors));
+
+    for (uint32_t n = 1; contiguous && (n < count); n++)
+    {
+        if (indices[n] != first + n)
+            contiguous = false;
+    }
+
+    if (contiguous)
+        return disk_writeback_sectors(pdrv, sector, count, cache_sector_address(first));
+
+    // Gather the sectors in a temporary buffer so that they can be written
+    // with one command.
+    uint8_t *buffer = NULL;
+    if (count > 1)
+        buffer = malloc(count * FF_MAX_SS);
+
+    if (buffer == NULL)
+    {
+        for (uint32_t n = 0; n < count; n++)
+        {
+            if (!disk_writeback_sectors(pdrv, sector + n, 1, cache_sector_address(indices[n])))
+                return false;
+        }
+
+        return true;
+    }
+
+    for (uint32_t n = 0; n < count; n++)
+        memcpy(buffer + n * FF_MAX_SS, cache_sector_address(indices[n]), FF_MAX_SS);
+
+    bool ret = disk_writeback_sectors(pdrv, sector, count, buffer);
+
+    free(buffer);
+
+    return ret;
+}
+
+// Write the run of consecutive dirty sectors that contains the specified entry.
+static int cache_flush_run(uint32_t i)
+{
+    uint8_t pdrv = cache_entries[i].pdrv;
+    uint32_t sector = cache_entries[i].sector;
+
+    // Look for the start of the run
+    while ((sector > 0) && cache_is_dirty(pdrv, sector - 1))
+        sector--;
+
+    int ret = 0;
+
+    while (1)
+    {
+        uint32_t indices[CACHE_MAX_WRITEBACK_RUN];
+        uint32_t count = 0;
+
+        while (count < CACHE_MAX_WRITEBACK_RUN)
+        {
+            uint32_t j = cache_lookup(pdrv, sector + count);
+            if ((j == CACHE_INDEX_NONE) || (cache_entries[j].dirty == 0))
+                break;
+
+            indices[count++] = j;
+        }
+
+        if (count == 0)
+            break;
+
+        // If the write fails there isn't much that can be done. Forget about
+        // the data and report the error the next time the cache is flushed.
+        disk_io_trace(pdrv, FAT_IO_OP_WRITEBACK, sector, count, 0);
+
+        if (!cache_write_entries(pdrv, sector, indices, count))
+        {
+            cache_writeback_failed = true;
+            ret = -1;
+        }
+
+        for (uint32_t n = 0; n < count; n++)
+            cache_entries[indices[n]].dirty = 0;
+
+        cache_num_dirty -= count;
+        sector += count;
+    }
+
+    return ret;
+}
+
+// Find an entry to be reused, remove it from the hash table, and return its
+// index. It never fails if the cache isn't empty.
+static uint32_t cache_evict(void)
+{
+    while (1)
+    {
+        uint32_t i = clock_hand;
+        cache_entry_t *entry = &(cache_entries[i]);
+
+        clock_hand++;
+        if (clock_hand == cache_num_sectors)
+            clock_hand = 0;
+
         if (entry->valid == 0)
-            continue;
+            return i;
 
-        if ((entry->pdrv != pdrv) || (entry->sector != sector))
+        if (entry->referenced)
+        {
+            // Give it a second chance
+            entry->referenced = 0;
             continue;
+        }
 
-        entry->used_at = usage_counter++;
+        if (entry->dirty)
+            cache_flush_run(i);
 
-        return cache_sector_address(i);
+        cache_unlink(i);
+        return i;
     }
+}
 
-    return NULL;
+void *cache_sector_get(uint8_t pdrv, uint32_t sector)
+{
+    if (!cache_num_sectors)
+        return NULL;
+
+    uint32_t i = cache_lookup(pdrv, sector);
+    if (i == CACHE_INDEX_NONE)
+        return NULL;
+
+    cache_entry_t *entry = &(cache_entries[i]);
+
+    entry->referenced = 1;
+
+    cache_stats.hits++;
+    if (entry->prefetched)
+    {
+        entry->prefetched = 0;
+        cache_stats.readahead_hits++;
+    }
+
+    return cache_sector_address(i);
 }
 
-void *cache_sector_add(uint8_t pdrv, uint32_t sector)
+bool cache_sector_present(uint8_t pdrv, uint32_t sector)
 {
-    uint32_t used_at_difference = 0;
-    uint32_t selected_entry = 0;
+    if (!cache_num_sectors)
+        return false;
 
+    return cache_lookup(pdrv, sector) != CACHE_INDEX_NONE;
+}
+
+void *cache_sector_add(uint8_t pdrv, uint32_t sector)
+{
     if (!cache_num_sectors)
         return NULL;
 
     // Assumption: cache_sector_get() has been called,
     // and we know the sector is not present
-    for (uint32_t i = 0; i < cache_num_sectors; i++)
+    uint32_t i = cache_evict();
+
+    if (pdrv != 0xFF)
     {
-        if (cache_entries[i].valid == 0)
-        {
-            // Entry free, use it
-            selected_entry = i;
+        cache_entry_t *entry = &(cache_entries[i]);
+
+        entry->pdrv = pdrv;
+        entry->valid = 1;
+        entry->sector = sector;
+        // The entry gets a full sweep of the clock hand before it can be
+        // evicted, it doesn't need to be marked as referenced.
+        entry->referenced = 0;
+        entry->prefetched = 0;
+
+        cache_link(i);
+
+        cache_stats.misses++;
+        cache_stats.fill_reads++;
+    }
+
+    return cache_sector_address(i);
+}
+
+void *cache_sector_add_run(uint8_t pdrv, uint32_t sector, uint32_t *count,
+                           uint32_t requested)
+{
+    if (!cache_num_sectors)
+        return NULL;
+
+    // Assumption: None of the sectors are present in the cache.
+
+    uint32_t first = cache_evict();
+    uint32_t n = 1;
+
+    // Take the entries that follow the first one while they are in the same
+    // memory block and they can be evicted.
+    while (n < *count)
+    {
+        uint32_t i = first + n;
+
+        if ((i >= cache_num_sectors) || (i == dldi_stub_space_sectors))
             break;
-        }
 
-        // Check if this entry was least recently used
-        uint32_t i_used_at_difference = usage_counter - cache_entries[i].used_at;
-        if (i_used_at_difference > used_at_difference)
+        cache_entry_t *entry = &(cache_entries[i]);
+
+        if (entry->valid)
         {
-            used_at_difference = i_used_at_difference;
-            selected_entry = i;
+            if (entry->referenced)
+                break;
+
+            if (entry->dirty)
+                cache_flush_run(i);
+
+            cache_unlink(i);
         }
+
+        n++;
     }
 
-    cache_entry_t *entry = &(cache_entries[selected_entry]);
+    clock_hand = first + n;
+    if (clock_hand >= cache_num_sectors)
+        clock_hand = 0;
 
-    if (pdrv != 0xFF)
+    for (uint32_t k = 0; k < n; k++)
     {
+        cache_entry_t *entry = &(cache_entries[first + k]);
+
         entry->pdrv = pdrv;
         entry->valid = 1;
-        entry->sector = sector;
-        entry->used_at = usage_counter++;
+        entry->sector = sector + k;
+        entry->referenced = 0;
+        entry->prefetched = (k >= requested) ? 1 : 0;
+
+        cache_link(first + k);
+    }
+
+    cache_stats.fill_reads++;
+    if (n > requested)
+    {
+        cache_stats.misses += requested;
+        cache_stats.readahead_sectors += n - requested;
     }
     else
     {
-        entry->valid = 0;
+        cache_stats.misses += n;
     }
 
-    return cache_sector_address(selected_entry);
+    *count = n;
+
+    return cache_sector_address(first);
+}
+
+uint32_t cache_max_fill_sectors(void)
+{
+    // Don't let a single read evict a big part of the cache
+    uint32_t max = cache_num_sectors / 4;
+
+    if (max > CACHE_MAX_FILL_RUN)
+        max = CACHE_MAX_FILL_RUN;
+    else if (max == 0)
+        max = 1;
+
+    return max;
+}
+
+void cache_get_stats(fat_cache_stats_t *stats)
+{
+    *stats = cache_stats;
+}
+
+void cache_reset_stats(void)
+{
+    memset(&cache_stats, 0, sizeof(cache_stats));
 }
 
 void cache_sector_invalidate(uint8_t pdrv, uint32_t sector_from, uint32_t sector_to)
 {
+    if ((!cache_num_sectors) || (sector_to < sector_from))
+        return;
+
+    // For small ranges it's faster to look for each sector in the hash table
+    // than to check every entry of the cache.
+    if ((sector_to - sector_from) < cache_num_sectors)
+    {
+        uint32_t count = sector_to - sector_from + 1;
+
+        for (uint32_t n = 0; n < count; n++)
+        {
+            uint32_t i = cache_lookup(pdrv, sector_from + n);
+            if (i != CACHE_INDEX_NONE)
+                cache_unlink(i);
+        }
+
+        return;
+    }
+
     for (uint32_t i = 0; i < cache_num_sectors; i++)
     {
         cache_entry_t *entry = &(cache_entries[i]);
@@ -187,6 +581,184 @@ void cache_sector_invalidate(uint8_t pdrv, uint32_t sector_from, uint32_t sector
         if ((entry->pdrv != pdrv) || (entry->sector < sector_from) || (entry->sector > sector_to))
             continue;
 
-        entry->valid = 0;
+        cache_unlink(i);
+    }
+}
+
+void *cache_sector_write(uint8_t pdrv, uint32_t sector)
+{
+    if (!cache_num_sectors)
+        return NULL;
+
+    uint32_t i = cache_lookup(pdrv, sector);
+    if (i == CACHE_INDEX_NONE)
+    {
+        i = cache_evict();
+
+        cache_entry_t *entry = &(cache_entries[i]);
+
+        entry->pdrv = pdrv;
+        entry->valid = 1;
+        entry->sector = sector;
+
+        cache_link(i);
+    }
+
+    cache_entry_t *entry = &(cache_entries[i]);
+
+    entry->referenced = 1;
+    entry->prefetched = 0;
+
+    if (entry->dirty == 0)
+    {
+        entry->dirty = 1;
+        cache_num_dirty++;
+    }
+
+    return cache_sector_address(i);
+}
+
+int cache_flush(uint8_t pdrv)
+{
+    int ret = 0;
+
+    for (uint32_t i = 0; (i < cache_num_sectors) && (cache_num_dirty > 0); i++)
+    {
+        cache_entry_t *entry = &(cache_entries[i]);
+
+        if ((entry->valid == 0) || (entry->dirty == 0))
+            continue;
+
+        if ((pdrv != 0xFF) && (entry->pdrv != pdrv))
+            continue;
+
+        if (cache_flush_run(i) != 0)
+            ret = -1;
+    }
+
+    // Report errors that happened when evicting entries, too.
+    if (cache_writeback_failed)
+    {
+        cache_writeback_failed = false;
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int cache_flush_range(uint8_t pdrv, uint32_t sector_from, uint32_t sector_to)
+{
+    if ((cache_num_dirty == 0) || (sector_to < sector_from))
+        return 0;
+
+    int ret = 0;
+
+    if ((sector_to - sector_from) < cache_num_sectors)
+    {
+        uint32_t count = sector_to - sector_from + 1;
+
+        for (uint32_t n = 0; n < count; n++)
+        {
+            uint32_t i = cache_lookup(pdrv, sector_from + n);
+            if ((i != CACHE_INDEX_NONE) && cache_entries[i].dirty)
+            {
+                if (cache_flush_run(i) != 0)
+                    ret = -1;
+            }
+        }
+
+        return ret;
+    }
+
+    for (uint32_t i = 0; i < cache_num_sectors; i++)
+    {
+        cache_entry_t *entry = &(cache_entries[i]);
+
+        if ((entry->valid == 0) || (entry->dirty == 0) || (entry->pdrv != pdrv))
+            continue;
+
+        if ((entry->sector < sector_from) || (entry->sector > sector_to))
+            continue;
+
+        if (cache_flush_run(i) != 0)
+            ret = -1;
+    }
+
+    return ret;
+}
+
+void cache_set_writeback(bool enable)
+{
+    cache_writeback = enable;
+}
+
+bool cache_writeback_accepts(uint32_t count)
+{
+    // Only keep small writes (FAT tables, directory entries, partial sectors
+    // of files) in the cache. Big writes would evict too many entries.
+    return cache_writeback && (count <= (cache_num_sectors / 4));
+}
+
+int cache_bounce_init(uint32_t num_buffers, uint32_t sectors_per_buffer)
+{
+    if (num_buffers > CACHE_BOUNCE_MAX_BUFFERS)
+        return -1;
+
+    for (uint32_t i = 0; i < CACHE_BOUNCE_MAX_BUFFERS; i++)
+    {
+        if (bounce_in_use[i])
+            return -1;
+    }
+
+    for (uint32_t i = 0; i < CACHE_BOUNCE_MAX_BUFFERS; i++)
+    {
+        free(bounce_buffers[i]);
+        bounce_buffers[i] = NULL;
+    }
+
+    bounce_num_buffers = num_buffers;
+    bounce_num_sectors = sectors_per_buffer;
+
+    return 0;
+}
+
+void *cache_bounce_acquire(uint32_t *num_sectors)
+{
+    if (bounce_num_sectors > 0)
+    {
+        for (uint32_t i = 0; i < bounce_num_buffers; i++)
+        {
+            if (bounce_in_use[i])
+                continue;
+
+            if (bounce_buffers[i] == NULL)
+            {
+                // Align it to cache lines so that drivers can safely
+                // invalidate the data cache over it.
+                bounce_buffers[i] = memalign(CACHE_LINE_SIZE, bounce_num_sectors * FF_MAX_SS);
+                if (bounce_buffers[i] == NULL)
+                    break;
+            }
+
+            bounce_in_use[i] = true;
+            *num_sectors = bounce_num_sectors;
+            return bounce_buffers[i];
+        }
+    }
+
+    // If there are no free buffers, use a cache entry.
+    *num_sectors = 1;
+    return cache_sector_borrow();
+}
+
+void cache_bounce_release(void *buffer)
+{
+    for (uint32_t i = 0; i < bounce_num_buffers; i++)
+    {
+        if (bounce_buffers[i] == buffer)
+        {
+            bounce_in_use[i] = false;
+            return;
+        }
     }
 }
@@ -8,6 +8,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
+
+#include <fat.h>
 
 bool cache_initialized(void);
 void cache_deinit(void);
@@ -15,6 +18,50 @@ int cache_init(int32_t num_sectors);
 void *cache_sector_get(uint8_t pdrv, uint32_t sector);
 void *cache_sector_add(uint8_t pdrv, uint32_t sector);
 void cache_sector_invalidate(uint8_t pdrv, uint32_t sector_from, uint32_t sector_to);
+bool cache_sector_present(uint8_t pdrv, uint32_t sector);
+
+// Add up to "count" consecutive sectors to the cache, in entries that are
+// consecutive in memory, so that they can be filled with a single read. It
+// returns the address of the first entry and it updates "count" with the number
+// of entries actually added (at least one). Sectors after the first
+// "requested" ones are accounted as read-ahead sectors.
+void *cache_sector_add_run(uint8_t pdrv, uint32_t sector, uint32_t *count,
+                           uint32_t requested);
+uint32_t cache_max_fill_sectors(void);
+
+// Pool of multi-sector buffers in main RAM, aligned to cache lines. When no
+// buffer is available it falls back to a borrowed cache entry (one sector).
+// cache_bounce_release() must be called with any pointer returned by
+// cache_bounce_acquire().
+int cache_bounce_init(uint32_t num_buffers, uint32_t sectors_per_buffer);
+void *cache_bounce_acquire(uint32_t *num_sectors);
+void cache_bounce_release(void *buffer);
+
+// Statistics, using the struct of the public API.
+void cache_get_stats(fat_cache_stats_t *stats);
+void cache_reset_stats(void);
+
+// Write-back mode. cache_sector_write() returns the cache entry of a sector,
+// creating it if required, and marks it as dirty. The caller must fill it with
+// the full sector. Dirty entries are written with disk_writeback_sectors().
+void cache_set_writeback(bool enable);
+bool cache_writeback_accepts(uint32_t count);
+void *cache_sector_write(uint8_t pdrv, uint32_t sector);
+int cache_flush(uint8_t pdrv); // 0xFF flushes all drives
+int cache_flush_range(uint8_t pdrv, uint32_t sector_from, uint32_t sector_to);
+
+// Implemented in diskio.c
+bool disk_writeback_sectors(uint8_t pdrv, uint32_t sector, uint32_t count,
+                            const void *buffer);
+
+// I/O statistics and trace, implemented in diskio.c. The public API uses them.
+void disk_io_trace(uint8_t pdrv, uint8_t op, uint32_t sector, uint32_t count,
+                   uint32_t ticks);
+int disk_io_trace_start(uint32_t num_entries);
+void disk_io_trace_stop(void);
+int disk_io_trace_save(FILE *file);
+void disk_get_io_stats(uint8_t pdrv, fat_io_stats_t *stats);
+void disk_reset_io_stats(void);
 
 // "Borrow" an unused cache entry to use as a write buffer.
 LIBNDS_ALWAYS_INLINE
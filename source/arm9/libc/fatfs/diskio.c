@@ -26,6 +26,7 @@
 // storage control modules to the FatFs module with a defined API.
 //-----------------------------------------------------------------------
 
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,9 +38,11 @@
 #include <nds/arm9/dldi.h>
 #include <nds/arm9/sassert.h>
 #include <nds/arm9/sdmmc.h>
+#include <nds/disc_io.h>
 #include <nds/interrupts.h>
 #include <nds/memory.h>
 #include <nds/system.h>
+#include <nds/timers.h>
 
 #include "../fatfs_internal.h"
 
@@ -51,6 +54,7 @@
 #define DEV_DLDI    0x00 // DLDI driver (flashcard)
 #define DEV_SD      0x01 // SD slot of the DSi
 #define DEV_NAND    0x02 // NAND of the DSi
+#define DEV_RAM     0x03 // RAM disk
 
 // Debugging defines.
 // #define DISABLE_DIRECT_READS
@@ -68,6 +72,150 @@ static const DISC_INTERFACE *fs_io[FF_VOLUMES];
 #error "This file assumes that the sector size is always the same".
 #endif
 
+static_assert(DEV_DLDI == FAT_IO_DRIVE_DLDI);
+static_assert(DEV_SD == FAT_IO_DRIVE_SD);
+static_assert(DEV_NAND == FAT_IO_DRIVE_NAND);
+static_assert(DEV_RAM == FAT_IO_DRIVE_RAM);
+
+//-----------------------------------------------------------------------
+// I/O statistics and trace
+//-----------------------------------------------------------------------
+
+static fat_io_stats_t io_stats[FF_VOLUMES];
+
+// Ring buffer of trace entries. It's disabled if the pointer is NULL.
+static fat_io_trace_entry_t *io_trace = NULL;
+static uint32_t io_trace_size;
+static uint32_t io_trace_next; // Index of the next entry to be written
+static bool io_trace_wrapped;
+static bool io_trace_paused;
+
+void disk_io_trace(uint8_t pdrv, uint8_t op, uint32_t sector, uint32_t count,
+                   uint32_t ticks)
+{
+    if ((io_trace == NULL) || io_trace_paused)
+        return;
+
+    fat_io_trace_entry_t *entry = &io_trace[io_trace_next];
+
+    entry->time = cpuGetTiming();
+    entry->sector = sector;
+    entry->count = count;
+    entry->ticks = ticks;
+    entry->drive = pdrv;
+    entry->op = op;
+
+    io_trace_next++;
+    if (io_trace_next == io_trace_size)
+    {
+        io_trace_next = 0;
+        io_trace_wrapped = true;
+    }
+}
+
+int disk_io_trace_start(uint32_t num_entries)
+{
+    disk_io_trace_stop();
+
+    io_trace = malloc(num_entries * sizeof(fat_io_trace_entry_t));
+    if (io_trace == NULL)
+        return -1;
+
+    io_trace_size = num_entries;
+    io_trace_next = 0;
+    io_trace_wrapped = false;
+    io_trace_paused = false;
+
+    return 0;
+}
+
+void disk_io_trace_stop(void)
+{
+    free(io_trace);
+    io_trace = NULL;
+}
+
+int disk_io_trace_save(FILE *file)
+{
+    if (io_trace == NULL)
+        return -1;
+
+    // Don't record the accesses done to save the trace
+    io_trace_paused = true;
+
+    uint32_t start = io_trace_wrapped ? io_trace_next : 0;
+    uint32_t count = io_trace_wrapped ? io_trace_size : io_trace_next;
+
+    int ret = 0;
+
+    if (fprintf(file, "time,drive,op,sector,count,ticks\n") < 0)
+        ret = -1;
+
+    for (uint32_t i = 0; (i < count) && (ret == 0); i++)
+    {
+        const fat_io_trace_entry_t *entry = &io_trace[(start + i) % io_trace_size];
+
+        if (fprintf(file, "%" PRIu32 ",%u,%u,%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+                    entry->time, entry->drive, entry->op, entry->sector,
+                    entry->count, entry->ticks) < 0)
+            ret = -1;
+    }
+
+    io_trace_paused = false;
+
+    return ret;
+}
+
+void disk_get_io_stats(uint8_t pdrv, fat_io_stats_t *stats)
+{
+    *stats = io_stats[pdrv];
+}
+
+void disk_reset_io_stats(void)
+{
+    memset(io_stats, 0, sizeof(io_stats));
+}
+
+// All commands sent to the devices go through these two functions so that
+// they can be accounted for.
+
+static bool disk_device_read(BYTE pdrv, LBA_t sector, UINT count, void *buffer)
+{
+    uint32_t start = cpuGetTiming();
+    bool ret = fs_io[pdrv]->readSectors(sector, count, buffer);
+    uint32_t ticks = cpuGetTiming() - start;
+
+    fat_io_stats_t *stats = &io_stats[pdrv];
+    stats->device_reads++;
+    stats->sectors_read += count;
+    stats->read_ticks += ticks;
+    if (!ret)
+        stats->errors++;
+
+    disk_io_trace(pdrv, FAT_IO_OP_DEVICE_READ, sector, count, ticks);
+
+    return ret;
+}
+
+static bool disk_device_write(BYTE pdrv, LBA_t sector, UINT count,
+                              const void *buffer)
+{
+    uint32_t start = cpuGetTiming();
+    bool ret = fs_io[pdrv]->writeSectors(sector, count, buffer);
+    uint32_t ticks = cpuGetTiming() - start;
+
+    fat_io_stats_t *stats = &io_stats[pdrv];
+    stats->device_writes++;
+    stats->sectors_written += count;
+    stats->write_ticks += ticks;
+    if (!ret)
+        stats->errors++;
+
+    disk_io_trace(pdrv, FAT_IO_OP_DEVICE_WRITE, sector, count, ticks);
+
+    return ret;
+}
+
 static const DISC_INTERFACE *get_disk_interface(BYTE pdrv)
 {
     const DISC_INTERFACE *io = NULL;
@@ -82,6 +230,9 @@ static const DISC_INTERFACE *get_disk_interface(BYTE pdrv)
         case DEV_DLDI:
             io = dldiGetInternal();
             break;
+        case DEV_RAM:
+            io = get_io_ramdisk();
+            break;
     }
     return io;
 }
@@ -151,6 +302,52 @@ DSTATUS disk_initialize(BYTE pdrv)
 
 #define IS_WORD_ALIGNED(buff) (!(((uintptr_t) (buff)) & 0x03))
 
+//-----------------------------------------------------------------------
+// Read-ahead of cacheable reads
+//-----------------------------------------------------------------------
+
+// Cacheable reads are used for the FAT tables and directories. When they are
+// sequential (like when walking a cluster chain or listing a big directory),
+// the following sectors are read ahead of time in the same command. The window
+// grows while accesses are sequential, and it is reset when they aren't.
+
+#define READAHEAD_MIN_SECTORS   4
+#define READAHEAD_MAX_SECTORS   32
+
+typedef struct {
+    LBA_t next_sector; // Sector that follows the last cacheable read
+    uint32_t window; // Number of sectors to read ahead of time
+} readahead_state_t;
+
+static readahead_state_t readahead_state[FF_VOLUMES];
+
+static void readahead_reset(BYTE pdrv)
+{
+    readahead_state[pdrv].window = 0;
+}
+
+// Returns the number of sectors to read after the end of the request
+static uint32_t readahead_update(BYTE pdrv, LBA_t sector, UINT count)
+{
+    readahead_state_t *state = &readahead_state[pdrv];
+
+    if (sector == state->next_sector)
+    {
+        if (state->window == 0)
+            state->window = READAHEAD_MIN_SECTORS;
+        else if (state->window < READAHEAD_MAX_SECTORS)
+            state->window <<= 1;
+    }
+    else
+    {
+        state->window = 0;
+    }
+
+    state->next_sector = sector + count;
+
+    return state->window;
+}
+
 //-----------------------------------------------------------------------
 // Read Sector(s)
 //-----------------------------------------------------------------------
@@ -175,11 +372,35 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
 
     switch (pdrv)
     {
+        case DEV_RAM:
+        {
+            // Reading from the RAM disk is as fast as reading from the cache,
+            // so the cache isn't used.
+            io_stats[pdrv].read_requests++;
+            disk_io_trace(pdrv, cacheable ? FAT_IO_OP_READ_CACHED : FAT_IO_OP_READ,
+                          sector, count, 0);
+
+            if (!disk_device_read(pdrv, sector, count, buff))
+                return RES_ERROR;
+
+            return RES_OK;
+        }
+
         case DEV_DLDI:
         case DEV_SD:
         case DEV_NAND:
         {
-            const DISC_INTERFACE *io = fs_io[pdrv];
+            io_stats[pdrv].read_requests++;
+            disk_io_trace(pdrv, cacheable ? FAT_IO_OP_READ_CACHED : FAT_IO_OP_READ,
+                          sector, count, 0);
+
+            // Reads that don't go through the cache need the device to be
+            // up to date with any sectors modified in the cache.
+            if (!cacheable)
+            {
+                if (cache_flush_range(pdrv, sector, sector + count - 1) != 0)
+                    return RES_ERROR;
+            }
 
 #ifndef DISABLE_DIRECT_READS
             // The DSi SD driver supports unaligned buffers; we cannot make
@@ -187,7 +408,7 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
             if (!cacheable && memBufferIsInMainRam(buff, count << 9)
                 && (pdrv == DEV_SD || IS_WORD_ALIGNED(buff)))
             {
-                if (!io->readSectors(sector, count, buff))
+                if (!disk_device_read(pdrv, sector, count, buff))
                     return RES_ERROR;
 
                 return RES_OK;
@@ -196,44 +417,90 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
 
             if (!cacheable)
             {
-                void *cache = cache_sector_borrow();
+                // The destination can't be used by the driver. Read as many
+                // sectors as possible at once into a bounce buffer.
+                uint32_t bounce_sectors;
+                uint8_t *bounce = cache_bounce_acquire(&bounce_sectors);
 
                 while (count > 0)
                 {
-                    if (!io->readSectors(sector, 1, cache))
+                    uint32_t n = count < bounce_sectors ? count : bounce_sectors;
+
+                    if (!disk_device_read(pdrv, sector, n, bounce))
                     {
+                        cache_bounce_release(bounce);
                         return RES_ERROR;
                     }
 
-                    __aeabi_memcpy(buff, cache, FF_MAX_SS);
+                    __aeabi_memcpy(buff, bounce, n * FF_MAX_SS);
 
-                    count--;
-                    sector++;
-                    buff += FF_MAX_SS;
+                    count -= n;
+                    sector += n;
+                    buff += n * FF_MAX_SS;
                 }
+
+                cache_bounce_release(bounce);
             }
             else
             {
+                uint32_t readahead = readahead_update(pdrv, sector, count);
+                uint32_t max_fill = cache_max_fill_sectors();
+
                 while (count > 0)
                 {
                     void *cache = cache_sector_get(pdrv, sector);
 
-                    if (cache == NULL)
+                    if (cache != NULL)
                     {
-                        cache = cache_sector_add(pdrv, sector);
+                        __aeabi_memcpy(buff, cache, FF_MAX_SS);
 
-                        if (!io->readSectors(sector, 1, cache))
+                        count--;
+                        sector++;
+                        buff += FF_MAX_SS;
+                        continue;
+                    }
+
+                    // Look for the run of requested sectors that are missing
+                    // from the cache. If it reaches the end of the request,
+                    // extend it with the sectors to be read ahead of time.
+                    uint32_t requested = 1;
+                    while ((requested < count) && (requested < max_fill)
+                           && !cache_sector_present(pdrv, sector + requested))
+                        requested++;
+
+                    uint32_t run = requested;
+                    if (requested == count)
+                    {
+                        while ((run < count + readahead) && (run < max_fill)
+                               && !cache_sector_present(pdrv, sector + run))
+                            run++;
+                    }
+
+                    uint8_t *fill = cache_sector_add_run(pdrv, sector, &run, requested);
+
+                    if (!disk_device_read(pdrv, sector, run, fill))
+                    {
+                        // The read-ahead part may be past the end of the
+                        // device. Retry with just the first sector.
+                        cache_sector_invalidate(pdrv, sector + 1, sector + run - 1);
+                        readahead_reset(pdrv);
+
+                        if ((run == 1) || !disk_device_read(pdrv, sector, 1, fill))
                         {
                             cache_sector_invalidate(pdrv, sector, sector);
                             return RES_ERROR;
                         }
+
+                        run = 1;
                     }
 
-                    __aeabi_memcpy(buff, cache, FF_MAX_SS);
+                    uint32_t copy = run < count ? run : count;
 
-                    count--;
-                    sector++;
-                    buff += FF_MAX_SS;
+                    __aeabi_memcpy(buff, fill, copy * FF_MAX_SS);
+
+                    count -= copy;
+                    sector += copy;
+                    buff += copy * FF_MAX_SS;
                 }
             }
 
@@ -261,13 +528,45 @@ DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
 
     switch (pdrv)
     {
+        case DEV_RAM:
+        {
+            io_stats[pdrv].write_requests++;
+            disk_io_trace(pdrv, FAT_IO_OP_WRITE, sector, count, 0);
+
+            if (!disk_device_write(pdrv, sector, count, buff))
+                return RES_ERROR;
+
+            return RES_OK;
+        }
+
         case DEV_DLDI:
         case DEV_SD:
         case DEV_NAND:
         {
+            io_stats[pdrv].write_requests++;
+            disk_io_trace(pdrv, FAT_IO_OP_WRITE, sector, count, 0);
+
+            if (cache_writeback_accepts(count))
+            {
+                // Keep the data in the cache until it is flushed
+                while (count > 0)
+                {
+                    void *cache = cache_sector_write(pdrv, sector);
+
+                    __aeabi_memcpy(cache, buff, FF_MAX_SS);
+
+                    count--;
+                    sector++;
+                    buff += FF_MAX_SS;
+                }
+
+                return RES_OK;
+            }
+
+            // This also discards any dirty sector in the cache, they are
+            // overwritten by this write.
             cache_sector_invalidate(pdrv, sector, sector + count - 1);
 
-            const DISC_INTERFACE *io = fs_io[pdrv];
             // The DSi SD driver supports unaligned buffers; we cannot make
             // the same guarantee for DLDI in practice.
 #ifndef DISABLE_DIRECT_WRITES
@@ -275,27 +574,34 @@ DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
                 || !(pdrv == DEV_SD || IS_WORD_ALIGNED(buff)))
 #endif
             {
-                // DLDI drivers expect a 4-byte aligned buffer.
-                uint8_t *align_buffer = cache_sector_borrow();
+                // DLDI drivers expect a 4-byte aligned buffer in main RAM.
+                // Write as many sectors as possible at once from a bounce
+                // buffer.
+                uint32_t bounce_sectors;
+                uint8_t *bounce = cache_bounce_acquire(&bounce_sectors);
 
                 while (count > 0)
                 {
-                    __aeabi_memcpy(align_buffer, buff, FF_MAX_SS);
-                    if (!io->writeSectors(sector, 1, align_buffer))
+                    uint32_t n = count < bounce_sectors ? count : bounce_sectors;
+
+                    __aeabi_memcpy(bounce, buff, n * FF_MAX_SS);
+                    if (!disk_device_write(pdrv, sector, n, bounce))
                     {
-                        free(align_buffer);
+                        cache_bounce_release(bounce);
                         return RES_ERROR;
                     }
 
-                    count--;
-                    sector++;
-                    buff += FF_MAX_SS;
+                    count -= n;
+                    sector += n;
+                    buff += n * FF_MAX_SS;
                 }
+
+                cache_bounce_release(bounce);
             }
 #ifndef DISABLE_DIRECT_WRITES
             else
             {
-                if (!io->writeSectors(sector, count, buff))
+                if (!disk_device_write(pdrv, sector, count, buff))
                     return RES_ERROR;
             }
 #endif
@@ -307,6 +613,17 @@ DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
     return RES_PARERR;
 }
 
+// Used by the cache to write dirty sectors to the device. The cache only
+// passes buffers that are word-aligned and in main RAM.
+bool disk_writeback_sectors(uint8_t pdrv, uint32_t sector, uint32_t count,
+                            const void *buffer)
+{
+    if (!fs_initialized[pdrv])
+        return false;
+
+    return disk_device_write(pdrv, sector, count, buffer);
+}
+
 #endif
 
 //-----------------------------------------------------------------------
@@ -342,7 +659,23 @@ DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
             // Fall through
 
         case DEV_DLDI:
-            // This command flushes the writeback cache, but there is no such cache right now.
+            // This command flushes the writeback cache.
+            if (cmd == CTRL_SYNC)
+                return cache_flush(pdrv) == 0 ? RES_OK : RES_ERROR;
+
+            return RES_PARERR;
+
+        case DEV_RAM:
+            if (cmd == GET_SECTOR_COUNT)
+            {
+                *((LBA_t*) buff) = ramdiskGetSectors();
+                return RES_OK;
+            }
+            if (cmd == GET_BLOCK_SIZE)
+            {
+                *((DWORD*) buff) = 1;
+                return RES_OK;
+            }
             if (cmd == CTRL_SYNC)
                 return RES_OK;
 
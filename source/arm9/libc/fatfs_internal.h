@@ -16,4 +16,12 @@ int fatfs_error_to_posix(FRESULT error);
 time_t fatfs_fattime_to_timestamp(uint16_t ftime, uint16_t fdate);
 uint32_t fatfs_timestamp_to_fattime(struct tm *stm);
 
+// Cached version of f_stat(). Any function that modifies the filesystem, or
+// that changes the meaning of relative paths, must invalidate the cache.
+FRESULT fatfs_stat_cached(const char *path, FILINFO *fno);
+void fatfs_stat_cache_invalidate(void);
+
+struct stat;
+void fatfs_filinfo_to_stat(const FILINFO *fno, struct stat *st);
+
 #endif // FATFS_INTERNAL_H__
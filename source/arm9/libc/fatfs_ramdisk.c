@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Mounting of the RAM disk as "ram:/". This is kept separate from fatfs.c so
+// that f_mkfs() is only linked in programs that use RAM disks.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <nds/disc_io.h>
+
+#include "fat.h"
+#include "ff.h"
+#include "fatfs_internal.h"
+
+static const char *ram_drive = "ram:/";
+
+// The FATFS struct is only allocated while the RAM disk is mounted
+static FATFS *ram_fs_info = NULL;
+
+// Buffer allocated by fatInitRamDisk(), if any
+static void *ram_buffer_allocated = NULL;
+
+int fatInitRamDisk(void *buffer, size_t size, bool format)
+{
+    if (ram_fs_info != NULL)
+    {
+        errno = EBUSY;
+        return -1;
+    }
+
+    FATFS *fs_info = calloc(1, sizeof(FATFS));
+    if (fs_info == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    void *allocated = NULL;
+
+    if (buffer == NULL)
+    {
+        allocated = malloc(size);
+        if (allocated == NULL)
+        {
+            free(fs_info);
+            errno = ENOMEM;
+            return -1;
+        }
+        buffer = allocated;
+    }
+
+    if (!ramdiskSetup(buffer, size / FF_MAX_SS))
+    {
+        free(allocated);
+        free(fs_info);
+        errno = EINVAL;
+        return -1;
+    }
+
+    FRESULT result = f_mount(fs_info, ram_drive, 1);
+
+    // Only format the disk if it doesn't contain a filesystem already, so that
+    // memory that survives a reset (like a Slot-2 RAM expansion) keeps its
+    // contents.
+    if ((result == FR_NO_FILESYSTEM) && format)
+    {
+        const MKFS_PARM opt = { FM_ANY | FM_SFD, 1, 0, 0, 0 };
+        BYTE work[FF_MAX_SS];
+
+        result = f_mkfs(ram_drive, &opt, work, sizeof(work));
+        if (result == FR_OK)
+            result = f_mount(fs_info, ram_drive, 1);
+    }
+
+    if (result != FR_OK)
+    {
+        f_mount(NULL, ram_drive, 0);
+        ramdiskSetup(NULL, 0);
+        free(allocated);
+        free(fs_info);
+        errno = fatfs_error_to_posix(result);
+        return -1;
+    }
+
+    ram_fs_info = fs_info;
+    ram_buffer_allocated = allocated;
+
+    return 0;
+}
+
+int fatExitRamDisk(void)
+{
+    if (ram_fs_info == NULL)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    FRESULT result = f_mount(NULL, ram_drive, 0);
+    if (result != FR_OK)
+    {
+        errno = fatfs_error_to_posix(result);
+        return -1;
+    }
+
+    // Paths in "ram:/" may be in the stat cache
+    fatfs_stat_cache_invalidate();
+
+    ramdiskSetup(NULL, 0);
+
+    free(ram_buffer_allocated);
+    ram_buffer_allocated = NULL;
+
+    free(ram_fs_info);
+    ram_fs_info = NULL;
+
+    return 0;
+}
@@ -127,19 +127,25 @@ int open(const char *path, int flags, ...)
         mode |= FA_OPEN_EXISTING; // r
     }
 
-    FIL *fp = calloc(1, sizeof(FIL));
-    if (fp == NULL)
+    fat_file_t *file = calloc(1, sizeof(fat_file_t));
+    if (file == NULL)
     {
         errno = ENOMEM;
         return -1;
     }
 
+    FIL *fp = &file->fil;
+
+    // Opening a file may create it or truncate it
+    if (mode & FA_WRITE)
+        fatfs_stat_cache_invalidate();
+
     FRESULT result = f_open(fp, path, mode);
 
     if (result == FR_OK)
         return FD_FAT_PACK(fp);
 
-    free(fp);
+    free(file);
     errno = fatfs_error_to_posix(result);
     return -1;
 }
@@ -216,6 +222,8 @@ ssize_t write(int fd, const void *ptr, size_t len)
     FIL *fp = FD_FAT_UNPACK(fd);
     UINT bytes_written = 0;
 
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_write(fp, ptr, len, &bytes_written);
 
     if (result == FR_OK)
@@ -241,6 +249,9 @@ int fsync(int fd)
 
     FIL *fp = FD_FAT_UNPACK(fd);
 
+    // This updates the directory entry of the file
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_sync(fp);
 
     if (result == FR_OK)
@@ -254,6 +265,27 @@ int fsync(int fd)
 // so the fsync() symbol is aliased.
 int fdatasync(int fd) __attribute__((alias("fsync")));
 
+// Frees the clusters reserved by fat_preallocate() that haven't been used.
+static FRESULT fat_release_reserved(fat_file_t *file)
+{
+    FIL *fp = &file->fil;
+    FSIZE_t size = f_size(fp);
+
+    if (file->reserved_size <= size)
+        return FR_OK;
+
+    // The cluster chain is as long as the reserved area. Make FatFs see it as
+    // part of the file so that f_truncate() removes the unused clusters.
+    fp->obj.objsize = file->reserved_size;
+    file->reserved_size = 0;
+
+    FRESULT result = f_lseek(fp, size);
+    if (result != FR_OK)
+        return result;
+
+    return f_truncate(fp);
+}
+
 int close(int fd)
 {
     // The stdio descriptors can't be opened or closed
@@ -276,7 +308,14 @@ int close(int fd)
 
     FIL *fp = FD_FAT_UNPACK(fd);
 
-    FRESULT result = f_close(fp);
+    // Closing a file updates its directory entry
+    fatfs_stat_cache_invalidate();
+
+    FRESULT result = fat_release_reserved((fat_file_t *)fp);
+
+    FRESULT close_result = f_close(fp);
+    if (result == FR_OK)
+        result = close_result;
 
     if (fp->cltbl != NULL)
         free(fp->cltbl);
@@ -325,6 +364,14 @@ off_t lseek(int fd, off_t offset, int whence)
         return -1;
     }
 
+    if (offset < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fat_lookup_cache_auto((fat_file_t *)fp, offset);
+
     FRESULT result = f_lseek(fp, offset);
 
     if (result == FR_OK)
@@ -341,6 +388,8 @@ _off64_t lseek64(int fd, _off64_t offset, int whence)
 
 int unlink(const char *name)
 {
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_unlink(name);
 
     if (result == FR_OK)
@@ -352,6 +401,8 @@ int unlink(const char *name)
 
 int rmdir(const char *name)
 {
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_rmdir(name);
 
     if (result == FR_OK)
@@ -373,7 +424,7 @@ int stat(const char *path, struct stat *st)
         return nitrofs_stat(path, st);
 
     FILINFO fno = { 0 };
-    FRESULT result = f_stat(path, &fno);
+    FRESULT result = fatfs_stat_cached(path, &fno);
 
     if (result != FR_OK)
     {
@@ -381,29 +432,7 @@ int stat(const char *path, struct stat *st)
         return -1;
     }
 
-    // On FatFS, st_dev is either 0 (DLDI) or 1 (DSi SD),
-    // while st_ino is the file's starting cluster in FAT.
-    st->st_dev = fno.fpdrv;
-    st->st_ino = fno.fclust;
-
-    st->st_size = fno.fsize;
-
-#if FF_MAX_SS != FF_MIN_SS
-#error "Set the block size to the right value"
-#endif
-    st->st_blksize = FF_MAX_SS;
-    st->st_blocks = (fno.fsize + FF_MAX_SS - 1) / FF_MAX_SS;
-
-    st->st_mode = (fno.fattrib & AM_DIR) ?
-                   S_IFDIR : // Directory
-                   S_IFREG;  // Regular file
-
-    time_t time = fatfs_fattime_to_timestamp(fno.fdate, fno.ftime);
-    time_t crtime = fatfs_fattime_to_timestamp(fno.crdate, fno.crtime);
-
-    st->st_atim.tv_sec = time; // Time of last access
-    st->st_mtim.tv_sec = time; // Time of last modification
-    st->st_ctim.tv_sec = crtime; // Time of last file entry change (~= creation)
+    fatfs_filinfo_to_stat(&fno, st);
 
     return 0;
 }
@@ -477,6 +506,8 @@ int link(const char *old, const char *new)
 
 int rename(const char *old, const char *new)
 {
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_rename(old, new);
 
     if (result == FR_OK)
@@ -494,6 +525,8 @@ static int ftruncate_internal(int fd, off_t length)
 
     FIL *fp = FD_FAT_UNPACK(fd);
 
+    fatfs_stat_cache_invalidate();
+
     FSIZE_t fsize = f_size(fp);
 
     // If the new size is bigger, it's not enough to use f_lseek to set the
@@ -539,7 +572,17 @@ static int ftruncate_internal(int fd, off_t length)
     {
         // Truncate the file to a smaller size
 
-        FRESULT result = f_lseek(fp, length);
+        // Release the clusters reserved by fat_preallocate() first. If not,
+        // f_truncate() may free the whole cluster chain and the clusters
+        // would be released again when the file is closed.
+        FRESULT result = fat_release_reserved((fat_file_t *)fp);
+        if (result != FR_OK)
+        {
+            errno = fatfs_error_to_posix(result);
+            return -1;
+        }
+
+        result = f_lseek(fp, length);
         if (result != FR_OK)
         {
             errno = fatfs_error_to_posix(result);
@@ -557,6 +600,44 @@ static int ftruncate_internal(int fd, off_t length)
     return 0;
 }
 
+int posix_fallocate(int fd, off_t offset, off_t len)
+{
+    // This function doesn't work on stdin, stdout or stderr
+    if ((fd >= STDIN_FILENO) && (fd <= STDERR_FILENO))
+        return EBADF;
+
+    if (FD_TYPE(fd) != FD_TYPE_FAT)
+        return EBADF;
+
+    if ((offset < 0) || (len <= 0))
+        return EINVAL;
+
+    FIL *fp = FD_FAT_UNPACK(fd);
+
+    FSIZE_t end = (FSIZE_t)offset + (FSIZE_t)len;
+    if (end <= f_size(fp))
+        return 0; // The space is already allocated
+
+    // Try to reserve a contiguous area for empty files. If there isn't enough
+    // contiguous free space, the file is extended normally.
+    if (f_size(fp) == 0)
+        fat_preallocate((fat_file_t *)fp, end);
+
+    // POSIX requires the file offset to remain unchanged
+    FSIZE_t prev_offset = f_tell(fp);
+
+    // The new space needs to read as zeroes, so it needs to be written.
+    int ret = 0;
+    if (ftruncate_internal(fd, end) != 0)
+        ret = errno;
+
+    FRESULT result = f_lseek(fp, prev_offset);
+    if ((ret == 0) && (result != FR_OK))
+        ret = fatfs_error_to_posix(result);
+
+    return ret;
+}
+
 int ftruncate(int fd, off_t length)
 {
     // This function doesn't work on stdin, stdout or stderr
@@ -634,6 +715,8 @@ int mkdir(const char *path, mode_t mode)
 {
     (void)mode; // There are no permissions in FAT filesystems
 
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_mkdir(path);
     if (result != FR_OK)
     {
@@ -730,7 +813,7 @@ int access(const char *path, int amode)
     }
 
     FILINFO fno = { 0 };
-    FRESULT result = f_stat(path, &fno);
+    FRESULT result = fatfs_stat_cached(path, &fno);
     if (result != FR_OK)
     {
         errno = fatfs_error_to_posix(result);
@@ -803,6 +886,8 @@ bool fatSetVolumeLabel(const char *name, const char *label)
     // Append destination volume label
     strcat(buffer, label);
 
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_setlabel(buffer);
     free(buffer);
     return result == FR_OK;
@@ -820,7 +905,7 @@ int FAT_getAttr(const char *file)
         return nitrofs_fat_get_attr(file);
 
     FILINFO fno = { 0 };
-    FRESULT result = f_stat(file, &fno);
+    FRESULT result = fatfs_stat_cached(file, &fno);
 
     if (result != FR_OK)
     {
@@ -848,6 +933,8 @@ int FAT_setAttr(const char *file, uint8_t attr)
     // Modify all attributes (except for directory and volume)
     BYTE mask = AM_RDO | AM_ARC | AM_SYS | AM_HID;
 
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_chmod(file, attr, mask);
 
     if (result != FR_OK)
@@ -867,7 +954,7 @@ bool FAT_getShortNameFor(const char *path, char *buf)
     }
 
     FILINFO fno = { 0 };
-    FRESULT result = f_stat(path, &fno);
+    FRESULT result = fatfs_stat_cached(path, &fno);
 
     if (result != FR_OK)
     {
@@ -30,6 +30,17 @@
 #define FD_IS_NITRO(x)  (FD_TYPE(x) == FD_TYPE_NITRO)
 #define FD_IS_SOCKET(x) (FD_TYPE(x) == FD_TYPE_SOCKET)
 
+// Information of a file opened in a FAT filesystem. The FIL structure must be
+// the first member so that file descriptors can be used as FIL pointers.
+typedef struct {
+    FIL fil;
+    // Set if the file is too fragmented to get an automatic look-up cache
+    bool lookup_cache_failed;
+    // Size of the contiguous area reserved by fat_preallocate(). Any part of it
+    // that isn't used when the file is closed is released.
+    FSIZE_t reserved_size;
+} fat_file_t;
+
 // Create a file descriptor from a FIL pointer
 static inline int FD_FAT_PACK(FIL *f)
 {
@@ -44,4 +55,12 @@ static inline FIL *FD_FAT_UNPACK(int fd)
 
 extern bool current_drive_is_nitrofs;
 
+// Creates the look-up cache of a file if the automatic look-up cache is enabled
+// and seeking to the new offset would require a long walk of the cluster chain.
+void fat_lookup_cache_auto(fat_file_t *file, FSIZE_t offset);
+
+// Reserves a contiguous cluster chain for an empty file without changing its
+// size. It returns 0 on success or an errno code on error.
+int fat_preallocate(fat_file_t *file, FSIZE_t size);
+
 #endif // FILESYSTEM_INTERNAL_H__
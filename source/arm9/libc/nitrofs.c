@@ -5,6 +5,7 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <malloc.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -14,6 +15,7 @@
 
 #include <aeabi.h>
 #include <fat.h>
+#include <filesystem.h>
 #include <nds/arm9/card.h>
 #include <nds/arm9/sassert.h>
 #include <nds/arm9/dldi.h>
@@ -54,11 +56,6 @@ bool nitrofs_use_for_path(const char *path)
         return current_drive_is_nitrofs;
 }
 
-// Symbol defined by the linker
-extern char __dtcm_start[];
-const uintptr_t DTCM_START = (uintptr_t)__dtcm_start;
-const uintptr_t DTCM_END   = DTCM_START + (16 * 1024) - 1;
-
 // Read from NitroFS when it is being read from a file
 static ssize_t nitrofs_read_internal_file(void *ptr, size_t offset, size_t len)
 {
@@ -74,35 +71,57 @@ static ssize_t nitrofs_read_internal_slot2(void *ptr, size_t offset, size_t len)
     return len;
 }
 
+// DMA channel used for slot-1 reads from the ARM9, or -1 to use polled reads
+static int nitrofs_card_dma_channel = -1;
+
+int nitroFSSetCardDmaChannel(int channel)
+{
+    if ((channel < -1) || (channel > 3))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nitrofs_card_dma_channel = channel;
+    return 0;
+}
+
 // Read from NitroFS when it is being read with cartridge commands
 static ssize_t nitrofs_read_internal_cart(void *ptr, size_t offset, size_t len)
 {
     if (dldiGetMode() == DLDI_MODE_ARM7)
     {
-        if ((uintptr_t)ptr >= DTCM_START && (uintptr_t)ptr < DTCM_END)
+        if (!memBufferIsInMainRam(ptr, len))
         {
-            // The destination is in DTCM
+            // The destination isn't in main RAM (it may be in DTCM or ITCM, for
+            // example), so the ARM7 can't access it. Read as much data as
+            // possible at once into a bounce buffer.
 
-            void *cache = cache_sector_borrow();
+            uint32_t bounce_sectors;
+            void *bounce = cache_bounce_acquire(&bounce_sectors);
 
 #if FF_MAX_SS != FF_MIN_SS
 #error "This code expects a fixed sector size"
 #endif
+            size_t bounce_size = bounce_sectors * FF_MAX_SS;
             uint8_t *buff = ptr;
+            size_t remaining = len;
 
-            while (len > 0)
+            while (remaining > 0)
             {
-                size_t read_size = len > FF_MAX_SS ? FF_MAX_SS : len;
+                size_t read_size = remaining > bounce_size ? bounce_size : remaining;
 
-                cardReadArm7(cache, offset, read_size, __NDSHeader->cardControl13);
+                cardReadArm7(bounce, offset, read_size, __NDSHeader->cardControl13);
 
-                __aeabi_memcpy(buff, cache, read_size);
+                __aeabi_memcpy(buff, bounce, read_size);
 
-                len -= read_size;
+                remaining -= read_size;
                 offset += read_size;
                 buff += read_size;
             }
 
+            cache_bounce_release(bounce);
+
             return len;
         }
         else
@@ -114,7 +133,15 @@ static ssize_t nitrofs_read_internal_cart(void *ptr, size_t offset, size_t len)
     else
     {
         sysSetCardOwner(BUS_OWNER_ARM9);
-        cardRead(ptr, offset, len, __NDSHeader->cardControl13);
+        if (nitrofs_card_dma_channel >= 0)
+        {
+            cardReadDma(ptr, offset, len, __NDSHeader->cardControl13,
+                        nitrofs_card_dma_channel);
+        }
+        else
+        {
+            cardRead(ptr, offset, len, __NDSHeader->cardControl13);
+        }
         return len;
     }
 }
@@ -131,13 +158,395 @@ static ssize_t nitrofs_read_internal(void *ptr, size_t offset, size_t len)
     return nitrofs_read_internal_cart(ptr, offset, len);
 }
 
+/// Block cache
+
+// Small reads are served from a cache of aligned blocks shared by all files.
+// This avoids sending a card command (or a fseek() and fread() pair) for every
+// small read. The number of blocks is expected to be small, so a linear search
+// is good enough.
+
+typedef struct {
+    uint32_t offset; // ROM offset of the block, NITROFS_CACHE_EMPTY if unused
+    uint32_t used_at;
+} nitrofs_cache_block_t;
+
+#define NITROFS_CACHE_EMPTY     UINT32_MAX
+
+static struct {
+    uint8_t *mem;
+    nitrofs_cache_block_t *blocks;
+    uint32_t block_size;
+    uint32_t num_blocks;
+    uint32_t usage_counter;
+    nitrofs_cache_stats_t stats;
+} nitrofs_cache;
+
+static void nitrofs_cache_invalidate(void)
+{
+    for (uint32_t i = 0; i < nitrofs_cache.num_blocks; i++)
+        nitrofs_cache.blocks[i].offset = NITROFS_CACHE_EMPTY;
+}
+
+static void nitrofs_cache_free(void)
+{
+    free(nitrofs_cache.mem);
+    nitrofs_cache.mem = NULL;
+    free(nitrofs_cache.blocks);
+    nitrofs_cache.blocks = NULL;
+    nitrofs_cache.num_blocks = 0;
+}
+
+int nitroFSInitCache(uint32_t block_size, uint32_t num_blocks)
+{
+    nitrofs_cache_free();
+
+    if (num_blocks == 0)
+        return 0;
+
+    // The block size must be a power of two
+    if ((block_size < 32) || (block_size & (block_size - 1)))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nitrofs_cache.blocks = malloc(num_blocks * sizeof(nitrofs_cache_block_t));
+    nitrofs_cache.mem = memalign(32, num_blocks * block_size);
+    if ((nitrofs_cache.blocks == NULL) || (nitrofs_cache.mem == NULL))
+    {
+        nitrofs_cache_free();
+        errno = ENOMEM;
+        return -1;
+    }
+
+    nitrofs_cache.block_size = block_size;
+    nitrofs_cache.num_blocks = num_blocks;
+    nitrofs_cache.usage_counter = 0;
+    nitrofs_cache_invalidate();
+
+    return 0;
+}
+
+void nitroFSGetCacheStats(nitrofs_cache_stats_t *stats)
+{
+    if (stats != NULL)
+        *stats = nitrofs_cache.stats;
+}
+
+void nitroFSResetCacheStats(void)
+{
+    memset(&nitrofs_cache.stats, 0, sizeof(nitrofs_cache.stats));
+}
+
+static const uint8_t *nitrofs_cache_block_get(uint32_t offset)
+{
+    uint32_t selected = 0;
+    uint32_t used_at_difference = 0;
+
+    for (uint32_t i = 0; i < nitrofs_cache.num_blocks; i++)
+    {
+        nitrofs_cache_block_t *block = &nitrofs_cache.blocks[i];
+
+        if (block->offset == offset)
+        {
+            block->used_at = nitrofs_cache.usage_counter++;
+            nitrofs_cache.stats.hits++;
+            return nitrofs_cache.mem + (i * nitrofs_cache.block_size);
+        }
+
+        if (block->offset == NITROFS_CACHE_EMPTY)
+        {
+            // Prefer empty blocks, but keep looking for the requested one
+            selected = i;
+            used_at_difference = UINT32_MAX;
+            continue;
+        }
+
+        uint32_t i_used_at_difference = nitrofs_cache.usage_counter - block->used_at;
+        if (i_used_at_difference > used_at_difference)
+        {
+            used_at_difference = i_used_at_difference;
+            selected = i;
+        }
+    }
+
+    nitrofs_cache_block_t *block = &nitrofs_cache.blocks[selected];
+    uint8_t *mem = nitrofs_cache.mem + (selected * nitrofs_cache.block_size);
+
+    nitrofs_cache.stats.misses++;
+
+    // The end of the block may be past the end of the ROM. That's fine, the
+    // callers never use data past the end of the files.
+    if (nitrofs_read_internal(mem, offset, nitrofs_cache.block_size) < 0)
+    {
+        block->offset = NITROFS_CACHE_EMPTY;
+        return NULL;
+    }
+
+    block->offset = offset;
+    block->used_at = nitrofs_cache.usage_counter++;
+
+    return mem;
+}
+
+// This reads from NitroFS using the block cache for small reads
+ssize_t nitrofs_read_cached(void *ptr, size_t offset, size_t len)
+{
+    if (nitrofs_cache.num_blocks == 0)
+        return nitrofs_read_internal(ptr, offset, len);
+
+    // Slot-2 is memory-mapped, and big reads are faster without the cache.
+    if (nitrofs_local.use_slot2 || (len >= nitrofs_cache.block_size))
+    {
+        nitrofs_cache.stats.bypassed++;
+        return nitrofs_read_internal(ptr, offset, len);
+    }
+
+    uint8_t *buff = ptr;
+    size_t remaining = len;
+
+    while (remaining > 0)
+    {
+        uint32_t block_offset = offset & ~(nitrofs_cache.block_size - 1);
+        size_t in_block = offset - block_offset;
+        size_t copy = nitrofs_cache.block_size - in_block;
+        if (copy > remaining)
+            copy = remaining;
+
+        const uint8_t *block = nitrofs_cache_block_get(block_offset);
+        if (block == NULL)
+            return -1;
+
+        memcpy(buff, block + in_block, copy);
+
+        remaining -= copy;
+        offset += copy;
+        buff += copy;
+    }
+
+    return len;
+}
+
+// This reads from the FNT, from the copy in RAM if there is one. The offset is
+// relative to the start of the ROM. Data past the end of the FNT is zeroed.
+static void nitrofs_read_fnt(void *ptr, size_t offset, size_t len)
+{
+    if (nitrofs_local.fnt_copy == NULL)
+    {
+        nitrofs_read_cached(ptr, offset, len);
+        return;
+    }
+
+    size_t fnt_offset = offset - nitrofs_local.fnt_offset;
+    size_t available = 0;
+    if (fnt_offset < nitrofs_local.fnt_size)
+        available = nitrofs_local.fnt_size - fnt_offset;
+    if (available > len)
+        available = len;
+
+    memcpy(ptr, nitrofs_local.fnt_copy + fnt_offset, available);
+    memset((uint8_t *)ptr + available, 0, len - available);
+}
+
+/// Path index
+
+// FNV-1a hash of a name, seeded with the directory that contains it
+static uint32_t nitrofs_index_hash(uint16_t dir, const char *name, size_t len)
+{
+    uint32_t hash = 2166136261U ^ dir;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static int32_t nitrofs_index_lookup(uint16_t dir, const char *name, size_t len)
+{
+    uint32_t mask = nitrofs_local.index_mask;
+    uint32_t i = nitrofs_index_hash(dir, name, len) & mask;
+
+    while (1)
+    {
+        nitrofs_index_entry_t *entry = &nitrofs_local.index[i];
+
+        if (entry->name_offset == 0)
+            return -1;
+
+        if (entry->dir == dir)
+        {
+            const uint8_t *entry_name = nitrofs_local.fnt_copy + entry->name_offset;
+
+            // The type byte that precedes the name contains its length
+            if (((entry_name[-1] & 0x7F) == len) && !memcmp(entry_name, name, len))
+                return entry->id;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+static void nitrofs_index_free(void)
+{
+    free(nitrofs_local.index);
+    nitrofs_local.index = NULL;
+    free(nitrofs_local.fnt_copy);
+    nitrofs_local.fnt_copy = NULL;
+}
+
+// Iterate over all entries of the FNT in RAM. If "index" is NULL the entries
+// are only counted. It returns the number of entries, or -1 if the FNT is
+// corrupted.
+static int32_t nitrofs_index_fill(const uint8_t *fnt, uint32_t fnt_size,
+                                  nitrofs_index_entry_t *index, uint32_t mask)
+{
+    if (fnt_size < sizeof(nitrofs_fnt_entry_t))
+        return -1;
+
+    // The "parent" field of the root directory is the number of directories
+    uint32_t num_dirs = fnt[6] | (fnt[7] << 8);
+    if ((num_dirs == 0) || (num_dirs > 0x1000) || (num_dirs * 8 > fnt_size))
+        return -1;
+
+    int32_t count = 0;
+
+    for (uint32_t d = 0; d < num_dirs; d++)
+    {
+        const uint8_t *dir_entry = fnt + (d * 8);
+
+        uint32_t pos = dir_entry[0] | (dir_entry[1] << 8) | (dir_entry[2] << 16)
+                     | (dir_entry[3] << 24);
+        uint16_t file_index = dir_entry[4] | (dir_entry[5] << 8);
+
+        while (1)
+        {
+            if (pos >= fnt_size)
+                return -1;
+
+            uint8_t type = fnt[pos];
+            if (type == 0)
+                break;
+
+            uint32_t len = type & 0x7F;
+            uint32_t name_offset = pos + 1;
+            uint16_t id;
+
+            if (type & 0x80)
+            {
+                if (name_offset + len + 2 > fnt_size)
+                    return -1;
+
+                id = fnt[name_offset + len] | (fnt[name_offset + len + 1] << 8);
+                pos = name_offset + len + 2;
+            }
+            else
+            {
+                if (name_offset + len > fnt_size)
+                    return -1;
+
+                id = file_index++;
+                pos = name_offset + len;
+            }
+
+            if (index != NULL)
+            {
+                uint16_t dir = 0xF000 + d;
+                uint32_t i = nitrofs_index_hash(dir, (const char *)(fnt + name_offset), len) & mask;
+
+                while (index[i].name_offset != 0)
+                    i = (i + 1) & mask;
+
+                index[i].name_offset = name_offset;
+                index[i].dir = dir;
+                index[i].id = id;
+            }
+
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int nitroFSInitPathIndex(uint32_t max_memory)
+{
+    if (!nitrofs_local.fnt_offset)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    if (nitrofs_local.index != NULL)
+        return 0;
+
+    uint32_t fnt_size = nitrofs_local.fnt_size;
+    if (fnt_size > max_memory)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // Card reads benefit from word-aligned accesses
+    uint32_t misalign = nitrofs_local.fnt_offset & 3;
+    uint8_t *fnt_buffer = malloc(fnt_size + misalign);
+    if (fnt_buffer == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    nitrofs_read_internal(fnt_buffer, nitrofs_local.fnt_offset - misalign,
+                          fnt_size + misalign);
+    if (misalign)
+        memmove(fnt_buffer, fnt_buffer + misalign, fnt_size);
+
+    int32_t count = nitrofs_index_fill(fnt_buffer, fnt_size, NULL, 0);
+    if (count < 0)
+    {
+        free(fnt_buffer);
+        errno = EIO;
+        return -1;
+    }
+
+    // Keep the load factor of the table under 75%
+    uint32_t capacity = 1;
+    while (capacity < (uint32_t)count + ((uint32_t)count / 3) + 1)
+        capacity <<= 1;
+
+    if (fnt_size + (capacity * sizeof(nitrofs_index_entry_t)) > max_memory)
+    {
+        free(fnt_buffer);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    nitrofs_index_entry_t *index = calloc(capacity, sizeof(nitrofs_index_entry_t));
+    if (index == NULL)
+    {
+        free(fnt_buffer);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    nitrofs_index_fill(fnt_buffer, fnt_size, index, capacity - 1);
+
+    nitrofs_local.fnt_copy = fnt_buffer;
+    nitrofs_local.index = index;
+    nitrofs_local.index_mask = capacity - 1;
+
+    return 0;
+}
+
 /// Directory I/O
 
 static bool nitrofs_dir_state_init(nitrofs_dir_state_t *state, uint16_t dir)
 {
     nitrofs_fnt_entry_t fnt_entry;
 
-    nitrofs_read_internal(&fnt_entry, nitrofs_local.fnt_offset + ((dir - 0xF000) * 8), sizeof(fnt_entry));
+    nitrofs_read_fnt(&fnt_entry, nitrofs_local.fnt_offset + ((dir - 0xF000) * 8), sizeof(fnt_entry));
     state->offset = nitrofs_local.fnt_offset + fnt_entry.offset;
     state->sector_offset = 0;
     state->position = 0;
@@ -149,7 +558,7 @@ static bool nitrofs_dir_state_init(nitrofs_dir_state_t *state, uint16_t dir)
     state->dotdot_offset = dir == 0xF000 ? 0 : -2;
 #endif
 
-    if (nitrofs_local.file == NULL)
+    if ((nitrofs_local.file == NULL) && (nitrofs_local.fnt_copy == NULL))
     {
         // Card reads benefit from word-aligning table accesses.
         state->position = state->offset & 3;
@@ -157,7 +566,7 @@ static bool nitrofs_dir_state_init(nitrofs_dir_state_t *state, uint16_t dir)
     }
 
     state->buffer[state->position] = 0;
-    nitrofs_read_internal(state->buffer, state->offset, 512);
+    nitrofs_read_fnt(state->buffer, state->offset, 512);
     return state->buffer[state->position] != 0;
 }
 
@@ -187,7 +596,7 @@ static bool nitrofs_dir_state_next(nitrofs_dir_state_t *state)
             memcpy(state->buffer, state->buffer + shift, next_sector_offset);
             state->offset += 512;
             state->sector_offset = next_sector_offset;
-            nitrofs_read_internal(state->buffer + next_sector_offset, state->offset, 512);
+            nitrofs_read_fnt(state->buffer + next_sector_offset, state->offset, 512);
             state->position &= 3;
         }
     }
@@ -217,7 +626,7 @@ static uint16_t nitrofs_dir_parent_index(uint16_t dir)
         return dir;
 
     nitrofs_fnt_entry_t fnt_entry;
-    nitrofs_read_internal(&fnt_entry, nitrofs_local.fnt_offset + ((dir - 0xF000) * 8), sizeof(fnt_entry));
+    nitrofs_read_fnt(&fnt_entry, nitrofs_local.fnt_offset + ((dir - 0xF000) * 8), sizeof(fnt_entry));
     return fnt_entry.parent;
 }
 
@@ -231,10 +640,14 @@ static int32_t nitrofs_dir_step(uint16_t dir, const char *name)
     if (!strcmp(name, ".."))
         return nitrofs_dir_parent_index(dir);
 
+    size_t name_len = strlen(name);
+
+    if (nitrofs_local.index != NULL)
+        return nitrofs_index_lookup(dir, name, name_len);
+
     if (!nitrofs_dir_state_init(&state, dir))
         return dir;
 
-    size_t name_len = strlen(name);
     do
     {
         uint8_t type = state.buffer[state.position];
@@ -470,26 +883,85 @@ int nitrofs_chdir(const char *path)
 
 /// File I/O
 
+static bool nitrofs_decompression_enabled = false;
+
+void nitroFSSetDecompression(bool enable)
+{
+    nitrofs_decompression_enabled = enable;
+}
+
+// Returns true if the file has to be decompressed when it's read, and the
+// compression header in that case.
+static bool nitrofs_file_get_compression(const nitrofs_file_t *f, uint32_t *header)
+{
+    if (!nitrofs_decompression_enabled)
+        return false;
+
+    uint32_t size = f->endofs - f->offset;
+    if (size <= 4)
+        return false;
+
+    if (nitrofs_read_cached(header, f->offset, sizeof(uint32_t)) != sizeof(uint32_t))
+        return false;
+
+    return nitrofs_decoder_check_header(*header, size);
+}
+
 ssize_t nitrofs_read(int fd, void *ptr, size_t len)
 {
     nitrofs_file_t *f = (nitrofs_file_t *) FD_DESC(fd);
+
+    if (f->decoder != NULL)
+        return nitrofs_decoder_read(f->decoder, ptr, len);
+
     size_t remaining = f->endofs - f->position;
     if (len > remaining)
         len = remaining;
     if (len == 0)
         return 0;
-    ssize_t result = nitrofs_read_internal(ptr, f->position, len);
+    ssize_t result = nitrofs_read_cached(ptr, f->position, len);
     if (result <= 0)
         return result;
     f->position += result;
     return result;
 }
 
+static off_t nitrofs_lseek_compressed(nitrofs_file_t *f, off_t offset, int whence)
+{
+    nitrofs_decoder_t *d = f->decoder;
+    off_t new_position;
+
+    if (whence == SEEK_END)
+        new_position = nitrofs_decoder_size(d) + offset;
+    else if (whence == SEEK_CUR)
+        new_position = nitrofs_decoder_tell(d) + offset;
+    else if (whence == SEEK_SET)
+        new_position = offset;
+    else
+    {
+        errno = EINVAL;
+        return (off_t)-1;
+    }
+
+    if (new_position < 0)
+        new_position = 0;
+
+    // Seeking forwards decodes and discards the data in between. Seeking
+    // backwards needs to start decoding from the beginning of the file.
+    if (nitrofs_decoder_seek(d, new_position) != 0)
+        return (off_t)-1;
+
+    return nitrofs_decoder_tell(d);
+}
+
 off_t nitrofs_lseek(int fd, off_t offset, int whence)
 {
     nitrofs_file_t *f = (nitrofs_file_t *) FD_DESC(fd);
     size_t new_position;
 
+    if (f->decoder != NULL)
+        return nitrofs_lseek_compressed(f, offset, whence);
+
     if (whence == SEEK_END)
         new_position = f->endofs + offset;
     else if (whence == SEEK_CUR)
@@ -513,6 +985,7 @@ off_t nitrofs_lseek(int fd, off_t offset, int whence)
 int nitrofs_close(int fd)
 {
     nitrofs_file_t *f = (nitrofs_file_t *) FD_DESC(fd);
+    nitrofs_decoder_free(f->decoder);
     free(f);
     return 0;
 }
@@ -524,9 +997,10 @@ static int nitrofs_open_by_id(nitrofs_file_t *f, uint16_t id)
         // not a file
         return -1;
     }
-    nitrofs_read_internal(f, nitrofs_local.fat_offset + (id * 8), 8);
+    nitrofs_read_cached(f, nitrofs_local.fat_offset + (id * 8), 8);
     f->position = f->offset;
     f->file_index = id;
+    f->decoder = NULL;
     return 0;
 }
 
@@ -547,9 +1021,122 @@ int nitroFSOpenById(uint16_t id)
         return -1;
     }
 
+    uint32_t header;
+    if (nitrofs_file_get_compression(f, &header))
+    {
+        f->decoder = nitrofs_decoder_create(header, f->offset, f->endofs);
+        if (f->decoder == NULL)
+        {
+            free(f);
+            return -1;
+        }
+    }
+
     return FD_DESC(f) | (FD_TYPE_NITRO << 28);
 }
 
+// Slot-2 ROM is mapped in this range of the ARM9 address space
+#define NITROFS_SLOT2_START     0x08000000
+#define NITROFS_SLOT2_END       0x0A000000
+
+// Decompresses the whole file to RAM. It uses a new decoder so that the
+// position of the file isn't modified.
+static const void *nitrofs_map_compressed(nitrofs_file_t *f, size_t *size)
+{
+    uint32_t header;
+    if (!nitrofs_file_get_compression(f, &header))
+    {
+        errno = EIO;
+        return NULL;
+    }
+
+    nitrofs_decoder_t *d = nitrofs_decoder_create(header, f->offset, f->endofs);
+    if (d == NULL)
+        return NULL;
+
+    size_t file_size = nitrofs_decoder_size(d);
+
+    void *copy = malloc(file_size);
+    if (copy == NULL)
+    {
+        nitrofs_decoder_free(d);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    ssize_t ret = nitrofs_decoder_read(d, copy, file_size);
+    nitrofs_decoder_free(d);
+
+    if ((ret < 0) || ((size_t)ret != file_size))
+    {
+        free(copy);
+        errno = EIO;
+        return NULL;
+    }
+
+    if (size != NULL)
+        *size = file_size;
+
+    return copy;
+}
+
+const void *nitroFSMapFile(int fd, size_t *size)
+{
+    if (!FD_IS_NITRO(fd))
+    {
+        errno = EBADF;
+        return NULL;
+    }
+
+    nitrofs_file_t *f = (nitrofs_file_t *) FD_DESC(fd);
+    size_t file_size = f->endofs - f->offset;
+
+    if (f->decoder != NULL)
+        return nitrofs_map_compressed(f, size);
+
+    if (size != NULL)
+        *size = file_size;
+
+    // Files in Slot-2 can be used in place
+    if (nitrofs_local.use_slot2)
+    {
+        sysSetCartOwner(BUS_OWNER_ARM9);
+        return (const void *)(NITROFS_SLOT2_START + f->offset);
+    }
+
+    // In any other case the file needs to be loaded to RAM
+    void *copy = malloc(file_size > 0 ? file_size : 1);
+    if (copy == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (file_size > 0)
+    {
+        ssize_t ret = nitrofs_read_cached(copy, f->offset, file_size);
+        if ((ret < 0) || ((size_t)ret != file_size))
+        {
+            free(copy);
+            errno = EIO;
+            return NULL;
+        }
+    }
+
+    return copy;
+}
+
+void nitroFSUnmapFile(const void *ptr)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+
+    // Pointers to Slot-2 don't own any memory
+    if ((addr >= NITROFS_SLOT2_START) && (addr < NITROFS_SLOT2_END))
+        return;
+
+    free((void *)ptr);
+}
+
 FILE *nitroFSFopenById(uint16_t id, const char *mode)
 {
     int fd = nitroFSOpenById(id);
@@ -581,6 +1168,13 @@ static int nitrofs_stat_file_internal(nitrofs_file_t *f, struct stat *st)
     st->st_dev = 128;
     st->st_ino = f->file_index;
     st->st_size = f->endofs - f->offset;
+
+    // Report the size of the data returned by read()
+    uint32_t header;
+    if (f->decoder != NULL)
+        st->st_size = nitrofs_decoder_size(f->decoder);
+    else if (nitrofs_file_get_compression(f, &header))
+        st->st_size = header >> 8;
     st->st_blksize = 0x200;
     st->st_blocks = (st->st_size + 0x200 - 1) / 0x200;
     st->st_mode = S_IFREG;
@@ -613,38 +1207,45 @@ int nitrofs_fat_get_attr(const char *name)
     return ATTR_READONLY;
 }
 
-int nitrofs_stat(const char *name, struct stat *st)
+int nitrofs_stat_by_id(uint16_t id, struct stat *st)
 {
-    if (!nitrofs_local.fnt_offset)
+    if (id >= 0xF000)
     {
-        errno = ENODEV;
-        return -1;
+        st->st_ino = id;
+        st->st_size = 0;
+        st->st_mode = S_IFDIR;
+        st->st_atim.tv_sec = 0; // Time of last access
+        st->st_mtim.tv_sec = 0; // Time of last modification
+        st->st_ctim.tv_sec = 0; // Time of last status change
+        return 0;
     }
 
     nitrofs_file_t f;
-    int32_t res = nitrofs_path_resolve(name);
-    if (res < 0)
+    if (nitrofs_open_by_id(&f, id) < 0)
     {
         errno = ENOENT;
         return -1;
     }
-    else if (res >= 0xF000)
+
+    return nitrofs_stat_file_internal(&f, st);
+}
+
+int nitrofs_stat(const char *name, struct stat *st)
+{
+    if (!nitrofs_local.fnt_offset)
     {
-        st->st_ino = res;
-        st->st_size = 0;
-        st->st_mode = S_IFDIR;
-        st->st_atim.tv_sec = 0; // Time of last access
-        st->st_mtim.tv_sec = 0; // Time of last modification
-        st->st_ctim.tv_sec = 0; // Time of last status change
-        return 0;
+        errno = ENODEV;
+        return -1;
     }
-    res = nitrofs_open_by_id(&f, res);
+
+    int32_t res = nitrofs_path_resolve(name);
     if (res < 0)
     {
         errno = ENOENT;
         return -1;
     }
-    return nitrofs_stat_file_internal(&f, st);
+
+    return nitrofs_stat_by_id(res, st);
 }
 
 int nitrofs_fstat(int fd, struct stat *st)
@@ -668,6 +1269,9 @@ bool nitroFSExit(void)
             return false;
     }
 
+    nitrofs_index_free();
+    nitrofs_cache_invalidate();
+
     nitrofs_local.fnt_offset = 0;
     nitrofs_local.fat_offset = 0;
     return true;
@@ -681,6 +1285,9 @@ bool nitroFSInit(const char *basepath)
     nitrofs_local.file = NULL;
     nitrofs_local.current_dir = 0xF000;
 
+    // The cache may contain blocks of a different backing store
+    nitrofs_cache_invalidate();
+
     // Initialize cache if it hasn't been initialized already
     if (!cache_initialized())
     {
@@ -880,7 +1487,10 @@ bool nitroFSInit(const char *basepath)
     // Initialize FNT offset, if valid. Allow opening files by direct ID
     // even without an FNT.
     if (nitrofs_offsets.filenameOffset >= 0x8000 && nitrofs_offsets.filenameSize > 0)
+    {
         nitrofs_local.fnt_offset = nitrofs_offsets.filenameOffset;
+        nitrofs_local.fnt_size = nitrofs_offsets.filenameSize;
+    }
 
     // Set "nitro:/" as default path
     current_drive_is_nitrofs = true;
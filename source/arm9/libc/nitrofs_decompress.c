@@ -0,0 +1,592 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nitrofs_internal.h"
+
+// Streaming decoders for the compression formats supported by the BIOS. The
+// BIOS functions need the whole compressed file and the whole output buffer,
+// so they can't be used to decompress files as they are read. These decoders
+// only need a small input buffer, and LZ77 also needs a window with the last
+// 4 KiB of output.
+//
+// LZ4 blocks are also supported. They aren't a BIOS format, so they use a
+// header type that the BIOS doesn't use. The header is followed by a raw LZ4
+// block (without the frame format). LZ4 needs a window of 64 KiB.
+
+#define DECODER_TYPE_LZ77       0x10
+#define DECODER_TYPE_HUFF       0x20
+#define DECODER_TYPE_RLE        0x30
+#define DECODER_TYPE_LZ4        0x60
+
+#define LZ77_WINDOW_SIZE        0x1000 // Max LZ77 displacement
+#define LZ4_WINDOW_SIZE         0x10000 // Max LZ4 offset + 1
+#define LZ4_MIN_MATCH           4
+#define HUFF_TREE_MAX_SIZE      512
+#define DECODER_INPUT_SIZE      256
+
+struct nitrofs_decoder {
+    uint8_t type;
+    uint8_t huff_bits; // Size of each Huffman symbol (4 or 8 bits)
+
+    uint32_t size; // Decompressed size
+    uint32_t position; // Position in the decompressed data
+
+    // Compressed data
+    uint32_t data_start; // ROM offset of the compressed data after the header
+    uint32_t data_end;
+    uint32_t in_offset; // ROM offset of the next byte to read to in_buf
+    uint16_t in_pos;
+    uint16_t in_len;
+    uint8_t in_buf[DECODER_INPUT_SIZE];
+
+    union {
+        struct {
+            uint8_t flags;
+            uint8_t flags_left;
+            uint16_t copy_left; // Bytes left to copy from the window
+            uint16_t copy_disp;
+            uint16_t window_pos;
+            uint8_t window[LZ77_WINDOW_SIZE];
+        } lz77;
+        struct {
+            uint8_t token; // Token of the current sequence
+            bool match_pending; // The match of the token hasn't been read
+            uint16_t window_pos;
+            uint16_t copy_disp;
+            uint32_t copy_left; // Bytes left to copy from the window
+            uint32_t literals_left;
+            uint8_t window[LZ4_WINDOW_SIZE];
+        } lz4;
+        struct {
+            uint8_t is_run;
+            uint8_t run_byte;
+            uint8_t run_left;
+        } rle;
+        struct {
+            uint32_t word;
+            uint8_t word_bits;
+            uint8_t nibble; // Pending low nibble in 4-bit mode
+            uint8_t has_nibble;
+            uint16_t tree_size;
+            uint8_t tree[HUFF_TREE_MAX_SIZE];
+        } huff;
+    };
+};
+
+static int nitrofs_decoder_refill(nitrofs_decoder_t *d)
+{
+    uint32_t len = d->data_end - d->in_offset;
+    if (len > DECODER_INPUT_SIZE)
+        len = DECODER_INPUT_SIZE;
+
+    if (len == 0)
+        return -1;
+
+    if (nitrofs_read_cached(d->in_buf, d->in_offset, len) != (ssize_t)len)
+        return -1;
+
+    d->in_offset += len;
+    d->in_pos = 0;
+    d->in_len = len;
+
+    return 0;
+}
+
+static int nitrofs_decoder_get_byte(nitrofs_decoder_t *d)
+{
+    if (d->in_pos == d->in_len)
+    {
+        if (nitrofs_decoder_refill(d) != 0)
+            return -1;
+    }
+
+    return d->in_buf[d->in_pos++];
+}
+
+bool nitrofs_decoder_check_header(uint32_t header, uint32_t compressed_size)
+{
+    // Files need at least a header and one byte of data
+    if (compressed_size <= 4)
+        return false;
+
+    // A size of 0 means that the real size is stored in an extended header,
+    // which the BIOS doesn't support.
+    if ((header >> 8) == 0)
+        return false;
+
+    switch (header & 0xFF)
+    {
+        case DECODER_TYPE_LZ77:
+        case DECODER_TYPE_LZ4:
+        case DECODER_TYPE_RLE:
+        case DECODER_TYPE_HUFF | 4:
+        case DECODER_TYPE_HUFF | 8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int nitrofs_decoder_reset(nitrofs_decoder_t *d)
+{
+    d->position = 0;
+    d->in_offset = d->data_start;
+    d->in_pos = 0;
+    d->in_len = 0;
+
+    if (d->type == DECODER_TYPE_LZ77)
+    {
+        d->lz77.flags_left = 0;
+        d->lz77.copy_left = 0;
+        d->lz77.window_pos = 0;
+    }
+    else if (d->type == DECODER_TYPE_LZ4)
+    {
+        d->lz4.match_pending = false;
+        d->lz4.window_pos = 0;
+        d->lz4.copy_left = 0;
+        d->lz4.literals_left = 0;
+    }
+    else if (d->type == DECODER_TYPE_RLE)
+    {
+        d->rle.run_left = 0;
+    }
+    else if (d->type == DECODER_TYPE_HUFF)
+    {
+        d->huff.word_bits = 0;
+        d->huff.has_nibble = 0;
+
+        // The first byte of the tree table is its size in halfwords minus one.
+        // The bitstream starts right after the table.
+        int value = nitrofs_decoder_get_byte(d);
+        if (value < 0)
+            return -1;
+
+        d->huff.tree_size = (value + 1) * 2;
+        d->huff.tree[0] = value;
+
+        for (uint32_t i = 1; i < d->huff.tree_size; i++)
+        {
+            value = nitrofs_decoder_get_byte(d);
+            if (value < 0)
+                return -1;
+
+            d->huff.tree[i] = value;
+        }
+    }
+
+    return 0;
+}
+
+nitrofs_decoder_t *nitrofs_decoder_create(uint32_t header, uint32_t offset,
+                                          uint32_t endofs)
+{
+    nitrofs_decoder_t *d;
+
+    // Only allocate the window of the format of the file. The Huffman state is
+    // the biggest one of the formats without a window.
+    uint8_t type = header & 0xF0;
+    if (type == DECODER_TYPE_LZ4)
+        d = malloc(sizeof(nitrofs_decoder_t));
+    else if (type == DECODER_TYPE_LZ77)
+        d = malloc(offsetof(nitrofs_decoder_t, lz77.window) + LZ77_WINDOW_SIZE);
+    else
+        d = malloc(offsetof(nitrofs_decoder_t, huff.tree) + HUFF_TREE_MAX_SIZE);
+
+    if (d == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    d->type = type;
+    d->huff_bits = header & 0xF;
+    d->size = header >> 8;
+    d->data_start = offset + 4;
+    d->data_end = endofs;
+
+    if (nitrofs_decoder_reset(d) != 0)
+    {
+        free(d);
+        errno = EIO;
+        return NULL;
+    }
+
+    return d;
+}
+
+void nitrofs_decoder_free(nitrofs_decoder_t *d)
+{
+    free(d);
+}
+
+uint32_t nitrofs_decoder_size(const nitrofs_decoder_t *d)
+{
+    return d->size;
+}
+
+uint32_t nitrofs_decoder_tell(const nitrofs_decoder_t *d)
+{
+    return d->position;
+}
+
+// All decoders write to ptr if it isn't NULL, or they discard the output if it
+// is NULL. They return the number of bytes decoded, or -1 on error.
+
+static ssize_t nitrofs_decoder_lz77(nitrofs_decoder_t *d, uint8_t *ptr, size_t len)
+{
+    size_t done = 0;
+    uint8_t *window = d->lz77.window;
+
+    while (done < len)
+    {
+        if (d->lz77.copy_left > 0)
+        {
+            // Copy from the window. The source and destination ranges may
+            // overlap, so it needs to go byte by byte.
+            uint8_t value = window[(d->lz77.window_pos - d->lz77.copy_disp)
+                                   & (LZ77_WINDOW_SIZE - 1)];
+            window[d->lz77.window_pos] = value;
+            d->lz77.window_pos = (d->lz77.window_pos + 1) & (LZ77_WINDOW_SIZE - 1);
+            d->lz77.copy_left--;
+
+            if (ptr != NULL)
+                ptr[done] = value;
+            done++;
+            continue;
+        }
+
+        if (d->lz77.flags_left == 0)
+        {
+            int flags = nitrofs_decoder_get_byte(d);
+            if (flags < 0)
+                return -1;
+
+            d->lz77.flags = flags;
+            d->lz77.flags_left = 8;
+        }
+
+        bool compressed = d->lz77.flags & 0x80;
+        d->lz77.flags <<= 1;
+        d->lz77.flags_left--;
+
+        if (compressed)
+        {
+            int b0 = nitrofs_decoder_get_byte(d);
+            int b1 = nitrofs_decoder_get_byte(d);
+            if ((b0 < 0) || (b1 < 0))
+                return -1;
+
+            d->lz77.copy_left = (b0 >> 4) + 3;
+            d->lz77.copy_disp = (((b0 & 0xF) << 8) | b1) + 1;
+        }
+        else
+        {
+            int value = nitrofs_decoder_get_byte(d);
+            if (value < 0)
+                return -1;
+
+            window[d->lz77.window_pos] = value;
+            d->lz77.window_pos = (d->lz77.window_pos + 1) & (LZ77_WINDOW_SIZE - 1);
+
+            if (ptr != NULL)
+                ptr[done] = value;
+            done++;
+        }
+    }
+
+    return done;
+}
+
+// Adds the extra bytes of a length of a LZ4 sequence. A length of 15 in the
+// token is followed by bytes that are added to it until one isn't 255.
+static int nitrofs_decoder_lz4_length(nitrofs_decoder_t *d, uint32_t *length)
+{
+    if (*length != 15)
+        return 0;
+
+    while (1)
+    {
+        int value = nitrofs_decoder_get_byte(d);
+        if (value < 0)
+            return -1;
+
+        *length += value;
+
+        if (value != 255)
+            return 0;
+    }
+}
+
+static ssize_t nitrofs_decoder_lz4(nitrofs_decoder_t *d, uint8_t *ptr, size_t len)
+{
+    size_t done = 0;
+    uint8_t *window = d->lz4.window;
+
+    while (done < len)
+    {
+        if (d->lz4.copy_left > 0)
+        {
+            // Copy from the window. The source and destination ranges may
+            // overlap, so it needs to go byte by byte. The window position
+            // wraps around at 64 KiB on its own.
+            uint8_t value = window[(uint16_t)(d->lz4.window_pos - d->lz4.copy_disp)];
+            window[d->lz4.window_pos++] = value;
+            d->lz4.copy_left--;
+
+            if (ptr != NULL)
+                ptr[done] = value;
+            done++;
+            continue;
+        }
+
+        if (d->lz4.literals_left > 0)
+        {
+            int value = nitrofs_decoder_get_byte(d);
+            if (value < 0)
+                return -1;
+
+            window[d->lz4.window_pos++] = value;
+            d->lz4.literals_left--;
+
+            if (ptr != NULL)
+                ptr[done] = value;
+            done++;
+            continue;
+        }
+
+        // The last sequence of a block only has literals. It ends at the
+        // decompressed size, so this is never reached after it.
+        if (d->lz4.match_pending)
+        {
+            int b0 = nitrofs_decoder_get_byte(d);
+            int b1 = nitrofs_decoder_get_byte(d);
+            if ((b0 < 0) || (b1 < 0))
+                return -1;
+
+            uint32_t disp = b0 | (b1 << 8);
+            if (disp == 0)
+                return -1;
+
+            uint32_t length = d->lz4.token & 0xF;
+            if (nitrofs_decoder_lz4_length(d, &length) != 0)
+                return -1;
+
+            d->lz4.copy_disp = disp;
+            d->lz4.copy_left = length + LZ4_MIN_MATCH;
+            d->lz4.match_pending = false;
+            continue;
+        }
+
+        int token = nitrofs_decoder_get_byte(d);
+        if (token < 0)
+            return -1;
+
+        uint32_t literals = token >> 4;
+        if (nitrofs_decoder_lz4_length(d, &literals) != 0)
+            return -1;
+
+        d->lz4.token = token;
+        d->lz4.literals_left = literals;
+        d->lz4.match_pending = true;
+    }
+
+    return done;
+}
+
+static ssize_t nitrofs_decoder_rle(nitrofs_decoder_t *d, uint8_t *ptr, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        if (d->rle.run_left == 0)
+        {
+            int flags = nitrofs_decoder_get_byte(d);
+            if (flags < 0)
+                return -1;
+
+            if (flags & 0x80)
+            {
+                int value = nitrofs_decoder_get_byte(d);
+                if (value < 0)
+                    return -1;
+
+                d->rle.is_run = 1;
+                d->rle.run_byte = value;
+                d->rle.run_left = (flags & 0x7F) + 3;
+            }
+            else
+            {
+                d->rle.is_run = 0;
+                d->rle.run_left = (flags & 0x7F) + 1;
+            }
+        }
+
+        size_t count = d->rle.run_left;
+        if (count > len - done)
+            count = len - done;
+
+        if (d->rle.is_run)
+        {
+            if (ptr != NULL)
+                memset(ptr + done, d->rle.run_byte, count);
+        }
+        else
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                int value = nitrofs_decoder_get_byte(d);
+                if (value < 0)
+                    return -1;
+
+                if (ptr != NULL)
+                    ptr[done + i] = value;
+            }
+        }
+
+        d->rle.run_left -= count;
+        done += count;
+    }
+
+    return done;
+}
+
+// Returns the next Huffman symbol, or -1 on error
+static int nitrofs_decoder_huff_symbol(nitrofs_decoder_t *d)
+{
+    const uint8_t *tree = d->huff.tree;
+
+    // The root node is right after the size byte
+    uint32_t node = 1;
+
+    while (1)
+    {
+        if (d->huff.word_bits == 0)
+        {
+            // The bitstream is made of little endian words, read from the most
+            // significant bit.
+            uint32_t word = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                int value = nitrofs_decoder_get_byte(d);
+                if (value < 0)
+                    return -1;
+
+                word |= (uint32_t)value << (i * 8);
+            }
+
+            d->huff.word = word;
+            d->huff.word_bits = 32;
+        }
+
+        uint32_t bit = d->huff.word >> 31;
+        d->huff.word <<= 1;
+        d->huff.word_bits--;
+
+        uint8_t value = tree[node];
+        uint32_t child = (node & ~1) + ((value & 0x3F) * 2) + 2 + bit;
+
+        if (child >= d->huff.tree_size)
+            return -1;
+
+        // Bit 7 means that child 0 is a leaf, bit 6 that child 1 is a leaf
+        if (value & (0x80 >> bit))
+            return tree[child];
+
+        node = child;
+    }
+}
+
+static ssize_t nitrofs_decoder_huff(nitrofs_decoder_t *d, uint8_t *ptr, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        int value = nitrofs_decoder_huff_symbol(d);
+        if (value < 0)
+            return -1;
+
+        if (d->huff_bits == 4)
+        {
+            // The first symbol goes to the low nibble of the byte
+            if (!d->huff.has_nibble)
+            {
+                d->huff.nibble = value & 0xF;
+                d->huff.has_nibble = 1;
+                continue;
+            }
+
+            value = d->huff.nibble | ((value & 0xF) << 4);
+            d->huff.has_nibble = 0;
+        }
+
+        if (ptr != NULL)
+            ptr[done] = value;
+        done++;
+    }
+
+    return done;
+}
+
+ssize_t nitrofs_decoder_read(nitrofs_decoder_t *d, void *ptr, size_t len)
+{
+    size_t remaining = d->size - d->position;
+    if (len > remaining)
+        len = remaining;
+    if (len == 0)
+        return 0;
+
+    ssize_t ret;
+
+    if (d->type == DECODER_TYPE_LZ77)
+        ret = nitrofs_decoder_lz77(d, ptr, len);
+    else if (d->type == DECODER_TYPE_LZ4)
+        ret = nitrofs_decoder_lz4(d, ptr, len);
+    else if (d->type == DECODER_TYPE_RLE)
+        ret = nitrofs_decoder_rle(d, ptr, len);
+    else
+        ret = nitrofs_decoder_huff(d, ptr, len);
+
+    if (ret < 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    d->position += ret;
+    return ret;
+}
+
+int nitrofs_decoder_seek(nitrofs_decoder_t *d, uint32_t position)
+{
+    if (position > d->size)
+        position = d->size;
+
+    // Going backwards requires decoding the file from the start
+    if (position < d->position)
+    {
+        if (nitrofs_decoder_reset(d) != 0)
+        {
+            errno = EIO;
+            return -1;
+        }
+    }
+
+    if (position > d->position)
+    {
+        if (nitrofs_decoder_read(d, NULL, position - d->position) < 0)
+            return -1;
+    }
+
+    return 0;
+}
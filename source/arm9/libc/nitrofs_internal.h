@@ -5,15 +5,29 @@
 #ifndef NITROFS_INTERNAL_H__
 #define NITROFS_INTERNAL_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <sys/types.h>
+
+// Entry of the hash table of paths. An entry is empty if name_offset is 0.
+typedef struct {
+    uint32_t name_offset; // Offset of the name in the copy of the FNT
+    uint16_t dir; // Directory that contains the entry
+    uint16_t id; // File or directory ID
+} nitrofs_index_entry_t;
 
 typedef struct {
     FILE *file; // if NULL, use direct cartridge I/O
     uint32_t fnt_offset;
+    uint32_t fnt_size;
     uint32_t fat_offset;
     uint16_t current_dir;
     bool use_slot2;
+    // Optional copy of the FNT in RAM and hash table of paths
+    uint8_t *fnt_copy;
+    nitrofs_index_entry_t *index;
+    uint32_t index_mask;
 } nitrofs_t;
 
 typedef struct {
@@ -29,6 +43,8 @@ typedef struct {
     uint32_t endofs;
     uint32_t position;
     uint16_t file_index;
+    // Decoder of compressed files, NULL if the file is read as it is
+    struct nitrofs_decoder *decoder;
 } nitrofs_file_t;
 
 typedef struct
@@ -67,7 +83,23 @@ ssize_t nitrofs_read(int fd, void *ptr, size_t len);
 off_t nitrofs_lseek(int fd, off_t offset, int whence);
 int nitrofs_close(int fd);
 int nitrofs_stat(const char *name, struct stat *st);
+int nitrofs_stat_by_id(uint16_t id, struct stat *st);
 int nitrofs_fstat(int fd, struct stat *st);
 int nitrofs_fat_get_attr(const char *name);
 
+ssize_t nitrofs_read_cached(void *ptr, size_t offset, size_t len);
+
+// Streaming decompression of files (nitrofs_decompress.c)
+typedef struct nitrofs_decoder nitrofs_decoder_t;
+
+bool nitrofs_decoder_check_header(uint32_t header, uint32_t compressed_size);
+nitrofs_decoder_t *nitrofs_decoder_create(uint32_t header, uint32_t offset,
+                                          uint32_t endofs);
+void nitrofs_decoder_free(nitrofs_decoder_t *d);
+int nitrofs_decoder_reset(nitrofs_decoder_t *d);
+uint32_t nitrofs_decoder_size(const nitrofs_decoder_t *d);
+uint32_t nitrofs_decoder_tell(const nitrofs_decoder_t *d);
+ssize_t nitrofs_decoder_read(nitrofs_decoder_t *d, void *ptr, size_t len);
+int nitrofs_decoder_seek(nitrofs_decoder_t *d, uint32_t position);
+
 #endif // NITROFS_INTERNAL_H__
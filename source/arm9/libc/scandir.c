@@ -28,6 +28,8 @@ int scandir(const char *path, struct dirent ***names,
 {
     bool error = false;
     int count = 0;
+    int capacity = 0;
+    struct dirent **list = NULL;
     struct dirent *ent;
     int errno_prev;
 
@@ -41,7 +43,6 @@ int scandir(const char *path, struct dirent ***names,
     // ensure errno is reset so readdir loop doesn't break early
     errno = 0;
 
-    *names = NULL;
     while ((ent = readdir(dir)) != NULL)
     {
         if (errno)
@@ -52,47 +53,57 @@ int scandir(const char *path, struct dirent ***names,
 
         if (filter_f == NULL || (filter_f(ent) != 0))
         {
-            struct dirent **new_names = realloc(*names, (count + 1) * sizeof(struct dirent *));
-            if (new_names == NULL)
+            // Grow the list geometrically so that big directories don't need
+            // one realloc() per entry.
+            if (count == capacity)
             {
-                error = true;
-                break;
+                int new_capacity = capacity == 0 ? 16 : capacity * 2;
+                struct dirent **new_list = realloc(list, new_capacity * sizeof(struct dirent *));
+                if (new_list == NULL)
+                {
+                    error = true;
+                    break;
+                }
+
+                list = new_list;
+                capacity = new_capacity;
             }
 
             struct dirent *ent_copy = malloc(sizeof(struct dirent));
             if (ent_copy == NULL)
             {
-                free(new_names);
                 error = true;
                 break;
             }
             memcpy(ent_copy, ent, sizeof(struct dirent));
 
-            new_names[count++] = ent_copy;
-            *names = new_names;
+            list[count++] = ent_copy;
         }
     }
 
-    if (*names != NULL && error)
+    closedir(dir);
+
+    if (error)
     {
         // deallocate name list
         for (int i = 0; i < count; i++)
-            if (*names[i] != NULL)
-                free(*names[i]);
-        free(*names);
+            free(list[i]);
+        free(list);
         *names = NULL;
+        return -1;
     }
-    else if (count > 0 && compare_f != NULL)
+
+    if (count > 0 && compare_f != NULL)
     {
         // sort name list
-        qsort(*names, count, sizeof(struct dirent *), (__compar_fn_t) compare_f);
+        qsort(list, count, sizeof(struct dirent *), (__compar_fn_t) compare_f);
     }
 
-    closedir(dir);
+    *names = list;
 
     // restore previous errno if no new errnos
     if (errno == 0)
         errno = errno_prev;
 
-    return error ? -1 : count;
+    return count;
 }
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat.h>
+
+#include "ff.h"
+#include "fatfs_internal.h"
+
+// Cache of the results of f_stat(), indexed by path. It is direct-mapped: each
+// path can only be stored in the entry selected by its hash.
+//
+// Instead of tracking which entries are affected by each modification of the
+// filesystem, any modification increments a generation counter. Entries are
+// only valid if their generation matches the current one, so invalidating the
+// whole cache is O(1).
+
+// Paths longer than this aren't cached
+#define STAT_CACHE_MAX_PATH     128
+
+typedef struct {
+    uint32_t generation;
+    uint32_t hash;
+    FRESULT result;
+    FILINFO fno;
+    char path[STAT_CACHE_MAX_PATH];
+} stat_cache_entry_t;
+
+static stat_cache_entry_t *stat_cache = NULL;
+static uint32_t stat_cache_size = 0;
+
+// Generation 0 is never used, so that entries filled with zeroes are invalid.
+static uint32_t stat_cache_generation = 1;
+
+static fat_stat_cache_stats_t stat_cache_stats;
+
+void fatfs_stat_cache_invalidate(void)
+{
+    stat_cache_generation++;
+    if (stat_cache_generation == 0)
+    {
+        // The counter has wrapped around. Make sure that old entries can't
+        // become valid again.
+        if (stat_cache != NULL)
+            memset(stat_cache, 0, stat_cache_size * sizeof(stat_cache_entry_t));
+
+        stat_cache_generation = 1;
+    }
+}
+
+// Copies the path removing repeated slashes, "./" components and trailing
+// slashes, so that different ways of writing the same path share the entry.
+// It returns false if the path is too long to be cached.
+static bool stat_cache_normalize(const char *path, char *out)
+{
+    size_t len = 0;
+
+    while (*path != '\0')
+    {
+        bool at_component_start = (len == 0) || (out[len - 1] == '/');
+
+        if (at_component_start)
+        {
+            if ((len > 0) && (*path == '/'))
+            {
+                path++;
+                continue;
+            }
+
+            if ((path[0] == '.') && ((path[1] == '/') || (path[1] == '\0')))
+            {
+                path++;
+                continue;
+            }
+        }
+
+        if (len == STAT_CACHE_MAX_PATH - 1)
+            return false;
+
+        out[len++] = *path++;
+    }
+
+    while ((len > 1) && (out[len - 1] == '/') && (out[len - 2] != ':'))
+        len--;
+
+    out[len] = '\0';
+
+    return true;
+}
+
+static uint32_t stat_cache_hash(const char *path)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    while (*path != '\0')
+    {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+FRESULT fatfs_stat_cached(const char *path, FILINFO *fno)
+{
+    if (stat_cache == NULL)
+        return f_stat(path, fno);
+
+    char key[STAT_CACHE_MAX_PATH];
+    if (!stat_cache_normalize(path, key))
+    {
+        stat_cache_stats.misses++;
+        return f_stat(path, fno);
+    }
+
+    uint32_t hash = stat_cache_hash(key);
+    stat_cache_entry_t *entry = &stat_cache[hash % stat_cache_size];
+
+    if ((entry->generation == stat_cache_generation) && (entry->hash == hash)
+        && (strcmp(entry->path, key) == 0))
+    {
+        stat_cache_stats.hits++;
+        *fno = entry->fno;
+        return entry->result;
+    }
+
+    stat_cache_stats.misses++;
+
+    // f_stat() may yield to other threads, which may modify the filesystem.
+    // Use the generation from before the call so that the result is discarded
+    // in that case.
+    uint32_t generation = stat_cache_generation;
+
+    FRESULT result = f_stat(path, fno);
+
+    // Cache missing files too, it's common to check if a file exists before
+    // trying to open it. Don't cache other errors.
+    if ((result != FR_OK) && (result != FR_NO_FILE) && (result != FR_NO_PATH))
+        return result;
+
+    entry->generation = generation;
+    entry->hash = hash;
+    entry->result = result;
+    entry->fno = *fno;
+    strcpy(entry->path, key);
+
+    return result;
+}
+
+int fatInitStatCache(uint32_t num_entries)
+{
+    free(stat_cache);
+    stat_cache = NULL;
+    stat_cache_size = 0;
+
+    if (num_entries == 0)
+        return 0;
+
+    stat_cache = calloc(num_entries, sizeof(stat_cache_entry_t));
+    if (stat_cache == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    stat_cache_size = num_entries;
+
+    return 0;
+}
+
+void fatGetStatCacheStats(fat_stat_cache_stats_t *stats)
+{
+    if (stats == NULL)
+        return;
+
+    *stats = stat_cache_stats;
+}
+
+void fatResetStatCacheStats(void)
+{
+    memset(&stat_cache_stats, 0, sizeof(stat_cache_stats));
+}
@@ -32,6 +32,8 @@ int utimes(const char *filename, const struct timeval times[2])
     fno.ftime = modstamp;
     fno.fdate = modstamp >> 16;
 
+    fatfs_stat_cache_invalidate();
+
     FRESULT result = f_utime(filename, &fno);
 
     if (result == FR_OK)
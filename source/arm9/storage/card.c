@@ -2,11 +2,22 @@
 //
 // Copyright (C) 2023-2024 Antonio Niño Díaz
 
+#include <malloc.h>
+#include <string.h>
+
 #include <nds/arm9/cache.h>
+#include <nds/arm9/card.h>
 #include <nds/arm9/sassert.h>
+#include <nds/card.h>
+#include <nds/cothread.h>
+#include <nds/dma.h>
 #include <nds/fifocommon.h>
 #include <nds/fifomessages.h>
+#include <nds/interrupts.h>
 #include <nds/memory.h>
+#include <nds/system.h>
+
+#include "common/libnds_internal.h"
 
 // Function to ask the ARM7 to read from the slot-1 using card commands
 bool cardReadArm7(void *dest, size_t offset, size_t size, uint32_t flags)
@@ -33,3 +44,221 @@ bool cardReadArm7(void *dest, size_t offset, size_t size, uint32_t flags)
 
     return result != 0;
 }
+
+// Size of the blocks read by each card command (CARD_BLK_SIZE(1)). Blocks
+// aligned to this size never cross a 0x1000 byte page of the card.
+#define CARD_ASYNC_BLOCK_SIZE 0x200
+
+// Size of the buffer used by cardReadDma() when the destination can't be
+// written by DMA. It's allocated the first time it's needed.
+#define CARD_DMA_BOUNCE_SIZE (8 * 1024)
+
+static u8 *card_dma_bounce;
+
+// Queue of asynchronous reads. The first request is the one being read.
+static card_read_async_t *card_async_head;
+static card_read_async_t *card_async_tail;
+
+// The IRQ_CARD handler is only used while there are requests in the queue. The
+// previous handler is restored when the queue becomes empty.
+static VoidFn card_async_prev_handler;
+static bool card_async_irq_was_enabled;
+
+static void card_async_start_block(card_read_async_t *req)
+{
+    u8 command[8];
+
+    command[7] = CARD_CMD_DATA_READ;
+    command[6] = (u8)(req->offset >> 24);
+    command[5] = (u8)(req->offset >> 16);
+    command[4] = (u8)(req->offset >> 8);
+    command[3] = (u8)(req->offset >> 0);
+    command[2] = 0;
+    command[1] = 0;
+    command[0] = 0;
+
+    cardStartTransfer(command, (u32 *)req->dest, req->channel,
+                      req->flags | CARD_ACTIVATE | CARD_nRESET | CARD_BLK_SIZE(1));
+}
+
+static void card_async_irq_handler(void)
+{
+    card_read_async_t *req = card_async_head;
+
+    // The interrupt may come from a transfer that isn't ours
+    if ((req == NULL) || (REG_ROMCTRL & CARD_BUSY))
+        return;
+
+    // The DMA is in repeat mode, it needs to be stopped so that the next block
+    // can use a new destination address.
+    dmaStopSafe(req->channel);
+
+    req->dest += CARD_ASYNC_BLOCK_SIZE;
+    req->offset += CARD_ASYNC_BLOCK_SIZE;
+    req->remaining -= CARD_ASYNC_BLOCK_SIZE;
+
+    if (req->remaining > 0)
+    {
+        card_async_start_block(req);
+        return;
+    }
+
+    req->done = true;
+
+    card_async_head = req->next;
+    if (card_async_head == NULL)
+    {
+        card_async_tail = NULL;
+
+        irqSet(IRQ_CARD, card_async_prev_handler);
+        if (!card_async_irq_was_enabled)
+            irqDisable(IRQ_CARD);
+    }
+    else
+    {
+        card_async_start_block(card_async_head);
+    }
+}
+
+bool cardReadAsyncSubmit(card_read_async_t *req, void *dest, size_t offset,
+                         size_t size, uint32_t flags, int channel)
+{
+    if ((req == NULL) || (dest == NULL) || (size == 0))
+        return false;
+
+    if ((channel < 0) || (channel > 3))
+        return false;
+
+    if (((offset | size) & (CARD_ASYNC_BLOCK_SIZE - 1)) != 0)
+        return false;
+
+    // The CPU can't touch the cache lines of the buffer while the DMA writes
+    // to it, so it can't share them with anything else.
+    if (((uintptr_t)dest & (CACHE_LINE_SIZE - 1)) != 0)
+        return false;
+
+    if (!memBufferIsInMainRam(dest, size))
+        return false;
+
+    DC_FlushRange(dest, size);
+
+    req->next = NULL;
+    req->dest = dest;
+    req->offset = offset;
+    req->remaining = size;
+    req->flags = flags;
+    req->channel = channel;
+    req->done = false;
+
+    int oldIME = enterCriticalSection();
+
+    if (card_async_tail == NULL)
+    {
+        card_async_irq_was_enabled = (REG_IE & IRQ_CARD) != 0;
+        card_async_prev_handler = irqSetGetPrevious(IRQ_CARD, card_async_irq_handler);
+        irqEnable(IRQ_CARD);
+
+        card_async_head = req;
+        card_async_start_block(req);
+    }
+    else
+    {
+        card_async_tail->next = req;
+    }
+    card_async_tail = req;
+
+    leaveCriticalSection(oldIME);
+
+    return true;
+}
+
+void cardReadAsyncWait(card_read_async_t *req)
+{
+    int oldIME = enterCriticalSection();
+
+    // cothread_yield_irq() enables interrupts right before switching threads,
+    // so the interrupt can't happen between the check and the call.
+    while (!req->done)
+    {
+        cothread_yield_irq(IRQ_CARD);
+        REG_IME = 0;
+    }
+
+    leaveCriticalSection(oldIME);
+}
+
+void cardReadDma(void *dest, size_t offset, size_t size, uint32_t flags,
+                 int channel)
+{
+    u8 *pc = dest;
+
+    // cardRead() can't be used while other requests are in progress
+    while (card_async_tail != NULL)
+        cardReadAsyncWait(card_async_tail);
+
+    // Bytes before the first block boundary of the ROM. They are read with
+    // cardRead(), as well as any bytes after the last full block.
+    size_t head = (CARD_ASYNC_BLOCK_SIZE - (offset & (CARD_ASYNC_BLOCK_SIZE - 1)))
+                & (CARD_ASYNC_BLOCK_SIZE - 1);
+    if (head > size)
+        head = size;
+
+    size_t body = (size - head) & ~(CARD_ASYNC_BLOCK_SIZE - 1);
+
+    if ((body > 0) && (channel >= 0) && (channel <= 3))
+    {
+        u8 *body_dest = pc + head;
+        size_t body_offset = offset + head;
+        bool done = false;
+
+        if ((((uintptr_t)body_dest & (CACHE_LINE_SIZE - 1)) == 0) &&
+            memBufferIsInMainRam(body_dest, body))
+        {
+            card_read_async_t req;
+            cardReadAsyncSubmit(&req, body_dest, body_offset, body, flags, channel);
+            cardReadAsyncWait(&req);
+            done = true;
+        }
+        else
+        {
+            // The DMA can't write to the destination directly, use an aligned
+            // buffer in main RAM and copy the data from it.
+            if (card_dma_bounce == NULL)
+                card_dma_bounce = memalign(CACHE_LINE_SIZE, CARD_DMA_BOUNCE_SIZE);
+
+            if (card_dma_bounce != NULL)
+            {
+                for (size_t i = 0; i < body; i += CARD_DMA_BOUNCE_SIZE)
+                {
+                    size_t chunk = body - i;
+                    if (chunk > CARD_DMA_BOUNCE_SIZE)
+                        chunk = CARD_DMA_BOUNCE_SIZE;
+
+                    card_read_async_t req;
+                    cardReadAsyncSubmit(&req, card_dma_bounce, body_offset + i,
+                                        chunk, flags, channel);
+                    cardReadAsyncWait(&req);
+
+                    memcpy(body_dest + i, card_dma_bounce, chunk);
+                }
+
+                done = true;
+            }
+        }
+
+        if (done)
+        {
+            // The start can't be read while the DMA is active, so it's read
+            // after the rest of the aligned blocks.
+            if (head > 0)
+                cardRead(pc, offset, head, flags);
+
+            pc += head + body;
+            offset += head + body;
+            size -= head + body;
+        }
+    }
+
+    if (size > 0)
+        cardRead(pc, offset, size, flags);
+}
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <aeabi.h>
+#include <nds/disc_io.h>
+
+static uint8_t *ramdisk_buffer;
+static sec_t ramdisk_sectors;
+
+// The Slot-2 bus doesn't support 8-bit writes, so RAM expansion paks need to
+// be written with 16-bit accesses.
+static bool ramdisk_in_slot2;
+
+static bool ramdisk_Startup(void)
+{
+    return ramdisk_buffer != NULL;
+}
+
+static bool ramdisk_IsInserted(void)
+{
+    return ramdisk_buffer != NULL;
+}
+
+static bool ramdisk_ReadSectors(sec_t sector, sec_t numSectors, void *buffer)
+{
+    if ((sector >= ramdisk_sectors) || (numSectors > ramdisk_sectors - sector))
+        return false;
+
+    __aeabi_memcpy(buffer, ramdisk_buffer + sector * 512, numSectors * 512);
+
+    return true;
+}
+
+static bool ramdisk_WriteSectors(sec_t sector, sec_t numSectors, const void *buffer)
+{
+    if ((sector >= ramdisk_sectors) || (numSectors > ramdisk_sectors - sector))
+        return false;
+
+    uint8_t *dst = ramdisk_buffer + sector * 512;
+    size_t size = numSectors * 512;
+
+    if (!ramdisk_in_slot2)
+    {
+        __aeabi_memcpy(dst, buffer, size);
+        return true;
+    }
+
+    const uint8_t *src = buffer;
+    volatile uint16_t *dst16 = (volatile uint16_t *)dst;
+
+    for (size_t i = 0; i < size; i += 2)
+        *dst16++ = src[i] | (src[i + 1] << 8);
+
+    return true;
+}
+
+static bool ramdisk_ClearStatus(void)
+{
+    return true;
+}
+
+static bool ramdisk_Shutdown(void)
+{
+    return true;
+}
+
+static const DISC_INTERFACE __io_ramdisk =
+{
+    DEVICE_TYPE_RAM_DISK,
+    FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE,
+    &ramdisk_Startup,
+    &ramdisk_IsInserted,
+    &ramdisk_ReadSectors,
+    &ramdisk_WriteSectors,
+    &ramdisk_ClearStatus,
+    &ramdisk_Shutdown
+};
+
+bool ramdiskSetup(void *buffer, sec_t numSectors)
+{
+    // Sectors are copied with word accesses when possible
+    if ((((uintptr_t)buffer) & 3) != 0)
+        return false;
+
+    ramdisk_buffer = buffer;
+    ramdisk_sectors = buffer == NULL ? 0 : numSectors;
+
+    uintptr_t addr = (uintptr_t)buffer;
+    ramdisk_in_slot2 = (addr >= 0x08000000) && (addr < 0x0A000000);
+
+    return true;
+}
+
+sec_t ramdiskGetSectors(void)
+{
+    return ramdisk_sectors;
+}
+
+const DISC_INTERFACE *get_io_ramdisk(void)
+{
+    return ramdisk_buffer != NULL ? &__io_ramdisk : NULL;
+}
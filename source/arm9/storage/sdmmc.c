@@ -5,18 +5,53 @@
 
 #include <stdbool.h>
 #include <nds/arm9/cache.h>
+#include <nds/arm9/cp15_asm.h>
 #include <nds/arm9/sdmmc.h>
+#include <nds/cothread.h>
 #include <nds/disc_io.h>
 #include <nds/fifocommon.h>
 #include <nds/fifomessages.h>
 #include <nds/memory.h>
 #include <nds/system.h>
 
+// Stream with a read request in progress. While there is one, the stream owns
+// the FIFO_STORAGE mutex, and any other request needs to wait for it to finish.
+TWL_BSS static sdmmc_read_stream_t *sdmmc_stream_pending;
+
+TWL_CODE static void sdmmc_stream_wait(sdmmc_read_stream_t *stream)
+{
+    // Another thread may be waiting for the reply already
+    while (stream->pending && stream->waiting)
+        cothread_yield();
+
+    if (!stream->pending)
+        return;
+
+    stream->waiting = true;
+
+    fifoWaitValue32Async(FIFO_STORAGE);
+    stream->result = fifoGetValue32(FIFO_STORAGE);
+
+    stream->waiting = false;
+    stream->pending = false;
+    sdmmc_stream_pending = NULL;
+
+    fifoMutexRelease(FIFO_STORAGE);
+}
+
+TWL_CODE static void sdmmc_fifo_acquire(void)
+{
+    if (sdmmc_stream_pending != NULL)
+        sdmmc_stream_wait(sdmmc_stream_pending);
+
+    fifoMutexAcquire(FIFO_STORAGE);
+}
+
 TWL_CODE static u32 sdmmc_fifo_value(uint32_t cmd)
 {
     u32 result;
 
-    fifoMutexAcquire(FIFO_STORAGE);
+    sdmmc_fifo_acquire();
 
     fifoSendValue32(FIFO_STORAGE, cmd);
     fifoWaitValue32Async(FIFO_STORAGE);
@@ -27,7 +62,9 @@ TWL_CODE static u32 sdmmc_fifo_value(uint32_t cmd)
     return result;
 }
 
-TWL_CODE static u32 sdmmc_fifo_sectors(uint32_t cmd, sec_t sector, sec_t numSectors, void *buffer)
+// Sends a request to the ARM7. The caller must own the FIFO_STORAGE mutex.
+TWL_CODE static void sdmmc_fifo_sectors_send(uint32_t cmd, sec_t sector,
+                                             sec_t numSectors, void *buffer)
 {
     FifoMessage msg;
 
@@ -38,9 +75,14 @@ TWL_CODE static u32 sdmmc_fifo_sectors(uint32_t cmd, sec_t sector, sec_t numSect
     msg.sdParams.numsectors = numSectors;
     msg.sdParams.buffer = buffer;
 
-    fifoMutexAcquire(FIFO_STORAGE);
-
     fifoSendDatamsg(FIFO_STORAGE, sizeof(msg), (u8 *)&msg);
+}
+
+TWL_CODE static u32 sdmmc_fifo_sectors(uint32_t cmd, sec_t sector, sec_t numSectors, void *buffer)
+{
+    sdmmc_fifo_acquire();
+
+    sdmmc_fifo_sectors_send(cmd, sector, numSectors, buffer);
     fifoWaitValue32Async(FIFO_STORAGE);
     int result = fifoGetValue32(FIFO_STORAGE);
 
@@ -49,6 +91,104 @@ TWL_CODE static u32 sdmmc_fifo_sectors(uint32_t cmd, sec_t sector, sec_t numSect
     return result;
 }
 
+// Asks the ARM7 to fill the next chunk of the stream. It doesn't wait for the
+// request to finish.
+TWL_CODE static void sdmmc_stream_request(sdmmc_read_stream_t *stream)
+{
+    if (stream->remaining == 0)
+        return;
+
+    sec_t count = stream->remaining;
+    if (count > stream->chunkSectors)
+        count = stream->chunkSectors;
+
+    u8 *buffer = stream->buffer + stream->pendingIndex * stream->chunkSectors * 512;
+
+    sdmmc_fifo_acquire();
+
+    uint32_t cmd = stream->device == SDMMC_DEVICE_NAND ?
+                   SDMMC_NAND_READ_SECTORS : SDMMC_SD_READ_SECTORS;
+    sdmmc_fifo_sectors_send(cmd, stream->nextSector, count, buffer);
+
+    stream->pending = true;
+    stream->pendingSectors = count;
+    sdmmc_stream_pending = stream;
+
+    stream->nextSector += count;
+    stream->remaining -= count;
+}
+
+TWL_CODE bool sdmmc_ReadStreamStart(sdmmc_read_stream_t *stream, int device,
+                                    sec_t sector, sec_t numSectors,
+                                    void *buffer, sec_t chunkSectors)
+{
+    if ((stream == NULL) || (buffer == NULL) || (chunkSectors == 0))
+        return false;
+
+    if ((device != SDMMC_DEVICE_SD) && (device != SDMMC_DEVICE_NAND))
+        return false;
+
+    // The ARM9 reads one buffer while the ARM7 writes to the other one, so
+    // they can't share cache lines with anything else.
+    if (((uintptr_t)buffer & (CACHE_LINE_SIZE - 1)) != 0)
+        return false;
+
+    if (!memBufferIsInMainRam(buffer, 2 * chunkSectors * 512))
+        return false;
+
+    stream->buffer = buffer;
+    stream->chunkSectors = chunkSectors;
+    stream->nextSector = sector;
+    stream->remaining = numSectors;
+    stream->pendingSectors = 0;
+    stream->pendingIndex = 0;
+    stream->device = device;
+    stream->pending = false;
+    stream->waiting = false;
+    stream->result = 0;
+
+    sdmmc_stream_request(stream);
+
+    return true;
+}
+
+TWL_CODE const void *sdmmc_ReadStreamNext(sdmmc_read_stream_t *stream,
+                                          sec_t *numSectors)
+{
+    *numSectors = 0;
+
+    if (stream->pendingSectors == 0)
+        return NULL;
+
+    sdmmc_stream_wait(stream);
+
+    if (stream->result != 0)
+    {
+        // Stop the stream
+        stream->remaining = 0;
+        stream->pendingSectors = 0;
+        return NULL;
+    }
+
+    u8 *ready = stream->buffer + stream->pendingIndex * stream->chunkSectors * 512;
+    *numSectors = stream->pendingSectors;
+    stream->pendingSectors = 0;
+
+    // Start filling the other buffer while the caller uses this one
+    stream->pendingIndex ^= 1;
+    sdmmc_stream_request(stream);
+
+    return ready;
+}
+
+TWL_CODE void sdmmc_ReadStreamEnd(sdmmc_read_stream_t *stream)
+{
+    sdmmc_stream_wait(stream);
+
+    stream->remaining = 0;
+    stream->pendingSectors = 0;
+}
+
 TWL_CODE bool sdmmc_ClearStatus(void)
 {
     return true;
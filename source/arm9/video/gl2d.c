@@ -9,6 +9,8 @@
 //
 // A very small and simple DS rendering lib using the 3d core to render 2D stuff
 
+#include <stdlib.h>
+
 #include <gl2d.h>
 
 // Our static global variable used for depth values since we cannot disable
@@ -17,6 +19,160 @@
 static v16 g_depth = 0;
 int gCurrentTexture = 0;
 
+// Batch mode
+// ----------
+//
+// When batch mode is enabled, glSprite() only records quads. They are sorted
+// by texture when glEnd2D() is called (or when the buffer is full), and each
+// run of quads that use the same texture is sent as a packed list by DMA. Each
+// quad keeps the depth value that it got when it was recorded, so the depth
+// test gives the same result as drawing them in order.
+
+// Each quad is sent as 4 texture coordinates and 4 vertices: 8 packed commands
+// (2 command headers) with 9 parameters.
+#define GL2D_BATCH_QUAD_HEADERS     2
+#define GL2D_BATCH_QUAD_PARAMS      9
+#define GL2D_BATCH_QUAD_WORDS       (GL2D_BATCH_QUAD_HEADERS + GL2D_BATCH_QUAD_PARAMS)
+
+// Size of the list, and header and parameter of the glBegin() of each run
+#define GL2D_BATCH_LIST_EXTRA_WORDS 3
+
+// The list only holds one run of quads at a time, and it grows if a run is
+// bigger than this, so there is no need to allocate more up front.
+#define GL2D_BATCH_LIST_MAX_QUADS   256
+
+typedef struct {
+    int textureID;
+    s16 x1, y1, x2, y2;
+    s16 u1, v1, u2, v2;
+    v16 depth;
+} gl2d_quad_t;
+
+static struct {
+    gl2d_quad_t *quads;
+    gl2d_quad_t **sorted;
+    size_t capacity;
+    size_t count;
+    bool in_2d;
+    gl_list_t list;
+} g_batch;
+
+static int gl2d_batch_compare(const void *a, const void *b)
+{
+    const gl2d_quad_t *qa = *(const gl2d_quad_t **)a;
+    const gl2d_quad_t *qb = *(const gl2d_quad_t **)b;
+
+    if (qa->textureID != qb->textureID)
+        return qa->textureID < qb->textureID ? -1 : 1;
+
+    // Keep the original order inside each texture run
+    return qa < qb ? -1 : (qa > qb ? 1 : 0);
+}
+
+static void gl2d_batch_flush(void)
+{
+    if (g_batch.count == 0)
+        return;
+
+    for (size_t i = 0; i < g_batch.count; i++)
+        g_batch.sorted[i] = &g_batch.quads[i];
+
+    qsort(g_batch.sorted, g_batch.count, sizeof(gl2d_quad_t *), gl2d_batch_compare);
+
+    size_t start = 0;
+
+    while (start < g_batch.count)
+    {
+        int textureID = g_batch.sorted[start]->textureID;
+
+        glListReset(&g_batch.list);
+        glListBegin(&g_batch.list, GL_QUADS);
+
+        size_t end = start;
+        while ((end < g_batch.count) && (g_batch.sorted[end]->textureID == textureID))
+        {
+            const gl2d_quad_t *q = g_batch.sorted[end];
+
+            glListCommand1(&g_batch.list, FIFO_TEX_COORD, TEXTURE_PACK(q->u1 << 4, q->v1 << 4));
+            glListVertex3v16(&g_batch.list, q->x1, q->y1, q->depth);
+            glListCommand1(&g_batch.list, FIFO_TEX_COORD, TEXTURE_PACK(q->u1 << 4, q->v2 << 4));
+            glListVertex2v16(&g_batch.list, q->x1, q->y2);
+            glListCommand1(&g_batch.list, FIFO_TEX_COORD, TEXTURE_PACK(q->u2 << 4, q->v2 << 4));
+            glListVertex2v16(&g_batch.list, q->x2, q->y2);
+            glListCommand1(&g_batch.list, FIFO_TEX_COORD, TEXTURE_PACK(q->u2 << 4, q->v1 << 4));
+            glListVertex2v16(&g_batch.list, q->x2, q->y1);
+
+            end++;
+        }
+
+        glListEnd(&g_batch.list);
+
+        if (textureID != gCurrentTexture)
+        {
+            glBindTexture(GL_TEXTURE_2D, textureID);
+            gCurrentTexture = textureID;
+        }
+
+        const void *list = glListFinish(&g_batch.list);
+        if (list != NULL)
+            glCallList(list);
+
+        start = end;
+    }
+
+    g_batch.count = 0;
+}
+
+int glBatch2DInit(size_t max_quads)
+{
+    glBatch2DFree();
+
+    if (max_quads == 0)
+        return -1;
+
+    g_batch.quads = malloc(max_quads * sizeof(gl2d_quad_t));
+    g_batch.sorted = malloc(max_quads * sizeof(gl2d_quad_t *));
+
+    size_t list_quads = max_quads;
+    if (list_quads > GL2D_BATCH_LIST_MAX_QUADS)
+        list_quads = GL2D_BATCH_LIST_MAX_QUADS;
+
+    int ret = glListInit(&g_batch.list, list_quads * GL2D_BATCH_QUAD_WORDS
+                                        + GL2D_BATCH_LIST_EXTRA_WORDS);
+
+    if ((g_batch.quads == NULL) || (g_batch.sorted == NULL) || (ret != 0))
+    {
+        glBatch2DFree();
+        return -1;
+    }
+
+    g_batch.capacity = max_quads;
+    g_batch.count = 0;
+
+    return 0;
+}
+
+void glBatch2DFree(void)
+{
+    // Draw anything that has been recorded before disabling batch mode
+    if (g_batch.in_2d)
+        gl2d_batch_flush();
+
+    free(g_batch.quads);
+    free(g_batch.sorted);
+    glListFree(&g_batch.list);
+
+    g_batch.quads = NULL;
+    g_batch.sorted = NULL;
+    g_batch.capacity = 0;
+    g_batch.count = 0;
+}
+
+void glBatch2DFlush(void)
+{
+    gl2d_batch_flush();
+}
+
 void glScreen2D(void)
 {
     // Initialize gl
@@ -129,10 +285,16 @@ void glBegin2D(void)
     gCurrentTexture = 0; // Set current texture to 0
     // Set depth to 0. We need this var since we cannot disable depth testing
     g_depth = 0;
+
+    g_batch.in_2d = true;
 }
 
 void glEnd2D(void)
 {
+    // Draw all batched quads while the 2D matrices are still active
+    gl2d_batch_flush();
+    g_batch.in_2d = false;
+
     // Restore 3d matrices and set current matrix to modelview
     glMatrixMode(GL_PROJECTION);
     glPopMatrix(1);
@@ -319,6 +481,28 @@ void glSprite(int x, int y, int flipmode, const glImage *spr)
     int v1 = spr->v_off + ((flipmode & GL_FLIP_V) ? spr->height - 1 : 0);
     int v2 = spr->v_off + ((flipmode & GL_FLIP_V) ? 0 : spr->height);
 
+    if (g_batch.capacity > 0)
+    {
+        if (g_batch.count == g_batch.capacity)
+            gl2d_batch_flush();
+
+        gl2d_quad_t *q = &g_batch.quads[g_batch.count++];
+
+        q->textureID = spr->textureID;
+        q->x1 = x1;
+        q->y1 = y1;
+        q->x2 = x2;
+        q->y2 = y2;
+        q->u1 = u1;
+        q->v1 = v1;
+        q->u2 = u2;
+        q->v2 = v2;
+        q->depth = g_depth;
+
+        g_depth++;
+        return;
+    }
+
     if (spr->textureID != gCurrentTexture)
     {
         glBindTexture(GL_TEXTURE_2D, spr->textureID);
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Builder of packed display lists for glCallList()
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/sassert.h>
+#include <nds/arm9/videoGL.h>
+
+// Number of parameters of each geometry command
+static const uint8_t gl_list_num_params[0x73] = {
+    [0x00] = 0, // NOP
+    [0x10] = 1, // MTX_MODE
+    [0x11] = 0, // MTX_PUSH
+    [0x12] = 1, // MTX_POP
+    [0x13] = 1, // MTX_STORE
+    [0x14] = 1, // MTX_RESTORE
+    [0x15] = 0, // MTX_IDENTITY
+    [0x16] = 16, // MTX_LOAD_4x4
+    [0x17] = 12, // MTX_LOAD_4x3
+    [0x18] = 16, // MTX_MULT_4x4
+    [0x19] = 12, // MTX_MULT_4x3
+    [0x1A] = 9, // MTX_MULT_3x3
+    [0x1B] = 3, // MTX_SCALE
+    [0x1C] = 3, // MTX_TRANS
+    [0x20] = 1, // COLOR
+    [0x21] = 1, // NORMAL
+    [0x22] = 1, // TEXCOORD
+    [0x23] = 2, // VTX_16
+    [0x24] = 1, // VTX_10
+    [0x25] = 1, // VTX_XY
+    [0x26] = 1, // VTX_XZ
+    [0x27] = 1, // VTX_YZ
+    [0x28] = 1, // VTX_DIFF
+    [0x29] = 1, // POLYGON_ATTR
+    [0x2A] = 1, // TEXIMAGE_PARAM
+    [0x2B] = 1, // PLTT_BASE
+    [0x30] = 1, // DIF_AMB
+    [0x31] = 1, // SPE_EMI
+    [0x32] = 1, // LIGHT_VECTOR
+    [0x33] = 1, // LIGHT_COLOR
+    [0x34] = 32, // SHININESS
+    [0x40] = 1, // BEGIN_VTXS
+    [0x41] = 0, // END_VTXS
+    [0x50] = 1, // SWAP_BUFFERS
+    [0x60] = 1, // VIEWPORT
+    [0x70] = 3, // BOX_TEST
+    [0x71] = 2, // POS_TEST
+    [0x72] = 1, // VEC_TEST
+};
+
+static bool gl_list_reserve(gl_list_t *list, uint32_t words)
+{
+    if (list->error)
+        return false;
+
+    if (list->size + words <= list->capacity)
+        return true;
+
+    uint32_t capacity = list->capacity * 2;
+    if (capacity < list->size + words)
+        capacity = list->size + words;
+
+    u32 *buffer = realloc(list->buffer, capacity * sizeof(u32));
+    if (buffer == NULL)
+    {
+        list->error = true;
+        return false;
+    }
+
+    list->buffer = buffer;
+    list->capacity = capacity;
+
+    return true;
+}
+
+// Closes the command header that is being filled, if any
+static void gl_list_close_header(gl_list_t *list)
+{
+    if (list->header == 0)
+        return;
+
+    // If none of the commands of the header has parameters the hardware still
+    // expects one parameter word. A zero word is harmless otherwise, as it is
+    // read as a header of four NOPs.
+    if (list->header_params == 0)
+    {
+        if (gl_list_reserve(list, 1))
+            list->buffer[list->size++] = 0;
+    }
+
+    list->header = 0;
+}
+
+int glListInit(gl_list_t *list, size_t initial_words)
+{
+    sassert(list != NULL, "NULL list");
+
+    // Word 0 holds the size of the list
+    if (initial_words < 2)
+        initial_words = 2;
+
+    memset(list, 0, sizeof(gl_list_t));
+
+    list->buffer = malloc(initial_words * sizeof(u32));
+    if (list->buffer == NULL)
+        return -1;
+
+    list->capacity = initial_words;
+    list->size = 1;
+
+    return 0;
+}
+
+void glListFree(gl_list_t *list)
+{
+    free(list->buffer);
+    memset(list, 0, sizeof(gl_list_t));
+}
+
+void glListReset(gl_list_t *list)
+{
+    list->size = 1;
+    list->header = 0;
+    list->error = list->buffer == NULL;
+}
+
+void glListCommand(gl_list_t *list, uint8_t command, const u32 *params,
+                   size_t num_params)
+{
+    sassert(command < sizeof(gl_list_num_params), "Invalid command 0x%X", command);
+    sassert(gl_list_num_params[command] == num_params,
+            "Command 0x%X needs %u params", command, gl_list_num_params[command]);
+
+    if (!gl_list_reserve(list, 1 + num_params))
+        return;
+
+    if (list->header == 0)
+    {
+        list->header = list->size;
+        list->buffer[list->size++] = 0;
+        list->header_commands = 0;
+        list->header_params = 0;
+    }
+
+    list->buffer[list->header] |= (u32)command << (list->header_commands * 8);
+    list->header_commands++;
+    list->header_params += num_params;
+
+    for (size_t i = 0; i < num_params; i++)
+        list->buffer[list->size++] = params[i];
+
+    if (list->header_commands == 4)
+        gl_list_close_header(list);
+}
+
+const void *glListFinish(gl_list_t *list)
+{
+    gl_list_close_header(list);
+
+    if (list->error)
+        return NULL;
+
+    // glCallList() can't send empty lists
+    if (list->size == 1)
+    {
+        if (!gl_list_reserve(list, 1))
+            return NULL;
+
+        list->buffer[list->size++] = 0;
+    }
+
+    list->buffer[0] = list->size - 1;
+
+    return list->buffer;
+}
@@ -0,0 +1,501 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/textureCache.h>
+#include <nds/arm9/videoGL.h>
+
+// Texture cache.
+//
+// Each registered texture keeps the frame in which it was last bound. When a
+// texture that isn't in VRAM is bound, it's marked as pending, and it's loaded
+// in the next call to glTexCacheUpdate(), which happens during VBlank. If there
+// isn't enough space, the texture that was used least recently is evicted. A
+// texture bound during the current frame is never evicted because the GPU will
+// render that frame after the VBlank.
+//
+// Textures loaded from files are read to RAM by glTexCachePrefetch() before
+// they can be uploaded, so glTexCacheUpdate() only copies data to VRAM.
+
+typedef struct {
+    gl_tex_cache_source_t source;
+    char *path; // Copy of source.path
+    void *staged; // Data read from "path", until it's loaded to VRAM
+    uint32_t vram_size; // Texture and palette size in bytes
+    uint32_t last_used; // Frame in which it was bound for the last time
+    int name; // Texture name, only valid if it's resident
+    bool in_use;
+    bool resident;
+    bool pending;
+} gl_tex_cache_entry_t;
+
+static struct {
+    gl_tex_cache_entry_t *entries;
+    int num_entries;
+    uint32_t budget;
+    uint32_t upload_limit;
+    uint32_t frame;
+    gl_tex_cache_stats_t stats;
+    bool initialized;
+} tex_cache;
+
+// Returns the size in bytes of the texture data in VRAM, or 0 on error
+static uint32_t tex_cache_texture_size(const gl_tex_cache_source_t *source)
+{
+    int sizeX = source->sizeX;
+    int sizeY = source->sizeY;
+
+    if (sizeX >= 8)
+        sizeX = glTexSizeToEnum(sizeX);
+    if (sizeY >= 8)
+        sizeY = glTexSizeToEnum(sizeY);
+
+    if ((sizeX < 0) || (sizeY < 0))
+        return 0;
+
+    uint32_t size = 1 << (sizeX + sizeY + 6);
+
+    switch (source->type)
+    {
+        case GL_RGB:
+        case GL_RGBA:
+            return size << 1;
+        case GL_RGB4:
+            return size >> 2;
+        case GL_COMPRESSED:
+            // The extra data is half the size of the texel data
+            return (size >> 2) + (size >> 3);
+        case GL_RGB16:
+            return size >> 1;
+        case GL_RGB32_A3:
+        case GL_RGB256:
+        case GL_RGB8_A5:
+            return size;
+        default:
+            return 0;
+    }
+}
+
+static gl_tex_cache_entry_t *tex_cache_get(int handle)
+{
+    if ((handle < 1) || (handle > tex_cache.num_entries))
+        return NULL;
+
+    gl_tex_cache_entry_t *entry = &tex_cache.entries[handle - 1];
+    if (!entry->in_use)
+        return NULL;
+
+    return entry;
+}
+
+static void tex_cache_unload(gl_tex_cache_entry_t *entry)
+{
+    if (!entry->resident)
+        return;
+
+    glDeleteTextures(1, &entry->name);
+
+    entry->resident = false;
+    tex_cache.stats.resident_bytes -= entry->vram_size;
+}
+
+// Evicts the least recently used texture that isn't used in the current frame.
+// Returns false if there are no textures that can be evicted.
+static bool tex_cache_evict_one(void)
+{
+    gl_tex_cache_entry_t *lru = NULL;
+
+    for (int i = 0; i < tex_cache.num_entries; i++)
+    {
+        gl_tex_cache_entry_t *entry = &tex_cache.entries[i];
+
+        if (!entry->in_use || !entry->resident)
+            continue;
+
+        if (entry->last_used >= tex_cache.frame)
+            continue;
+
+        if ((lru == NULL) || (entry->last_used < lru->last_used))
+            lru = entry;
+    }
+
+    if (lru == NULL)
+        return false;
+
+    tex_cache_unload(lru);
+    tex_cache.stats.evictions++;
+
+    return true;
+}
+
+// Returns the texture data that has to be loaded to VRAM, or NULL if the
+// texture is loaded from a file that hasn't been read yet.
+static const void *tex_cache_get_data(gl_tex_cache_entry_t *entry)
+{
+    if (entry->source.texture != NULL)
+        return entry->source.texture;
+
+    return entry->staged;
+}
+
+// Reads the texture data of a texture loaded from a file to RAM. Returns false
+// on error.
+static bool tex_cache_stage(gl_tex_cache_entry_t *entry)
+{
+    if (tex_cache_get_data(entry) != NULL)
+        return true;
+
+    uint32_t size = tex_cache_texture_size(&entry->source);
+
+    FILE *f = fopen(entry->path, "rb");
+    if (f == NULL)
+        return false;
+
+    void *buffer = malloc(size);
+    if (buffer == NULL)
+        goto error;
+
+    if (fseek(f, entry->source.offset, SEEK_SET) != 0)
+        goto error;
+
+    if (fread(buffer, 1, size, f) != size)
+        goto error;
+
+    fclose(f);
+
+    entry->staged = buffer;
+    return true;
+
+error:
+    free(buffer);
+    fclose(f);
+    return false;
+}
+
+static void tex_cache_unstage(gl_tex_cache_entry_t *entry)
+{
+    free(entry->staged);
+    entry->staged = NULL;
+}
+
+typedef enum {
+    TEX_CACHE_UPLOAD_OK,
+    TEX_CACHE_UPLOAD_NO_VRAM, // Evicting textures may help
+    TEX_CACHE_UPLOAD_ERROR, // Evicting textures won't help
+} tex_cache_upload_result_t;
+
+// Tries to load the texture to VRAM without evicting anything
+static tex_cache_upload_result_t tex_cache_try_upload(gl_tex_cache_entry_t *entry,
+                                                      const void *data)
+{
+    const gl_tex_cache_source_t *source = &entry->source;
+
+    // This fails if there are no texture names left or if there isn't enough
+    // RAM. Freeing VRAM won't fix it.
+    int name;
+    if (glGenTextures(1, &name) == 0)
+        return TEX_CACHE_UPLOAD_ERROR;
+
+    glBindTexture(0, name);
+
+    if (glTexImageNtr2D(source->type, source->sizeX, source->sizeY,
+                        source->param, data, NULL) == 0)
+        goto error;
+
+    if ((source->palette != NULL) && (source->num_colors > 0))
+    {
+        if (glColorTableNtr(source->num_colors, source->palette) == 0)
+            goto error;
+    }
+
+    entry->name = name;
+    return TEX_CACHE_UPLOAD_OK;
+
+error:
+    // The parameters have been checked by glTexCacheRegister(), so this is
+    // caused by a lack of VRAM.
+    glDeleteTextures(1, &name);
+    return TEX_CACHE_UPLOAD_NO_VRAM;
+}
+
+// Loads a texture to VRAM, evicting textures if there isn't enough space. The
+// data of textures loaded from files must have been staged. If "allow_compact"
+// is true, the free VRAM is compacted once before evicting textures. This moves
+// textures in VRAM and changes the mapping of the VRAM banks, so it can't be
+// done while the GPU may be using the textures.
+static bool tex_cache_upload(gl_tex_cache_entry_t *entry, bool allow_compact)
+{
+    if (entry->resident)
+        return true;
+
+    // Don't evict anything until the data is ready to be copied
+    const void *data = tex_cache_get_data(entry);
+    if (data == NULL)
+        return false;
+
+    if ((tex_cache.budget != 0) && (entry->vram_size > tex_cache.budget))
+        return false;
+
+    while ((tex_cache.budget != 0)
+           && (tex_cache.stats.resident_bytes + entry->vram_size > tex_cache.budget))
+    {
+        if (!tex_cache_evict_one())
+            return false;
+    }
+
+    tex_cache_upload_result_t result;
+
+    while (1)
+    {
+        result = tex_cache_try_upload(entry, data);
+        if (result != TEX_CACHE_UPLOAD_NO_VRAM)
+            break;
+
+        // The free VRAM may be fragmented. Try to join the free space before
+        // evicting textures.
+        if (allow_compact)
+        {
+            glCompactTextures();
+            allow_compact = false;
+            continue;
+        }
+
+        if (!tex_cache_evict_one())
+            break;
+    }
+
+    // If there isn't enough VRAM, keep the staged data for the next try
+    if (result != TEX_CACHE_UPLOAD_OK)
+        return false;
+
+    tex_cache_unstage(entry);
+
+    entry->resident = true;
+    entry->pending = false;
+
+    tex_cache.stats.uploads++;
+    tex_cache.stats.bytes_uploaded += entry->vram_size;
+    tex_cache.stats.resident_bytes += entry->vram_size;
+
+    return true;
+}
+
+int glTexCacheInit(size_t budget, size_t upload_limit)
+{
+    glTexCacheExit();
+
+    tex_cache.budget = budget;
+    tex_cache.upload_limit = upload_limit;
+    tex_cache.frame = 1;
+    tex_cache.initialized = true;
+
+    return 0;
+}
+
+void glTexCacheExit(void)
+{
+    for (int i = 0; i < tex_cache.num_entries; i++)
+    {
+        gl_tex_cache_entry_t *entry = &tex_cache.entries[i];
+
+        if (!entry->in_use)
+            continue;
+
+        tex_cache_unload(entry);
+        tex_cache_unstage(entry);
+        free(entry->path);
+    }
+
+    free(tex_cache.entries);
+
+    memset(&tex_cache, 0, sizeof(tex_cache));
+}
+
+int glTexCacheRegister(const gl_tex_cache_source_t *source)
+{
+    if (!tex_cache.initialized || (source == NULL))
+        return -1;
+
+    if ((source->texture == NULL) && (source->path == NULL))
+        return -1;
+
+    uint32_t size = tex_cache_texture_size(source);
+    if (size == 0)
+        return -1;
+
+    // Look for a free entry
+    int index;
+    for (index = 0; index < tex_cache.num_entries; index++)
+    {
+        if (!tex_cache.entries[index].in_use)
+            break;
+    }
+
+    if (index == tex_cache.num_entries)
+    {
+        int num_entries = tex_cache.num_entries == 0 ? 16 : tex_cache.num_entries * 2;
+
+        gl_tex_cache_entry_t *entries = realloc(tex_cache.entries,
+                                    num_entries * sizeof(gl_tex_cache_entry_t));
+        if (entries == NULL)
+            return -1;
+
+        memset(&entries[tex_cache.num_entries], 0,
+               (num_entries - tex_cache.num_entries) * sizeof(gl_tex_cache_entry_t));
+
+        tex_cache.entries = entries;
+        tex_cache.num_entries = num_entries;
+    }
+
+    gl_tex_cache_entry_t *entry = &tex_cache.entries[index];
+
+    memset(entry, 0, sizeof(gl_tex_cache_entry_t));
+
+    if (source->texture == NULL)
+    {
+        entry->path = strdup(source->path);
+        if (entry->path == NULL)
+            return -1;
+    }
+
+    entry->source = *source;
+    entry->source.path = entry->path;
+    entry->vram_size = size;
+    if (source->palette != NULL)
+        entry->vram_size += source->num_colors * 2;
+    entry->in_use = true;
+
+    return index + 1;
+}
+
+void glTexCacheUnregister(int handle)
+{
+    gl_tex_cache_entry_t *entry = tex_cache_get(handle);
+    if (entry == NULL)
+        return;
+
+    tex_cache_unload(entry);
+    tex_cache_unstage(entry);
+    free(entry->path);
+
+    memset(entry, 0, sizeof(gl_tex_cache_entry_t));
+}
+
+int glTexCacheBind(int handle)
+{
+    gl_tex_cache_entry_t *entry = tex_cache_get(handle);
+    if (entry == NULL)
+        return 0;
+
+    entry->last_used = tex_cache.frame;
+
+    if (entry->resident)
+    {
+        tex_cache.stats.hits++;
+        glBindTexture(0, entry->name);
+        return 1;
+    }
+
+    tex_cache.stats.misses++;
+    entry->pending = true;
+    glBindTexture(0, 0);
+    return 0;
+}
+
+int glTexCachePreload(int handle)
+{
+    gl_tex_cache_entry_t *entry = tex_cache_get(handle);
+    if (entry == NULL)
+        return 0;
+
+    if (!tex_cache_stage(entry))
+        return 0;
+
+    return tex_cache_upload(entry, true) ? 1 : 0;
+}
+
+void glTexCachePrefetch(void)
+{
+    if (!tex_cache.initialized)
+        return;
+
+    uint32_t staged = 0;
+
+    for (int i = 0; i < tex_cache.num_entries; i++)
+    {
+        gl_tex_cache_entry_t *entry = &tex_cache.entries[i];
+
+        if (!entry->in_use || !entry->pending)
+            continue;
+
+        if (tex_cache_get_data(entry) != NULL)
+            continue;
+
+        // Leave the rest of textures for the next frames
+        if ((tex_cache.upload_limit != 0) && (staged > 0)
+            && (staged + entry->vram_size > tex_cache.upload_limit))
+            break;
+
+        if (!tex_cache_stage(entry))
+        {
+            // Don't try to read the file again every frame
+            entry->pending = false;
+            continue;
+        }
+
+        staged += entry->vram_size;
+    }
+}
+
+void glTexCacheUpdate(void)
+{
+    if (!tex_cache.initialized)
+        return;
+
+    uint32_t uploaded = 0;
+
+    for (int i = 0; i < tex_cache.num_entries; i++)
+    {
+        gl_tex_cache_entry_t *entry = &tex_cache.entries[i];
+
+        if (!entry->in_use || !entry->pending)
+            continue;
+
+        // Files are only read by glTexCachePrefetch()
+        if (tex_cache_get_data(entry) == NULL)
+            continue;
+
+        // Leave the rest of textures for the next frames
+        if ((tex_cache.upload_limit != 0) && (uploaded > 0)
+            && (uploaded + entry->vram_size > tex_cache.upload_limit))
+            break;
+
+        // If it fails it stays pending, and it will be tried again in the next
+        // frame, when other textures may be evicted.
+        if (tex_cache_upload(entry, false))
+            uploaded += entry->vram_size;
+    }
+
+    tex_cache.frame++;
+}
+
+void glTexCacheGetStats(gl_tex_cache_stats_t *stats)
+{
+    if (stats != NULL)
+        *stats = tex_cache.stats;
+}
+
+void glTexCacheResetStats(void)
+{
+    uint32_t resident_bytes = tex_cache.stats.resident_bytes;
+
+    memset(&tex_cache.stats, 0, sizeof(tex_cache.stats));
+
+    tex_cache.stats.resident_bytes = resident_bytes;
+}
@@ -13,11 +13,14 @@
 #include <nds/arm9/videoGL.h>
 #include <nds/arm9/video.h>
 #include <nds/bios.h>
+#include <nds/cothread.h>
 #include <nds/interrupts.h>
 #include <nds/memory.h>
 #include <nds/ndstypes.h>
 #include <nds/system.h>
 
+#include "common/libnds_internal.h"
+
 // Structures specific to allocating and deallocating texture and palette VRAM
 // ---------------------------------------------------------------------------
 
@@ -30,9 +33,28 @@ typedef struct s_SingleBlock
     // 2-3: prev/next empty/alloc block
     struct s_SingleBlock *node[4];
 
+    // prev/next empty block of the same size class (only for empty blocks)
+    struct s_SingleBlock *binPrev, *binNext;
+    uint8_t bin;
+
     uint32_t blockSize;
 } s_SingleBlock;
 
+// Empty blocks are also kept in lists of blocks of similar size. List N has
+// blocks with a size between 2^N and 2^(N+1) - 1 bytes, so allocations can skip
+// all the empty blocks that are too small. The largest VRAM area is 512 KB.
+#define VRAM_BLOCK_BINS 20
+
+// Blocks are allocated in chunks and reused instead of being allocated and
+// freed every time an empty block is split or merged.
+#define VRAM_BLOCK_CHUNK_SIZE 32
+
+typedef struct s_BlockChunk
+{
+    struct s_BlockChunk *next;
+    struct s_SingleBlock blocks[VRAM_BLOCK_CHUNK_SIZE];
+} s_BlockChunk;
+
 typedef struct s_vramBlock
 {
     uint8_t *startAddr, *endAddr;
@@ -40,6 +62,14 @@ typedef struct s_vramBlock
     struct s_SingleBlock *firstEmpty;
     struct s_SingleBlock *firstAlloc;
 
+    // Pool of unused blocks, linked with node[1]
+    struct s_BlockChunk *blockChunks;
+    struct s_SingleBlock *freeBlocks;
+    uint32_t freeBlockCount;
+
+    // Empty blocks sorted by size class
+    struct s_SingleBlock *bins[VRAM_BLOCK_BINS];
+
     struct s_SingleBlock *lastExamined;
     uint8_t *lastExaminedAddr;
     uint32_t lastExaminedSize;
@@ -67,6 +97,7 @@ typedef struct gl_palette_data
     uint32_t palIndex;      // The index in the memory block
     uint16_t addr;          // The offset address for texture palettes in VRAM
     uint16_t palSize;       // The length of the palette
+    uint8_t addrShift;      // Shift between the VRAM offset and addr (3 or 4)
     uint32_t connectCount;  // The number of textures currently using this palette
 } gl_palette_data;
 
@@ -127,6 +158,25 @@ gl_hidden_globals;
 // This is the actual data of the globals for videoGL.
 gl_hidden_globals glGlob;
 
+// Queue of lists sent with glCallListAsync(). The list at the head is the one
+// being sent by DMA channel 0. Fences are the number of lists submitted so far,
+// so a fence has been signaled when the number of lists sent reaches it.
+#define GL_ASYNC_QUEUE_SIZE 8
+
+static struct {
+    const u32 *list[GL_ASYNC_QUEUE_SIZE];
+    u32 head;
+    u32 count;
+    u32 submitted;
+    vu32 completed;
+    bool irq_installed;
+
+    // Start of the list at the head delayed until the next VBlank
+    bool vblank_armed;
+    bool vblank_was_enabled;
+    VoidFn vblank_handler; // Handler of the user, called by ours
+} glAsync;
+
 ARM_CODE void glRotatef32i(int angle, int32_t x, int32_t y, int32_t z)
 {
     int32_t axis[3];
@@ -359,11 +409,181 @@ ARM_CODE void glTexCoord2f32(int32_t u, int32_t v)
 // Internal VRAM allocation/deallocation functions. Calling these functions
 // outside of videoGL may interfere with normal operations.
 
+static int vramBlock__reserveBlocks(s_vramBlock *mb, uint32_t count)
+{
+    while (mb->freeBlockCount < count)
+    {
+        s_BlockChunk *chunk = malloc(sizeof(s_BlockChunk));
+        if (chunk == NULL)
+            return 0;
+
+        chunk->next = mb->blockChunks;
+        mb->blockChunks = chunk;
+
+        for (int i = 0; i < VRAM_BLOCK_CHUNK_SIZE; i++)
+        {
+            chunk->blocks[i].node[1] = mb->freeBlocks;
+            mb->freeBlocks = &chunk->blocks[i];
+        }
+        mb->freeBlockCount += VRAM_BLOCK_CHUNK_SIZE;
+    }
+
+    return 1;
+}
+
+static struct s_SingleBlock *vramBlock__newBlock(s_vramBlock *mb)
+{
+    if (vramBlock__reserveBlocks(mb, 1) == 0)
+        return NULL;
+
+    struct s_SingleBlock *block = mb->freeBlocks;
+    mb->freeBlocks = block->node[1];
+    mb->freeBlockCount--;
+
+    memset(block, 0, sizeof(struct s_SingleBlock));
+    return block;
+}
+
+static void vramBlock__freeBlock(s_vramBlock *mb, struct s_SingleBlock *block)
+{
+    block->node[1] = mb->freeBlocks;
+    mb->freeBlocks = block;
+    mb->freeBlockCount++;
+}
+
+static void vramBlock__freeChunks(s_vramBlock *mb)
+{
+    s_BlockChunk *chunk = mb->blockChunks;
+
+    while (chunk != NULL)
+    {
+        s_BlockChunk *nextChunk = chunk->next;
+        free(chunk);
+        chunk = nextChunk;
+    }
+
+    mb->blockChunks = NULL;
+    mb->freeBlocks = NULL;
+    mb->freeBlockCount = 0;
+
+    mb->firstBlock = mb->firstEmpty = mb->firstAlloc = NULL;
+    memset(mb->bins, 0, sizeof(mb->bins));
+}
+
+static uint32_t vramBlock__binIndex(uint32_t size)
+{
+    if (size == 0)
+        return 0;
+
+    uint32_t bin = 31 - __builtin_clz(size);
+    return bin < VRAM_BLOCK_BINS ? bin : VRAM_BLOCK_BINS - 1;
+}
+
+// Adds an empty block to the list of its size class. The size of the block
+// must not change until it is removed from the list.
+static void vramBlock__binInsert(s_vramBlock *mb, struct s_SingleBlock *block)
+{
+    uint32_t bin = vramBlock__binIndex(block->blockSize);
+
+    block->bin = bin;
+    block->binPrev = NULL;
+    block->binNext = mb->bins[bin];
+    if (block->binNext)
+        block->binNext->binPrev = block;
+    mb->bins[bin] = block;
+}
+
+static void vramBlock__binRemove(s_vramBlock *mb, struct s_SingleBlock *block)
+{
+    if (block->binPrev)
+        block->binPrev->binNext = block->binNext;
+    else
+        mb->bins[block->bin] = block->binNext;
+
+    if (block->binNext)
+        block->binNext->binPrev = block->binPrev;
+
+    block->binPrev = block->binNext = NULL;
+}
+
+// Gets the address range of a texture (or texture palette) bank, and returns
+// true if it can be used for allocations: it is mapped as a texture (or texture
+// palette) bank and it isn't locked.
+static bool vramBlock__bankUsable(bool palette, uint32_t i, uint8_t **start,
+                                  uint32_t *size)
+{
+    uint32_t vramCtrl = palette ? VRAM_EFG_CR : VRAM_CR;
+    int vramLock = palette ? glGlob.vramLockPal : glGlob.vramLockTex;
+
+    if (palette)
+    {
+        *start = (i == 0 ? (uint8_t *)VRAM_E : (uint8_t *)VRAM_F + ((i - 1) * 0x4000));
+        *size = (i == 0 ? 0x10000 : 0x4000);
+    }
+    else
+    {
+        *start = (uint8_t *)VRAM_A + (i * 0x20000);
+        *size = 0x20000;
+    }
+
+    // VRAM_ENABLE | ( VRAM_x_TEXTURE | VRAM_x_TEX_PALETTE )
+    return (((vramCtrl >> (i * 8)) & 0x83) == 0x83) && !(vramLock & BIT(i));
+}
+
+// Returns the lowest address of an empty block where "size" bytes aligned to
+// (1 << align) bytes fit without using banks that can't be used, or NULL.
+static uint8_t *vramBlock__fitInBlock(s_vramBlock *mb, struct s_SingleBlock *block,
+                                      uint32_t size, uint8_t align)
+{
+    bool palette = mb->startAddr >= (uint8_t *)VRAM_E;
+    uint32_t numBanks = palette ? 3 : 4;
+    uint8_t *blockEnd = block->AddrSet + block->blockSize;
+
+    // Allocations can span several banks as long as all of them can be used, so
+    // look for runs of consecutive usable banks.
+    uint8_t *runStart = NULL;
+    uint8_t *runEnd = NULL;
+
+    for (uint32_t i = 0; i <= numBanks; i++)
+    {
+        uint8_t *bankStart;
+        uint32_t bankSize;
+
+        if ((i < numBanks) && vramBlock__bankUsable(palette, i, &bankStart, &bankSize))
+        {
+            if (runStart == NULL)
+                runStart = bankStart;
+            runEnd = bankStart + bankSize;
+            continue;
+        }
+
+        if (runStart == NULL)
+            continue;
+
+        uint8_t *start = block->AddrSet > runStart ? block->AddrSet : runStart;
+        uint8_t *end = blockEnd < runEnd ? blockEnd : runEnd;
+
+        start = (uint8_t *)(((uint32_t)start + ((1 << align) - 1)) & (~((1 << align) - 1)));
+
+        if ((start < end) && ((uint32_t)(end - start) >= size))
+            return start;
+
+        runStart = NULL;
+    }
+
+    return NULL;
+}
+
 int vramBlock_init(s_vramBlock *mb)
 {
+    mb->blockChunks = NULL;
+    mb->freeBlocks = NULL;
+    mb->freeBlockCount = 0;
+    memset(mb->bins, 0, sizeof(mb->bins));
+
     // Construct a new block that will be set as the first block, as well as the
     // first empty block.
-    struct s_SingleBlock *newBlock = calloc(1, sizeof(struct s_SingleBlock));
+    struct s_SingleBlock *newBlock = vramBlock__newBlock(mb);
     if (newBlock == NULL)
         return 0;
 
@@ -371,6 +591,8 @@ int vramBlock_init(s_vramBlock *mb)
     newBlock->blockSize = (uint32_t)mb->endAddr - (uint32_t)mb->startAddr;
 
     mb->firstBlock = mb->firstEmpty = newBlock;
+    mb->firstAlloc = NULL;
+    vramBlock__binInsert(mb, newBlock);
 
     // Default settings and initializations for up to 16 blocks (will increase
     // as limit is reached).
@@ -383,13 +605,13 @@ int vramBlock_init(s_vramBlock *mb)
 
     if (DynamicArrayInit(&mb->blockPtrs, 16) == NULL)
     {
-        free(newBlock);
+        vramBlock__freeChunks(mb);
         return 0;
     }
     if (DynamicArrayInit(&mb->deallocBlocks, 16) == NULL)
     {
         DynamicArrayDelete(&mb->blockPtrs);
-        free(newBlock);
+        vramBlock__freeChunks(mb);
         return 0;
     }
 
@@ -433,16 +655,8 @@ s_vramBlock *vramBlock_Construct(uint8_t *start, uint8_t *end)
 
 void vramBlock_terminate(s_vramBlock *mb)
 {
-    // Starts at the container's first block, and goes through each sequential block,
-    // deleting them.
-    struct s_SingleBlock *curBlock = mb->firstBlock;
-
-    while (curBlock != NULL)
-    {
-        struct s_SingleBlock *nextBlock = curBlock->node[1];
-        free(curBlock);
-        curBlock = nextBlock;
-    }
+    // All blocks are stored in chunks, free the chunks
+    vramBlock__freeChunks(mb);
 
     DynamicArrayDelete(&mb->deallocBlocks);
     DynamicArrayDelete(&mb->blockPtrs);
@@ -467,6 +681,15 @@ struct s_SingleBlock *vramBlock__allocateBlock(s_vramBlock *mb,
         || (addr + size) > (block->AddrSet + block->blockSize))
         return NULL;
 
+    // The block may be split up to two times. Make sure that this can't fail
+    // halfway through.
+    if (vramBlock__reserveBlocks(mb, 2) == 0)
+        return NULL;
+
+    // The block is going to be allocated, and the empty blocks created by
+    // splitting it are added to the lists of empty blocks below.
+    vramBlock__binRemove(mb, block);
+
     // Get pointers to the various blocks, as those may change from allocation
     struct s_SingleBlock **first = &mb->firstBlock;
     struct s_SingleBlock **alloc = &mb->firstAlloc;
@@ -499,9 +722,7 @@ struct s_SingleBlock *vramBlock__allocateBlock(s_vramBlock *mb,
             // block will be the true block. Also done is examination of the
             // first block and first empty block, which will be set as well.
 
-            struct s_SingleBlock *newBlock = malloc(sizeof(struct s_SingleBlock));
-            if (newBlock == NULL)
-                return NULL;
+            struct s_SingleBlock *newBlock = vramBlock__newBlock(mb);
 
             newBlock->indexOut = 0;
             newBlock->AddrSet = block->AddrSet + (i * size);
@@ -533,6 +754,8 @@ struct s_SingleBlock *vramBlock__allocateBlock(s_vramBlock *mb,
             newBlock->node[i] = testBlock[i];
             newBlock->node[i + 2] = testBlock[i + 2];
 
+            vramBlock__binInsert(mb, newBlock);
+
             block->node[i] = newBlock;
             if (testBlock[i])
                 testBlock[i]->node[1 - i] = newBlock;
@@ -650,6 +873,7 @@ uint32_t vramBlock__deallocateBlock(s_vramBlock *mb, struct s_SingleBlock *block
                 if (block->node[i + 2])
                     block->node[i + 2]->node[3 - i] = block;
 
+                vramBlock__binRemove(mb, testBlock[i + 2]);
                 block->blockSize += testBlock[i + 2]->blockSize;
 
                 if (!i)
@@ -662,7 +886,7 @@ uint32_t vramBlock__deallocateBlock(s_vramBlock *mb, struct s_SingleBlock *block
                 if (testBlock[i + 2] == *empty)
                     *empty = block;
 
-                free(testBlock[i + 2]);
+                vramBlock__freeBlock(mb, testBlock[i + 2]);
 
                 // Even if the above did not happen, there is still a chance the
                 // new deallocated block may now be the first empty block, so
@@ -675,6 +899,12 @@ uint32_t vramBlock__deallocateBlock(s_vramBlock *mb, struct s_SingleBlock *block
         }
     }
 
+    // If all VRAM was allocated there weren't any empty blocks to compare with
+    if (*empty == NULL)
+        *empty = block;
+
+    vramBlock__binInsert(mb, block);
+
     return 1;
 }
 
@@ -874,15 +1104,28 @@ uint32_t vramBlock_allocateBlock(s_vramBlock *mb, uint32_t size, uint8_t align)
     if (mb->firstEmpty == NULL || !size || align >= 8)
         return 0;
 
-    // Grab the first empty block, and begin examination for a valid spot from
-    // there
-    struct s_SingleBlock *block = mb->firstEmpty;
-    uint8_t *checkAddr = vramBlock_examineSpecial(mb, block->AddrSet, size, align);
-    if (checkAddr == NULL)
-        return 0;
+    // Look for an empty block starting from the lists of the smallest blocks
+    // that may be big enough. Blocks in the first list may still be too small.
+    for (uint32_t bin = vramBlock__binIndex(size); bin < VRAM_BLOCK_BINS; bin++)
+    {
+        for (struct s_SingleBlock *block = mb->bins[bin]; block; block = block->binNext)
+        {
+            if (block->blockSize < size)
+                continue;
+
+            uint8_t *checkAddr = vramBlock__fitInBlock(mb, block, size, align);
+            if (checkAddr == NULL)
+                continue;
 
-    // If execution gets here, then a spot was found, so allocate it
-    return vramBlock_allocateSpecial(mb, checkAddr, size);
+            // A spot was found, so allocate it
+            mb->lastExamined = block;
+            mb->lastExaminedAddr = checkAddr;
+            mb->lastExaminedSize = size;
+            return vramBlock_allocateSpecial(mb, checkAddr, size);
+        }
+    }
+
+    return 0;
 }
 
 // TODO: The return value of this function isn't checked anywhere, but I'm not
@@ -1474,6 +1717,29 @@ int glBindTexture(int target, int name)
 
 // Load a 15-bit color format palette into palette memory, and set it to the
 // currently bound texture.
+// Returns the offset used by the GPU to access a palette in VRAM, or -1 if the
+// palette can't be used at that address.
+static int glPaletteVramToOffset(uint8_t *vramAddr, uint32_t shift)
+{
+    uint16_t *baseBank = vramGetBank((uint16_t *)vramAddr);
+    uint32_t addr = ((uint32_t)vramAddr - (uint32_t)baseBank);
+    uint8_t offset = 0;
+
+    if (baseBank == VRAM_F)
+        offset = (VRAM_F_CR >> 3) & 3;
+    else if (baseBank == VRAM_G)
+        offset = (VRAM_G_CR >> 3) & 3;
+    addr += ((offset & 0x1) * 0x4000) + ((offset & 0x2) * 0x8000);
+
+    addr >>= shift;
+
+    // 4 color mode cannot extend past 64K texture palette space
+    if (shift == 3 && addr >= 0x2000)
+        return -1;
+
+    return addr;
+}
+
 int glColorTableNtr(size_t num_colors, const void *table)
 {
     // We can only load a palette if there is an active texture
@@ -1507,18 +1773,8 @@ int glColorTableNtr(size_t num_colors, const void *table)
     }
 
     // Calculate the address, logical and actual, of where the palette will go
-    uint16_t *baseBank = vramGetBank((uint16_t *)checkAddr);
-    uint32_t addr = ((uint32_t)checkAddr - (uint32_t)baseBank);
-    uint8_t offset = 0;
-
-    if (baseBank == VRAM_F)
-        offset = (VRAM_F_CR >> 3) & 3;
-    else if (baseBank == VRAM_G)
-        offset = (VRAM_G_CR >> 3) & 3;
-    addr += ((offset & 0x1) * 0x4000) + ((offset & 0x2) * 0x8000);
-
-    addr >>= colFormatVal;
-    if (colFormatVal == 3 && addr >= 0x2000)
+    int addr = glPaletteVramToOffset(checkAddr, colFormatVal);
+    if (addr < 0)
     {
         // Palette location not good because 4 color mode cannot extend
         // past 64K texture palette space
@@ -1565,6 +1821,7 @@ int glColorTableNtr(size_t num_colors, const void *table)
 
     palette->vramAddr = checkAddr;
     palette->addr = addr;
+    palette->addrShift = colFormatVal;
 
     palette->connectCount = 1;
     palette->palSize = num_colors << 1;
@@ -2063,6 +2320,318 @@ int glTexImageNtr2D(GL_TEXTURE_TYPE_ENUM type, int sizeX, int sizeY, int param,
     return 1;
 }
 
+// Copies data between two VRAM blocks that may overlap. VRAM doesn't support
+// 8-bit writes, so this can't use memmove().
+static void glVramMove(void *dest, const void *src, uint32_t size)
+{
+    vu16 *d = dest;
+    const vu16 *s = src;
+    uint32_t count = size / 2;
+
+    if (d < s)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            d[i] = s[i];
+    }
+    else
+    {
+        for (uint32_t i = count; i > 0; i--)
+            d[i - 1] = s[i - 1];
+    }
+}
+
+static int glCompactCompare(const void *a, const void *b)
+{
+    uint32_t addr_a = (uint32_t)(*(void * const *)a);
+    uint32_t addr_b = (uint32_t)(*(void * const *)b);
+
+    return addr_a < addr_b ? -1 : (addr_a > addr_b ? 1 : 0);
+}
+
+// Returns an array with the names of all textures or palettes, sorted by their
+// address in VRAM. The first field of both structs is the VRAM address, so the
+// sorting is done with pairs of address and name.
+static void **glCompactSortedList(DynamicArray *ptrs, int count, int *out_count)
+{
+    void **list = malloc(count * 2 * sizeof(void *));
+    if (list == NULL)
+        return NULL;
+
+    int n = 0;
+    for (int i = 1; i < count; i++)
+    {
+        void **data = DynamicArrayGet(ptrs, i);
+        if ((data == NULL) || (data[0] == NULL))
+            continue;
+
+        list[n * 2] = data[0];
+        list[n * 2 + 1] = (void *)i;
+        n++;
+    }
+
+    qsort(list, n, 2 * sizeof(void *), glCompactCompare);
+
+    *out_count = n;
+    return list;
+}
+
+// Returns true if all the VRAM banks that contain the range of addresses are
+// mapped as texture (or texture palette) banks and they aren't locked.
+static bool glCompactRangeUsable(bool palette, uint8_t *start, uint32_t size)
+{
+    uint32_t numBanks = palette ? 3 : 4;
+
+    for (uint32_t i = 0; i < numBanks; i++)
+    {
+        uint8_t *bankStart;
+        uint32_t bankSize;
+        bool usable = vramBlock__bankUsable(palette, i, &bankStart, &bankSize);
+
+        if ((start >= bankStart + bankSize) || (start + size <= bankStart))
+            continue;
+
+        if (!usable)
+            return false;
+    }
+
+    return true;
+}
+
+typedef struct gl_vram_move
+{
+    uint8_t *dest;
+    uint8_t *src;
+    uint32_t size;
+} gl_vram_move;
+
+// Moves a block to the lowest address of VRAM where it fits. The block is
+// freed first so that it can overlap its old location. If it can't be
+// allocated at a lower address it's allocated again at its old address, which
+// is always possible because it has just been freed. Returns the new index of
+// the block (0 on error) and its new address.
+static uint32_t glCompactBlock(s_vramBlock *mb, uint32_t index, uint8_t *oldAddr,
+                               uint32_t size, uint8_t align, bool palette,
+                               uint8_t **newAddr)
+{
+    // Allocating the block again may require up to two new blocks. Reserve them
+    // before freeing it so that going back to the old address can't fail.
+    if (vramBlock__reserveBlocks(mb, 2) == 0)
+    {
+        *newAddr = oldAddr;
+        return index;
+    }
+
+    vramBlock_deallocateBlock(mb, index);
+
+    uint8_t *addr = vramBlock_examineSpecial(mb, mb->firstEmpty->AddrSet, size, align);
+
+    // 4 color palettes can only use the first 64 KB of palette space
+    if ((addr != NULL) && palette && (glPaletteVramToOffset(addr, align) < 0))
+        addr = NULL;
+
+    if ((addr == NULL) || (addr > oldAddr))
+        addr = vramBlock_examineSpecial(mb, oldAddr, size, align);
+
+    *newAddr = addr;
+    return vramBlock_allocateSpecial(mb, addr, size);
+}
+
+// Copies the data of all the blocks that have been moved. The destination of a
+// move may overlap the source of a previous one, so they need to be done in
+// the same order as they were planned.
+static void glCompactCopy(const gl_vram_move *moves, int numMoves)
+{
+    for (int i = 0; i < numMoves; i++)
+        glVramMove(moves[i].dest, moves[i].src, moves[i].size);
+}
+
+// The new locations of all textures and palettes are decided before setting
+// the banks to LCD mode because the allocator only uses banks that are mapped
+// as texture or texture palette banks.
+static int glCompactTexturesVram(void)
+{
+    int count;
+    void **list = glCompactSortedList(&glGlob.texturePtrs, glGlob.texCount, &count);
+    if (list == NULL)
+        return 0;
+
+    gl_vram_move *moves = malloc((count + 1) * sizeof(gl_vram_move));
+    if (moves == NULL)
+    {
+        free(list);
+        return 0;
+    }
+
+    s_vramBlock *mb = glGlob.vramBlocksTex;
+    int numMoves = 0;
+    int ret = 1;
+
+    for (int i = 0; i < count; i++)
+    {
+        int name = (int)list[i * 2 + 1];
+        gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, name);
+
+        // The location of the texel data of compressed textures depends on the
+        // location of their extra data, so they can't be moved.
+        if (tex->texIndexExt)
+            continue;
+
+        // Textures in locked banks must stay where they are
+        uint8_t *oldAddr = tex->vramAddr;
+        if (!glCompactRangeUsable(false, oldAddr, tex->texSize))
+            continue;
+
+        uint8_t *newAddr;
+        tex->texIndex = glCompactBlock(mb, tex->texIndex, oldAddr, tex->texSize,
+                                       3, false, &newAddr);
+        if (tex->texIndex == 0)
+        {
+            // This should never happen. Leave the texture without VRAM rather
+            // than pointing to memory that may be used by other textures.
+            tex->vramAddr = NULL;
+            tex->texFormat = 0;
+            ret = 0;
+            continue;
+        }
+
+        if (newAddr == oldAddr)
+            continue;
+
+        moves[numMoves].dest = newAddr;
+        moves[numMoves].src = oldAddr;
+        moves[numMoves].size = tex->texSize;
+        numMoves++;
+
+        tex->vramAddr = newAddr;
+        tex->texFormat = (tex->texFormat & ~0xFFFF) | (((uint32_t)newAddr >> 3) & 0xFFFF);
+    }
+
+    if (numMoves > 0)
+    {
+        uint32_t vramTemp = VRAM_CR;
+
+        // Only set to LCD mode the banks used for textures
+        if ((VRAM_A_CR & 0x83) == 0x83)
+            vramSetBankA(VRAM_A_LCD);
+        if ((VRAM_B_CR & 0x83) == 0x83)
+            vramSetBankB(VRAM_B_LCD);
+        if ((VRAM_C_CR & 0x83) == 0x83)
+            vramSetBankC(VRAM_C_LCD);
+        if ((VRAM_D_CR & 0x83) == 0x83)
+            vramSetBankD(VRAM_D_LCD);
+
+        glCompactCopy(moves, numMoves);
+
+        vramRestorePrimaryBanks(vramTemp);
+    }
+
+    if (glGlob.activeTexture)
+    {
+        gl_texture_data *tex = DynamicArrayGet(&glGlob.texturePtrs, glGlob.activeTexture);
+        GFX_TEX_FORMAT = tex->texFormat;
+    }
+
+    free(moves);
+    free(list);
+
+    return ret;
+}
+
+static int glCompactPalettesVram(void)
+{
+    int count;
+    void **list = glCompactSortedList(&glGlob.palettePtrs, glGlob.palCount, &count);
+    if (list == NULL)
+        return 0;
+
+    gl_vram_move *moves = malloc((count + 1) * sizeof(gl_vram_move));
+    if (moves == NULL)
+    {
+        free(list);
+        return 0;
+    }
+
+    s_vramBlock *mb = glGlob.vramBlocksPal;
+    int numMoves = 0;
+    int ret = 1;
+
+    for (int i = 0; i < count; i++)
+    {
+        int name = (int)list[i * 2 + 1];
+        gl_palette_data *pal = DynamicArrayGet(&glGlob.palettePtrs, name);
+
+        // Palettes in locked banks must stay where they are
+        uint8_t *oldAddr = pal->vramAddr;
+        if (!glCompactRangeUsable(true, oldAddr, pal->palSize))
+            continue;
+
+        uint8_t *newAddr;
+        pal->palIndex = glCompactBlock(mb, pal->palIndex, oldAddr, pal->palSize,
+                                       pal->addrShift, true, &newAddr);
+        if (pal->palIndex == 0)
+        {
+            // This should never happen. The palette can't be removed from the
+            // textures that use it, so keep the old address, even if that
+            // memory may be reused.
+            ret = 0;
+            continue;
+        }
+
+        if (newAddr == oldAddr)
+            continue;
+
+        moves[numMoves].dest = newAddr;
+        moves[numMoves].src = oldAddr;
+        moves[numMoves].size = pal->palSize;
+        numMoves++;
+
+        pal->vramAddr = newAddr;
+        pal->addr = glPaletteVramToOffset(newAddr, pal->addrShift);
+    }
+
+    if (numMoves > 0)
+    {
+        uint32_t vramTemp = VRAM_EFG_CR;
+
+        // Only set to LCD mode the banks used for texture palettes
+        if ((VRAM_E_CR & 0x83) == 0x83)
+            vramSetBankE(VRAM_E_LCD);
+        if ((VRAM_F_CR & 0x83) == 0x83)
+            vramSetBankF(VRAM_F_LCD);
+        if ((VRAM_G_CR & 0x83) == 0x83)
+            vramSetBankG(VRAM_G_LCD);
+
+        glCompactCopy(moves, numMoves);
+
+        vramRestoreBanks_EFG(vramTemp);
+    }
+
+    if (glGlob.activePalette)
+    {
+        gl_palette_data *pal = DynamicArrayGet(&glGlob.palettePtrs, glGlob.activePalette);
+        GFX_PAL_FORMAT = pal->addr;
+    }
+
+    free(moves);
+    free(list);
+
+    return ret;
+}
+
+int glCompactTextures(void)
+{
+    if (!glGlob.isActive)
+        return 0;
+
+    // Commands that are waiting to be sent may use the old addresses
+    glCallListAsyncWait(glAsync.submitted);
+
+    int ret = glCompactTexturesVram();
+    ret &= glCompactPalettesVram();
+
+    return ret;
+}
+
 void glGetFixed(const GL_GET_ENUM param, int *f)
 {
     switch (param)
@@ -2160,6 +2729,157 @@ void glTexCoord2f(float s, float t)
     }
 }
 
+static bool glAsyncOtherDmaBusy(void)
+{
+    return dmaBusy(1) || dmaBusy(2) || dmaBusy(3);
+}
+
+static void glAsyncStart(void);
+
+static void glAsyncVBlankHandler(void)
+{
+    // This is a one-shot handler. Give the interrupt back to the user before
+    // doing anything else, as the start may need to be delayed again.
+    irqSet(IRQ_VBLANK, glAsync.vblank_handler);
+    if (!glAsync.vblank_was_enabled)
+        irqDisable(IRQ_VBLANK);
+    glAsync.vblank_armed = false;
+
+    if (glAsync.vblank_handler != NULL)
+        glAsync.vblank_handler();
+
+    if ((glAsync.count > 0) && !dmaBusy(0))
+        glAsyncStart();
+}
+
+// Retries the start of the list at the head of the queue in the next VBlank.
+// The VBlank handler of the user is still called.
+static void glAsyncArmVBlank(void)
+{
+    VoidFn previous = irqSetGetPrevious(IRQ_VBLANK, glAsyncVBlankHandler);
+
+    // If the user has replaced the handler since it was armed, the new one is
+    // the one that has to be called.
+    if (previous != glAsyncVBlankHandler)
+        glAsync.vblank_handler = previous;
+
+    if (!glAsync.vblank_armed)
+        glAsync.vblank_was_enabled = (REG_IE & IRQ_VBLANK) != 0;
+
+    glAsync.vblank_armed = true;
+
+    irqEnable(IRQ_VBLANK);
+}
+
+// Starts sending the list at the head of the queue. There is a hardware bug
+// that affects DMA when there are multiple channels active, so it's delayed
+// until the next VBlank if other channels are in use.
+static void glAsyncStart(void)
+{
+    if (glAsyncOtherDmaBusy())
+    {
+        glAsyncArmVBlank();
+        return;
+    }
+
+    const u32 *ptr = glAsync.list[glAsync.head];
+    dmaSetParams(0, ptr + 1, (void *)&GFX_FIFO, DMA_FIFO | DMA_IRQ_REQ | ptr[0]);
+}
+
+static void glAsyncDmaHandler(void)
+{
+    if (glAsync.count == 0)
+        return;
+
+    glAsync.head = (glAsync.head + 1) % GL_ASYNC_QUEUE_SIZE;
+    glAsync.count--;
+    glAsync.completed++;
+
+    if (glAsync.count > 0)
+        glAsyncStart();
+}
+
+u32 glCallListAsync(const void *list)
+{
+    sassert(list != NULL, "glCallListAsync received a null display list pointer");
+
+    const u32 *ptr = list;
+
+    sassert(ptr[0] != 0, "glCallListAsync received a display list of size 0");
+
+    // Flush the area that we are going to DMA
+    DC_FlushRange(ptr, (ptr[0] + 1) * 4);
+
+    int oldIME = enterCriticalSection();
+
+    if (!glAsync.irq_installed)
+    {
+        irqSet(IRQ_DMA0, glAsyncDmaHandler);
+        irqEnable(IRQ_DMA0);
+        glAsync.irq_installed = true;
+    }
+
+    // Wait until there is space in the queue
+    while (glAsync.count == GL_ASYNC_QUEUE_SIZE)
+    {
+        cothread_yield_irq(IRQ_DMA0);
+        REG_IME = 0;
+    }
+
+    if (glAsync.count == 0)
+    {
+        // Make sure that a previous glCallList() has finished
+        while (dmaBusy(0));
+    }
+
+    glAsync.list[(glAsync.head + glAsync.count) % GL_ASYNC_QUEUE_SIZE] = ptr;
+    glAsync.count++;
+    glAsync.submitted++;
+
+    u32 fence = glAsync.submitted;
+
+    if (glAsync.count == 1)
+        glAsyncStart();
+
+    leaveCriticalSection(oldIME);
+
+    return fence;
+}
+
+void glFlush(u32 mode)
+{
+    // The lists sent with glCallListAsync() belong to the frame being swapped
+    glCallListAsyncWait(glAsync.submitted);
+
+    COMPILER_MEMORY_BARRIER();
+    GFX_FLUSH = mode;
+}
+
+bool glCallListAsyncDone(u32 fence)
+{
+    return (s32)(glAsync.completed - fence) >= 0;
+}
+
+void glCallListAsyncWait(u32 fence)
+{
+    int oldIME = enterCriticalSection();
+
+    // cothread_yield_irq() enables interrupts right before switching threads,
+    // so the interrupt can't happen between the check and the call.
+    while (!glCallListAsyncDone(fence))
+    {
+        // Make sure that a delayed start isn't lost if the user has replaced
+        // the VBlank handler.
+        if (glAsync.vblank_armed)
+            glAsyncArmVBlank();
+
+        cothread_yield_irq(IRQ_DMA0);
+        REG_IME = 0;
+    }
+
+    leaveCriticalSection(oldIME);
+}
+
 void glCallList(const void *list)
 {
     sassert(list != NULL, "glCallList received a null display list pointer");
@@ -2172,6 +2892,9 @@ void glCallList(const void *list)
     // Flush the area that we are going to DMA
     DC_FlushRange(ptr, count * 4);
 
+    // The lists sent with glCallListAsync() need to be sent before this one
+    glCallListAsyncWait(glAsync.submitted);
+
     // There is a hardware bug that affects DMA when there are multiple channels
     // active, under certain conditions. Instead of checking for said
     // conditions, simply ensure that there are no DMA channels active.
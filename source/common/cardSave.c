@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/card.h>
+
+// Save manager for the card EEPROM/FLASH.
+//
+// All writes go to a copy of the save data in RAM, and only the pages that
+// have changed are programmed when the data is flushed. Pages are always
+// programmed from their start so that the chip never wraps around a page.
+//
+// FLASH chips can only clear bits when a page is programmed. A page that needs
+// to set any bit requires the whole sector to be erased first, so the copy in
+// RAM always covers full sectors, and all the pages of the sector can be
+// programmed again after the erase.
+
+#define CARD_SAVE_FLASH_PAGE_SIZE       256
+#define CARD_SAVE_FLASH_SECTOR_SIZE     0x10000
+
+static struct {
+    uint8_t *data;
+    uint32_t *dirty; // Bitmap of pages that may be different from the chip
+    uint32_t size;
+    uint32_t page_size;
+    int type;
+    card_save_stats_t stats;
+} card_save;
+
+static bool card_save_page_is_dirty(uint32_t page)
+{
+    return card_save.dirty[page / 32] & BIT(page % 32);
+}
+
+static void card_save_page_set_dirty(uint32_t page)
+{
+    card_save.dirty[page / 32] |= BIT(page % 32);
+}
+
+static void card_save_page_clear_dirty(uint32_t page)
+{
+    card_save.dirty[page / 32] &= ~BIT(page % 32);
+}
+
+static uint32_t card_save_num_pages(void)
+{
+    // The size is always a multiple of the page size
+    return card_save.size / card_save.page_size;
+}
+
+void cardSaveExit(void)
+{
+    free(card_save.data);
+    card_save.data = NULL;
+    free(card_save.dirty);
+    card_save.dirty = NULL;
+    card_save.size = 0;
+}
+
+int cardSaveInit(uint32_t size)
+{
+    cardSaveExit();
+
+    int type = cardEepromGetType();
+    if (type < 1)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    uint32_t chip_size = cardEepromGetSize();
+
+    if (size == 0)
+        size = chip_size;
+
+    uint32_t page_size;
+
+    if (type == 1)
+    {
+        page_size = 16;
+    }
+    else if (type == 2)
+    {
+        page_size = 32;
+    }
+    else
+    {
+        page_size = CARD_SAVE_FLASH_PAGE_SIZE;
+
+        // Sectors that are erased must be written again from RAM
+        size = (size + CARD_SAVE_FLASH_SECTOR_SIZE - 1)
+             & ~(CARD_SAVE_FLASH_SECTOR_SIZE - 1);
+    }
+
+    // Pages are always programmed in full, so the copy in RAM must cover all
+    // the pages that can be modified.
+    size = (size + page_size - 1) & ~(page_size - 1);
+
+    if (size > chip_size)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    uint32_t num_pages = size / page_size;
+
+    card_save.data = malloc(size);
+    card_save.dirty = calloc((num_pages + 31) / 32, sizeof(uint32_t));
+    if ((card_save.data == NULL) || (card_save.dirty == NULL))
+    {
+        cardSaveExit();
+        errno = ENOMEM;
+        return -1;
+    }
+
+    card_save.size = size;
+    card_save.page_size = page_size;
+    card_save.type = type;
+
+    cardReadEeprom(0, card_save.data, size, type);
+
+    return 0;
+}
+
+int cardSaveRead(uint32_t offset, void *data, uint32_t length)
+{
+    if (card_save.data == NULL)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    if ((offset > card_save.size) || (length > card_save.size - offset))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(data, card_save.data + offset, length);
+
+    return 0;
+}
+
+int cardSaveWrite(uint32_t offset, const void *data, uint32_t length)
+{
+    if (card_save.data == NULL)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    if ((offset > card_save.size) || (length > card_save.size - offset))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const uint8_t *src = data;
+
+    while (length > 0)
+    {
+        uint32_t page = offset / card_save.page_size;
+        uint32_t page_end = (page + 1) * card_save.page_size;
+
+        uint32_t chunk = page_end - offset;
+        if (chunk > length)
+            chunk = length;
+
+        // Only mark the page as dirty if the data has really changed
+        if (memcmp(card_save.data + offset, src, chunk) != 0)
+        {
+            memcpy(card_save.data + offset, src, chunk);
+            card_save_page_set_dirty(page);
+        }
+
+        offset += chunk;
+        src += chunk;
+        length -= chunk;
+    }
+
+    return 0;
+}
+
+// Checks that a page of the chip matches the copy in RAM
+static bool card_save_page_verify(uint32_t page)
+{
+    uint32_t address = page * card_save.page_size;
+
+    uint8_t buffer[CARD_SAVE_FLASH_PAGE_SIZE];
+    cardReadEeprom(address, buffer, card_save.page_size, card_save.type);
+
+    return memcmp(buffer, card_save.data + address, card_save.page_size) == 0;
+}
+
+// Programs a page and reads it back. If it doesn't match, the page stays dirty
+// and false is returned.
+static bool card_save_program_page(uint32_t page)
+{
+    uint32_t address = page * card_save.page_size;
+
+    cardWriteEeprom(address, card_save.data + address, card_save.page_size,
+                    card_save.type);
+
+    card_save.stats.pages_programmed++;
+    card_save.stats.bytes_programmed += card_save.page_size;
+
+    if (!card_save_page_verify(page))
+    {
+        card_save.stats.pages_failed++;
+        return false;
+    }
+
+    card_save_page_clear_dirty(page);
+    return true;
+}
+
+static bool card_save_flush_eeprom(void)
+{
+    uint32_t num_pages = card_save_num_pages();
+    bool ok = true;
+
+    for (uint32_t page = 0; page < num_pages; page++)
+    {
+        if (!card_save_page_is_dirty(page))
+            continue;
+
+        if (!card_save_program_page(page))
+            ok = false;
+    }
+
+    return ok;
+}
+
+static bool card_save_page_is_erased(uint32_t page)
+{
+    const uint8_t *src = card_save.data + page * card_save.page_size;
+
+    for (uint32_t i = 0; i < card_save.page_size; i++)
+    {
+        if (src[i] != 0xFF)
+            return false;
+    }
+
+    return true;
+}
+
+static bool card_save_flush_flash_sector(uint32_t sector)
+{
+    const uint32_t pages_per_sector = CARD_SAVE_FLASH_SECTOR_SIZE / CARD_SAVE_FLASH_PAGE_SIZE;
+
+    uint32_t first_page = sector * pages_per_sector;
+    uint32_t end_page = first_page + pages_per_sector;
+
+    // Check if the dirty pages can be programmed without an erase, which is
+    // only possible if no bit needs to go from 0 to 1.
+    bool needs_erase = false;
+
+    for (uint32_t page = first_page; page < end_page; page++)
+    {
+        if (!card_save_page_is_dirty(page))
+            continue;
+
+        uint32_t address = page * CARD_SAVE_FLASH_PAGE_SIZE;
+        const uint8_t *src = card_save.data + address;
+
+        uint8_t old[CARD_SAVE_FLASH_PAGE_SIZE];
+        cardReadEeprom(address, old, sizeof(old), card_save.type);
+
+        if (memcmp(old, src, sizeof(old)) == 0)
+        {
+            card_save.stats.pages_unchanged++;
+            card_save_page_clear_dirty(page);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < sizeof(old); i++)
+        {
+            if ((old[i] & src[i]) != src[i])
+            {
+                needs_erase = true;
+                break;
+            }
+        }
+
+        if (needs_erase)
+            break;
+    }
+
+    bool ok = true;
+
+    if (needs_erase)
+    {
+        cardEepromSectorErase(sector * CARD_SAVE_FLASH_SECTOR_SIZE);
+        card_save.stats.sectors_erased++;
+
+        // All pages of the sector are 0xFF now. Pages that are meant to be
+        // 0xFF don't need to be programmed, but they are still checked. Pages
+        // that fail are marked as dirty so that the sector is erased again in
+        // the next flush.
+        for (uint32_t page = first_page; page < end_page; page++)
+        {
+            card_save_page_set_dirty(page);
+
+            if (card_save_page_is_erased(page))
+            {
+                if (card_save_page_verify(page))
+                {
+                    card_save_page_clear_dirty(page);
+                    continue;
+                }
+
+                card_save.stats.pages_failed++;
+                ok = false;
+                continue;
+            }
+
+            if (!card_save_program_page(page))
+                ok = false;
+        }
+    }
+    else
+    {
+        for (uint32_t page = first_page; page < end_page; page++)
+        {
+            if (!card_save_page_is_dirty(page))
+                continue;
+
+            if (!card_save_program_page(page))
+                ok = false;
+        }
+    }
+
+    return ok;
+}
+
+int cardSaveFlush(void)
+{
+    if (card_save.data == NULL)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+
+    bool ok = true;
+
+    if (card_save.type == 3)
+    {
+        uint32_t num_sectors = card_save.size / CARD_SAVE_FLASH_SECTOR_SIZE;
+
+        for (uint32_t sector = 0; sector < num_sectors; sector++)
+        {
+            if (!card_save_flush_flash_sector(sector))
+                ok = false;
+        }
+    }
+    else
+    {
+        ok = card_save_flush_eeprom();
+    }
+
+    if (!ok)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+void cardSaveGetStats(card_save_stats_t *stats)
+{
+    if (stats != NULL)
+        *stats = card_save.stats;
+}
+
+void cardSaveResetStats(void)
+{
+    memset(&card_save.stats, 0, sizeof(card_save.stats));
+}
@@ -114,6 +114,21 @@ void irqSet(u32 mask, VoidFn handler)
     leaveCriticalSection(oldIME);
 }
 
+VoidFn irqSetGetPrevious(u32 irq, VoidFn handler)
+{
+    if (irq == 0)
+        return NULL;
+
+    int oldIME = enterCriticalSection();
+
+    VoidFn previous = irqTable[__builtin_clz(irq) ^ 0x1F];
+    irqSet(irq, handler);
+
+    leaveCriticalSection(oldIME);
+
+    return previous;
+}
+
 void irqInitHandler(VoidFn handler)
 {
     REG_IME = 0;
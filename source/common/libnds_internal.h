@@ -114,4 +114,9 @@ void __libnds_exit(int rc);
 int nocash_putc_buffered(char c, FILE *file);
 ssize_t nocash_write(const char *ptr, size_t len);
 
+// Like irqSet(), but it returns the handler that was set before. "irq" must
+// contain a single interrupt. This lets the library install a handler
+// temporarily and call the one of the user from it.
+VoidFn irqSetGetPrevious(u32 irq, VoidFn handler);
+
 #endif // COMMON_LIBNDS_INTERNAL_H__
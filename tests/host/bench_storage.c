@@ -0,0 +1,643 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Storage benchmark. It runs a set of workloads on a FAT volume in a simulated
+// device, and it reports the throughput in virtual time, the number of device
+// commands and the hit rate of the sector cache.
+//
+// The workloads use the open(), read(), write() and lseek() of filesystem.c,
+// and opendir() and readdir() of dirent.c, so every access goes through FatFs,
+// diskio.c and cache.c like on the DS. Real accesses can be replayed from a
+// trace saved with fatSaveIoTrace() on hardware.
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat.h>
+
+// Rename the DIR of "ff.h" like dirent.c does, it's different from the one of
+// "dirent.h".
+#define DIR DIRff
+#include "ff.h"
+#include "diskio.h"
+#include "cache.h"
+#include "fat_volume.h"
+#undef DIR
+
+#include <dirent.h>
+
+#include "disc_sim.h"
+#include "host.h"
+#include "nds_syscalls.h"
+
+#define SECTOR_SIZE     512
+#define BUFFER_SECTORS  256
+
+typedef struct {
+    uint8_t pdrv;
+    uint32_t num_sectors;
+    FATFS fs;
+    BYTE fmt; // Format of the volume (FM_*)
+    DWORD cluster_size; // Requested cluster size, or 0
+    uint8_t *buffer; // Word-aligned buffer in main RAM
+    uint64_t bytes; // Bytes read or written by the workload
+    uint32_t errors;
+    uint32_t random_state;
+} bench_t;
+
+static uint32_t bench_random(bench_t *b)
+{
+    // xorshift32
+    uint32_t x = b->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    b->random_state = x;
+    return x;
+}
+
+static int bench_open(bench_t *b, const char *path, int flags)
+{
+    int fd = nds_open(path, flags, 0644);
+    if (fd == -1)
+        b->errors++;
+    return fd;
+}
+
+static void bench_close(bench_t *b, int fd)
+{
+    if ((fd != -1) && (nds_close(fd) != 0))
+        b->errors++;
+}
+
+static void bench_read(bench_t *b, int fd, size_t size)
+{
+    if (nds_read(fd, b->buffer, size) != (ssize_t)size)
+        b->errors++;
+
+    b->bytes += size;
+}
+
+static void bench_write(bench_t *b, int fd, size_t size)
+{
+    if (nds_write(fd, b->buffer, size) != (ssize_t)size)
+        b->errors++;
+
+    b->bytes += size;
+}
+
+static void bench_seek(bench_t *b, int fd, off_t offset)
+{
+    if (nds_lseek(fd, offset, SEEK_SET) != offset)
+        b->errors++;
+}
+
+// Workloads
+// ---------
+
+#define SEQ_SIZE            (8 * 1024 * 1024)
+#define SEQ_REQUEST_SIZE    (32 * 1024) // Size of the reads done by the application
+#define SEQ_FILE            "seq.bin"
+
+static void write_seq_file(bench_t *b)
+{
+    int fd = bench_open(b, SEQ_FILE, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd == -1)
+        return;
+
+    for (uint32_t i = 0; i < SEQ_SIZE; i += SEQ_REQUEST_SIZE)
+        bench_write(b, fd, SEQ_REQUEST_SIZE);
+
+    bench_close(b, fd);
+}
+
+static void workload_seq_read(bench_t *b)
+{
+    int fd = bench_open(b, SEQ_FILE, O_RDONLY);
+    if (fd == -1)
+        return;
+
+    for (uint32_t i = 0; i < SEQ_SIZE; i += SEQ_REQUEST_SIZE)
+        bench_read(b, fd, SEQ_REQUEST_SIZE);
+
+    bench_close(b, fd);
+}
+
+static void workload_seq_write(bench_t *b)
+{
+    write_seq_file(b);
+}
+
+#define RANDOM_OPS          2048
+#define RANDOM_SIZE         4096
+
+static void workload_random_read(bench_t *b)
+{
+    int fd = bench_open(b, SEQ_FILE, O_RDONLY);
+    if (fd == -1)
+        return;
+
+    for (uint32_t i = 0; i < RANDOM_OPS; i++)
+    {
+        bench_seek(b, fd, (off_t)(bench_random(b) % (SEQ_SIZE / RANDOM_SIZE)) * RANDOM_SIZE);
+        bench_read(b, fd, RANDOM_SIZE);
+    }
+
+    bench_close(b, fd);
+}
+
+static void workload_random_write(bench_t *b)
+{
+    int fd = bench_open(b, SEQ_FILE, O_RDWR);
+    if (fd == -1)
+        return;
+
+    for (uint32_t i = 0; i < RANDOM_OPS; i++)
+    {
+        bench_seek(b, fd, (off_t)(bench_random(b) % (SEQ_SIZE / RANDOM_SIZE)) * RANDOM_SIZE);
+        bench_write(b, fd, RANDOM_SIZE);
+    }
+
+    bench_close(b, fd);
+}
+
+#define SEEK_OPS            256
+
+// Without a look-up cache, FatFs follows the cluster chain from the start of
+// the file on every backwards seek.
+static void workload_seek(bench_t *b)
+{
+    int fd = bench_open(b, SEQ_FILE, O_RDONLY);
+    if (fd == -1)
+        return;
+
+    for (uint32_t i = 0; i < SEEK_OPS; i++)
+    {
+        bench_seek(b, fd, bench_random(b) % SEQ_SIZE);
+        bench_read(b, fd, 1);
+    }
+
+    bench_close(b, fd);
+}
+
+#define SMALL_FILES         256
+#define SMALL_FILE_SIZE     2048
+
+static void prepare_small_files(bench_t *b)
+{
+    if (nds_mkdir("small", 0755) != 0)
+        b->errors++;
+}
+
+// Files with long names that are created, written and closed one at a time,
+// like the files of a save directory.
+static void workload_small_files(bench_t *b)
+{
+    for (uint32_t i = 0; i < SMALL_FILES; i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "small/save_slot_%04" PRIu32 ".dat", i);
+
+        int fd = bench_open(b, path, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd == -1)
+            continue;
+
+        bench_write(b, fd, SMALL_FILE_SIZE);
+        bench_close(b, fd);
+    }
+}
+
+#define DIR_SCAN_ENTRIES    2000
+#define DIR_SCAN_PASSES     3
+
+static void prepare_dir_scan(bench_t *b)
+{
+    if (nds_mkdir("scan", 0755) != 0)
+        b->errors++;
+
+    for (uint32_t i = 0; i < DIR_SCAN_ENTRIES; i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "scan/entry_%04" PRIu32 ".txt", i);
+
+        bench_close(b, bench_open(b, path, O_WRONLY | O_CREAT));
+    }
+}
+
+// Directory with long names that is listed several times, like a file browser
+// that refreshes the list. It doesn't transfer any data.
+static void workload_dir_scan(bench_t *b)
+{
+    for (uint32_t pass = 0; pass < DIR_SCAN_PASSES; pass++)
+    {
+        DIR *dirp = opendir("scan");
+        if (dirp == NULL)
+        {
+            b->errors++;
+            return;
+        }
+
+        uint32_t count = 0;
+        while (readdir(dirp) != NULL)
+            count++;
+
+        // Including "." and ".."
+        if (count != DIR_SCAN_ENTRIES + 2)
+            b->errors++;
+
+        closedir(dirp);
+    }
+}
+
+// Replays the reads and writes requested by the filesystem in a trace saved by
+// fatSaveIoTrace(). Commands sent to the device are ignored, they depend on the
+// cache configuration. The requests are sent to diskio.c directly, without
+// going through FatFs.
+static const char *trace_path = NULL;
+
+static void replay_read(bench_t *b, uint32_t sector, uint32_t count, bool cacheable)
+{
+    // FatFs marks window reads (FAT and directory sectors) as cacheable
+    uint8_t pdrv = b->pdrv | (cacheable ? 0x80 : 0);
+
+    if (disk_read(pdrv, b->buffer, sector, count) != RES_OK)
+        b->errors++;
+
+    b->bytes += count * SECTOR_SIZE;
+}
+
+static void replay_write(bench_t *b, uint32_t sector, uint32_t count)
+{
+    if (disk_write(b->pdrv, b->buffer, sector, count) != RES_OK)
+        b->errors++;
+
+    b->bytes += count * SECTOR_SIZE;
+}
+
+static void workload_trace(bench_t *b)
+{
+    FILE *f = fopen(trace_path, "r");
+    if (f == NULL)
+    {
+        printf("Can't open trace: %s\n", trace_path);
+        b->errors++;
+        return;
+    }
+
+    char line[256];
+    uint32_t skipped = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        uint32_t time, drive, op, sector, count, ticks;
+
+        if (sscanf(line, "%" SCNu32 ",%" SCNu32 ",%" SCNu32 ",%" SCNu32 ",%" SCNu32 ",%" SCNu32,
+                   &time, &drive, &op, &sector, &count, &ticks) != 6)
+            continue; // Header
+
+        if ((drive != b->pdrv) || (sector + count > b->num_sectors))
+        {
+            skipped++;
+            continue;
+        }
+
+        // Split requests that don't fit in the buffer
+        while (count > 0)
+        {
+            uint32_t n = count < BUFFER_SECTORS ? count : BUFFER_SECTORS;
+
+            if (op == FAT_IO_OP_READ)
+                replay_read(b, sector, n, false);
+            else if (op == FAT_IO_OP_READ_CACHED)
+                replay_read(b, sector, n, true);
+            else if (op == FAT_IO_OP_WRITE)
+                replay_write(b, sector, n);
+
+            sector += n;
+            count -= n;
+        }
+    }
+
+    fclose(f);
+
+    if (disk_ioctl(b->pdrv, CTRL_SYNC, NULL) != RES_OK)
+        b->errors++;
+
+    if (skipped > 0)
+        printf("  (%" PRIu32 " trace entries of other drives or outside of the device skipped)\n", skipped);
+}
+
+typedef struct {
+    const char *name;
+    void (*prepare)(bench_t *b); // Runs before the measurement, or NULL
+    void (*fn)(bench_t *b);
+} workload_t;
+
+static const workload_t workloads[] = {
+    { "seq_read", write_seq_file, workload_seq_read },
+    { "seq_write", NULL, workload_seq_write },
+    { "random_4k_read", write_seq_file, workload_random_read },
+    { "random_4k_write", write_seq_file, workload_random_write },
+    { "seek", write_seq_file, workload_seek },
+    { "small_files", prepare_small_files, workload_small_files },
+    { "dir_scan", prepare_dir_scan, workload_dir_scan },
+};
+
+// Benchmark driver
+// ----------------
+
+#define MAX_CACHE_SIZES 16
+#define TRACE_ENTRIES   (1024 * 1024)
+
+typedef struct {
+    const disc_model_t *model;
+    const char *image;
+    uint32_t size_mb;
+    int32_t cache_sizes[MAX_CACHE_SIZES]; // Sectors of the cache
+    uint32_t num_cache_sizes;
+    uint32_t cluster_size;
+    bool writeback;
+    uint32_t bounce_buffers;
+    uint32_t bounce_sectors;
+    const char *only;
+    const char *save_trace;
+} bench_config_t;
+
+static void bench_print_header(void)
+{
+    printf("%-16s %6s %9s %10s %8s %8s %9s %9s %6s %9s\n",
+           "workload", "cache", "MiB/s", "ms", "dev_rd", "dev_wr", "sect_rd", "sect_wr",
+           "hit%", "host_ms");
+}
+
+static int bench_run(bench_t *b, const workload_t *w,
+                     const bench_config_t *config, int32_t cache_sectors)
+{
+    // Start every run with an empty cache
+    if (cache_init(cache_sectors) != 0)
+    {
+        printf("Can't allocate the cache\n");
+        return -1;
+    }
+    cache_set_writeback(config->writeback);
+
+    // Start every run with an empty volume too. Formatting the volume and
+    // preparing the files used by the workload isn't measured.
+    if (fat_volume_format(&b->fs, b->pdrv, FM_ANY, config->cluster_size) != FR_OK)
+    {
+        printf("Can't format the volume\n");
+        return -1;
+    }
+
+    b->errors = 0;
+    b->random_state = 0x12345678;
+
+    if (w->prepare != NULL)
+        w->prepare(b);
+
+    // Only the last run is kept in the trace
+    if (config->save_trace != NULL)
+    {
+        if (disk_io_trace_start(TRACE_ENTRIES) != 0)
+        {
+            printf("Can't allocate the trace\n");
+            return -1;
+        }
+    }
+
+    cache_reset_stats();
+    disk_reset_io_stats();
+
+    b->bytes = 0;
+
+    uint64_t start = host_clock_ticks();
+    uint64_t start_ns = host_wall_ns();
+
+    w->fn(b);
+
+    uint64_t ticks = host_clock_ticks() - start;
+    uint64_t ns = host_wall_ns() - start_ns;
+
+    fat_io_stats_t io;
+    disk_get_io_stats(b->pdrv, &io);
+    fat_cache_stats_t cache;
+    cache_get_stats(&cache);
+
+    double ms = host_ticks_to_ms(ticks);
+    double mib_s = ms > 0 ? (b->bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0;
+    uint32_t lookups = cache.hits + cache.misses;
+    double hit = lookups > 0 ? (100.0 * cache.hits) / lookups : 0;
+
+    // Workloads that don't transfer data have no throughput
+    char mib_s_str[16] = "-";
+    if (b->bytes > 0)
+        snprintf(mib_s_str, sizeof(mib_s_str), "%.2f", mib_s);
+
+    printf("%-16s %6" PRId32 " %9s %10.1f %8" PRIu32 " %8" PRIu32 " %9" PRIu32 " %9" PRIu32
+           " %6.1f %9.2f\n",
+           w->name, cache_sectors, mib_s_str, ms, io.device_reads, io.device_writes,
+           io.sectors_read, io.sectors_written, hit, ns / 1000000.0);
+
+    if (b->errors > 0)
+    {
+        printf("  %" PRIu32 " errors\n", b->errors);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void usage(void)
+{
+    printf("Usage: bench_storage [options]\n"
+           "\n"
+           "  -d dldi|sd|nand   Device model (default: dldi)\n"
+           "  -i path           Disk image (default: RAM)\n"
+           "  -s size           Size of the device in MiB (default: 128)\n"
+           "  -a bytes          Size of the clusters (default: chosen by FatFs)\n"
+           "  -c sectors,...    Sectors in the cache (default: 64). If more than\n"
+           "                    one size is specified, all workloads are run\n"
+           "                    with each size.\n"
+           "  -w                Enable write-back mode in the cache\n"
+           "  -b num,sectors    Bounce buffers (default: 1,8)\n"
+           "  -t trace.csv      Replay a trace saved with fatSaveIoTrace()\n"
+           "  -T trace.csv      Save a trace of the last workload that is run\n"
+           "  -W name           Only run the specified workload\n");
+}
+
+int main(int argc, char *argv[])
+{
+    // File descriptors of filesystem.c contain pointers
+    host_use_low_heap(argv);
+
+    bench_config_t config = {
+        .model = &disc_model_dldi,
+        .size_mb = 128,
+        .cache_sizes = { 64 },
+        .num_cache_sizes = 1,
+        .bounce_buffers = 1,
+        .bounce_sectors = 8,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:i:s:a:c:wb:t:T:W:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                config.model = disc_model_find(optarg);
+                if (config.model == NULL)
+                {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'i':
+                config.image = optarg;
+                break;
+            case 's':
+                config.size_mb = strtoul(optarg, NULL, 0);
+                break;
+            case 'a':
+                config.cluster_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+            {
+                char *str = optarg;
+
+                config.num_cache_sizes = 0;
+                while (config.num_cache_sizes < MAX_CACHE_SIZES)
+                {
+                    char *end;
+                    config.cache_sizes[config.num_cache_sizes++] = strtol(str, &end, 0);
+                    if (*end != ',')
+                        break;
+                    str = end + 1;
+                }
+                break;
+            }
+            case 'w':
+                config.writeback = true;
+                break;
+            case 'b':
+                if (sscanf(optarg, "%" SCNu32 ",%" SCNu32,
+                           &config.bounce_buffers, &config.bounce_sectors) != 2)
+                {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'T':
+                config.save_trace = optarg;
+                break;
+            case 'W':
+                config.only = optarg;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    fat_io_drive_t drive = FAT_IO_DRIVE_DLDI;
+    if (config.model == &disc_model_sd)
+        drive = FAT_IO_DRIVE_SD;
+    else if (config.model == &disc_model_nand)
+        drive = FAT_IO_DRIVE_NAND;
+
+    bench_t b = { 0 };
+
+    b.pdrv = drive;
+    b.num_sectors = config.size_mb * (1024 * 1024 / SECTOR_SIZE);
+
+    // The sequential file and the metadata of the other workloads
+    if ((uint64_t)b.num_sectors * SECTOR_SIZE < 2 * SEQ_SIZE)
+    {
+        printf("The device is too small\n");
+        return 1;
+    }
+
+    if (disc_sim_attach(drive, config.model, config.image, b.num_sectors) != 0)
+    {
+        printf("Can't create the device\n");
+        return 1;
+    }
+
+    if (cache_bounce_init(config.bounce_buffers, config.bounce_sectors) != 0)
+    {
+        printf("Invalid bounce buffer configuration\n");
+        return 1;
+    }
+
+    b.buffer = aligned_alloc(32, BUFFER_SECTORS * SECTOR_SIZE);
+    if (b.buffer == NULL)
+        return 1;
+
+    memset(b.buffer, 0xA5, BUFFER_SECTORS * SECTOR_SIZE);
+
+    printf("Device: %s (%" PRIu32 " MiB), cache: %s, "
+           "bounce buffers: %" PRIu32 " x %" PRIu32 " sectors\n\n",
+           config.model->name, config.size_mb,
+           config.writeback ? "write-back" : "write-through",
+           config.bounce_buffers, config.bounce_sectors);
+
+    bench_print_header();
+
+    int ret = 0;
+
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        const workload_t *w = &workloads[i];
+
+        if ((config.only != NULL) && (strcmp(config.only, w->name) != 0))
+            continue;
+
+        for (uint32_t c = 0; c < config.num_cache_sizes; c++)
+        {
+            if (bench_run(&b, w, &config, config.cache_sizes[c]) != 0)
+                ret = 1;
+        }
+    }
+
+    if (trace_path != NULL)
+    {
+        const workload_t w = { "trace", NULL, workload_trace };
+
+        for (uint32_t c = 0; c < config.num_cache_sizes; c++)
+        {
+            if (bench_run(&b, &w, &config, config.cache_sizes[c]) != 0)
+                ret = 1;
+        }
+    }
+
+    if (config.save_trace != NULL)
+    {
+        FILE *f = fopen(config.save_trace, "w");
+        if ((f == NULL) || (disk_io_trace_save(f) != 0))
+        {
+            printf("Can't save the trace\n");
+            ret = 1;
+        }
+        if (f != NULL)
+            fclose(f);
+
+        disk_io_trace_stop();
+    }
+
+    fat_volume_unmount(drive);
+    cache_deinit();
+    free(b.buffer);
+    disc_sim_detach(drive);
+
+    return ret;
+}
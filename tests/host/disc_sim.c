@@ -0,0 +1,402 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fat.h>
+#include <nds/arm9/dldi.h>
+#include <nds/arm9/sdmmc.h>
+#include <nds/disc_io.h>
+#include <nds/system.h>
+#include <nds/timers.h>
+
+#include "fatfs_internal.h"
+
+#include "disc_sim.h"
+#include "host.h"
+
+#define SECTOR_SIZE 512
+
+const disc_model_t disc_model_dldi = {
+    .name = "dldi",
+    .command_us = 250,
+    .read_kib_s = 3 * 1024,
+    .write_kib_s = 1536,
+    .aligned_main_ram_only = true,
+};
+
+const disc_model_t disc_model_sd = {
+    .name = "sd",
+    .command_us = 120,
+    .read_kib_s = 8 * 1024,
+    .write_kib_s = 4 * 1024,
+    .aligned_main_ram_only = false,
+};
+
+const disc_model_t disc_model_nand = {
+    .name = "nand",
+    .command_us = 150,
+    .read_kib_s = 4 * 1024,
+    .write_kib_s = 2 * 1024,
+    .aligned_main_ram_only = true,
+};
+
+const disc_model_t *disc_model_find(const char *name)
+{
+    const disc_model_t *models[] = {
+        &disc_model_dldi, &disc_model_sd, &disc_model_nand
+    };
+
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+    {
+        if (strcmp(models[i]->name, name) == 0)
+            return models[i];
+    }
+
+    return NULL;
+}
+
+typedef struct {
+    const disc_model_t *model;
+    uint32_t num_sectors;
+    uint8_t *data; // Data in RAM, or NULL if it's in a file
+    int fd; // Disk image, or -1 if the data is in RAM
+    bool fail_writes;
+    disc_sim_stats_t stats;
+} disc_sim_t;
+
+#define DISC_SIM_DRIVES 3 // DLDI, SD and NAND
+
+static disc_sim_t disc_sim[DISC_SIM_DRIVES] = {
+    { .fd = -1 }, { .fd = -1 }, { .fd = -1 }
+};
+
+static disc_sim_t *disc_sim_get(fat_io_drive_t drive)
+{
+    if ((unsigned int)drive >= DISC_SIM_DRIVES)
+        return NULL;
+
+    disc_sim_t *sim = &disc_sim[drive];
+    if (sim->model == NULL)
+        return NULL;
+
+    return sim;
+}
+
+int disc_sim_attach(fat_io_drive_t drive, const disc_model_t *model,
+                    const char *path, uint32_t num_sectors)
+{
+    if (((unsigned int)drive >= DISC_SIM_DRIVES) || (model == NULL))
+        return -1;
+
+    if ((path == NULL) && (num_sectors == 0))
+        return -1;
+
+    disc_sim_detach(drive);
+
+    disc_sim_t *sim = &disc_sim[drive];
+
+    if (path == NULL)
+    {
+        sim->data = calloc(num_sectors, SECTOR_SIZE);
+        if (sim->data == NULL)
+            return -1;
+    }
+    else
+    {
+        sim->fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (sim->fd < 0)
+            return -1;
+
+        struct stat st;
+        if (fstat(sim->fd, &st) != 0)
+            goto error;
+
+        off_t size = (off_t)num_sectors * SECTOR_SIZE;
+
+        if (num_sectors == 0)
+            num_sectors = st.st_size / SECTOR_SIZE;
+        else if (st.st_size < size)
+        {
+            if (ftruncate(sim->fd, size) != 0)
+                goto error;
+        }
+
+        if (num_sectors == 0)
+            goto error;
+    }
+
+    sim->model = model;
+    sim->num_sectors = num_sectors;
+    sim->fail_writes = false;
+    memset(&sim->stats, 0, sizeof(sim->stats));
+
+    return 0;
+
+error:
+    close(sim->fd);
+    sim->fd = -1;
+    return -1;
+}
+
+void disc_sim_detach(fat_io_drive_t drive)
+{
+    if ((unsigned int)drive >= DISC_SIM_DRIVES)
+        return;
+
+    disc_sim_t *sim = &disc_sim[drive];
+
+    free(sim->data);
+    sim->data = NULL;
+
+    if (sim->fd >= 0)
+        close(sim->fd);
+    sim->fd = -1;
+
+    sim->model = NULL;
+}
+
+int disc_sim_move(fat_io_drive_t from, fat_io_drive_t to)
+{
+    disc_sim_t *sim = disc_sim_get(from);
+    if ((sim == NULL) || ((unsigned int)to >= DISC_SIM_DRIVES) || (from == to))
+        return -1;
+
+    disc_sim_detach(to);
+
+    disc_sim[to] = *sim;
+    memset(sim, 0, sizeof(disc_sim_t));
+    sim->fd = -1;
+
+    return 0;
+}
+
+void disc_sim_set_model(fat_io_drive_t drive, const disc_model_t *model)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if ((sim != NULL) && (model != NULL))
+        sim->model = model;
+}
+
+void disc_sim_fail_writes(fat_io_drive_t drive, bool fail)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if (sim != NULL)
+        sim->fail_writes = fail;
+}
+
+void disc_sim_get_stats(fat_io_drive_t drive, disc_sim_stats_t *stats)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if (sim != NULL)
+        *stats = sim->stats;
+    else
+        memset(stats, 0, sizeof(disc_sim_stats_t));
+}
+
+void disc_sim_reset_stats(fat_io_drive_t drive)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if (sim != NULL)
+        memset(&sim->stats, 0, sizeof(sim->stats));
+}
+
+bool disc_sim_peek(fat_io_drive_t drive, uint32_t sector, uint32_t count,
+                   void *buffer)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if ((sim == NULL) || (sector + count > sim->num_sectors) || (sector + count < sector))
+        return false;
+
+    size_t size = (size_t)count * SECTOR_SIZE;
+    off_t offset = (off_t)sector * SECTOR_SIZE;
+
+    if (sim->data != NULL)
+    {
+        memcpy(buffer, sim->data + offset, size);
+        return true;
+    }
+
+    return pread(sim->fd, buffer, size, offset) == (ssize_t)size;
+}
+
+bool disc_sim_poke(fat_io_drive_t drive, uint32_t sector, uint32_t count,
+                   const void *buffer)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if ((sim == NULL) || (sector + count > sim->num_sectors) || (sector + count < sector))
+        return false;
+
+    size_t size = (size_t)count * SECTOR_SIZE;
+    off_t offset = (off_t)sector * SECTOR_SIZE;
+
+    if (sim->data != NULL)
+    {
+        memcpy(sim->data + offset, buffer, size);
+        return true;
+    }
+
+    return pwrite(sim->fd, buffer, size, offset) == (ssize_t)size;
+}
+
+// Advance the virtual clock by the time that a command would take
+static void disc_sim_spend(disc_sim_t *sim, uint32_t count, uint32_t kib_s)
+{
+    uint64_t ticks = host_us_to_ticks(sim->model->command_us);
+    ticks += ((uint64_t)count * SECTOR_SIZE * BUS_CLOCK) / ((uint64_t)kib_s * 1024);
+
+    sim->stats.busy_ticks += ticks;
+    host_clock_advance(ticks);
+}
+
+static void disc_sim_check_buffer(disc_sim_t *sim, const void *buffer,
+                                  uint32_t count)
+{
+    if (!sim->model->aligned_main_ram_only)
+        return;
+
+    if ((((uintptr_t)buffer) & 3) || !memBufferIsInMainRam(buffer, count * SECTOR_SIZE))
+        sim->stats.bad_buffers++;
+}
+
+static bool disc_sim_read(fat_io_drive_t drive, sec_t sector, sec_t count,
+                          void *buffer)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if (sim == NULL)
+        return false;
+
+    sim->stats.reads++;
+    sim->stats.sectors_read += count;
+    disc_sim_check_buffer(sim, buffer, count);
+    disc_sim_spend(sim, count, sim->model->read_kib_s);
+
+    return disc_sim_peek(drive, sector, count, buffer);
+}
+
+static bool disc_sim_write(fat_io_drive_t drive, sec_t sector, sec_t count,
+                           const void *buffer)
+{
+    disc_sim_t *sim = disc_sim_get(drive);
+    if (sim == NULL)
+        return false;
+
+    sim->stats.writes++;
+    sim->stats.sectors_written += count;
+    disc_sim_check_buffer(sim, buffer, count);
+    disc_sim_spend(sim, count, sim->model->write_kib_s);
+
+    if (sim->fail_writes)
+        return false;
+
+    return disc_sim_poke(drive, sector, count, buffer);
+}
+
+static bool disc_sim_true(void)
+{
+    return true;
+}
+
+#define DISC_SIM_INTERFACE(drive, type)                                         \
+    static bool disc_sim_read_##type(sec_t sector, sec_t count, void *buffer)   \
+    {                                                                           \
+        return disc_sim_read(drive, sector, count, buffer);                     \
+    }                                                                           \
+    static bool disc_sim_write_##type(sec_t sector, sec_t count,                \
+                                      const void *buffer)                       \
+    {                                                                           \
+        return disc_sim_write(drive, sector, count, buffer);                    \
+    }                                                                           \
+    static const DISC_INTERFACE disc_sim_io_##type = {                          \
+        .ioType = 0x4D495348, /* "HSIM" */                                      \
+        .features = FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE,           \
+        .startup = disc_sim_true,                                               \
+        .isInserted = disc_sim_true,                                            \
+        .readSectors = disc_sim_read_##type,                                    \
+        .writeSectors = disc_sim_write_##type,                                  \
+        .clearStatus = disc_sim_true,                                           \
+        .shutdown = disc_sim_true,                                              \
+    };
+
+DISC_SIM_INTERFACE(FAT_IO_DRIVE_DLDI, dldi)
+DISC_SIM_INTERFACE(FAT_IO_DRIVE_SD, sd)
+DISC_SIM_INTERFACE(FAT_IO_DRIVE_NAND, nand)
+
+// Functions of the storage drivers used by diskio.c and cache.c
+
+const DISC_INTERFACE *dldiGetInternal(void)
+{
+    return disc_sim_get(FAT_IO_DRIVE_DLDI) ? &disc_sim_io_dldi : NULL;
+}
+
+const DISC_INTERFACE *get_io_dsisd(void)
+{
+    return disc_sim_get(FAT_IO_DRIVE_SD) ? &disc_sim_io_sd : NULL;
+}
+
+const DISC_INTERFACE *get_io_dsinand(void)
+{
+    return disc_sim_get(FAT_IO_DRIVE_NAND) ? &disc_sim_io_nand : NULL;
+}
+
+u8 sdmmc_GetDiskStatus(void)
+{
+    return 0;
+}
+
+u8 nand_GetDiskStatus(void)
+{
+    return 0;
+}
+
+void nand_WriteProtect(bool protect)
+{
+    (void)protect;
+}
+
+u32 sdmmc_GetSectors(void)
+{
+    disc_sim_t *sim = disc_sim_get(FAT_IO_DRIVE_SD);
+    return sim ? sim->num_sectors : 0;
+}
+
+u32 nand_GetSectors(void)
+{
+    disc_sim_t *sim = disc_sim_get(FAT_IO_DRIVE_NAND);
+    return sim ? sim->num_sectors : 0;
+}
+
+// There is no DLDI driver in RAM, so there is no unused space in the stub that
+// the sector cache can use. All entries are allocated with malloc().
+static uint8_t dldi_stub[1];
+
+uint8_t *dldiGetStubDataEnd(void)
+{
+    return dldi_stub;
+}
+
+uint8_t *dldiGetStubEnd(void)
+{
+    return dldi_stub;
+}
+
+// Used by get_fattime() in diskio.c. Programs that build fatfs.c use the
+// version in that file.
+__attribute__((weak))
+uint32_t fatfs_timestamp_to_fattime(struct tm *stm)
+{
+    return (uint32_t)(stm->tm_year - 80) << 25 |
+           (uint32_t)(stm->tm_mon + 1) << 21 |
+           (uint32_t)stm->tm_mday << 16 |
+           (uint32_t)stm->tm_hour << 11 |
+           (uint32_t)stm->tm_min << 5 |
+           (uint32_t)stm->tm_sec >> 1;
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Simulated storage devices. They are returned by dldiGetInternal(),
+// get_io_dsisd() and get_io_dsinand(), so diskio.c uses them like the real
+// drivers. The data is kept in RAM or in a disk image in the host filesystem.
+
+#ifndef DISC_SIM_H__
+#define DISC_SIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <fat.h>
+
+// Timing of a device. The time of a command is the fixed cost plus the time
+// needed to transfer the data at the specified bandwidth. The default models
+// are rough approximations, they aren't measurements of specific devices.
+typedef struct {
+    const char *name;
+    uint32_t command_us; // Fixed cost of each command
+    uint32_t read_kib_s; // Read bandwidth
+    uint32_t write_kib_s; // Write bandwidth
+    // If true, the driver can only use word-aligned buffers in main RAM. Other
+    // buffers are counted in "bad_buffers".
+    bool aligned_main_ram_only;
+} disc_model_t;
+
+extern const disc_model_t disc_model_dldi;
+extern const disc_model_t disc_model_sd;
+extern const disc_model_t disc_model_nand;
+
+// Returns the model with the specified name, or NULL.
+const disc_model_t *disc_model_find(const char *name);
+
+typedef struct {
+    uint32_t reads; // Read commands
+    uint32_t writes; // Write commands
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t bad_buffers; // Buffers the real driver couldn't have used
+    uint64_t busy_ticks; // Time spent executing commands
+} disc_sim_stats_t;
+
+// Attaches a simulated device to a drive (FAT_IO_DRIVE_DLDI, FAT_IO_DRIVE_SD or
+// FAT_IO_DRIVE_NAND). If "path" is NULL the data is kept in RAM. If not, it's
+// the path to a disk image that is created or extended if required. Returns 0
+// on success, -1 on error.
+int disc_sim_attach(fat_io_drive_t drive, const disc_model_t *model,
+                    const char *path, uint32_t num_sectors);
+
+// Removes the device from the drive and frees its resources.
+void disc_sim_detach(fat_io_drive_t drive);
+
+// Moves the device attached to a drive to another drive, keeping its data and
+// statistics. Any device attached to the destination is detached. Returns 0 on
+// success, -1 on error.
+int disc_sim_move(fat_io_drive_t from, fat_io_drive_t to);
+
+// Changes the timing model of an attached device.
+void disc_sim_set_model(fat_io_drive_t drive, const disc_model_t *model);
+
+// Makes all write commands fail (or work again).
+void disc_sim_fail_writes(fat_io_drive_t drive, bool fail);
+
+void disc_sim_get_stats(fat_io_drive_t drive, disc_sim_stats_t *stats);
+void disc_sim_reset_stats(fat_io_drive_t drive);
+
+// Access the data of the device directly, without going through the timing
+// model or the statistics. They return false on error.
+bool disc_sim_peek(fat_io_drive_t drive, uint32_t sector, uint32_t count,
+                   void *buffer);
+bool disc_sim_poke(fat_io_drive_t drive, uint32_t sector, uint32_t count,
+                   const void *buffer);
+
+#endif // DISC_SIM_H__
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Simulated save chip of a DS card, and host versions of the functions of
+// cardEeprom.c.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/card.h>
+
+#include "eeprom_sim.h"
+#include "host.h"
+
+#define FLASH_SECTOR_SIZE   0x10000
+
+// The SPI bus runs at 4 MHz
+#define SPI_BYTE_US         2
+
+const eeprom_model_t eeprom_model_512b = {
+    .name = "eeprom_512b",
+    .type = 1,
+    .size = 512,
+    .page_size = 16,
+    .program_us = 5000,
+};
+
+const eeprom_model_t eeprom_model_8k = {
+    .name = "eeprom_8k",
+    .type = 2,
+    .size = 8 * 1024,
+    .page_size = 32,
+    .program_us = 5000,
+};
+
+const eeprom_model_t eeprom_model_64k = {
+    .name = "eeprom_64k",
+    .type = 2,
+    .size = 64 * 1024,
+    .page_size = 128,
+    .program_us = 5000,
+};
+
+const eeprom_model_t eeprom_model_flash_256k = {
+    .name = "flash_256k",
+    .type = 3,
+    .size = 256 * 1024,
+    .page_size = 256,
+    .program_us = 1400,
+    .erase_ms = 600,
+};
+
+static const eeprom_model_t *eeprom_sim_model;
+static uint8_t *eeprom_sim_mem;
+static uint32_t *eeprom_sim_page_programs;
+static uint32_t eeprom_sim_programs_to_fail;
+static eeprom_sim_stats_t eeprom_sim_stats;
+
+void eeprom_sim_remove(void)
+{
+    free(eeprom_sim_mem);
+    eeprom_sim_mem = NULL;
+    free(eeprom_sim_page_programs);
+    eeprom_sim_page_programs = NULL;
+    eeprom_sim_model = NULL;
+}
+
+void eeprom_sim_insert(const eeprom_model_t *model, uint8_t fill)
+{
+    eeprom_sim_remove();
+
+    eeprom_sim_programs_to_fail = 0;
+    eeprom_sim_reset_stats();
+
+    if (model == NULL)
+        return;
+
+    eeprom_sim_mem = malloc(model->size);
+    eeprom_sim_page_programs = calloc(model->size / model->page_size, sizeof(uint32_t));
+    if ((eeprom_sim_mem == NULL) || (eeprom_sim_page_programs == NULL))
+    {
+        printf("eeprom_sim: out of memory\n");
+        abort();
+    }
+
+    memset(eeprom_sim_mem, fill, model->size);
+    eeprom_sim_model = model;
+}
+
+void eeprom_sim_fail_programs(uint32_t count)
+{
+    eeprom_sim_programs_to_fail = count;
+}
+
+void eeprom_sim_get_stats(eeprom_sim_stats_t *stats)
+{
+    *stats = eeprom_sim_stats;
+}
+
+void eeprom_sim_reset_stats(void)
+{
+    memset(&eeprom_sim_stats, 0, sizeof(eeprom_sim_stats));
+
+    if (eeprom_sim_model != NULL)
+    {
+        memset(eeprom_sim_page_programs, 0,
+               eeprom_sim_model->size / eeprom_sim_model->page_size * sizeof(uint32_t));
+    }
+}
+
+uint8_t *eeprom_sim_data(void)
+{
+    return eeprom_sim_mem;
+}
+
+static void eeprom_sim_wait(uint64_t us)
+{
+    uint64_t ticks = host_us_to_ticks(us);
+    eeprom_sim_stats.busy_ticks += ticks;
+    host_clock_advance(ticks);
+}
+
+static void eeprom_sim_spi_transfer(uint32_t bytes)
+{
+    eeprom_sim_wait((uint64_t)bytes * SPI_BYTE_US);
+}
+
+// Number of bytes used by the command and the address
+static uint32_t eeprom_sim_header_size(void)
+{
+    if (eeprom_sim_model->type == 1)
+        return 2;
+    if (eeprom_sim_model->type == 2)
+        return 3;
+    return 4;
+}
+
+// Program command with up to one page of data
+static void eeprom_sim_program(uint32_t address, const uint8_t *data,
+                               uint32_t length)
+{
+    const eeprom_model_t *m = eeprom_sim_model;
+
+    eeprom_sim_spi_transfer(1); // Write enable
+    eeprom_sim_spi_transfer(eeprom_sim_header_size() + length);
+
+    eeprom_sim_stats.programs++;
+    eeprom_sim_stats.bytes_programmed += length;
+
+    address %= m->size;
+
+    uint32_t page = address / m->page_size;
+    uint32_t page_start = page * m->page_size;
+
+    if (eeprom_sim_programs_to_fail > 0)
+    {
+        eeprom_sim_programs_to_fail--;
+        return;
+    }
+
+    uint32_t programs = ++eeprom_sim_page_programs[page];
+    if (programs > eeprom_sim_stats.max_page_programs)
+        eeprom_sim_stats.max_page_programs = programs;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        // The address wraps around at the end of the page
+        uint32_t offset = page_start + (address - page_start + i) % m->page_size;
+
+        if (m->type == 3)
+            eeprom_sim_mem[offset] &= data[i];
+        else
+            eeprom_sim_mem[offset] = data[i];
+    }
+
+    // cardWriteEeprom() waits until the chip isn't busy
+    eeprom_sim_wait(m->program_us);
+}
+
+// Functions of cardEeprom.c
+// -------------------------
+
+int cardEepromGetType(void)
+{
+    if (eeprom_sim_model == NULL)
+        return -1;
+
+    return eeprom_sim_model->type;
+}
+
+u32 cardEepromGetSize(void)
+{
+    if (eeprom_sim_model == NULL)
+        return 0;
+
+    return eeprom_sim_model->size;
+}
+
+void cardReadEeprom(u32 address, u8 *data, u32 length, u32 addrtype)
+{
+    const eeprom_model_t *m = eeprom_sim_model;
+
+    if ((m == NULL) || ((int)addrtype != m->type))
+    {
+        memset(data, 0xFF, length);
+        return;
+    }
+
+    eeprom_sim_spi_transfer(eeprom_sim_header_size() + length);
+    eeprom_sim_stats.reads++;
+    eeprom_sim_stats.bytes_read += length;
+
+    // Reads aren't limited to a page, the address wraps around at the end of
+    // the chip.
+    for (uint32_t i = 0; i < length; i++)
+        data[i] = eeprom_sim_mem[(address + i) % m->size];
+}
+
+void cardWriteEeprom(u32 address, u8 *data, u32 length, u32 addrtype)
+{
+    const eeprom_model_t *m = eeprom_sim_model;
+
+    if ((m == NULL) || ((int)addrtype != m->type))
+        return;
+
+    // Same size of the commands as the real function
+    uint32_t max_length = 32;
+    if (addrtype == 1)
+        max_length = 16;
+    if (addrtype == 3)
+        max_length = 256;
+
+    while (length > 0)
+    {
+        uint32_t chunk = (length > max_length) ? max_length : length;
+
+        eeprom_sim_program(address, data, chunk);
+
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+void cardEepromSectorErase(u32 address)
+{
+    const eeprom_model_t *m = eeprom_sim_model;
+
+    if ((m == NULL) || (m->type != 3))
+        return;
+
+    eeprom_sim_spi_transfer(1 + 4);
+
+    uint32_t start = (address % m->size) & ~(FLASH_SECTOR_SIZE - 1);
+    memset(eeprom_sim_mem + start, 0xFF, FLASH_SECTOR_SIZE);
+
+    eeprom_sim_stats.erases++;
+    eeprom_sim_wait((uint64_t)m->erase_ms * 1000);
+}
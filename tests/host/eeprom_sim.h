@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Simulated save chip of a DS card, used instead of cardEeprom.c.
+//
+// cardEeprom.c talks to the chip with the SPI registers, which can't be used
+// on the host, so this module implements the same functions on top of a model
+// of the chip. cardWriteEeprom() splits writes in commands like the real one
+// (16, 32 or 256 bytes per command, starting at the requested address), and
+// the chip handles each command like the real hardware:
+//
+// - The address wraps around at the end of the page of the chip, which may be
+//   bigger than the size of the commands of cardWriteEeprom().
+// - EEPROM chips replace the old data. FLASH chips can only clear bits, so the
+//   new data is ANDed with the old data. cardEepromSectorErase() sets a 64 KiB
+//   sector to 0xFF.
+//
+// Each command advances the virtual clock. The default timings are rough
+// values taken from datasheets of similar chips, not measurements.
+
+#ifndef EEPROM_SIM_H__
+#define EEPROM_SIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *name;
+    int type; // Value returned by cardEepromGetType()
+    uint32_t size;
+    uint32_t page_size; // Page of the chip, the address wraps around it
+    uint32_t program_us; // Time needed to program a page
+    uint32_t erase_ms; // Time needed to erase a sector (FLASH only)
+} eeprom_model_t;
+
+extern const eeprom_model_t eeprom_model_512b; // 4 Kbit EEPROM
+extern const eeprom_model_t eeprom_model_8k; // 64 Kbit EEPROM
+extern const eeprom_model_t eeprom_model_64k; // 512 Kbit EEPROM
+extern const eeprom_model_t eeprom_model_flash_256k; // 2 Mbit FLASH
+
+typedef struct {
+    uint32_t reads; // Read commands
+    uint32_t programs; // Program commands
+    uint32_t erases; // Sectors erased
+    uint64_t bytes_read;
+    uint64_t bytes_programmed; // Bytes sent in program commands
+    uint32_t max_page_programs; // Times the most programmed page was programmed
+    uint64_t busy_ticks; // Time spent executing commands
+} eeprom_sim_stats_t;
+
+// Inserts a chip in the simulated card, filled with "fill". If "model" is NULL
+// the card has no save chip. The chip is removed with eeprom_sim_remove().
+void eeprom_sim_insert(const eeprom_model_t *model, uint8_t fill);
+void eeprom_sim_remove(void);
+
+// The next "count" program commands are ignored, as if power had been lost
+// while they were running. The chip works normally after that.
+void eeprom_sim_fail_programs(uint32_t count);
+
+void eeprom_sim_get_stats(eeprom_sim_stats_t *stats);
+void eeprom_sim_reset_stats(void);
+
+// Access the data of the chip directly, without going through the model.
+uint8_t *eeprom_sim_data(void);
+
+#endif // EEPROM_SIM_H__
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fat.h>
+
+#include "ff.h"
+#include "cache.h"
+
+#include "disc_sim.h"
+#include "fat_volume.h"
+
+#define SECTOR_SIZE     512
+
+const char *fat_volume_root(fat_io_drive_t drive)
+{
+    switch (drive)
+    {
+        case FAT_IO_DRIVE_SD:
+            return "sd:/";
+        case FAT_IO_DRIVE_NAND:
+            return "nand:/";
+        default:
+            return "fat:/";
+    }
+}
+
+FRESULT fat_volume_format(FATFS *fs, fat_io_drive_t drive, BYTE fmt,
+                          DWORD cluster_size)
+{
+    static BYTE work[FF_MAX_SS];
+
+    const char *root = fat_volume_root(drive);
+    FRESULT result;
+
+    // diskio.c can't get the size of DLDI devices, so FatFs can't format them.
+    // The device is moved to the SD drive while it's formatted.
+    fat_io_drive_t format_drive = drive;
+    if (drive == FAT_IO_DRIVE_DLDI)
+    {
+        format_drive = FAT_IO_DRIVE_SD;
+        if (disc_sim_move(drive, format_drive) != 0)
+            return FR_NOT_READY;
+    }
+
+    // "nand:/" is mapped to the first partition of the drive in VolToPart
+    if (drive == FAT_IO_DRIVE_NAND)
+    {
+        const LBA_t partitions[] = { 100, 0 }; // 100% of the drive
+        result = f_fdisk(drive, partitions, work);
+        if (result != FR_OK)
+            return result;
+    }
+
+    const MKFS_PARM opt = { fmt | FM_SFD, 1, 0, 0, cluster_size };
+
+    result = f_mkfs(fat_volume_root(format_drive), &opt, work, sizeof(work));
+
+    if (format_drive != drive)
+    {
+        // Don't leave sectors of the SD drive in the cache
+        cache_sector_invalidate(format_drive, 0, UINT32_MAX);
+        disc_sim_move(format_drive, drive);
+    }
+
+    if (result != FR_OK)
+        return result;
+
+    result = f_mount(fs, root, 1);
+    if (result != FR_OK)
+        return result;
+
+    return f_chdrive(root);
+}
+
+void fat_volume_unmount(fat_io_drive_t drive)
+{
+    f_mount(NULL, fat_volume_root(drive), 0);
+}
+
+// Reads bytes of the first FAT, which may be split between two sectors
+static bool fat_volume_read_fat(const FATFS *fs, uint32_t offset, void *buffer,
+                                uint32_t size)
+{
+    uint8_t sectors[2 * SECTOR_SIZE];
+
+    uint32_t sector = fs->fatbase + offset / SECTOR_SIZE;
+    uint32_t count = ((offset % SECTOR_SIZE) + size > SECTOR_SIZE) ? 2 : 1;
+
+    if (!disc_sim_peek(fs->pdrv, sector, count, sectors))
+        return false;
+
+    memcpy(buffer, sectors + (offset % SECTOR_SIZE), size);
+    return true;
+}
+
+uint32_t fat_volume_get_entry(const FATFS *fs, uint32_t cluster)
+{
+    if ((cluster < 2) || (cluster >= fs->n_fatent))
+        return 1;
+
+    uint8_t b[4];
+
+    switch (fs->fs_type)
+    {
+        case FS_FAT12:
+        {
+            if (!fat_volume_read_fat(fs, cluster + cluster / 2, b, 2))
+                return 1;
+
+            uint32_t entry = b[0] | (b[1] << 8);
+            return (cluster & 1) ? (entry >> 4) : (entry & 0xFFF);
+        }
+        case FS_FAT16:
+        {
+            if (!fat_volume_read_fat(fs, cluster * 2, b, 2))
+                return 1;
+
+            return b[0] | (b[1] << 8);
+        }
+        case FS_FAT32:
+        {
+            if (!fat_volume_read_fat(fs, cluster * 4, b, 4))
+                return 1;
+
+            return (b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24))
+                   & 0x0FFFFFFF;
+        }
+        default:
+            return 1;
+    }
+}
+
+uint32_t fat_volume_chain(const FATFS *fs, uint32_t first, uint32_t *clusters,
+                          uint32_t max)
+{
+    uint32_t count = 0;
+    uint32_t cluster = first;
+
+    // Values outside of the range of clusters mark the end of the chain. The
+    // loop also stops if there is a loop in the chain.
+    while ((cluster >= 2) && (cluster < fs->n_fatent) && (count < fs->n_fatent))
+    {
+        if (count < max)
+            clusters[count] = cluster;
+        count++;
+
+        cluster = fat_volume_get_entry(fs, cluster);
+    }
+
+    return count;
+}
+
+uint32_t fat_volume_fragments(const uint32_t *clusters, uint32_t count)
+{
+    uint32_t fragments = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if ((i == 0) || (clusters[i] != clusters[i - 1] + 1))
+            fragments++;
+    }
+
+    return fragments;
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// FAT volumes created by FatFs in the simulated devices of disc_sim.c, and
+// functions to inspect them without going through FatFs.
+
+#ifndef FAT_VOLUME_H__
+#define FAT_VOLUME_H__
+
+#include <stdint.h>
+
+#include <fat.h>
+
+#include "ff.h"
+
+// Returns the path of the root directory of the volume of a drive: "fat:/",
+// "sd:/" or "nand:/".
+const char *fat_volume_root(fat_io_drive_t drive);
+
+// Formats the device attached to a drive and mounts the new volume in "fs". It
+// also makes it the current drive, so relative paths can be used. "fmt" is
+// FM_FAT, FM_FAT32 or FM_ANY, and "cluster_size" is the size of the clusters in
+// bytes, or 0 to let FatFs choose it. The volume of the NAND drive is created
+// in the first partition of a partition table, like "nand:/" expects. The other
+// volumes use the whole device.
+FRESULT fat_volume_format(FATFS *fs, fat_io_drive_t drive, BYTE fmt,
+                          DWORD cluster_size);
+
+// Unmounts the volume of a drive.
+void fat_volume_unmount(fat_io_drive_t drive);
+
+// Reads the FAT entry of a cluster from the device. The FAT sectors modified
+// by FatFs are only written to the device when files are closed or synced.
+// Returns 1 on error, like FatFs does.
+uint32_t fat_volume_get_entry(const FATFS *fs, uint32_t cluster);
+
+// Follows the cluster chain that starts at "first". The first "max" clusters
+// are stored in "clusters", and it returns the total length of the chain.
+uint32_t fat_volume_chain(const FATFS *fs, uint32_t first, uint32_t *clusters,
+                          uint32_t max);
+
+// Returns the number of fragments of a chain returned by fat_volume_chain().
+uint32_t fat_volume_fragments(const uint32_t *clusters, uint32_t count);
+
+#endif // FAT_VOLUME_H__
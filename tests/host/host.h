@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Services of the host platform layer used by tests and benchmarks.
+
+#ifndef HOST_H__
+#define HOST_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Virtual clock
+// -------------
+//
+// cpuGetTiming() returns the virtual clock, in ticks of BUS_CLOCK. It only
+// advances when a simulated device spends time executing a command, so results
+// don't depend on the speed of the host.
+
+uint64_t host_clock_ticks(void);
+void host_clock_advance(uint64_t ticks);
+uint64_t host_us_to_ticks(uint64_t us);
+double host_ticks_to_ms(uint64_t ticks);
+
+// Wall clock of the host in nanoseconds. It measures the CPU cost of the code
+// under test, which the virtual clock ignores.
+uint64_t host_wall_ns(void);
+
+// Memory map
+// ----------
+
+// memBufferIsInMainRam() returns false for buffers inside this array, like it
+// does on hardware for buffers in DTCM.
+#define HOST_DTCM_SIZE  (16 * 1024)
+extern uint8_t host_dtcm[HOST_DTCM_SIZE];
+
+// NitroFS keeps pointers to its open files in the low 28 bits of the file
+// descriptors, which works on the DS because the heap is in main RAM. Programs
+// that open NitroFS files call this at the start of main() to make sure that
+// the heap is in the low 256 MiB of the address space. Linux places the heap at
+// a random address, so this disables the randomization and restarts the
+// program if needed. It exits if it fails.
+void host_use_low_heap(char *argv[]);
+
+// Checks
+// ------
+
+extern int host_checks_failed;
+
+#define HOST_CHECK(cond)                                                    \
+    do {                                                                    \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            host_checks_failed++;                                           \
+        }                                                                   \
+    } while (0)
+
+// Prints the result of a test program and returns its exit code.
+int host_test_result(const char *name);
+
+#endif // HOST_H__
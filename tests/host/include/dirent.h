@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// The <dirent.h> of the C library of the host defines its own DIR and struct
+// dirent. The library uses the ones of <sys/dirent.h>, so this header replaces
+// the one of picolibc, which only adds the prototypes of the functions.
+
+#ifndef HOST_DIRENT_H__
+#define HOST_DIRENT_H__
+
+#include <stdint.h>
+#include <sys/dirent.h>
+
+DIR *opendir(const char *name);
+int closedir(DIR *dirp);
+struct dirent *readdir(DIR *dirp);
+void rewinddir(DIR *dirp);
+void seekdir(DIR *dirp, long loc);
+long telldir(DIR *dirp);
+
+int alphasort(const struct dirent **a, const struct dirent **b);
+int versionsort(const struct dirent **a, const struct dirent **b);
+int scandir(const char *path, struct dirent ***names,
+            int (*filter_f)(const struct dirent *),
+            int (*compare_f)(const struct dirent **, const struct dirent **));
+
+#endif // HOST_DIRENT_H__
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// The real header implements some BIOS calls as inline assembly with the GCC
+// toolchain, and declares them as regular functions with Clang. The harness
+// uses the Clang declarations, and platform.c implements the functions it needs.
+
+#ifndef HOST_NDS_BIOS_H__
+#define HOST_NDS_BIOS_H__
+
+#ifndef __clang__
+#define HOST_UNDEF_CLANG
+#define __clang__ 1
+#endif
+
+#include_next <nds/bios.h>
+
+#ifdef HOST_UNDEF_CLANG
+#undef __clang__
+#undef HOST_UNDEF_CLANG
+#endif
+
+#endif // HOST_NDS_BIOS_H__
@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// The real header checks the offsets of cothread_info_t against the values used
+// by the assembly code, which assume 32-bit pointers. The harness never runs
+// threads, so the offsets are replaced by the ones of the host.
+
+#ifndef HOST_NDS_COTHREAD_H__
+#define HOST_NDS_COTHREAD_H__
+
+#include <stddef.h>
+
+#include <nds/cothread_asm.h>
+
+#undef COTHREAD_INFO_NEXT_IRQ_OFFSET
+#define COTHREAD_INFO_NEXT_IRQ_OFFSET   offsetof(cothread_info_t, next_irq)
+#undef COTHREAD_INFO_FLAGS_OFFSET
+#define COTHREAD_INFO_FLAGS_OFFSET      offsetof(cothread_info_t, flags)
+
+#include_next <nds/cothread.h>
+
+#endif // HOST_NDS_COTHREAD_H__
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Attributes that select the ARM or Thumb instruction sets, or place code and
+// data in sections of the DS memory map, have no meaning on the host.
+
+#ifndef HOST_NDS_NDSTYPES_H__
+#define HOST_NDS_NDSTYPES_H__
+
+#include_next <nds/ndstypes.h>
+
+#undef ITCM_CODE
+#define ITCM_CODE
+#undef ITCM_DATA
+#define ITCM_DATA
+#undef ITCM_BSS
+#define ITCM_BSS
+#undef DTCM_DATA
+#define DTCM_DATA
+#undef DTCM_BSS
+#define DTCM_BSS
+#undef TWL_CODE
+#define TWL_CODE
+#undef TWL_DATA
+#define TWL_DATA
+#undef TWL_BSS
+#define TWL_BSS
+#undef ARM_CODE
+#define ARM_CODE
+#undef THUMB_CODE
+#define THUMB_CODE
+
+#endif // HOST_NDS_NDSTYPES_H__
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// System calls implemented by filesystem.c. The object of that file is built
+// with its symbols renamed (see "filesystem.syms") so that the functions of the
+// host keep working, and programs call the versions of libnds with these names.
+//
+// They use the types and flags of the C library of the host, like the rest of
+// the library files built by the harness. File descriptors contain pointers,
+// so programs that use them must call host_use_low_heap().
+
+#ifndef NDS_SYSCALLS_H__
+#define NDS_SYSCALLS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+int nds_open(const char *path, int flags, ...);
+ssize_t nds_read(int fd, void *ptr, size_t len);
+ssize_t nds_write(int fd, const void *ptr, size_t len);
+int nds_fsync(int fd);
+int nds_close(int fd);
+off_t nds_lseek(int fd, off_t offset, int whence);
+int nds_unlink(const char *name);
+int nds_rmdir(const char *name);
+int nds_stat(const char *path, struct stat *st);
+int nds_fstat(int fd, struct stat *st);
+int nds_rename(const char *old, const char *new);
+int nds_ftruncate(int fd, off_t length);
+int nds_truncate(const char *path, off_t length);
+int nds_posix_fallocate(int fd, off_t offset, off_t len);
+int nds_mkdir(const char *path, mode_t mode);
+int nds_access(const char *path, int amode);
+
+#endif // NDS_SYSCALLS_H__
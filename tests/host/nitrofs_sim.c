@@ -0,0 +1,332 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Synthetic NDS files for NitroFS, and host implementations of the functions
+// that nitrofs.c uses to access the storage devices.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat.h>
+#include <nds/arm9/card.h>
+#include <nds/arm9/dldi.h>
+#include <nds/card.h>
+#include <nds/memory.h>
+#include <nds/timers.h>
+
+#include "host.h"
+#include "nitrofs_sim.h"
+
+// Image builder
+// -------------
+
+typedef struct {
+    char *name;
+    bool is_dir;
+    uint16_t dir_id; // Directories only
+    uint8_t *data; // Files only
+    size_t size;
+} nitrofs_sim_entry_t;
+
+typedef struct {
+    uint16_t parent;
+    nitrofs_sim_entry_t *entries;
+    uint32_t num_entries;
+    uint32_t max_entries;
+} nitrofs_sim_dir_t;
+
+struct nitrofs_image {
+    nitrofs_sim_dir_t *dirs;
+    uint32_t num_dirs;
+    uint32_t max_dirs;
+};
+
+static void *nitrofs_sim_grow(void *array, uint32_t *max, size_t elem_size)
+{
+    *max = (*max == 0) ? 16 : *max * 2;
+    void *new_array = realloc(array, *max * elem_size);
+    if (new_array == NULL)
+    {
+        printf("nitrofs_sim: out of memory\n");
+        abort();
+    }
+    return new_array;
+}
+
+static nitrofs_sim_entry_t *nitrofs_sim_add_entry(nitrofs_image_t *img,
+                                                  uint16_t dir, const char *name)
+{
+    nitrofs_sim_dir_t *d = &img->dirs[dir - NITROFS_SIM_ROOT];
+
+    if (d->num_entries == d->max_entries)
+        d->entries = nitrofs_sim_grow(d->entries, &d->max_entries, sizeof(*d->entries));
+
+    nitrofs_sim_entry_t *e = &d->entries[d->num_entries++];
+    memset(e, 0, sizeof(*e));
+    e->name = strdup(name);
+    return e;
+}
+
+nitrofs_image_t *nitrofs_image_create(void)
+{
+    nitrofs_image_t *img = calloc(1, sizeof(nitrofs_image_t));
+    if (img == NULL)
+        return NULL;
+
+    img->dirs = nitrofs_sim_grow(NULL, &img->max_dirs, sizeof(*img->dirs));
+    memset(&img->dirs[0], 0, sizeof(img->dirs[0]));
+    img->num_dirs = 1;
+
+    return img;
+}
+
+void nitrofs_image_free(nitrofs_image_t *img)
+{
+    for (uint32_t d = 0; d < img->num_dirs; d++)
+    {
+        for (uint32_t i = 0; i < img->dirs[d].num_entries; i++)
+        {
+            free(img->dirs[d].entries[i].name);
+            free(img->dirs[d].entries[i].data);
+        }
+        free(img->dirs[d].entries);
+    }
+    free(img->dirs);
+    free(img);
+}
+
+uint16_t nitrofs_image_add_dir(nitrofs_image_t *img, uint16_t parent,
+                               const char *name)
+{
+    if (img->num_dirs == img->max_dirs)
+        img->dirs = nitrofs_sim_grow(img->dirs, &img->max_dirs, sizeof(*img->dirs));
+
+    uint16_t id = NITROFS_SIM_ROOT + img->num_dirs;
+
+    nitrofs_sim_dir_t *d = &img->dirs[img->num_dirs++];
+    memset(d, 0, sizeof(*d));
+    d->parent = parent;
+
+    nitrofs_sim_entry_t *e = nitrofs_sim_add_entry(img, parent, name);
+    e->is_dir = true;
+    e->dir_id = id;
+
+    return id;
+}
+
+void nitrofs_image_add_file(nitrofs_image_t *img, uint16_t dir,
+                            const char *name, const void *data, size_t size)
+{
+    nitrofs_sim_entry_t *e = nitrofs_sim_add_entry(img, dir, name);
+    e->data = malloc(size > 0 ? size : 1);
+    memcpy(e->data, data, size);
+    e->size = size;
+}
+
+static void put16(uint8_t *p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+bool nitrofs_image_save(nitrofs_image_t *img, const char *path)
+{
+    // Size of the FNT and number of files
+    uint32_t fnt_size = img->num_dirs * 8;
+    uint32_t num_files = 0;
+    size_t data_size = 0;
+
+    for (uint32_t d = 0; d < img->num_dirs; d++)
+    {
+        nitrofs_sim_dir_t *dir = &img->dirs[d];
+        for (uint32_t i = 0; i < dir->num_entries; i++)
+        {
+            nitrofs_sim_entry_t *e = &dir->entries[i];
+            fnt_size += 1 + strlen(e->name) + (e->is_dir ? 2 : 0);
+            if (!e->is_dir)
+            {
+                num_files++;
+                data_size += (e->size + 3) & ~3;
+            }
+        }
+        fnt_size++; // End of the directory
+    }
+
+    uint32_t fnt_offset = NITROFS_SIM_FNT_OFFSET;
+    uint32_t fat_offset = (fnt_offset + fnt_size + 3) & ~3;
+    uint32_t fat_size = num_files * 8;
+    uint32_t data_offset = fat_offset + fat_size + 8; // "NitroFS!" goes first
+
+    size_t total_size = data_offset + data_size;
+    uint8_t *rom = calloc(1, total_size);
+    if (rom == NULL)
+        return false;
+
+    // nitroFSInit() reads these fields with offsetof(tNDSHeader, ...). On a
+    // 64-bit host they aren't at 0x40 like in real NDS files because the header
+    // has some pointers, so the host offsets are used.
+    uint8_t *header = rom + offsetof(tNDSHeader, filenameOffset);
+    put32(header, fnt_offset);
+    put32(header + 4, fnt_size);
+    put32(header + 8, fat_offset);
+    put32(header + 12, fat_size);
+
+    memcpy(rom + fat_offset + fat_size, "NitroFS!", 8);
+
+    uint8_t *fnt = rom + fnt_offset;
+    uint32_t pos = img->num_dirs * 8;
+    uint32_t file_id = 0;
+
+    for (uint32_t d = 0; d < img->num_dirs; d++)
+    {
+        nitrofs_sim_dir_t *dir = &img->dirs[d];
+
+        put32(fnt + d * 8, pos);
+        put16(fnt + d * 8 + 4, file_id);
+        put16(fnt + d * 8 + 6, d == 0 ? img->num_dirs : dir->parent);
+
+        for (uint32_t i = 0; i < dir->num_entries; i++)
+        {
+            nitrofs_sim_entry_t *e = &dir->entries[i];
+            size_t len = strlen(e->name);
+
+            fnt[pos++] = len | (e->is_dir ? 0x80 : 0);
+            memcpy(fnt + pos, e->name, len);
+            pos += len;
+
+            if (e->is_dir)
+            {
+                put16(fnt + pos, e->dir_id);
+                pos += 2;
+                continue;
+            }
+
+            uint8_t *fat_entry = rom + fat_offset + file_id * 8;
+            put32(fat_entry, data_offset);
+            put32(fat_entry + 4, data_offset + e->size);
+            memcpy(rom + data_offset, e->data, e->size);
+
+            data_offset += (e->size + 3) & ~3;
+            file_id++;
+        }
+
+        fnt[pos++] = 0;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        free(rom);
+        return false;
+    }
+
+    bool ok = fwrite(rom, 1, total_size, f) == total_size;
+    ok = (fclose(f) == 0) && ok;
+
+    free(rom);
+    return ok;
+}
+
+// Backing store
+// -------------
+
+static const disc_model_t *nitrofs_sim_model = &disc_model_dldi;
+static nitrofs_sim_stats_t nitrofs_sim_stats;
+
+void nitrofs_sim_set_model(const disc_model_t *model)
+{
+    nitrofs_sim_model = model;
+}
+
+void nitrofs_sim_get_stats(nitrofs_sim_stats_t *stats)
+{
+    *stats = nitrofs_sim_stats;
+}
+
+void nitrofs_sim_reset_stats(void)
+{
+    memset(&nitrofs_sim_stats, 0, sizeof(nitrofs_sim_stats));
+}
+
+size_t __real_fread(void *ptr, size_t size, size_t nmemb, FILE *stream);
+
+size_t __wrap_fread(void *ptr, size_t size, size_t nmemb, FILE *stream)
+{
+    uint64_t bytes = (uint64_t)size * nmemb;
+
+    uint64_t ticks = host_us_to_ticks(nitrofs_sim_model->command_us);
+    ticks += (bytes * BUS_CLOCK) / ((uint64_t)nitrofs_sim_model->read_kib_s * 1024);
+
+    nitrofs_sim_stats.reads++;
+    nitrofs_sim_stats.bytes += bytes;
+    nitrofs_sim_stats.busy_ticks += ticks;
+    host_clock_advance(ticks);
+
+    return __real_fread(ptr, size, nmemb, stream);
+}
+
+// Functions used by nitrofs.c
+// ---------------------------
+
+// The NDS file is opened with the fopen() of the host. Programs that build
+// fatfs.c use the versions of that file, and they are linked with
+// "-Wl,--wrap=fatInitDefault" so that nitroFSInit() doesn't try to mount the
+// drives of the DS.
+__attribute__((weak)) bool fatInitDefault(void)
+{
+    return true;
+}
+
+bool __wrap_fatInitDefault(void)
+{
+    return true;
+}
+
+__attribute__((weak)) int fatInitLookupCache(int fd, uint32_t max_buffer_size)
+{
+    return 0;
+}
+
+// Programs that build filesystem.c use the variable of that file
+__attribute__((weak)) bool current_drive_is_nitrofs = false;
+
+DLDI_MODE dldiGetMode(void)
+{
+    return DLDI_MODE_ARM9;
+}
+
+// NitroFS is always read from a file, never from the cartridge
+
+static void nitrofs_sim_no_card(void)
+{
+    printf("nitrofs_sim: the cartridge can't be used on the host\n");
+    abort();
+}
+
+void cardRead(void *dest, size_t offset, size_t len, uint32_t flags)
+{
+    nitrofs_sim_no_card();
+}
+
+bool cardReadArm7(void *dest, size_t offset, size_t size, uint32_t flags)
+{
+    nitrofs_sim_no_card();
+    return false;
+}
+
+void cardReadDma(void *dest, size_t offset, size_t size, uint32_t flags,
+                 int channel)
+{
+    nitrofs_sim_no_card();
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Synthetic NDS files with a NitroFS filesystem, and a model of the time needed
+// to read them from a flashcart.
+//
+// nitroFSInit() opens NDS files with fopen() and reads them with fread(). The
+// programs that use this module are linked with "-Wl,--wrap=fread" so that
+// every fread() done by the library is counted and advances the virtual clock
+// like a read from the device model.
+
+#ifndef NITROFS_SIM_H__
+#define NITROFS_SIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "disc_sim.h"
+
+#define NITROFS_SIM_ROOT    0xF000
+
+typedef struct nitrofs_image nitrofs_image_t;
+
+nitrofs_image_t *nitrofs_image_create(void);
+void nitrofs_image_free(nitrofs_image_t *img);
+
+// Adds a directory inside "parent" and returns its ID. Directories and files
+// are stored in the FNT in the order they are added. Names can't be longer
+// than 127 characters.
+uint16_t nitrofs_image_add_dir(nitrofs_image_t *img, uint16_t parent,
+                               const char *name);
+
+// Adds a file inside "dir". The data is copied. Files get their IDs when the
+// image is saved, in the order of their directories.
+void nitrofs_image_add_file(nitrofs_image_t *img, uint16_t dir,
+                            const char *name, const void *data, size_t size);
+
+// Writes the NDS file. The FNT starts at NITROFS_SIM_FNT_OFFSET and the FAT
+// goes right after it. Returns false on error.
+#define NITROFS_SIM_FNT_OFFSET  0x8000
+bool nitrofs_image_save(nitrofs_image_t *img, const char *path);
+
+// Backing store
+// -------------
+
+typedef struct {
+    uint32_t reads; // Calls to fread()
+    uint64_t bytes;
+    uint64_t busy_ticks;
+} nitrofs_sim_stats_t;
+
+// Every fread() counts as one command of this model that transfers the whole
+// requested size. The default is disc_model_dldi.
+void nitrofs_sim_set_model(const disc_model_t *model);
+
+void nitrofs_sim_get_stats(nitrofs_sim_stats_t *stats);
+void nitrofs_sim_reset_stats(void);
+
+#endif // NITROFS_SIM_H__
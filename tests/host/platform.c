@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Host implementations of the hardware-dependent functions used by the library
+// files built by the harness.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/personality.h>
+
+#include <aeabi.h>
+#include <nds/arm9/sassert.h>
+#include <nds/cothread.h>
+#include <nds/system.h>
+#include <nds/timers.h>
+
+#include "host.h"
+
+// Virtual clock
+
+static uint64_t host_clock;
+
+uint64_t host_clock_ticks(void)
+{
+    return host_clock;
+}
+
+void host_clock_advance(uint64_t ticks)
+{
+    host_clock += ticks;
+}
+
+uint64_t host_us_to_ticks(uint64_t us)
+{
+    return (us * BUS_CLOCK) / 1000000;
+}
+
+double host_ticks_to_ms(uint64_t ticks)
+{
+    return (ticks * 1000.0) / BUS_CLOCK;
+}
+
+u32 cpuGetTiming(void)
+{
+    return (u32)host_clock;
+}
+
+uint64_t host_wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Memory map
+
+uint8_t host_dtcm[HOST_DTCM_SIZE] __attribute__((aligned(32)));
+
+bool __dsimode = false;
+
+bool memBufferIsInMainRam(const void *buffer, size_t size)
+{
+    uintptr_t start = (uintptr_t)buffer;
+    uintptr_t end = start + size;
+
+    uintptr_t dtcm_start = (uintptr_t)host_dtcm;
+    uintptr_t dtcm_end = dtcm_start + HOST_DTCM_SIZE;
+
+    return (end <= dtcm_start) || (start >= dtcm_end);
+}
+
+void host_use_low_heap(char *argv[])
+{
+    int persona = personality(0xFFFFFFFF);
+
+    if ((persona != -1) && !(persona & ADDR_NO_RANDOMIZE))
+    {
+        if (personality(persona | ADDR_NO_RANDOMIZE) != -1)
+            execv("/proc/self/exe", argv);
+    }
+
+    // Leave space for the allocations done by the program
+    if ((uintptr_t)sbrk(0) >= 0x08000000)
+    {
+        printf("The heap isn't in the low 256 MiB of the address space\n");
+        exit(1);
+    }
+}
+
+void __aeabi_memcpy(void *__restrict__ dest, const void *__restrict__ src, size_t n)
+{
+    memcpy(dest, src, n);
+}
+
+// Threads
+
+// The programs never start threads, so mutexes (like the ones of FatFs) are
+// never contended and nothing waits for signals.
+void cothread_send_signal(uint32_t signal_id)
+{
+    (void)signal_id;
+}
+
+void cothread_yield_signal(uint32_t signal_id)
+{
+    printf("cothread_yield_signal(0x%08X): no threads to switch to\n", signal_id);
+    abort();
+}
+
+// Error handling
+
+void __sassert(const char *fileName, int lineNumber, const char *conditionString,
+               const char *format, ...)
+{
+    printf("%s:%d: assertion failed: %s\n", fileName, lineNumber, conditionString);
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+
+    printf("\n");
+    abort();
+}
+
+// Checks
+
+int host_checks_failed = 0;
+
+int host_test_result(const char *name)
+{
+    if (host_checks_failed > 0)
+    {
+        printf("%s: %d checks failed\n", name, host_checks_failed);
+        return 1;
+    }
+
+    printf("%s: OK\n", name);
+    return 0;
+}
@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the pool of bounce buffers used for buffers that the storage drivers
+// can't access directly (unaligned buffers and buffers in DTCM).
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "cache.h"
+
+#include "disc_sim.h"
+#include "host.h"
+
+#define SECTOR_SIZE 512
+
+static void fill(void *ptr, uint32_t sector, uint32_t count, uint32_t seed)
+{
+    uint8_t *bytes = ptr;
+    for (uint32_t i = 0; i < count * SECTOR_SIZE; i++)
+        bytes[i] = (uint8_t)((sector * SECTOR_SIZE + i) * 7 + seed);
+}
+
+static bool check(const void *ptr, uint32_t sector, uint32_t count, uint32_t seed)
+{
+    const uint8_t *bytes = ptr;
+    for (uint32_t i = 0; i < count * SECTOR_SIZE; i++)
+    {
+        if (bytes[i] != (uint8_t)((sector * SECTOR_SIZE + i) * 7 + seed))
+            return false;
+    }
+    return true;
+}
+
+static void prepare_device(fat_io_drive_t drive, uint32_t num_sectors)
+{
+    uint8_t *data = malloc(num_sectors * SECTOR_SIZE);
+    fill(data, 0, num_sectors, 0);
+    disc_sim_poke(drive, 0, num_sectors, data);
+    free(data);
+}
+
+static void test_pool_config(void)
+{
+    HOST_CHECK(cache_bounce_init(5, 8) != 0);
+    HOST_CHECK(cache_bounce_init(2, 4) == 0);
+
+    uint32_t n1, n2, n3;
+    void *a = cache_bounce_acquire(&n1);
+    void *b = cache_bounce_acquire(&n2);
+    HOST_CHECK((a != NULL) && (b != NULL) && (a != b));
+    HOST_CHECK((n1 == 4) && (n2 == 4));
+    HOST_CHECK(((uintptr_t)a % 32) == 0);
+
+    // The configuration can't change while buffers are in use
+    HOST_CHECK(cache_bounce_init(1, 8) != 0);
+
+    // When all buffers are in use, a cache entry is used
+    void *c = cache_bounce_acquire(&n3);
+    HOST_CHECK((c != NULL) && (c != a) && (c != b));
+    HOST_CHECK(n3 == 1);
+
+    cache_bounce_release(c);
+    cache_bounce_release(b);
+    cache_bounce_release(a);
+
+    HOST_CHECK(cache_bounce_init(1, 8) == 0);
+}
+
+// Transfers with buffers that the DLDI driver can't use must never reach the
+// driver, and they must move several sectors per command.
+static void test_transfers(uint32_t buffers, uint32_t sectors)
+{
+    const fat_io_drive_t drive = FAT_IO_DRIVE_DLDI;
+    const uint32_t count = 16;
+
+    HOST_CHECK(cache_bounce_init(buffers, sectors) == 0);
+
+    uint8_t *main_ram = malloc(count * SECTOR_SIZE + 1);
+    uint8_t *targets[] = { host_dtcm, main_ram + 1 };
+
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++)
+    {
+        uint8_t *target = targets[t];
+
+        disc_sim_reset_stats(drive);
+
+        memset(target, 0, count * SECTOR_SIZE);
+        HOST_CHECK(disk_read(drive, target, 100, count) == RES_OK);
+        HOST_CHECK(check(target, 100, count, 0));
+
+        fill(target, 300, count, 1);
+        HOST_CHECK(disk_write(drive, target, 300, count) == RES_OK);
+
+        uint8_t *written = malloc(count * SECTOR_SIZE);
+        HOST_CHECK(disc_sim_peek(drive, 300, count, written));
+        HOST_CHECK(check(written, 300, count, 1));
+        free(written);
+
+        disc_sim_stats_t stats;
+        disc_sim_get_stats(drive, &stats);
+        HOST_CHECK(stats.bad_buffers == 0);
+
+        uint32_t per_command = sectors > 0 ? sectors : 1;
+        uint32_t commands = (count + per_command - 1) / per_command;
+        HOST_CHECK(stats.reads == commands);
+        HOST_CHECK(stats.writes == commands);
+    }
+
+    free(main_ram);
+
+    HOST_CHECK(cache_bounce_init(1, 8) == 0);
+}
+
+// The DSi SD driver can use unaligned buffers in main RAM directly
+static void test_sd_unaligned(void)
+{
+    const fat_io_drive_t drive = FAT_IO_DRIVE_SD;
+    const uint32_t count = 16;
+
+    uint8_t *main_ram = malloc(count * SECTOR_SIZE + 1);
+
+    disc_sim_reset_stats(drive);
+
+    HOST_CHECK(disk_read(drive, main_ram + 1, 100, count) == RES_OK);
+    HOST_CHECK(check(main_ram + 1, 100, count, 0));
+
+    disc_sim_stats_t stats;
+    disc_sim_get_stats(drive, &stats);
+    HOST_CHECK(stats.reads == 1);
+
+    free(main_ram);
+}
+
+// Compare the time needed to read into DTCM with bounce buffers of different
+// sizes. 0 sectors means that there is no pool, and a cache entry is used as a
+// single-sector buffer.
+static void bench_dtcm(void)
+{
+    const fat_io_drive_t drive = FAT_IO_DRIVE_DLDI;
+    const uint32_t count = HOST_DTCM_SIZE / SECTOR_SIZE;
+    const uint32_t total = 4096;
+    const uint32_t sizes[] = { 0, 4, 8, 16, 32 };
+
+    printf("Reads of %" PRIu32 " KiB into DTCM, %" PRIu32 " sectors per request:\n",
+           total / 2, count);
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        HOST_CHECK(cache_bounce_init(1, sizes[i]) == 0);
+
+        disc_sim_reset_stats(drive);
+        uint64_t start = host_clock_ticks();
+
+        for (uint32_t s = 0; s < total; s += count)
+            HOST_CHECK(disk_read(drive, host_dtcm, s, count) == RES_OK);
+
+        double ms = host_ticks_to_ms(host_clock_ticks() - start);
+
+        disc_sim_stats_t stats;
+        disc_sim_get_stats(drive, &stats);
+
+        printf("  bounce %2" PRIu32 " sectors: %5" PRIu32 " commands, %7.1f ms, %5.2f MiB/s\n",
+               sizes[i], stats.reads, ms, (total / 2048.0) / (ms / 1000.0));
+    }
+
+    HOST_CHECK(cache_bounce_init(1, 8) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    if (disc_sim_attach(FAT_IO_DRIVE_DLDI, &disc_model_dldi, NULL, 4096) != 0)
+        return 1;
+    if (disc_sim_attach(FAT_IO_DRIVE_SD, &disc_model_sd, NULL, 4096) != 0)
+        return 1;
+    if (disk_initialize(FAT_IO_DRIVE_DLDI) != 0)
+        return 1;
+    if (disk_initialize(FAT_IO_DRIVE_SD) != 0)
+        return 1;
+
+    prepare_device(FAT_IO_DRIVE_DLDI, 4096);
+    prepare_device(FAT_IO_DRIVE_SD, 4096);
+
+    // The cache is needed when there are no bounce buffers
+    HOST_CHECK(cache_init(16) == 0);
+
+    test_pool_config();
+    test_transfers(1, 0);
+    test_transfers(1, 8);
+    test_transfers(2, 16);
+    test_sd_unaligned();
+    bench_dtcm();
+
+    cache_deinit();
+
+    disc_sim_detach(FAT_IO_DRIVE_DLDI);
+    disc_sim_detach(FAT_IO_DRIVE_SD);
+
+    return host_test_result("test_bounce");
+}
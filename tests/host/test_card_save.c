@@ -0,0 +1,432 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the card save manager with simulated EEPROM and FLASH chips, and
+// comparison of the time needed to save with it and by rewriting the save
+// data with cardWriteEeprom().
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/card.h>
+
+#include "eeprom_sim.h"
+#include "host.h"
+
+#define FLASH_SECTOR_SIZE   0x10000
+
+static const eeprom_model_t *models[] = {
+    &eeprom_model_512b,
+    &eeprom_model_8k,
+    &eeprom_model_64k,
+    &eeprom_model_flash_256k,
+};
+
+#define NUM_MODELS          (sizeof(models) / sizeof(models[0]))
+
+static uint32_t rand_state = 0x2545F491;
+
+static uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+// Size of the pages programmed by the save manager
+static uint32_t manager_page_size(const eeprom_model_t *m)
+{
+    if (m->type == 1)
+        return 16;
+    if (m->type == 2)
+        return 32;
+    return 256;
+}
+
+static void test_errors(void)
+{
+    uint8_t buffer[16];
+
+    eeprom_sim_insert(NULL, 0);
+
+    errno = 0;
+    HOST_CHECK(cardSaveInit(0) == -1);
+    HOST_CHECK(errno == ENODEV);
+
+    errno = 0;
+    HOST_CHECK(cardSaveRead(0, buffer, sizeof(buffer)) == -1);
+    HOST_CHECK(errno == ENODEV);
+
+    errno = 0;
+    HOST_CHECK(cardSaveWrite(0, buffer, sizeof(buffer)) == -1);
+    HOST_CHECK(errno == ENODEV);
+
+    errno = 0;
+    HOST_CHECK(cardSaveFlush() == -1);
+    HOST_CHECK(errno == ENODEV);
+
+    eeprom_sim_insert(&eeprom_model_8k, 0xFF);
+
+    errno = 0;
+    HOST_CHECK(cardSaveInit(8 * 1024 + 1) == -1);
+    HOST_CHECK(errno == EINVAL);
+
+    HOST_CHECK(cardSaveInit(1000) == 0);
+
+    // The size is rounded up to the page size
+    HOST_CHECK(cardSaveRead(1000, buffer, 8) == 0);
+    errno = 0;
+    HOST_CHECK(cardSaveRead(1020, buffer, 8) == -1);
+    HOST_CHECK(errno == EINVAL);
+    errno = 0;
+    HOST_CHECK(cardSaveWrite(1024, buffer, 1) == -1);
+    HOST_CHECK(errno == EINVAL);
+    errno = 0;
+    HOST_CHECK(cardSaveWrite(0xFFFFFFFF, buffer, 2) == -1);
+    HOST_CHECK(errno == EINVAL);
+
+    cardSaveExit();
+    eeprom_sim_remove();
+}
+
+// Random writes of random sizes, compared against a copy of the expected data
+static void test_random_writes(const eeprom_model_t *m)
+{
+    // Start with random data in the chip
+    eeprom_sim_insert(m, 0xFF);
+    uint8_t *chip = eeprom_sim_data();
+    for (uint32_t i = 0; i < m->size; i++)
+        chip[i] = rand_next();
+
+    uint8_t *expected = malloc(m->size);
+    memcpy(expected, chip, m->size);
+
+    HOST_CHECK(cardSaveInit(0) == 0);
+
+    uint8_t *buffer = malloc(m->size);
+    HOST_CHECK(cardSaveRead(0, buffer, m->size) == 0);
+    HOST_CHECK(memcmp(buffer, expected, m->size) == 0);
+
+    const uint32_t page_size = manager_page_size(m);
+    const uint32_t num_pages = m->size / page_size;
+    bool *dirty = calloc(num_pages, sizeof(bool));
+
+    for (int round = 0; round < 20; round++)
+    {
+        memset(dirty, 0, num_pages * sizeof(bool));
+
+        for (int w = 0; w < 10; w++)
+        {
+            uint32_t offset = rand_next() % m->size;
+            uint32_t length = 1 + rand_next() % 300;
+            if (length > m->size - offset)
+                length = m->size - offset;
+
+            uint8_t data[300];
+            for (uint32_t i = 0; i < length; i++)
+            {
+                // Leave some bytes unchanged
+                data[i] = (rand_next() % 4) ? rand_next() : expected[offset + i];
+
+                if (data[i] != expected[offset + i])
+                    dirty[(offset + i) / page_size] = true;
+            }
+
+            memcpy(expected + offset, data, length);
+            HOST_CHECK(cardSaveWrite(offset, data, length) == 0);
+        }
+
+        uint32_t num_dirty = 0;
+        for (uint32_t p = 0; p < num_pages; p++)
+            num_dirty += dirty[p] ? 1 : 0;
+
+        cardSaveResetStats();
+        eeprom_sim_reset_stats();
+
+        HOST_CHECK(cardSaveFlush() == 0);
+
+        HOST_CHECK(memcmp(chip, expected, m->size) == 0);
+
+        card_save_stats_t stats;
+        cardSaveGetStats(&stats);
+        eeprom_sim_stats_t sim;
+        eeprom_sim_get_stats(&sim);
+
+        HOST_CHECK(stats.pages_failed == 0);
+        HOST_CHECK(stats.bytes_programmed == sim.bytes_programmed);
+        HOST_CHECK(stats.sectors_erased == sim.erases);
+
+        // EEPROM chips only program the pages that have changed
+        if (m->type != 3)
+            HOST_CHECK(stats.pages_programmed == num_dirty);
+    }
+
+    // Writing the same data again doesn't program anything
+    HOST_CHECK(cardSaveWrite(0, expected, m->size) == 0);
+    eeprom_sim_reset_stats();
+    HOST_CHECK(cardSaveFlush() == 0);
+
+    eeprom_sim_stats_t sim;
+    eeprom_sim_get_stats(&sim);
+    HOST_CHECK((sim.programs == 0) && (sim.erases == 0));
+
+    cardSaveExit();
+
+    free(dirty);
+    free(buffer);
+    free(expected);
+    eeprom_sim_remove();
+}
+
+// A modified partial page at the end of the save data is programmed
+static void test_last_page(void)
+{
+    eeprom_sim_insert(&eeprom_model_512b, 0x00);
+
+    HOST_CHECK(cardSaveInit(100) == 0);
+
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    HOST_CHECK(cardSaveWrite(100, data, sizeof(data)) == 0);
+    HOST_CHECK(cardSaveFlush() == 0);
+
+    HOST_CHECK(memcmp(eeprom_sim_data() + 100, data, sizeof(data)) == 0);
+
+    cardSaveExit();
+    eeprom_sim_remove();
+}
+
+// FLASH pages are programmed without erasing them when they only clear bits
+static void test_flash_erase(void)
+{
+    const eeprom_model_t *m = &eeprom_model_flash_256k;
+    card_save_stats_t stats;
+
+    eeprom_sim_insert(m, 0xFF);
+    HOST_CHECK(cardSaveInit(0) == 0);
+
+    // All the chip is empty, no erase is needed
+    uint8_t data[600];
+    memset(data, 0xF0, sizeof(data));
+
+    cardSaveResetStats();
+    HOST_CHECK(cardSaveWrite(1024, data, sizeof(data)) == 0);
+    HOST_CHECK(cardSaveFlush() == 0);
+    cardSaveGetStats(&stats);
+    HOST_CHECK(stats.sectors_erased == 0);
+    HOST_CHECK(stats.pages_programmed == 3);
+
+    // Only clearing bits
+    memset(data, 0x30, sizeof(data));
+
+    cardSaveResetStats();
+    HOST_CHECK(cardSaveWrite(1024, data, sizeof(data)) == 0);
+    HOST_CHECK(cardSaveFlush() == 0);
+    cardSaveGetStats(&stats);
+    HOST_CHECK(stats.sectors_erased == 0);
+    HOST_CHECK(stats.pages_programmed == 3);
+
+    // Setting bits requires an erase. Only the pages of the erased sector that
+    // aren't empty are programmed again.
+    uint8_t other[16];
+    memset(other, 0x00, sizeof(other));
+    HOST_CHECK(cardSaveWrite(FLASH_SECTOR_SIZE - 16, other, sizeof(other)) == 0);
+    HOST_CHECK(cardSaveWrite(3 * FLASH_SECTOR_SIZE, other, sizeof(other)) == 0);
+    HOST_CHECK(cardSaveFlush() == 0);
+
+    data[0] = 0x31;
+
+    cardSaveResetStats();
+    eeprom_sim_reset_stats();
+    HOST_CHECK(cardSaveWrite(1024, data, 1) == 0);
+    HOST_CHECK(cardSaveFlush() == 0);
+    cardSaveGetStats(&stats);
+    HOST_CHECK(stats.sectors_erased == 1);
+    HOST_CHECK(stats.pages_programmed == 4);
+
+    uint8_t *chip = eeprom_sim_data();
+    HOST_CHECK(memcmp(chip + 1024, data, sizeof(data)) == 0);
+    HOST_CHECK(memcmp(chip + FLASH_SECTOR_SIZE - 16, other, sizeof(other)) == 0);
+    HOST_CHECK(memcmp(chip + 3 * FLASH_SECTOR_SIZE, other, sizeof(other)) == 0);
+
+    eeprom_sim_stats_t sim;
+    eeprom_sim_get_stats(&sim);
+    HOST_CHECK(sim.max_page_programs == 1);
+
+    cardSaveExit();
+    eeprom_sim_remove();
+}
+
+// Pages that aren't programmed correctly stay dirty and are retried
+static void test_failures(void)
+{
+    for (size_t i = 0; i < NUM_MODELS; i++)
+    {
+        const eeprom_model_t *m = models[i];
+        card_save_stats_t stats;
+
+        eeprom_sim_insert(m, 0xFF);
+        HOST_CHECK(cardSaveInit(0) == 0);
+
+        uint8_t data[64];
+        for (uint32_t j = 0; j < sizeof(data); j++)
+            data[j] = j;
+
+        HOST_CHECK(cardSaveWrite(64, data, sizeof(data)) == 0);
+
+        eeprom_sim_fail_programs(1);
+        cardSaveResetStats();
+
+        errno = 0;
+        HOST_CHECK(cardSaveFlush() == -1);
+        HOST_CHECK(errno == EIO);
+
+        cardSaveGetStats(&stats);
+        HOST_CHECK(stats.pages_failed == 1);
+
+        cardSaveResetStats();
+        HOST_CHECK(cardSaveFlush() == 0);
+        cardSaveGetStats(&stats);
+        HOST_CHECK(stats.pages_programmed == 1);
+        HOST_CHECK(stats.pages_failed == 0);
+
+        HOST_CHECK(memcmp(eeprom_sim_data() + 64, data, sizeof(data)) == 0);
+
+        cardSaveExit();
+    }
+
+    eeprom_sim_remove();
+}
+
+// Writes that aren't aligned to pages wrap around in the chip. This is the
+// reason why the save manager programs full pages.
+static void test_page_wrap(void)
+{
+    eeprom_sim_insert(&eeprom_model_64k, 0x00);
+
+    uint8_t data[32];
+    memset(data, 0xAA, sizeof(data));
+    cardWriteEeprom(120, data, sizeof(data), 2);
+
+    uint8_t *chip = eeprom_sim_data();
+    HOST_CHECK(chip[127] == 0xAA);
+    HOST_CHECK(chip[128] == 0x00);
+    HOST_CHECK(chip[0] == 0xAA);
+    HOST_CHECK(chip[23] == 0xAA);
+    HOST_CHECK(chip[24] == 0x00);
+
+    eeprom_sim_remove();
+}
+
+// Saves a block of data several times with the specified number of changes.
+// If "clear_bits" is true, changes only clear bits, so FLASH chips don't need
+// to erase sectors. It prints the average cost of each save.
+static void bench_save_block(const eeprom_model_t *m, uint32_t changes,
+                             bool clear_bits, bool manager)
+{
+    const uint32_t block_size = 8 * 1024;
+    const uint32_t num_saves = 4;
+
+    eeprom_sim_insert(m, 0xFF);
+    if (manager)
+        HOST_CHECK(cardSaveInit(block_size) == 0);
+
+    uint8_t *block = malloc(block_size);
+    memset(block, 0x55, block_size);
+
+    rand_state = 0x1234;
+
+    // The first save creates the data in the chip, and it isn't measured
+    for (uint32_t s = 0; s <= num_saves; s++)
+    {
+        if (s == 1)
+            eeprom_sim_reset_stats();
+
+        for (uint32_t n = 0; (s > 0) && (n < changes); n++)
+        {
+            uint32_t offset = rand_next() % block_size;
+            if (clear_bits)
+                block[offset] &= ~BIT(rand_next() % 8);
+            else
+                block[offset]++;
+        }
+
+        if (manager)
+        {
+            HOST_CHECK(cardSaveWrite(0, block, block_size) == 0);
+            HOST_CHECK(cardSaveFlush() == 0);
+        }
+        else
+        {
+            if (m->type == 3)
+                cardEepromSectorErase(0);
+            cardWriteEeprom(0, block, block_size, m->type);
+        }
+    }
+
+    HOST_CHECK(memcmp(eeprom_sim_data(), block, block_size) == 0);
+
+    eeprom_sim_stats_t sim;
+    eeprom_sim_get_stats(&sim);
+
+    printf("  %-11s  %7u  %5s  %8s  %10llu  %6u  %8.1f\n", m->name, changes,
+           clear_bits ? "clear" : "any", manager ? "manager" : "rewrite",
+           (unsigned long long)sim.bytes_programmed / num_saves,
+           sim.erases / num_saves, host_ticks_to_ms(sim.busy_ticks) / num_saves);
+
+    if (manager)
+        cardSaveExit();
+    free(block);
+}
+
+// A game saves a block of 8 KiB with a few changes. Compare the save manager
+// with rewriting the whole block.
+static void bench_save(void)
+{
+    const uint32_t changes[] = { 1, 16, 256 };
+
+    printf("Saving a block of 8 KiB (average of 4 saves):\n");
+    printf("  chip         changes   bits    method  bytes prog  erases   ms/save\n");
+
+    for (size_t i = 1; i < NUM_MODELS; i++)
+    {
+        const eeprom_model_t *m = models[i];
+
+        for (size_t c = 0; c < sizeof(changes) / sizeof(changes[0]); c++)
+        {
+            // Only FLASH chips care about the bits that change
+            for (int clear_bits = 0; clear_bits <= (m->type == 3); clear_bits++)
+            {
+                bench_save_block(m, changes[c], clear_bits, false);
+                bench_save_block(m, changes[c], clear_bits, true);
+            }
+        }
+    }
+
+    eeprom_sim_remove();
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    test_errors();
+
+    for (size_t i = 0; i < NUM_MODELS; i++)
+        test_random_writes(models[i]);
+
+    test_last_page();
+    test_flash_erase();
+    test_failures();
+    test_page_wrap();
+
+    bench_save();
+
+    return host_test_result("test_card_save");
+}
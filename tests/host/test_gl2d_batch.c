@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the batch mode of glSprite(). The same frames are drawn right away
+// and in batch mode, and the geometry engine model must receive the same
+// polygons with the same texture state. It also compares the work needed to
+// send the frames in both modes.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gl2d.h>
+#include <nds/arm9/video.h>
+#include <nds/arm9/videoGL.h>
+
+#include "host.h"
+#include "video_sim.h"
+
+#define NUM_TEXTURES    16
+#define MAX_SPRITES     2048
+
+static int textures[NUM_TEXTURES];
+
+static uint32_t rand_state = 0x2545F491;
+
+static uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+// Sprite drawn by a frame
+typedef struct {
+    int x, y;
+    int flipmode;
+    glImage image;
+} sprite_t;
+
+static sprite_t sprites[MAX_SPRITES];
+
+// Polygons received by the model in the last frame, sorted by depth
+static gx_sim_polygon_t frame_polygons[2][MAX_SPRITES];
+static size_t frame_num_polygons[2];
+
+// Half of the textures use 16-color palettes, so the palette base is checked
+// too.
+static void load_textures(void)
+{
+    vramSetBankA(VRAM_A_TEXTURE);
+    vramSetBankE(VRAM_E_TEX_PALETTE);
+
+    HOST_CHECK(glGenTextures(NUM_TEXTURES, textures) == 1);
+
+    static uint16_t texels[64 * 64];
+    static uint16_t palette[16];
+
+    for (int i = 0; i < NUM_TEXTURES; i++)
+    {
+        for (size_t j = 0; j < sizeof(texels) / sizeof(texels[0]); j++)
+            texels[j] = rand_next();
+        for (size_t j = 0; j < sizeof(palette) / sizeof(palette[0]); j++)
+            palette[j] = rand_next() & 0x7FFF;
+
+        glBindTexture(0, textures[i]);
+
+        if (i & 1)
+        {
+            HOST_CHECK(glTexImage2D(0, 0, GL_RGB16, 64, 64, 0,
+                                    TEXGEN_TEXCOORD, texels) == 1);
+            HOST_CHECK(glColorTableNtr(16, palette) == 1);
+        }
+        else
+        {
+            HOST_CHECK(glTexImage2D(0, 0, GL_RGBA, 32, 32, 0,
+                                    TEXGEN_TEXCOORD, texels) == 1);
+        }
+    }
+}
+
+// Random sprites. Consecutive sprites use the same texture some of the time,
+// like tiles of a map or characters of a line of text.
+static void make_sprites(size_t count, int num_textures)
+{
+    int texture = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        sprite_t *s = &sprites[i];
+
+        if ((rand_next() % 4) == 0)
+            texture = rand_next() % num_textures;
+
+        s->x = (int)(rand_next() % 288) - 16;
+        s->y = (int)(rand_next() % 224) - 16;
+        s->flipmode = rand_next() % 4;
+        s->image.width = 1 + rand_next() % 32;
+        s->image.height = 1 + rand_next() % 32;
+        s->image.u_off = rand_next() % 32;
+        s->image.v_off = rand_next() % 32;
+        s->image.textureID = textures[texture];
+    }
+}
+
+static int compare_depth(const void *a, const void *b)
+{
+    const gx_sim_polygon_t *pa = a;
+    const gx_sim_polygon_t *pb = b;
+
+    return pa->z[0] - pb->z[0];
+}
+
+static bool polygons_match(const gx_sim_polygon_t *a, const gx_sim_polygon_t *b)
+{
+    if ((a->num_vertices != b->num_vertices) || (a->tex_format != b->tex_format)
+        || (a->pal_base != b->pal_base) || (a->poly_attr != b->poly_attr)
+        || (a->color != b->color))
+        return false;
+
+    for (int i = 0; i < a->num_vertices; i++)
+    {
+        if ((a->x[i] != b->x[i]) || (a->y[i] != b->y[i]) || (a->z[i] != b->z[i])
+            || (a->texcoord[i] != b->texcoord[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// Draws the sprites in one frame and keeps the polygons sent to the model in
+// frame_polygons[slot].
+static void draw_frame(size_t count, int slot, gx_sim_stats_t *stats)
+{
+    // Make sure that the first sprite binds its texture
+    glBindTexture(0, 0);
+
+    gx_sim_reset();
+    video_sim_capture_gx(true);
+
+    glBegin2D();
+    for (size_t i = 0; i < count; i++)
+        glSprite(sprites[i].x, sprites[i].y, sprites[i].flipmode, &sprites[i].image);
+    glEnd2D();
+
+    video_sim_capture_gx(false);
+
+    gx_sim_get_stats(stats);
+
+    size_t num;
+    const gx_sim_polygon_t *polygons = gx_sim_polygons(&num);
+
+    HOST_CHECK(num == count);
+    if (num > MAX_SPRITES)
+        num = MAX_SPRITES;
+
+    memcpy(frame_polygons[slot], polygons, num * sizeof(gx_sim_polygon_t));
+    frame_num_polygons[slot] = num;
+}
+
+// Number of times the texture changes between consecutive sprites
+static uint32_t texture_changes(size_t start, size_t end)
+{
+    uint32_t changes = 0;
+    for (size_t i = start; i < end; i++)
+    {
+        if ((i == start) || (sprites[i].image.textureID != sprites[i - 1].image.textureID))
+            changes++;
+    }
+    return changes;
+}
+
+static uint32_t distinct_textures(size_t start, size_t end)
+{
+    bool used[NUM_TEXTURES + 1] = { false };
+    uint32_t count = 0;
+
+    for (size_t i = start; i < end; i++)
+    {
+        int id = sprites[i].image.textureID;
+        if (!used[id])
+        {
+            used[id] = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+// The batch is flushed every "batch_size" sprites
+static void test_frame(size_t count, int num_textures, size_t batch_size)
+{
+    gx_sim_stats_t immediate, batch;
+
+    make_sprites(count, num_textures);
+
+    draw_frame(count, 0, &immediate);
+
+    HOST_CHECK(glBatch2DInit(batch_size) == 0);
+    draw_frame(count, 1, &batch);
+    glBatch2DFree();
+
+    // Polygons are sent in the order of the sprites right away, and sorted by
+    // texture in batch mode. The depth of each sprite is unique.
+    const gx_sim_polygon_t *p = frame_polygons[0];
+    for (size_t i = 0; i < frame_num_polygons[0]; i++)
+        HOST_CHECK(p[i].z[0] == (int16_t)i);
+
+    p = frame_polygons[1];
+    for (size_t i = 1; i < frame_num_polygons[1]; i++)
+    {
+        // Inside a flush, a texture is only bound once and sprites keep their
+        // order.
+        if ((size_t)p[i].z[0] / batch_size != (size_t)p[i - 1].z[0] / batch_size)
+            continue;
+
+        if (p[i].tex_format == p[i - 1].tex_format)
+            HOST_CHECK(p[i].z[0] > p[i - 1].z[0]);
+    }
+
+    HOST_CHECK(frame_num_polygons[0] == frame_num_polygons[1]);
+
+    qsort(frame_polygons[1], frame_num_polygons[1], sizeof(gx_sim_polygon_t),
+          compare_depth);
+
+    for (size_t i = 0; i < frame_num_polygons[0]; i++)
+    {
+        if (!polygons_match(&frame_polygons[0][i], &frame_polygons[1][i]))
+        {
+            printf("%zu sprites, batch of %zu: polygon %zu doesn't match\n",
+                   count, batch_size, i);
+            host_checks_failed++;
+            break;
+        }
+    }
+
+    HOST_CHECK(immediate.tex_params == texture_changes(0, count));
+
+    uint32_t binds = 0;
+    for (size_t start = 0; start < count; start += batch_size)
+    {
+        size_t end = (start + batch_size < count) ? start + batch_size : count;
+        binds += distinct_textures(start, end);
+    }
+
+    // The last texture of a flush may be the first one of the next flush
+    HOST_CHECK(batch.tex_params <= binds);
+    HOST_CHECK(batch.tex_params + (count - 1) / batch_size >= binds);
+
+    // Quads are only sent by DMA in batch mode, one list per texture run
+    HOST_CHECK(immediate.dma_words == 0);
+    HOST_CHECK(batch.dma_transfers == binds);
+}
+
+static void test_batch(void)
+{
+    static const size_t counts[] = { 1, 2, 50, 500, MAX_SPRITES };
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        test_frame(counts[c], 1, MAX_SPRITES);
+        test_frame(counts[c], NUM_TEXTURES, MAX_SPRITES);
+
+        // Small buffers that get full in the middle of the frame
+        test_frame(counts[c], NUM_TEXTURES, 7);
+        test_frame(counts[c], 4, 64);
+    }
+
+    // Nothing is drawn if there are no sprites
+    gx_sim_stats_t stats;
+    HOST_CHECK(glBatch2DInit(16) == 0);
+    draw_frame(0, 1, &stats);
+    glBatch2DFree();
+    HOST_CHECK((stats.dma_transfers == 0) && (stats.polygons == 0));
+
+    // Quads recorded outside of glBegin2D() and glEnd2D() are drawn by
+    // glBatch2DFlush() and glBatch2DFree(), not lost.
+    make_sprites(10, NUM_TEXTURES);
+    HOST_CHECK(glBatch2DInit(16) == 0);
+
+    glBegin2D();
+    for (int i = 0; i < 10; i++)
+        glSprite(sprites[i].x, sprites[i].y, sprites[i].flipmode, &sprites[i].image);
+
+    gx_sim_reset();
+    video_sim_capture_gx(true);
+    glBatch2DFlush();
+    video_sim_capture_gx(false);
+    glEnd2D();
+
+    gx_sim_get_stats(&stats);
+    HOST_CHECK(stats.polygons == 10);
+
+    glBatch2DFree();
+}
+
+// Time used by the host CPU to record and send one frame. The GX stores aren't
+// captured, so this is the cost of the code of gl2d and videoGL.
+static double frame_host_ns(size_t count, bool batch, int repeats)
+{
+    if (batch)
+        HOST_CHECK(glBatch2DInit(count) == 0);
+
+    uint64_t start = host_wall_ns();
+
+    for (int r = 0; r < repeats; r++)
+    {
+        glBegin2D();
+        for (size_t i = 0; i < count; i++)
+            glSprite(sprites[i].x, sprites[i].y, sprites[i].flipmode, &sprites[i].image);
+        glEnd2D();
+    }
+
+    uint64_t end = host_wall_ns();
+
+    if (batch)
+        glBatch2DFree();
+
+    return (double)(end - start) / repeats;
+}
+
+// Compares the number of stores done by the CPU to the geometry engine and the
+// number of texture binds per frame.
+static void bench_frames(void)
+{
+    static const size_t counts[] = { 100, 500, 2000 };
+    static const int num_textures[] = { 1, 4, 16 };
+
+    printf("Drawing a frame of sprites with glSprite():\n");
+    printf("  sprites  textures       mode  CPU stores  DMA words  binds  host ns/sprite\n");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        for (size_t t = 0; t < sizeof(num_textures) / sizeof(num_textures[0]); t++)
+        {
+            rand_state = 0x1234;
+            make_sprites(counts[c], num_textures[t]);
+
+            for (int batch = 0; batch <= 1; batch++)
+            {
+                gx_sim_stats_t stats;
+
+                if (batch)
+                    HOST_CHECK(glBatch2DInit(counts[c]) == 0);
+                draw_frame(counts[c], batch, &stats);
+                if (batch)
+                    glBatch2DFree();
+
+                double ns = frame_host_ns(counts[c], batch, 20);
+
+                printf("  %7zu  %8d  %9s  %10u  %9u  %5u  %14.1f\n", counts[c],
+                       num_textures[t], batch ? "batch" : "immediate",
+                       stats.port_writes + stats.fifo_writes, stats.dma_words,
+                       stats.tex_params, ns / counts[c]);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    video_sim_init();
+
+    glScreen2D();
+    load_textures();
+
+    test_batch();
+    bench_frames();
+
+    return host_test_result("test_gl2d_batch");
+}
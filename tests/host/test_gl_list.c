@@ -0,0 +1,614 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the display list builder. The lists recorded by each scene are
+// compared with golden files in "golden/gl_list", and they are unpacked like
+// the geometry engine does to check that they contain the recorded commands.
+//
+// Run "test_gl_list -u" from this folder to write the golden files again after
+// an intended change of the output.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/videoGL.h>
+
+#include "host.h"
+
+#define GOLDEN_DIR  "golden/gl_list"
+
+// The test is linked with "-Wl,--wrap=realloc" to simulate allocation failures.
+// If this is 0 the next call to realloc() fails. It's decremented by every call.
+static int realloc_calls_before_failure = -1;
+
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (realloc_calls_before_failure >= 0)
+    {
+        if (realloc_calls_before_failure-- == 0)
+            return NULL;
+    }
+    return __real_realloc(ptr, size);
+}
+
+// Geometry commands
+// -----------------
+
+typedef struct {
+    const char *name;
+    uint8_t num_params;
+} command_info_t;
+
+// Names and number of parameters of the commands, from the documentation of
+// the hardware. Unused IDs have no name.
+static const command_info_t commands[0x73] = {
+    [0x00] = { "NOP", 0 },
+    [0x10] = { "MTX_MODE", 1 },
+    [0x11] = { "MTX_PUSH", 0 },
+    [0x12] = { "MTX_POP", 1 },
+    [0x13] = { "MTX_STORE", 1 },
+    [0x14] = { "MTX_RESTORE", 1 },
+    [0x15] = { "MTX_IDENTITY", 0 },
+    [0x16] = { "MTX_LOAD_4x4", 16 },
+    [0x17] = { "MTX_LOAD_4x3", 12 },
+    [0x18] = { "MTX_MULT_4x4", 16 },
+    [0x19] = { "MTX_MULT_4x3", 12 },
+    [0x1A] = { "MTX_MULT_3x3", 9 },
+    [0x1B] = { "MTX_SCALE", 3 },
+    [0x1C] = { "MTX_TRANS", 3 },
+    [0x20] = { "COLOR", 1 },
+    [0x21] = { "NORMAL", 1 },
+    [0x22] = { "TEXCOORD", 1 },
+    [0x23] = { "VTX_16", 2 },
+    [0x24] = { "VTX_10", 1 },
+    [0x25] = { "VTX_XY", 1 },
+    [0x26] = { "VTX_XZ", 1 },
+    [0x27] = { "VTX_YZ", 1 },
+    [0x28] = { "VTX_DIFF", 1 },
+    [0x29] = { "POLYGON_ATTR", 1 },
+    [0x2A] = { "TEXIMAGE_PARAM", 1 },
+    [0x2B] = { "PLTT_BASE", 1 },
+    [0x30] = { "DIF_AMB", 1 },
+    [0x31] = { "SPE_EMI", 1 },
+    [0x32] = { "LIGHT_VECTOR", 1 },
+    [0x33] = { "LIGHT_COLOR", 1 },
+    [0x34] = { "SHININESS", 32 },
+    [0x40] = { "BEGIN_VTXS", 1 },
+    [0x41] = { "END_VTXS", 0 },
+    [0x50] = { "SWAP_BUFFERS", 1 },
+    [0x60] = { "VIEWPORT", 1 },
+    [0x70] = { "BOX_TEST", 3 },
+    [0x71] = { "POS_TEST", 2 },
+    [0x72] = { "VEC_TEST", 1 },
+};
+
+#define NUM_COMMAND_IDS (sizeof(commands) / sizeof(commands[0]))
+
+// Commands recorded by a scene, in the order they were sent
+#define MAX_LOG_COMMANDS    4096
+#define MAX_LOG_PARAMS      (MAX_LOG_COMMANDS * 4)
+
+typedef struct {
+    uint32_t num_commands;
+    uint8_t ids[MAX_LOG_COMMANDS];
+    uint32_t num_params;
+    u32 params[MAX_LOG_PARAMS];
+} command_log_t;
+
+static command_log_t expected;
+static command_log_t unpacked;
+
+static void log_command(command_log_t *log, uint8_t id, const u32 *params,
+                        size_t num_params)
+{
+    if ((log->num_commands == MAX_LOG_COMMANDS)
+        || (log->num_params + num_params > MAX_LOG_PARAMS))
+    {
+        printf("command log full\n");
+        abort();
+    }
+
+    log->ids[log->num_commands++] = id;
+    memcpy(log->params + log->num_params, params, num_params * sizeof(u32));
+    log->num_params += num_params;
+}
+
+// Unpacking
+// ---------
+
+// Reads a finished list like the geometry engine reads the words sent to
+// GXFIFO. The commands are added to "unpacked" and, if "out" isn't NULL, a
+// description of each word is written to it. Returns false if the list isn't
+// valid.
+static bool unpack_list(const u32 *list, FILE *out)
+{
+    memset(&unpacked, 0, sizeof(unpacked));
+
+    uint32_t size = list[0];
+    if (out != NULL)
+        fprintf(out, "%04X  %08X  size\n", 0, size);
+
+    if (size == 0)
+        return false;
+
+    uint32_t pos = 1;
+    while (pos <= size)
+    {
+        u32 header = list[pos];
+        if (out != NULL)
+        {
+            fprintf(out, "%04X  %08X  header", pos, header);
+            for (int i = 0; i < 4; i++)
+            {
+                uint8_t id = header >> (i * 8);
+                if (id != 0)
+                    fprintf(out, " %s", commands[id].name);
+            }
+            fprintf(out, "\n");
+        }
+        pos++;
+
+        uint32_t header_params = 0;
+
+        for (int i = 0; i < 4; i++)
+        {
+            uint8_t id = header >> (i * 8);
+
+            if ((id >= NUM_COMMAND_IDS) || (commands[id].name == NULL))
+                return false;
+
+            // NOPs inside a header are skipped
+            if (id == 0)
+                continue;
+
+            uint32_t n = commands[id].num_params;
+            if (pos + n > size + 1)
+                return false;
+
+            for (uint32_t p = 0; p < n; p++)
+            {
+                if (out != NULL)
+                {
+                    fprintf(out, "%04X  %08X    %s[%u]\n", pos + p,
+                            list[pos + p], commands[id].name, p);
+                }
+            }
+
+            log_command(&unpacked, id, list + pos, n);
+            pos += n;
+            header_params += n;
+        }
+
+        // A header with commands but no parameters is followed by a dummy
+        // parameter. A header of four NOPs is just skipped.
+        if ((header != 0) && (header_params == 0))
+        {
+            if (pos > size)
+                return false;
+
+            if (out != NULL)
+                fprintf(out, "%04X  %08X    (dummy)\n", pos, list[pos]);
+            pos++;
+        }
+    }
+
+    return pos == size + 1;
+}
+
+static bool logs_match(const command_log_t *a, const command_log_t *b)
+{
+    return (a->num_commands == b->num_commands)
+        && (a->num_params == b->num_params)
+        && (memcmp(a->ids, b->ids, a->num_commands) == 0)
+        && (memcmp(a->params, b->params, a->num_params * sizeof(u32)) == 0);
+}
+
+// Scenes
+// ------
+
+// Adds a command to the log of commands that the list must contain. The scenes
+// call it after recording each command.
+static void expect(uint8_t id, const u32 *params, size_t num_params)
+{
+    log_command(&expected, id, params, num_params);
+}
+
+static void expect0(uint8_t id)
+{
+    expect(id, NULL, 0);
+}
+
+static void expect1(uint8_t id, u32 param)
+{
+    expect(id, &param, 1);
+}
+
+static void scene_empty(gl_list_t *list)
+{
+    (void)list;
+}
+
+// A textured quad recorded with the inline wrappers
+static void scene_quad(gl_list_t *list)
+{
+    glListPolyFmt(list, POLY_ALPHA(31) | POLY_CULL_NONE);
+    expect1(FIFO_POLY_FORMAT, POLY_ALPHA(31) | POLY_CULL_NONE);
+
+    glListBegin(list, GL_QUADS);
+    expect1(FIFO_BEGIN, GL_QUADS);
+
+    glListColor(list, RGB15(31, 31, 31));
+    expect1(FIFO_COLOR, RGB15(31, 31, 31));
+
+    static const v16 vertices[4][2] = {
+        { -4096, -4096 }, { 4096, -4096 }, { 4096, 4096 }, { -4096, 4096 },
+    };
+    static const t16 texcoords[4][2] = {
+        { 0, 0 }, { 1024, 0 }, { 1024, 1024 }, { 0, 1024 },
+    };
+
+    for (int i = 0; i < 4; i++)
+    {
+        t16 u = texcoords[i][0];
+        t16 v = texcoords[i][1];
+        v16 x = vertices[i][0];
+        v16 y = vertices[i][1];
+
+        glListTexCoord2t16(list, u, v);
+        expect1(FIFO_TEX_COORD, TEXTURE_PACK(u, v));
+
+        glListVertex3v16(list, x, y, -512);
+        u32 params[2] = { ((u32)(u16)y << 16) | (u16)x, (u16)-512 };
+        expect(FIFO_VERTEX16, params, 2);
+    }
+
+    glListEnd(list);
+    expect0(FIFO_END);
+}
+
+// Matrix commands, several of them without parameters
+static void scene_matrices(gl_list_t *list)
+{
+    glListMatrixMode(list, GL_MODELVIEW);
+    expect1(FIFO_MATRIX_MODE, GL_MODELVIEW);
+
+    glListPushMatrix(list);
+    expect0(FIFO_MATRIX_PUSH);
+
+    glListLoadIdentity(list);
+    expect0(FIFO_MATRIX_IDENTITY);
+
+    glListTranslatef32(list, inttof32(1), -inttof32(2), inttof32(3));
+    u32 trans[3] = { inttof32(1), -inttof32(2), inttof32(3) };
+    expect(FIFO_MATRIX_TRANSLATE, trans, 3);
+
+    glListScalef32(list, inttof32(2), inttof32(2), inttof32(2));
+    u32 scale[3] = { inttof32(2), inttof32(2), inttof32(2) };
+    expect(FIFO_MATRIX_SCALE, scale, 3);
+
+    glListPopMatrix(list, 1);
+    expect1(FIFO_MATRIX_POP, 1);
+}
+
+// Four commands without parameters in the same header need a dummy parameter,
+// and so does a single one at the end of the list.
+static void scene_no_params(gl_list_t *list)
+{
+    glListPushMatrix(list);
+    expect0(FIFO_MATRIX_PUSH);
+    glListLoadIdentity(list);
+    expect0(FIFO_MATRIX_IDENTITY);
+    glListEnd(list);
+    expect0(FIFO_END);
+    glListPushMatrix(list);
+    expect0(FIFO_MATRIX_PUSH);
+
+    glListLoadIdentity(list);
+    expect0(FIFO_MATRIX_IDENTITY);
+}
+
+// A lit cube with normals, drawn with glListVertex2v16() where possible
+static void scene_cube(gl_list_t *list)
+{
+    static const v16 corners[8][3] = {
+        { -1024, -1024, -1024 }, { 1024, -1024, -1024 },
+        { 1024, 1024, -1024 }, { -1024, 1024, -1024 },
+        { -1024, -1024, 1024 }, { 1024, -1024, 1024 },
+        { 1024, 1024, 1024 }, { -1024, 1024, 1024 },
+    };
+    static const uint8_t faces[6][4] = {
+        { 0, 1, 2, 3 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 },
+        { 2, 3, 7, 6 }, { 0, 3, 7, 4 }, { 1, 2, 6, 5 },
+    };
+    static const int normals[6][3] = {
+        { 0, 0, -511 }, { 0, 0, 511 }, { 0, -511, 0 },
+        { 0, 511, 0 }, { -511, 0, 0 }, { 511, 0, 0 },
+    };
+
+    glListBegin(list, GL_QUADS);
+    expect1(FIFO_BEGIN, GL_QUADS);
+
+    for (int f = 0; f < 6; f++)
+    {
+        u32 normal = NORMAL_PACK(normals[f][0], normals[f][1], normals[f][2]);
+        glListNormal(list, normal);
+        expect1(FIFO_NORMAL, normal);
+
+        for (int i = 0; i < 4; i++)
+        {
+            const v16 *c = corners[faces[f][i]];
+            const v16 *prev = corners[faces[f][(i + 3) % 4]];
+
+            // The first vertex of each face sets Z for the rest
+            if ((i > 0) && (c[2] == prev[2]))
+            {
+                glListVertex2v16(list, c[0], c[1]);
+                expect1(FIFO_VERTEX_XY, ((u32)(u16)c[1] << 16) | (u16)c[0]);
+            }
+            else
+            {
+                glListVertex3v16(list, c[0], c[1], c[2]);
+                u32 params[2] = { ((u32)(u16)c[1] << 16) | (u16)c[0], (u16)c[2] };
+                expect(FIFO_VERTEX16, params, 2);
+            }
+        }
+    }
+
+    glListEnd(list);
+    expect0(FIFO_END);
+}
+
+// Every command with parameters that depend on its ID
+static void scene_all_commands(gl_list_t *list)
+{
+    for (uint32_t id = 0; id < NUM_COMMAND_IDS; id++)
+    {
+        if ((id == 0) || (commands[id].name == NULL))
+            continue;
+
+        u32 params[32];
+        for (uint32_t p = 0; p < commands[id].num_params; p++)
+            params[p] = (id << 16) | p;
+
+        glListCommand(list, id, params, commands[id].num_params);
+        expect(id, params, commands[id].num_params);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*record)(gl_list_t *list);
+} scene_t;
+
+static const scene_t scenes[] = {
+    { "empty", scene_empty },
+    { "quad", scene_quad },
+    { "matrices", scene_matrices },
+    { "no_params", scene_no_params },
+    { "cube", scene_cube },
+    { "all_commands", scene_all_commands },
+};
+
+#define NUM_SCENES  (sizeof(scenes) / sizeof(scenes[0]))
+
+// Golden files
+// ------------
+
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = malloc(size + 1);
+    if (fread(data, 1, size, f) != (size_t)size)
+    {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    data[size] = '\0';
+
+    fclose(f);
+    return data;
+}
+
+// Compares the dump of the list with the golden file, or replaces the golden
+// file if "update" is true.
+static void check_golden(const char *name, const u32 *list, bool update)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.txt", GOLDEN_DIR, name);
+
+    char *dump = NULL;
+    size_t dump_size = 0;
+    FILE *out = open_memstream(&dump, &dump_size);
+    unpack_list(list, out);
+    fclose(out);
+
+    if (update)
+    {
+        FILE *f = fopen(path, "wb");
+        HOST_CHECK(f != NULL);
+        if (f != NULL)
+        {
+            fwrite(dump, 1, dump_size, f);
+            fclose(f);
+        }
+        free(dump);
+        return;
+    }
+
+    char *golden = read_file(path);
+    if (golden == NULL)
+    {
+        printf("%s: can't read golden file\n", path);
+        host_checks_failed++;
+    }
+    else if (strcmp(golden, dump) != 0)
+    {
+        printf("%s: the list doesn't match the golden file:\n%s", path, dump);
+        host_checks_failed++;
+    }
+
+    free(golden);
+    free(dump);
+}
+
+// Tests
+// -----
+
+static void test_scenes(bool update)
+{
+    for (size_t s = 0; s < NUM_SCENES; s++)
+    {
+        const scene_t *scene = &scenes[s];
+        gl_list_t list;
+
+        // Start with the smallest buffer so that it has to grow
+        HOST_CHECK(glListInit(&list, 0) == 0);
+
+        memset(&expected, 0, sizeof(expected));
+        scene->record(&list);
+
+        const u32 *packed = glListFinish(&list);
+        HOST_CHECK(packed != NULL);
+        if (packed == NULL)
+        {
+            glListFree(&list);
+            continue;
+        }
+
+        HOST_CHECK(packed[0] == list.size - 1);
+
+        if (!unpack_list(packed, NULL) || !logs_match(&expected, &unpacked))
+        {
+            printf("%s: the list doesn't contain the recorded commands\n", scene->name);
+            host_checks_failed++;
+        }
+
+        check_golden(scene->name, packed, update);
+
+        // Recording the scene again after a reset gives the same list
+        u32 *copy = malloc(list.size * sizeof(u32));
+        memcpy(copy, packed, list.size * sizeof(u32));
+        uint32_t size = list.size;
+
+        glListReset(&list);
+        memset(&expected, 0, sizeof(expected));
+        scene->record(&list);
+        packed = glListFinish(&list);
+
+        HOST_CHECK(packed != NULL);
+        HOST_CHECK(list.size == size);
+        HOST_CHECK((packed != NULL) && (memcmp(packed, copy, size * sizeof(u32)) == 0));
+
+        free(copy);
+        glListFree(&list);
+        HOST_CHECK(list.buffer == NULL);
+    }
+}
+
+// Commands can be added after finishing a list, and the next call to
+// glListFinish() includes them.
+static void test_append(void)
+{
+    gl_list_t list;
+    HOST_CHECK(glListInit(&list, 64) == 0);
+
+    memset(&expected, 0, sizeof(expected));
+    scene_quad(&list);
+    HOST_CHECK(glListFinish(&list) != NULL);
+    scene_matrices(&list);
+
+    const u32 *packed = glListFinish(&list);
+    HOST_CHECK(packed != NULL);
+    HOST_CHECK(unpack_list(packed, NULL) && logs_match(&expected, &unpacked));
+
+    glListFree(&list);
+}
+
+static void test_out_of_memory(void)
+{
+    for (int calls = 0; calls < 4; calls++)
+    {
+        gl_list_t list;
+        HOST_CHECK(glListInit(&list, 0) == 0);
+
+        memset(&expected, 0, sizeof(expected));
+        realloc_calls_before_failure = calls;
+        scene_cube(&list);
+        realloc_calls_before_failure = -1;
+
+        // The error is only reported when the list is finished
+        HOST_CHECK(list.error);
+        HOST_CHECK(glListFinish(&list) == NULL);
+
+        // A reset clears the error, and the buffer can grow again
+        glListReset(&list);
+        HOST_CHECK(!list.error);
+
+        memset(&expected, 0, sizeof(expected));
+        scene_cube(&list);
+        const u32 *packed = glListFinish(&list);
+        HOST_CHECK(packed != NULL);
+        HOST_CHECK(unpack_list(packed, NULL) && logs_match(&expected, &unpacked));
+
+        glListFree(&list);
+    }
+}
+
+// Compares the number of words sent to the GPU by a packed list with the
+// number of register writes that immediate mode needs for the same commands.
+static void print_sizes(void)
+{
+    printf("Words sent to the geometry engine:\n");
+    printf("  scene         commands  immediate  packed list\n");
+
+    for (size_t s = 1; s < NUM_SCENES; s++)
+    {
+        gl_list_t list;
+        HOST_CHECK(glListInit(&list, 0) == 0);
+
+        memset(&expected, 0, sizeof(expected));
+        scenes[s].record(&list);
+        HOST_CHECK(glListFinish(&list) != NULL);
+
+        // Immediate mode writes every parameter to the register of the
+        // command, and commands without parameters need one write.
+        uint32_t writes = 0;
+        for (uint32_t i = 0; i < expected.num_commands; i++)
+        {
+            uint32_t n = commands[expected.ids[i]].num_params;
+            writes += (n == 0) ? 1 : n;
+        }
+
+        printf("  %-12s  %8u  %9u  %11u\n", scenes[s].name,
+               expected.num_commands, writes, list.size - 1);
+
+        glListFree(&list);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool update = (argc > 1) && (strcmp(argv[1], "-u") == 0);
+
+    test_scenes(update);
+    test_append();
+    test_out_of_memory();
+
+    print_sizes();
+
+    return host_test_result("test_gl_list");
+}
@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the automatic look-up caches of FAT files, and comparison of the
+// time needed to seek in fragmented files with and without them. Files are
+// created by FatFs in a FAT volume of a simulated device, and they are opened
+// and seeked with the open() and lseek() of filesystem.c.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "cache.h"
+#include "filesystem_internal.h"
+
+#include "disc_sim.h"
+#include "fat_volume.h"
+#include "host.h"
+#include "nds_syscalls.h"
+
+#define DRIVE               FAT_IO_DRIVE_DLDI
+#define SECTOR_SIZE         512
+#define CLUSTER_SIZE        4096
+#define VOLUME_SECTORS      (64 * 1024 * 1024 / SECTOR_SIZE)
+
+static FATFS fs;
+
+// The test is linked with "-Wl,--wrap=realloc" to simulate allocation failures.
+// If this is 0 the next call to realloc() fails. It's decremented by every call.
+static int realloc_calls_before_failure = -1;
+
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (realloc_calls_before_failure >= 0)
+    {
+        if (realloc_calls_before_failure-- == 0)
+            return NULL;
+    }
+    return __real_realloc(ptr, size);
+}
+
+// The test is linked with "-Wl,--wrap=f_lseek" to count the link maps created
+// by fatfs.c.
+static uint32_t linkmaps;
+
+FRESULT __real_f_lseek(FIL *fp, FSIZE_t ofs);
+
+FRESULT __wrap_f_lseek(FIL *fp, FSIZE_t ofs)
+{
+    if (ofs == CREATE_LINKMAP)
+        linkmaps++;
+    return __real_f_lseek(fp, ofs);
+}
+
+// The test is linked with "-Wl,--wrap=disk_read" to count the reads of FAT
+// sectors done by FatFs, whether they are found in the sector cache or not.
+static uint32_t fat_reads;
+
+DRESULT __real_disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count);
+
+DRESULT __wrap_disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    if ((sector < fs.fatbase + fs.fsize) && (sector + count > fs.fatbase))
+        fat_reads++;
+    return __real_disk_read(pdrv, buff, sector, count);
+}
+
+typedef struct {
+    int fd;
+    fat_file_t *file;
+    uint32_t *clusters;
+    uint32_t num_clusters;
+    uint32_t fragments;
+} test_file_t;
+
+static uint8_t cluster_data[CLUSTER_SIZE];
+
+// Formats the volume and creates a file of the specified number of clusters
+// split in "fragments" fragments. Each time a fragment ends a cluster is added
+// to another file, so there is a used cluster between fragments. The file is
+// opened with open() with the specified flags.
+static void create_file(test_file_t *t, uint32_t num_clusters,
+                        uint32_t fragments, int flags)
+{
+    memset(t, 0, sizeof(test_file_t));
+    t->fd = -1;
+
+    HOST_CHECK(fat_volume_format(&fs, DRIVE, FM_FAT, CLUSTER_SIZE) == FR_OK);
+
+    FIL file, spacer;
+    HOST_CHECK(f_open(&file, "file.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+    HOST_CHECK(f_open(&spacer, "spacer.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+
+    for (uint32_t i = 0; i < num_clusters; i++)
+    {
+        UINT bw;
+
+        // Start a new fragment
+        if ((i > 0) && ((uint64_t)i * fragments / num_clusters
+                        != (uint64_t)(i - 1) * fragments / num_clusters))
+        {
+            HOST_CHECK(f_write(&spacer, cluster_data, CLUSTER_SIZE, &bw) == FR_OK);
+        }
+
+        HOST_CHECK(f_write(&file, cluster_data, CLUSTER_SIZE, &bw) == FR_OK);
+    }
+
+    DWORD first_cluster = file.obj.sclust;
+
+    HOST_CHECK(f_close(&spacer) == FR_OK);
+    HOST_CHECK(f_close(&file) == FR_OK);
+
+    // Read the chain of the file from the FAT of the device
+    t->clusters = malloc(num_clusters * sizeof(uint32_t));
+    t->num_clusters = fat_volume_chain(&fs, first_cluster, t->clusters, num_clusters);
+    HOST_CHECK(t->num_clusters == num_clusters);
+    t->num_clusters = num_clusters;
+
+    t->fragments = fat_volume_fragments(t->clusters, num_clusters);
+    HOST_CHECK(t->fragments == fragments);
+
+    t->fd = nds_open("file.bin", flags);
+    HOST_CHECK(t->fd != -1);
+    t->file = (fat_file_t *)FD_FAT_UNPACK(t->fd);
+}
+
+static void close_file(test_file_t *t)
+{
+    HOST_CHECK(nds_close(t->fd) == 0);
+    free(t->clusters);
+}
+
+static DWORD *lookup_table(test_file_t *t)
+{
+    return t->file->fil.cltbl;
+}
+
+// Seeks with lseek() and reads a byte, which makes FatFs find the cluster of
+// the new offset.
+static bool seek(test_file_t *t, FSIZE_t offset)
+{
+    if (nds_lseek(t->fd, offset, SEEK_SET) != (off_t)offset)
+        return false;
+
+    uint8_t byte;
+    if (nds_read(t->fd, &byte, 1) != 1)
+        return false;
+
+    // Check that FatFs has found the right cluster
+    FIL *fp = &t->file->fil;
+    return (fp->fptr == offset + 1)
+           && (fp->clust == t->clusters[offset / CLUSTER_SIZE]);
+}
+
+static void test_config(void)
+{
+    errno = 0;
+    HOST_CHECK(fatSetAutoLookupCache(0, 8) == -1);
+    HOST_CHECK(errno == EINVAL);
+
+    HOST_CHECK(fatSetAutoLookupCache(0, 16) == 0);
+    HOST_CHECK(fatSetAutoLookupCache(0, 0) == 0);
+
+    // Disabled: files never get a look-up cache
+    test_file_t t;
+    create_file(&t, 1024, 10, O_RDONLY);
+    HOST_CHECK(seek(&t, 1000 * CLUSTER_SIZE + 1));
+    HOST_CHECK(seek(&t, 1));
+    HOST_CHECK(lookup_table(&t) == NULL);
+    close_file(&t);
+}
+
+// Only long seeks in big files opened in read-only mode create a cache
+static void test_policy(void)
+{
+    HOST_CHECK(fatSetAutoLookupCache(1024 * 1024, 4096) == 0);
+
+    test_file_t t;
+
+    // Too small
+    create_file(&t, 64, 10, O_RDONLY);
+    HOST_CHECK(seek(&t, 60 * CLUSTER_SIZE + 1));
+    HOST_CHECK(seek(&t, 1));
+    HOST_CHECK(lookup_table(&t) == NULL);
+    close_file(&t);
+
+    // Opened with write access
+    create_file(&t, 1024, 10, O_RDWR);
+    HOST_CHECK(seek(&t, 1000 * CLUSTER_SIZE + 1));
+    HOST_CHECK(seek(&t, 1));
+    HOST_CHECK(lookup_table(&t) == NULL);
+    close_file(&t);
+
+    create_file(&t, 1024, 10, O_RDONLY);
+
+    // Short forward seeks and backward seeks inside the current cluster
+    HOST_CHECK(seek(&t, 5 * CLUSTER_SIZE + 100));
+    HOST_CHECK(seek(&t, 10 * CLUSTER_SIZE + 100));
+    HOST_CHECK(seek(&t, 10 * CLUSTER_SIZE + 10));
+    HOST_CHECK(lookup_table(&t) == NULL);
+
+    // Backward seek to a different cluster
+    HOST_CHECK(seek(&t, 3 * CLUSTER_SIZE));
+    HOST_CHECK(lookup_table(&t) != NULL);
+
+    // The table has been reduced to the size needed by the file: size, two
+    // words per fragment and a terminator.
+    if (lookup_table(&t) != NULL)
+        HOST_CHECK(lookup_table(&t)[0] == 2 + t.fragments * 2);
+
+    // Seeks don't read the FAT anymore
+    fat_reads = 0;
+    for (uint32_t i = 0; i < 100; i++)
+        HOST_CHECK(seek(&t, ((i * 37) % 1024) * CLUSTER_SIZE + 7));
+    HOST_CHECK(fat_reads == 0);
+
+    close_file(&t);
+
+    // Long forward seek
+    create_file(&t, 1024, 10, O_RDONLY);
+    HOST_CHECK(seek(&t, 100 * CLUSTER_SIZE));
+    HOST_CHECK(lookup_table(&t) != NULL);
+    close_file(&t);
+}
+
+// Tables start small and grow to the size needed by the file
+static void test_growth(void)
+{
+    HOST_CHECK(fatSetAutoLookupCache(0, 64 * 1024) == 0);
+
+    test_file_t t;
+    create_file(&t, 4096, 500, O_RDONLY);
+
+    linkmaps = 0;
+    HOST_CHECK(seek(&t, 4000 * CLUSTER_SIZE + 3));
+    HOST_CHECK(lookup_table(&t) != NULL);
+    if (lookup_table(&t) != NULL)
+        HOST_CHECK(lookup_table(&t)[0] == 2 + t.fragments * 2);
+    HOST_CHECK(linkmaps == 2);
+
+    for (uint32_t i = 0; i < 4096; i += 7)
+        HOST_CHECK(seek(&t, (FSIZE_t)i * CLUSTER_SIZE + 1));
+
+    HOST_CHECK(linkmaps == 2);
+
+    close_file(&t);
+}
+
+// Files that don't fit in the maximum size never get a table
+static void test_too_fragmented(void)
+{
+    HOST_CHECK(fatSetAutoLookupCache(0, 1024) == 0);
+
+    test_file_t t;
+    create_file(&t, 4096, 500, O_RDONLY);
+
+    linkmaps = 0;
+    HOST_CHECK(seek(&t, 4000 * CLUSTER_SIZE + 3));
+    HOST_CHECK(lookup_table(&t) == NULL);
+    HOST_CHECK(t.file->lookup_cache_failed);
+
+    uint32_t count = linkmaps;
+    HOST_CHECK(count > 0);
+
+    // The cluster chain isn't walked again to create the table
+    HOST_CHECK(seek(&t, 1));
+    HOST_CHECK(seek(&t, 4000 * CLUSTER_SIZE + 3));
+    HOST_CHECK(linkmaps == count);
+
+    close_file(&t);
+}
+
+// Running out of memory isn't permanent, the table is created in a later seek
+static void test_alloc_failure(void)
+{
+    HOST_CHECK(fatSetAutoLookupCache(0, 64 * 1024) == 0);
+
+    // Fail the first allocation, and the one done to grow the table
+    for (int calls = 0; calls < 2; calls++)
+    {
+        test_file_t t;
+        create_file(&t, 4096, 500, O_RDONLY);
+
+        realloc_calls_before_failure = calls;
+        HOST_CHECK(seek(&t, 4000 * CLUSTER_SIZE + 3));
+        HOST_CHECK(lookup_table(&t) == NULL);
+        HOST_CHECK(!t.file->lookup_cache_failed);
+
+        realloc_calls_before_failure = -1;
+        HOST_CHECK(seek(&t, 1));
+        HOST_CHECK(lookup_table(&t) != NULL);
+
+        close_file(&t);
+    }
+}
+
+// Random seeks in a big file with different amounts of fragmentation
+static void bench_seek(void)
+{
+    const uint32_t num_clusters = 8192;
+    const uint32_t fragments[] = { 1, 64, 512, 4096 };
+    const uint32_t num_seeks = 2000;
+
+    printf("Random seeks in a file of %u MiB (%u KiB clusters, 16 sector cache):\n",
+           num_clusters * CLUSTER_SIZE / (1024 * 1024), CLUSTER_SIZE / 1024);
+    printf("  fragments  lookup  FAT reads  dev reads   us/seek\n");
+
+    for (size_t f = 0; f < sizeof(fragments) / sizeof(fragments[0]); f++)
+    {
+        for (int mode = 0; mode < 2; mode++)
+        {
+            HOST_CHECK(fatSetAutoLookupCache(0, mode ? 64 * 1024 : 0) == 0);
+
+            test_file_t t;
+            create_file(&t, num_clusters, fragments[f], O_RDONLY);
+
+            // Start with an empty cache
+            cache_deinit();
+            HOST_CHECK(cache_init(16) == 0);
+
+            fat_reads = 0;
+            disc_sim_reset_stats(DRIVE);
+            uint64_t start = host_clock_ticks();
+
+            uint32_t state = 0xACE1;
+            for (uint32_t i = 0; i < num_seeks; i++)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+
+                FSIZE_t offset = (FSIZE_t)(state % num_clusters) * CLUSTER_SIZE + 100;
+                if (!seek(&t, offset))
+                    host_checks_failed++;
+            }
+
+            double us = host_ticks_to_ms(host_clock_ticks() - start) * 1000;
+
+            disc_sim_stats_t dev;
+            disc_sim_get_stats(DRIVE, &dev);
+
+            printf("  %9u  %6s  %9.1f  %9.2f  %8.1f\n", fragments[f],
+                   mode ? "auto" : "none", (double)fat_reads / num_seeks,
+                   (double)dev.reads / num_seeks, us / num_seeks);
+
+            close_file(&t);
+        }
+    }
+
+    HOST_CHECK(fatSetAutoLookupCache(0, 0) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+
+    // File descriptors of filesystem.c contain pointers
+    host_use_low_heap(argv);
+
+    if (disc_sim_attach(DRIVE, &disc_model_dldi, NULL, VOLUME_SECTORS) != 0)
+        return 1;
+
+    HOST_CHECK(cache_init(16) == 0);
+
+    test_config();
+    test_policy();
+    test_growth();
+    test_too_fragmented();
+    test_alloc_failure();
+
+    bench_seek();
+
+    cache_deinit();
+
+    fat_volume_unmount(DRIVE);
+    disc_sim_detach(DRIVE);
+
+    return host_test_result("test_lookup_cache");
+}
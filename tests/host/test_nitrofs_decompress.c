@@ -0,0 +1,1086 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the transparent decompression of NitroFS files, and comparison of
+// the time needed to load compressed and uncompressed assets.
+//
+// The files are compressed by the encoders of this file. They are independent
+// from the decoders of the library, and a few hand-made files check that both
+// of them follow the format of the BIOS, or the LZ4 block format.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem.h>
+
+#include "nitrofs_internal.h"
+
+#include "host.h"
+#include "nitrofs_sim.h"
+
+#define TYPE_LZ77       0x10
+#define TYPE_HUFF4      0x24
+#define TYPE_HUFF8      0x28
+#define TYPE_RLE        0x30
+#define TYPE_LZ4        0x60
+
+// Output buffer of the encoders
+// -----------------------------
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t max_size;
+} buffer_t;
+
+static void buffer_put(buffer_t *b, uint8_t value)
+{
+    if (b->size == b->max_size)
+    {
+        b->max_size = (b->max_size == 0) ? 1024 : b->max_size * 2;
+        b->data = realloc(b->data, b->max_size);
+        if (b->data == NULL)
+        {
+            printf("out of memory\n");
+            abort();
+        }
+    }
+
+    b->data[b->size++] = value;
+}
+
+static void buffer_put_header(buffer_t *b, uint8_t type, size_t size)
+{
+    buffer_put(b, type);
+    buffer_put(b, size);
+    buffer_put(b, size >> 8);
+    buffer_put(b, size >> 16);
+}
+
+// Encoders
+// --------
+
+// Greedy LZ77 with hash chains. Matches are 3 to 18 bytes long, and they can
+// start up to 4096 bytes before the current position.
+#define LZ77_HASH_SIZE  4096
+#define LZ77_MAX_CHAIN  64
+
+static uint32_t lz77_hash(const uint8_t *p)
+{
+    return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & (LZ77_HASH_SIZE - 1);
+}
+
+static void encode_lz77(buffer_t *b, const uint8_t *src, size_t size)
+{
+    int32_t *head = malloc(LZ77_HASH_SIZE * sizeof(int32_t));
+    int32_t *prev = malloc(size * sizeof(int32_t));
+    for (size_t i = 0; i < LZ77_HASH_SIZE; i++)
+        head[i] = -1;
+
+    buffer_put_header(b, TYPE_LZ77, size);
+
+    size_t pos = 0;
+    size_t inserted = 0;
+
+    while (pos < size)
+    {
+        size_t flags_pos = b->size;
+        buffer_put(b, 0);
+
+        for (int block = 0; (block < 8) && (pos < size); block++)
+        {
+            // Add the positions before the current one to the hash chains
+            for (; (inserted < pos) && (inserted + 3 <= size); inserted++)
+            {
+                uint32_t h = lz77_hash(src + inserted);
+                prev[inserted] = head[h];
+                head[h] = inserted;
+            }
+
+            size_t best_len = 0;
+            size_t best_disp = 0;
+
+            if (pos + 3 <= size)
+            {
+                int32_t cand = head[lz77_hash(src + pos)];
+                for (int n = 0; (cand >= 0) && (n < LZ77_MAX_CHAIN); n++)
+                {
+                    size_t disp = pos - cand;
+                    if (disp > 0x1000)
+                        break;
+
+                    size_t len = 0;
+                    while ((len < 18) && (pos + len < size)
+                           && (src[cand + len] == src[pos + len]))
+                        len++;
+
+                    if (len > best_len)
+                    {
+                        best_len = len;
+                        best_disp = disp;
+                    }
+
+                    cand = prev[cand];
+                }
+            }
+
+            if (best_len >= 3)
+            {
+                b->data[flags_pos] |= 0x80 >> block;
+                buffer_put(b, ((best_len - 3) << 4) | ((best_disp - 1) >> 8));
+                buffer_put(b, best_disp - 1);
+                pos += best_len;
+            }
+            else
+            {
+                buffer_put(b, src[pos]);
+                pos++;
+            }
+        }
+    }
+
+    free(prev);
+    free(head);
+}
+
+// Greedy LZ4 block with hash chains. Matches are at least 4 bytes long, and
+// they can start up to 65535 bytes before the current position. Like the
+// reference encoder, the last 5 bytes are always literals and the last match
+// starts at least 12 bytes before the end of the data.
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5
+#define LZ4_MF_LIMIT        12
+
+static uint32_t lz4_hash(const uint8_t *p)
+{
+    return ((p[0] << 8) ^ (p[1] << 5) ^ (p[2] << 2) ^ p[3]) & (LZ77_HASH_SIZE - 1);
+}
+
+// Lengths of 15 or more are stored as 15 in the token, followed by the rest
+// of the length in bytes of 255 and a final byte smaller than 255.
+static void lz4_put_length(buffer_t *b, size_t length)
+{
+    for (length -= 15; length >= 255; length -= 255)
+        buffer_put(b, 255);
+    buffer_put(b, length);
+}
+
+// A match length of 0 means that the sequence only has literals
+static void lz4_put_sequence(buffer_t *b, const uint8_t *literals, size_t num_literals,
+                             size_t disp, size_t match_len)
+{
+    size_t ml = (match_len > 0) ? match_len - LZ4_MIN_MATCH : 0;
+
+    buffer_put(b, ((num_literals < 15 ? num_literals : 15) << 4) | (ml < 15 ? ml : 15));
+
+    if (num_literals >= 15)
+        lz4_put_length(b, num_literals);
+    for (size_t i = 0; i < num_literals; i++)
+        buffer_put(b, literals[i]);
+
+    if (match_len == 0)
+        return;
+
+    buffer_put(b, disp);
+    buffer_put(b, disp >> 8);
+
+    if (ml >= 15)
+        lz4_put_length(b, ml);
+}
+
+static void encode_lz4(buffer_t *b, const uint8_t *src, size_t size)
+{
+    int32_t *head = malloc(LZ77_HASH_SIZE * sizeof(int32_t));
+    int32_t *prev = malloc(size * sizeof(int32_t));
+    for (size_t i = 0; i < LZ77_HASH_SIZE; i++)
+        head[i] = -1;
+
+    buffer_put_header(b, TYPE_LZ4, size);
+
+    size_t match_limit = (size > LZ4_MF_LIMIT) ? size - LZ4_MF_LIMIT : 0;
+    size_t pos = 0;
+    size_t anchor = 0; // Start of the literals of the next sequence
+    size_t inserted = 0;
+
+    while (pos < match_limit)
+    {
+        for (; inserted < pos; inserted++)
+        {
+            uint32_t h = lz4_hash(src + inserted);
+            prev[inserted] = head[h];
+            head[h] = inserted;
+        }
+
+        size_t best_len = 0;
+        size_t best_disp = 0;
+
+        int32_t cand = head[lz4_hash(src + pos)];
+        for (int n = 0; (cand >= 0) && (n < LZ77_MAX_CHAIN); n++)
+        {
+            size_t disp = pos - cand;
+            if (disp > 0xFFFF)
+                break;
+
+            size_t len = 0;
+            while ((pos + len < size - LZ4_LAST_LITERALS)
+                   && (src[cand + len] == src[pos + len]))
+                len++;
+
+            if (len > best_len)
+            {
+                best_len = len;
+                best_disp = disp;
+            }
+
+            cand = prev[cand];
+        }
+
+        if (best_len >= LZ4_MIN_MATCH)
+        {
+            lz4_put_sequence(b, src + anchor, pos - anchor, best_disp, best_len);
+            pos += best_len;
+            anchor = pos;
+        }
+        else
+        {
+            pos++;
+        }
+    }
+
+    lz4_put_sequence(b, src + anchor, size - anchor, 0, 0);
+
+    free(prev);
+    free(head);
+}
+
+// Runs of 3 to 130 bytes, and blocks of 1 to 128 uncompressed bytes
+static void encode_rle(buffer_t *b, const uint8_t *src, size_t size)
+{
+    buffer_put_header(b, TYPE_RLE, size);
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        size_t run = 1;
+        while ((run < 130) && (pos + run < size) && (src[pos + run] == src[pos]))
+            run++;
+
+        if (run >= 3)
+        {
+            buffer_put(b, 0x80 | (run - 3));
+            buffer_put(b, src[pos]);
+            pos += run;
+            continue;
+        }
+
+        // Stop the block of uncompressed bytes at the next run
+        size_t len = 0;
+        while ((len < 128) && (pos + len < size))
+        {
+            const uint8_t *p = src + pos + len;
+            if ((pos + len + 3 <= size) && (p[0] == p[1]) && (p[0] == p[2]))
+                break;
+            len++;
+        }
+
+        buffer_put(b, len - 1);
+        for (size_t i = 0; i < len; i++)
+            buffer_put(b, src[pos + i]);
+        pos += len;
+    }
+}
+
+typedef struct {
+    uint32_t freq;
+    int child[2]; // -1 in leaves
+    uint32_t code;
+    uint8_t code_len;
+} huff_node_t;
+
+static void huff_assign_codes(huff_node_t *nodes, int n, uint32_t code,
+                              uint8_t len)
+{
+    nodes[n].code = code;
+    nodes[n].code_len = len;
+
+    if (nodes[n].child[0] >= 0)
+    {
+        huff_assign_codes(nodes, nodes[n].child[0], code << 1, len + 1);
+        huff_assign_codes(nodes, nodes[n].child[1], (code << 1) | 1, len + 1);
+    }
+}
+
+// Huffman with 4 or 8 bit symbols. The tree table is written in breadth-first
+// order, which only works if the children of every node are less than 64 pairs
+// of nodes away from it. That's true for the skewed frequencies of the test
+// data, but not for any input, so it returns false if the tree doesn't fit.
+static bool encode_huff(buffer_t *b, const uint8_t *src, size_t size, int bits)
+{
+    int num_symbols = 1 << bits;
+    huff_node_t nodes[512];
+
+    for (int i = 0; i < 512; i++)
+        nodes[i] = (huff_node_t){ .child = { -1, -1 } };
+
+    for (size_t i = 0; i < size; i++)
+    {
+        if (bits == 8)
+        {
+            nodes[src[i]].freq++;
+        }
+        else
+        {
+            nodes[src[i] & 0xF].freq++;
+            nodes[src[i] >> 4].freq++;
+        }
+    }
+
+    // The tree needs at least two leaves
+    int used = 0;
+    for (int i = 0; i < num_symbols; i++)
+        used += nodes[i].freq > 0;
+    for (int i = 0; (i < num_symbols) && (used < 2); i++)
+    {
+        if (nodes[i].freq == 0)
+        {
+            nodes[i].freq = 1;
+            used++;
+        }
+    }
+
+    // Build the tree by joining the two nodes with the lowest frequencies
+    bool active[512] = { false };
+    for (int i = 0; i < num_symbols; i++)
+        active[i] = nodes[i].freq > 0;
+
+    int num_nodes = num_symbols;
+    int root = -1;
+    while (1)
+    {
+        int lo[2] = { -1, -1 };
+        for (int i = 0; i < num_nodes; i++)
+        {
+            if (!active[i])
+                continue;
+            if ((lo[0] < 0) || (nodes[i].freq < nodes[lo[0]].freq))
+            {
+                lo[1] = lo[0];
+                lo[0] = i;
+            }
+            else if ((lo[1] < 0) || (nodes[i].freq < nodes[lo[1]].freq))
+            {
+                lo[1] = i;
+            }
+        }
+
+        if (lo[1] < 0)
+        {
+            root = lo[0];
+            break;
+        }
+
+        huff_node_t *n = &nodes[num_nodes];
+        n->freq = nodes[lo[0]].freq + nodes[lo[1]].freq;
+        n->child[0] = lo[0];
+        n->child[1] = lo[1];
+        active[lo[0]] = false;
+        active[lo[1]] = false;
+        active[num_nodes] = true;
+        num_nodes++;
+    }
+
+    huff_assign_codes(nodes, root, 0, 0);
+
+    // Tree table. The root goes right after the size byte, and each internal
+    // node points to the pair with its two children.
+    uint8_t table[512 + 4] = { 0 };
+    int queue[512];
+    int addr[512];
+    int q_head = 0;
+    int q_tail = 0;
+    int next_pair = 2;
+
+    queue[q_tail] = root;
+    addr[q_tail++] = 1;
+
+    while (q_head < q_tail)
+    {
+        int n = queue[q_head];
+        int a = addr[q_head++];
+
+        int offset = (next_pair - (a & ~1) - 2) / 2;
+        if (offset > 0x3F)
+            return false;
+
+        table[a] = offset;
+        for (int c = 0; c < 2; c++)
+        {
+            int child = nodes[n].child[c];
+            if (nodes[child].child[0] < 0)
+            {
+                table[a] |= 0x80 >> c;
+                table[next_pair + c] = child;
+            }
+            else
+            {
+                queue[q_tail] = child;
+                addr[q_tail++] = next_pair + c;
+            }
+        }
+        next_pair += 2;
+    }
+
+    // The bitstream starts at a word boundary
+    int table_size = (next_pair + 3) & ~3;
+    table[0] = table_size / 2 - 1;
+
+    buffer_put_header(b, bits == 8 ? TYPE_HUFF8 : TYPE_HUFF4, size);
+    for (int i = 0; i < table_size; i++)
+        buffer_put(b, table[i]);
+
+    // Bitstream of little endian words, filled from the most significant bit
+    uint32_t word = 0;
+    int word_bits = 0;
+
+    for (size_t i = 0; i < size * 8 / bits; i++)
+    {
+        int symbol;
+        if (bits == 8)
+            symbol = src[i];
+        else
+            symbol = (src[i / 2] >> ((i & 1) * 4)) & 0xF;
+
+        for (int k = nodes[symbol].code_len - 1; k >= 0; k--)
+        {
+            word |= ((nodes[symbol].code >> k) & 1) << (31 - word_bits);
+            word_bits++;
+            if (word_bits == 32)
+            {
+                for (int j = 0; j < 4; j++)
+                    buffer_put(b, word >> (j * 8));
+                word = 0;
+                word_bits = 0;
+            }
+        }
+    }
+
+    if (word_bits > 0)
+    {
+        for (int j = 0; j < 4; j++)
+            buffer_put(b, word >> (j * 8));
+    }
+
+    return true;
+}
+
+static bool encode(buffer_t *b, uint8_t type, const uint8_t *src, size_t size)
+{
+    b->size = 0;
+
+    if (type == TYPE_LZ77)
+        encode_lz77(b, src, size);
+    else if (type == TYPE_LZ4)
+        encode_lz4(b, src, size);
+    else if (type == TYPE_RLE)
+        encode_rle(b, src, size);
+    else if (type == TYPE_HUFF4)
+        return encode_huff(b, src, size, 4);
+    else if (type == TYPE_HUFF8)
+        return encode_huff(b, src, size, 8);
+    else
+        return false;
+
+    return true;
+}
+
+static const char *type_name(uint8_t type)
+{
+    switch (type)
+    {
+        case TYPE_LZ77:
+            return "lz77";
+        case TYPE_HUFF4:
+            return "huff4";
+        case TYPE_HUFF8:
+            return "huff8";
+        case TYPE_RLE:
+            return "rle";
+        case TYPE_LZ4:
+            return "lz4";
+        default:
+            return "raw";
+    }
+}
+
+// Test data
+// ---------
+
+static uint32_t rand_state = 0x1234567;
+
+static uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+// 4 bpp tiles made of a few patterns with random changes. Most pixels use the
+// first colors of the palette.
+static void make_tiles(uint8_t *dst, size_t size)
+{
+    uint8_t patterns[16][32];
+    for (int p = 0; p < 16; p++)
+    {
+        for (int i = 0; i < 32; i++)
+        {
+            uint32_t r = rand_next();
+            uint8_t lo = (r & 3) ? (r >> 8) & 3 : (r >> 8) & 0xF;
+            uint8_t hi = (r & 0x30) ? (r >> 12) & 3 : (r >> 12) & 0xF;
+            patterns[p][i] = lo | (hi << 4);
+        }
+    }
+
+    for (size_t i = 0; i < size; i += 32)
+    {
+        memcpy(dst + i, patterns[rand_next() % 16], 32);
+        if ((rand_next() % 4) == 0)
+            dst[i + rand_next() % 32] ^= 0x11;
+    }
+}
+
+// Text made of random words
+static void make_text(uint8_t *dst, size_t size)
+{
+    static const char *words[] = {
+        "the", "dragon", "sword", "of", "a", "village", "hero", "and",
+        "castle", "magic", "to", "is", "Princess", "in", "shield", "potion",
+        "north", "you", "found", "gold", "coins!", "Welcome", "traveler.",
+    };
+    const size_t num_words = sizeof(words) / sizeof(words[0]);
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        const char *w = words[rand_next() % num_words];
+        for (size_t i = 0; (w[i] != '\0') && (pos < size); i++)
+            dst[pos++] = w[i];
+        if (pos < size)
+            dst[pos++] = ((rand_next() % 12) == 0) ? '\n' : ' ';
+    }
+}
+
+// Tile map with long runs of the same tile
+static void make_map(uint8_t *dst, size_t size)
+{
+    size_t pos = 0;
+    while (pos < size)
+    {
+        uint8_t tile = rand_next() % 8;
+        size_t run = 1 + rand_next() % 40;
+        for (size_t i = 0; (i < run) && (pos < size); i++)
+            dst[pos++] = tile;
+    }
+}
+
+#define NOISE_SEED  0xC0FFEE
+
+static void make_noise(uint8_t *dst, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        dst[i] = rand_next();
+}
+
+// Image
+// -----
+
+#define ASSET_SIZE      (64 * 1024)
+
+typedef struct {
+    const char *name;
+    uint8_t type;
+    void (*make)(uint8_t *dst, size_t size);
+    uint8_t *data;
+    size_t compressed_size;
+} asset_t;
+
+static asset_t assets[] = {
+    { .name = "tiles", .type = TYPE_LZ77, .make = make_tiles },
+    { .name = "tiles", .type = TYPE_HUFF4, .make = make_tiles },
+    { .name = "tiles", .type = TYPE_LZ4, .make = make_tiles },
+    { .name = "text", .type = TYPE_HUFF8, .make = make_text },
+    { .name = "text", .type = TYPE_LZ77, .make = make_text },
+    { .name = "text", .type = TYPE_LZ4, .make = make_text },
+    { .name = "map", .type = TYPE_RLE, .make = make_map },
+    { .name = "map", .type = TYPE_LZ77, .make = make_map },
+    { .name = "map", .type = TYPE_LZ4, .make = make_map },
+};
+
+#define ASSET_MAP_RLE   6 // Index of the map compressed with RLE
+
+#define NUM_ASSETS  (sizeof(assets) / sizeof(assets[0]))
+
+static void asset_path(char *path, size_t size, const asset_t *a, bool compressed)
+{
+    snprintf(path, size, "/%s/%s.%s", compressed ? "packed" : "raw", a->name,
+             compressed ? type_name(a->type) : "bin");
+}
+
+// Hand-made files in the format described by the BIOS documentation
+static const uint8_t known_lz77[] = {
+    0x10, 0x09, 0x00, 0x00, 0x10, 'A', 'B', 'C', 0x30, 0x02
+};
+static const uint8_t known_rle[] = {
+    0x30, 0x06, 0x00, 0x00, 0x82, 'A', 0x00, 'B'
+};
+static const uint8_t known_huff8[] = {
+    0x28, 0x04, 0x00, 0x00, 0x01, 0xC0, 'A', 'B', 0x00, 0x00, 0x00, 0x40
+};
+static const uint8_t known_huff4[] = {
+    0x24, 0x01, 0x00, 0x00, 0x01, 0xC0, 0x01, 0x02, 0x00, 0x00, 0x00, 0x40
+};
+// Hand-made file in the LZ4 block format: a match that overlaps its own output
+// and a last sequence with literals only
+static const uint8_t known_lz4[] = {
+    0x60, 0x0E, 0x00, 0x00, 0x34, 'A', 'B', 'C', 0x03, 0x00, 0x30, 'X', 'Y', 'Z'
+};
+
+// Not compressed, but it starts with a valid LZ77 header
+static const uint8_t fake_header[] = {
+    0x10, 0x00, 0x00, 0x00, 'r', 'a', 'w'
+};
+
+static bool create_image(const char *path)
+{
+    nitrofs_image_t *img = nitrofs_image_create();
+    if (img == NULL)
+        return false;
+
+    uint16_t raw = nitrofs_image_add_dir(img, NITROFS_SIM_ROOT, "raw");
+    uint16_t packed = nitrofs_image_add_dir(img, NITROFS_SIM_ROOT, "packed");
+    uint16_t known = nitrofs_image_add_dir(img, NITROFS_SIM_ROOT, "known");
+
+    buffer_t b = { 0 };
+    bool ok = true;
+
+    for (size_t i = 0; i < NUM_ASSETS; i++)
+    {
+        asset_t *a = &assets[i];
+        char name[64];
+
+        a->data = malloc(ASSET_SIZE);
+        rand_state = 0x1000 + i;
+        a->make(a->data, ASSET_SIZE);
+
+        snprintf(name, sizeof(name), "%s.bin", a->name);
+        if ((i == 0) || (strcmp(a->name, assets[i - 1].name) != 0))
+            nitrofs_image_add_file(img, raw, name, a->data, ASSET_SIZE);
+
+        if (!encode(&b, a->type, a->data, ASSET_SIZE))
+        {
+            printf("%s: can't encode %s\n", a->name, type_name(a->type));
+            ok = false;
+            continue;
+        }
+
+        snprintf(name, sizeof(name), "%s.%s", a->name, type_name(a->type));
+        nitrofs_image_add_file(img, packed, name, b.data, b.size);
+        a->compressed_size = b.size;
+    }
+
+    nitrofs_image_add_file(img, known, "abc.lz77", known_lz77, sizeof(known_lz77));
+    nitrofs_image_add_file(img, known, "ab.rle", known_rle, sizeof(known_rle));
+    nitrofs_image_add_file(img, known, "ab.huff8", known_huff8, sizeof(known_huff8));
+    nitrofs_image_add_file(img, known, "nibbles.huff4", known_huff4, sizeof(known_huff4));
+    nitrofs_image_add_file(img, known, "abc.lz4", known_lz4, sizeof(known_lz4));
+    nitrofs_image_add_file(img, known, "fake.bin", fake_header, sizeof(fake_header));
+
+    // Files that end in the middle of the compressed data
+    encode(&b, TYPE_LZ77, assets[0].data, ASSET_SIZE);
+    nitrofs_image_add_file(img, known, "short.lz77", b.data, b.size / 2);
+    encode(&b, TYPE_RLE, assets[ASSET_MAP_RLE].data, ASSET_SIZE);
+    nitrofs_image_add_file(img, known, "short.rle", b.data, b.size / 2);
+    encode(&b, TYPE_LZ4, assets[0].data, ASSET_SIZE);
+    nitrofs_image_add_file(img, known, "short.lz4", b.data, b.size / 2);
+
+    // Incompressible data isn't worth compressing, but it must work
+    uint8_t *noise = malloc(ASSET_SIZE);
+    rand_state = NOISE_SEED;
+    make_noise(noise, ASSET_SIZE);
+    encode(&b, TYPE_LZ77, noise, ASSET_SIZE);
+    nitrofs_image_add_file(img, known, "noise.lz77", b.data, b.size);
+    encode(&b, TYPE_LZ4, noise, ASSET_SIZE);
+    nitrofs_image_add_file(img, known, "noise.lz4", b.data, b.size);
+    free(noise);
+
+    free(b.data);
+
+    ok = ok && nitrofs_image_save(img, path);
+    nitrofs_image_free(img);
+    return ok;
+}
+
+// Tests
+// -----
+
+// The functions of nitrofs.c modify the paths temporarily, so they can't be
+// string literals.
+static int open_file(const char *path)
+{
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", path);
+    return nitrofs_open(copy);
+}
+
+static off_t stat_size(const char *path)
+{
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", path);
+
+    struct stat st;
+    if (nitrofs_stat(copy, &st) != 0)
+        return -1;
+    return st.st_size;
+}
+
+// Reads the whole file with reads of "chunk" bytes
+static ssize_t read_all(const char *path, uint8_t *dst, size_t max, size_t chunk)
+{
+    int fd = open_file(path);
+    if (fd < 0)
+        return -1;
+
+    size_t total = 0;
+    while (total < max)
+    {
+        size_t len = (chunk < max - total) ? chunk : max - total;
+        ssize_t ret = nitrofs_read(fd, dst + total, len);
+        if (ret < 0)
+        {
+            nitrofs_close(fd);
+            return -1;
+        }
+        if (ret == 0)
+            break;
+        total += ret;
+    }
+
+    nitrofs_close(fd);
+    return total;
+}
+
+static void test_known(void)
+{
+    uint8_t buf[64];
+
+    HOST_CHECK(read_all("/known/abc.lz77", buf, sizeof(buf), 64) == 9);
+    HOST_CHECK(memcmp(buf, "ABCABCABC", 9) == 0);
+
+    HOST_CHECK(read_all("/known/ab.rle", buf, sizeof(buf), 64) == 6);
+    HOST_CHECK(memcmp(buf, "AAAAAB", 6) == 0);
+
+    HOST_CHECK(read_all("/known/ab.huff8", buf, sizeof(buf), 64) == 4);
+    HOST_CHECK(memcmp(buf, "ABAA", 4) == 0);
+
+    HOST_CHECK(read_all("/known/nibbles.huff4", buf, sizeof(buf), 64) == 1);
+    HOST_CHECK(buf[0] == 0x21);
+
+    HOST_CHECK(read_all("/known/abc.lz4", buf, sizeof(buf), 64) == 14);
+    HOST_CHECK(memcmp(buf, "ABCABCABCABXYZ", 14) == 0);
+
+    HOST_CHECK(stat_size("/known/abc.lz77") == 9);
+    HOST_CHECK(stat_size("/known/abc.lz4") == 14);
+    HOST_CHECK(stat_size("/known/nibbles.huff4") == 1);
+
+    // A header with a size of 0 isn't valid, so the file is read as it is
+    HOST_CHECK(read_all("/known/fake.bin", buf, sizeof(buf), 64) == sizeof(fake_header));
+    HOST_CHECK(memcmp(buf, fake_header, sizeof(fake_header)) == 0);
+    HOST_CHECK(stat_size("/known/fake.bin") == sizeof(fake_header));
+
+    uint8_t *out = malloc(ASSET_SIZE);
+
+    // Truncated files fail with EIO when the decoder runs out of data
+    const char *short_files[] = {
+        "/known/short.lz77", "/known/short.rle", "/known/short.lz4"
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        HOST_CHECK(stat_size(short_files[i]) == ASSET_SIZE);
+
+        errno = 0;
+        HOST_CHECK(read_all(short_files[i], out, ASSET_SIZE, ASSET_SIZE) == -1);
+        HOST_CHECK(errno == EIO);
+    }
+
+    uint8_t *noise = malloc(ASSET_SIZE);
+    rand_state = NOISE_SEED;
+    make_noise(noise, ASSET_SIZE);
+
+    HOST_CHECK(read_all("/known/noise.lz77", out, ASSET_SIZE, 4096) == ASSET_SIZE);
+    HOST_CHECK(memcmp(out, noise, ASSET_SIZE) == 0);
+
+    // The literals of LZ4 have long lengths with many extra bytes
+    HOST_CHECK(read_all("/known/noise.lz4", out, ASSET_SIZE, 4096) == ASSET_SIZE);
+    HOST_CHECK(memcmp(out, noise, ASSET_SIZE) == 0);
+
+    free(noise);
+
+    free(out);
+}
+
+static void test_read(void)
+{
+    static const size_t chunks[] = { 1, 7, 256, 1000, ASSET_SIZE };
+
+    uint8_t *out = malloc(ASSET_SIZE + 16);
+
+    for (size_t i = 0; i < NUM_ASSETS; i++)
+    {
+        const asset_t *a = &assets[i];
+        char path[64];
+        asset_path(path, sizeof(path), a, true);
+
+        HOST_CHECK(stat_size(path) == ASSET_SIZE);
+
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+        {
+            memset(out, 0, ASSET_SIZE + 16);
+
+            // Reads past the end of the file stop at the decompressed size
+            ssize_t ret = read_all(path, out, ASSET_SIZE + 16, chunks[c]);
+            HOST_CHECK(ret == ASSET_SIZE);
+            if ((ret != ASSET_SIZE) || (memcmp(out, a->data, ASSET_SIZE) != 0))
+            {
+                printf("%s: wrong data with reads of %zu bytes\n", path, chunks[c]);
+                host_checks_failed++;
+            }
+        }
+
+        int fd = open_file(path);
+        struct stat st;
+        HOST_CHECK(nitrofs_fstat(fd, &st) == 0);
+        HOST_CHECK(st.st_size == ASSET_SIZE);
+
+        // The mapped copy is decompressed, and it doesn't move the file
+        uint8_t first[16];
+        HOST_CHECK(nitrofs_read(fd, first, sizeof(first)) == sizeof(first));
+
+        size_t size = 0;
+        const void *map = nitroFSMapFile(fd, &size);
+        HOST_CHECK(map != NULL);
+        HOST_CHECK(size == ASSET_SIZE);
+        HOST_CHECK((map != NULL) && (memcmp(map, a->data, ASSET_SIZE) == 0));
+        nitroFSUnmapFile(map);
+
+        HOST_CHECK(nitrofs_lseek(fd, 0, SEEK_CUR) == sizeof(first));
+        nitrofs_close(fd);
+    }
+
+    free(out);
+}
+
+static void test_seek(void)
+{
+    for (size_t i = 0; i < NUM_ASSETS; i++)
+    {
+        const asset_t *a = &assets[i];
+        char path[64];
+        asset_path(path, sizeof(path), a, true);
+
+        int fd = open_file(path);
+        HOST_CHECK(fd >= 0);
+        if (fd < 0)
+            continue;
+
+        uint8_t buf[64];
+
+        // Random forward and backward seeks with all origins
+        for (int n = 0; n < 32; n++)
+        {
+            off_t pos = nitrofs_lseek(fd, 0, SEEK_CUR);
+            off_t target = rand_next() % (ASSET_SIZE - sizeof(buf));
+            off_t ret;
+
+            if ((n % 3) == 0)
+                ret = nitrofs_lseek(fd, target, SEEK_SET);
+            else if ((n % 3) == 1)
+                ret = nitrofs_lseek(fd, target - pos, SEEK_CUR);
+            else
+                ret = nitrofs_lseek(fd, target - ASSET_SIZE, SEEK_END);
+
+            HOST_CHECK(ret == target);
+            HOST_CHECK(nitrofs_read(fd, buf, sizeof(buf)) == sizeof(buf));
+            if (memcmp(buf, a->data + target, sizeof(buf)) != 0)
+            {
+                printf("%s: wrong data after seeking to %ld\n", path, (long)target);
+                host_checks_failed++;
+            }
+        }
+
+        // Seeks outside of the file are clamped to its limits
+        HOST_CHECK(nitrofs_lseek(fd, -10, SEEK_SET) == 0);
+        HOST_CHECK(nitrofs_read(fd, buf, 4) == 4);
+        HOST_CHECK(memcmp(buf, a->data, 4) == 0);
+        HOST_CHECK(nitrofs_lseek(fd, 100, SEEK_END) == ASSET_SIZE);
+        HOST_CHECK(nitrofs_read(fd, buf, 4) == 0);
+
+        errno = 0;
+        HOST_CHECK(nitrofs_lseek(fd, 0, 1234) == -1);
+        HOST_CHECK(errno == EINVAL);
+
+        nitrofs_close(fd);
+    }
+}
+
+// Without decompression the files are read as they are stored
+static void test_disabled(void)
+{
+    nitroFSSetDecompression(false);
+
+    const asset_t *a = &assets[0];
+    char path[64];
+    asset_path(path, sizeof(path), a, true);
+
+    HOST_CHECK(stat_size(path) == (off_t)a->compressed_size);
+
+    uint8_t header[4];
+    HOST_CHECK(read_all(path, header, sizeof(header), 4) == 4);
+    HOST_CHECK(header[0] == a->type);
+
+    // Files that were opened before keep their mode
+    int fd = open_file(path);
+    nitroFSSetDecompression(true);
+    HOST_CHECK(nitrofs_lseek(fd, 0, SEEK_END) == (off_t)a->compressed_size);
+    nitrofs_close(fd);
+}
+
+// Benchmark
+// ---------
+
+typedef struct {
+    uint32_t reads;
+    double kib_read;
+    double ms;
+    double host_ms;
+} load_cost_t;
+
+// Loads the whole file with one read(), like a game loading an asset
+static load_cost_t bench_load(const char *path, uint8_t *dst)
+{
+    nitrofs_sim_reset_stats();
+    uint64_t start = host_wall_ns();
+
+    if (read_all(path, dst, ASSET_SIZE, ASSET_SIZE) != ASSET_SIZE)
+        host_checks_failed++;
+
+    uint64_t ns = host_wall_ns() - start;
+
+    nitrofs_sim_stats_t stats;
+    nitrofs_sim_get_stats(&stats);
+
+    load_cost_t cost = {
+        .reads = stats.reads,
+        .kib_read = stats.bytes / 1024.0,
+        .ms = host_ticks_to_ms(stats.busy_ticks),
+        .host_ms = ns / 1e6,
+    };
+    return cost;
+}
+
+static void print_cost(const char *name, const char *format, size_t size,
+                       const char *cache, load_cost_t cost)
+{
+    printf("  %-6s %-6s %5.1f%%  %-8s %6u  %8.1f  %7.2f  %7.3f\n", name, format,
+           size * 100.0 / ASSET_SIZE, cache, cost.reads, cost.kib_read, cost.ms,
+           cost.host_ms);
+}
+
+static void bench(void)
+{
+    uint8_t *out = malloc(ASSET_SIZE);
+
+    printf("Loading 64 KiB assets (%s model):\n", disc_model_dldi.name);
+    printf("  asset  format  ratio  cache     reads  KiB read  dev ms  host ms\n");
+
+    static const char *caches[] = { "none", "8x2 KiB" };
+
+    for (int c = 0; c < 2; c++)
+    {
+        if (c == 0)
+            HOST_CHECK(nitroFSInitCache(512, 0) == 0);
+        else
+            HOST_CHECK(nitroFSInitCache(2048, 8) == 0);
+
+        for (size_t i = 0; i < NUM_ASSETS; i++)
+        {
+            const asset_t *a = &assets[i];
+            char path[64];
+
+            if ((i == 0) || (strcmp(a->name, assets[i - 1].name) != 0))
+            {
+                asset_path(path, sizeof(path), a, false);
+                print_cost(a->name, "raw", ASSET_SIZE, caches[c], bench_load(path, out));
+                HOST_CHECK(memcmp(out, a->data, ASSET_SIZE) == 0);
+            }
+
+            asset_path(path, sizeof(path), a, true);
+            print_cost(a->name, type_name(a->type), a->compressed_size, caches[c],
+                       bench_load(path, out));
+            HOST_CHECK(memcmp(out, a->data, ASSET_SIZE) == 0);
+        }
+    }
+
+    HOST_CHECK(nitroFSInitCache(512, 0) == 0);
+
+    printf("  Device time only. The time needed by the ARM9 to decompress the\n"
+           "  data isn't modeled, host ms is the cost on the host CPU.\n");
+
+    free(out);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+
+    host_use_low_heap(argv);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s.nds", argv[0]);
+
+    if (!create_image(path))
+        return 1;
+    if (!nitroFSInit(path))
+        return 1;
+
+    nitroFSSetDecompression(true);
+
+    test_known();
+    test_read();
+    test_seek();
+    test_disabled();
+
+    // The block cache must not change the results
+    HOST_CHECK(nitroFSInitCache(512, 4) == 0);
+    test_read();
+    test_seek();
+    HOST_CHECK(nitroFSInitCache(512, 0) == 0);
+
+    bench();
+
+    nitroFSSetDecompression(false);
+    nitroFSExit();
+
+    for (size_t i = 0; i < NUM_ASSETS; i++)
+        free(assets[i].data);
+
+    remove(path);
+
+    return host_test_result("test_nitrofs_decompress");
+}
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the path index of NitroFS, and comparison of the time needed to
+// open files with and without it.
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <filesystem.h>
+
+#include "nitrofs_internal.h"
+
+#include "host.h"
+#include "nitrofs_sim.h"
+
+// The image has 16 packs with 8 sets of 64 files each
+#define NUM_PACKS       16
+#define NUM_SETS        8
+#define FILES_PER_SET   64
+#define NUM_FILES       (NUM_PACKS * NUM_SETS * FILES_PER_SET + 1)
+
+static char *paths[NUM_FILES];
+
+// The contents of each file are its own path
+static bool create_image(const char *path, bool corrupt)
+{
+    nitrofs_image_t *img = nitrofs_image_create();
+    if (img == NULL)
+        return false;
+
+    uint32_t n = 0;
+
+    free(paths[n]);
+    paths[n] = strdup("/readme.txt");
+    nitrofs_image_add_file(img, NITROFS_SIM_ROOT, "readme.txt", paths[n], strlen(paths[n]));
+    n++;
+
+    uint16_t data = nitrofs_image_add_dir(img, NITROFS_SIM_ROOT, "data");
+
+    for (int p = 0; p < NUM_PACKS; p++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "pack%02d", p);
+        uint16_t pack = nitrofs_image_add_dir(img, data, name);
+
+        for (int s = 0; s < NUM_SETS; s++)
+        {
+            snprintf(name, sizeof(name), "set%d", s);
+            uint16_t set = nitrofs_image_add_dir(img, pack, name);
+
+            for (int f = 0; f < FILES_PER_SET; f++)
+            {
+                char file_path[64];
+                snprintf(name, sizeof(name), "sprite_%03d.bin", f);
+                snprintf(file_path, sizeof(file_path), "/data/pack%02d/set%d/%s", p, s, name);
+
+                free(paths[n]);
+                paths[n] = strdup(file_path);
+                nitrofs_image_add_file(img, set, name, paths[n], strlen(paths[n]));
+                n++;
+            }
+        }
+    }
+
+    bool ok = nitrofs_image_save(img, path);
+    nitrofs_image_free(img);
+
+    if (ok && corrupt)
+    {
+        // The number of directories is stored in the root entry of the FNT
+        FILE *f = fopen(path, "r+b");
+        if (f == NULL)
+            return false;
+        uint8_t num_dirs[2] = { 0x00, 0x20 };
+        fseek(f, NITROFS_SIM_FNT_OFFSET + 6, SEEK_SET);
+        ok = fwrite(num_dirs, 1, sizeof(num_dirs), f) == sizeof(num_dirs);
+        ok = (fclose(f) == 0) && ok;
+    }
+
+    return ok;
+}
+
+// The functions of nitrofs.c modify the paths temporarily, so they can't be
+// string literals.
+static int32_t resolve(const char *path)
+{
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", path);
+    return nitrofs_path_resolve(copy);
+}
+
+static bool open_and_check(const char *path)
+{
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", path);
+
+    int fd = nitrofs_open(copy);
+    if (fd < 0)
+        return false;
+
+    char buffer[64] = { 0 };
+    ssize_t size = nitrofs_read(fd, buffer, sizeof(buffer) - 1);
+    nitrofs_close(fd);
+
+    return (size == (ssize_t)strlen(path)) && (strcmp(buffer, path) == 0);
+}
+
+static const char *missing_paths[] = {
+    "/data/pack03/set2/sprite_999.bin",
+    "/data/pack03/set2/sprite_010.bi",
+    "/data/pack03/set2/sprite_010.bin2",
+    "/data/pack0/set2/sprite_010.bin",
+    "/data/pack99",
+    "/data/set2",
+    "/readme",
+    "/sprite_000.bin",
+};
+
+static const char *odd_paths[] = {
+    "nitro:/data/pack07/set5/sprite_063.bin",
+    "/data/pack03/../pack04/set1/sprite_001.bin",
+    "/data/./pack15/set7/../set0/sprite_000.bin",
+    "/data/pack01/",
+    "/",
+};
+
+// Resolve all paths, and compare the results with the index against the
+// results of the linear search in the FNT.
+static void test_resolve(int32_t *ids, bool have_reference)
+{
+    for (uint32_t i = 0; i < NUM_FILES; i++)
+    {
+        int32_t id = resolve(paths[i]);
+        HOST_CHECK((id >= 0) && (id < 0xF000));
+        if (have_reference)
+            HOST_CHECK(id == ids[i]);
+        ids[i] = id;
+    }
+
+    // Every file must have a different ID
+    for (uint32_t i = 1; i < NUM_FILES; i++)
+        HOST_CHECK(ids[i] != ids[i - 1]);
+
+    for (size_t i = 0; i < sizeof(missing_paths) / sizeof(missing_paths[0]); i++)
+        HOST_CHECK(resolve(missing_paths[i]) < 0);
+
+    for (size_t i = 0; i < sizeof(odd_paths) / sizeof(odd_paths[0]); i++)
+    {
+        int32_t id = resolve(odd_paths[i]);
+        HOST_CHECK(id >= 0);
+        if (have_reference)
+            HOST_CHECK(id == ids[NUM_FILES + i]);
+        ids[NUM_FILES + i] = id;
+    }
+
+    HOST_CHECK(resolve("/") == 0xF000);
+    HOST_CHECK(resolve("/data/pack04/set1/sprite_001.bin")
+               == resolve("/data/pack03/../pack04/set1/sprite_001.bin"));
+
+    for (uint32_t i = 0; i < NUM_FILES; i += 97)
+        HOST_CHECK(open_and_check(paths[i]));
+}
+
+// Directory listings use the copy of the FNT in RAM when there is an index
+static uint32_t list_dir(const char *path, char *names, size_t size)
+{
+    nitrofs_dir_state_t state;
+    struct dirent ent;
+    uint32_t count = 0;
+
+    names[0] = '\0';
+
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", path);
+
+    if (nitrofs_opendir(&state, copy) != 0)
+        return 0;
+
+    while (1)
+    {
+        // Like readdir(), clear the entry before filling it
+        memset(&ent, 0, sizeof(ent));
+        if (nitrofs_readdir(&state, &ent) != 0)
+            break;
+
+        strncat(names, ent.d_name, size - strlen(names) - 2);
+        strcat(names, "/");
+        count++;
+    }
+
+    return count;
+}
+
+static void test_errors(const char *path)
+{
+    nitroFSExit();
+
+    errno = 0;
+    HOST_CHECK(nitroFSInitPathIndex(1024 * 1024) == -1);
+    HOST_CHECK(errno == ENODEV);
+
+    // A corrupted FNT is detected, and NitroFS keeps working without index
+    HOST_CHECK(create_image(path, true));
+    HOST_CHECK(nitroFSInit(path));
+
+    errno = 0;
+    HOST_CHECK(nitroFSInitPathIndex(1024 * 1024) == -1);
+    HOST_CHECK(errno == EIO);
+
+    HOST_CHECK(open_and_check("/readme.txt"));
+
+    nitroFSExit();
+}
+
+typedef struct {
+    double reads;
+    double us;
+    double host_ns;
+} open_cost_t;
+
+static open_cost_t bench_open(const uint32_t *order)
+{
+    nitrofs_sim_reset_stats();
+    uint64_t start = host_wall_ns();
+
+    for (uint32_t i = 0; i < NUM_FILES; i++)
+    {
+        int fd = nitrofs_open(paths[order[i]]);
+        if (fd < 0)
+            host_checks_failed++;
+        else
+            nitrofs_close(fd);
+    }
+
+    uint64_t ns = host_wall_ns() - start;
+
+    nitrofs_sim_stats_t stats;
+    nitrofs_sim_get_stats(&stats);
+
+    open_cost_t cost = {
+        .reads = (double)stats.reads / NUM_FILES,
+        .us = host_ticks_to_ms(stats.busy_ticks) * 1000 / NUM_FILES,
+        .host_ns = (double)ns / NUM_FILES,
+    };
+    return cost;
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+
+    host_use_low_heap(argv);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s.nds", argv[0]);
+
+    test_errors(path);
+
+    if (!create_image(path, false))
+        return 1;
+    if (!nitroFSInit(path))
+        return 1;
+
+    const size_t num_odd = sizeof(odd_paths) / sizeof(odd_paths[0]);
+    int32_t *ids = malloc((NUM_FILES + num_odd) * sizeof(int32_t));
+
+    char *names = malloc(4096);
+    char *names_ref = malloc(4096);
+
+    test_resolve(ids, false);
+    uint32_t count_ref = list_dir("/data/pack01/set3", names_ref, 4096);
+    HOST_CHECK(count_ref == FILES_PER_SET + 2); // Including "." and ".."
+
+    // Random order, so that consecutive opens don't share FNT reads
+    uint32_t *order = malloc(NUM_FILES * sizeof(uint32_t));
+    for (uint32_t i = 0; i < NUM_FILES; i++)
+        order[i] = i;
+    uint32_t state = 0x12345;
+    for (uint32_t i = NUM_FILES - 1; i > 0; i--)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        uint32_t j = state % (i + 1);
+        uint32_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    open_cost_t before = bench_open(order);
+
+    // The block cache helps a bit, but most directories don't fit in it
+    HOST_CHECK(nitroFSInitCache(512, 16) == 0);
+    open_cost_t before_cached = bench_open(order);
+    HOST_CHECK(nitroFSInitCache(512, 0) == 0);
+
+    // The index doesn't fit in the limit
+    errno = 0;
+    HOST_CHECK(nitroFSInitPathIndex(64 * 1024) == -1);
+    HOST_CHECK(errno == ENOMEM);
+    test_resolve(ids, true);
+
+    HOST_CHECK(nitroFSInitPathIndex(1024 * 1024) == 0);
+    test_resolve(ids, true);
+
+    HOST_CHECK(list_dir("/data/pack01/set3", names, 4096) == count_ref);
+    HOST_CHECK(strcmp(names, names_ref) == 0);
+
+    open_cost_t after = bench_open(order);
+
+    printf("Opening %d files in random order (%s model):\n", NUM_FILES,
+           disc_model_dldi.name);
+    printf("  without index: %5.2f reads, %8.1f us, %7.1f host ns per file\n",
+           before.reads, before.us, before.host_ns);
+    printf("  8 KiB cache:   %5.2f reads, %8.1f us, %7.1f host ns per file\n",
+           before_cached.reads, before_cached.us, before_cached.host_ns);
+    printf("  with index:    %5.2f reads, %8.1f us, %7.1f host ns per file\n",
+           after.reads, after.us, after.host_ns);
+
+    // The index is freed by nitroFSExit() and it can be built again
+    HOST_CHECK(nitroFSExit());
+    HOST_CHECK(nitroFSInit(path));
+    HOST_CHECK(nitroFSInitPathIndex(1024 * 1024) == 0);
+    test_resolve(ids, true);
+    nitroFSExit();
+
+    free(order);
+    free(names_ref);
+    free(names);
+    free(ids);
+    for (uint32_t i = 0; i < NUM_FILES; i++)
+        free(paths[i]);
+
+    remove(path);
+
+    return host_test_result("test_nitrofs_index");
+}
@@ -0,0 +1,653 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of readdir_plus() and scandir() with FAT and NitroFS directories, and
+// comparison of the cost of listing a directory with readdir_plus() and with
+// readdir() followed by stat().
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <fat.h>
+#include <filesystem.h>
+
+// Rename the DIR of "ff.h" like dirent.c does, it's different from the one of
+// "dirent.h".
+#define DIR DIRff
+#include "ff.h"
+#include "diskio.h"
+#include "cache.h"
+#include "fatfs_internal.h"
+#undef DIR
+#include "nitrofs_internal.h"
+
+#include <dirent.h>
+
+#include "disc_sim.h"
+#include "fat_volume.h"
+#include "host.h"
+#include "nitrofs_sim.h"
+
+#define DRIVE               FAT_IO_DRIVE_DLDI
+#define SECTOR_SIZE         512
+#define CLUSTER_SIZE        4096
+#define VOLUME_SECTORS      (64 * 1024 * 1024 / SECTOR_SIZE)
+
+// Number of files in the directories used by the tests
+#define NUM_ASSETS          1500
+
+static const uint32_t bench_sizes[] = { 256, 1024, 4096 };
+#define NUM_BENCH_SIZES     (sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+static FATFS fs;
+
+// Timestamps in the format of FAT, and the time_t that they represent
+static uint16_t fat_date(int year, int month, int day)
+{
+    return ((year - 1980) << 9) | (month << 5) | day;
+}
+
+static uint16_t fat_time(int hour, int min, int sec)
+{
+    return (hour << 11) | (min << 5) | (sec / 2);
+}
+
+static time_t to_time(int year, int month, int day, int hour, int min, int sec)
+{
+    struct tm tm = {
+        .tm_year = year - 1900,
+        .tm_mon = month - 1,
+        .tm_mday = day,
+        .tm_hour = hour,
+        .tm_min = min,
+        .tm_sec = sec,
+    };
+    return mktime(&tm);
+}
+
+static uint32_t asset_size(uint32_t i)
+{
+    return (i * 37) % 5000;
+}
+
+static time_t asset_mtime(uint32_t i)
+{
+    return to_time(2000 + i % 20, 1 + i % 12, 1 + i % 28, i % 24, i % 60, (i % 30) * 2);
+}
+
+static uint8_t file_data[5000];
+
+// Creates a file with FatFs and sets its modification time
+static void create_file(const char *path, uint32_t size, uint16_t fdate,
+                        uint16_t ftime)
+{
+    FIL fp;
+    UINT bw;
+
+    HOST_CHECK(f_open(&fp, path, FA_WRITE | FA_CREATE_NEW) == FR_OK);
+    HOST_CHECK(f_write(&fp, file_data, size, &bw) == FR_OK);
+    HOST_CHECK(f_close(&fp) == FR_OK);
+
+    FILINFO fno = { 0 };
+    fno.fdate = fdate;
+    fno.ftime = ftime;
+    HOST_CHECK(f_utime(path, &fno) == FR_OK);
+}
+
+// fat:/readme.txt
+// fat:/games/assets/sprite_0000.bin ... sprite_1499.bin
+// fat:/games/assets/sub/
+// fat:/big<N>/file_0000.bin ... for each size of the benchmark
+static void create_fat_volume(void)
+{
+    HOST_CHECK(fat_volume_format(&fs, DRIVE, FM_FAT, CLUSTER_SIZE) == FR_OK);
+
+    create_file("fat:/readme.txt", 100, fat_date(2024, 1, 1), fat_time(0, 0, 0));
+
+    HOST_CHECK(f_mkdir("fat:/games") == FR_OK);
+    HOST_CHECK(f_mkdir("fat:/games/assets") == FR_OK);
+
+    for (uint32_t i = 0; i < NUM_ASSETS; i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "fat:/games/assets/sprite_%04u.bin", i);
+        create_file(path, asset_size(i),
+                    fat_date(2000 + i % 20, 1 + i % 12, 1 + i % 28),
+                    fat_time(i % 24, i % 60, (i % 30) * 2));
+    }
+
+    HOST_CHECK(f_mkdir("fat:/games/assets/sub") == FR_OK);
+
+    for (size_t b = 0; b < NUM_BENCH_SIZES; b++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "fat:/big%u", bench_sizes[b]);
+        HOST_CHECK(f_mkdir(path) == FR_OK);
+
+        for (uint32_t i = 0; i < bench_sizes[b]; i++)
+        {
+            snprintf(path, sizeof(path), "fat:/big%u/file_%04u.bin", bench_sizes[b], i);
+            create_file(path, 16, fat_date(2024, 1, 1), fat_time(0, 0, 0));
+        }
+    }
+}
+
+// This is what stat() does with FAT paths
+static int fat_stat(const char *path, struct stat *st)
+{
+    FILINFO fno = { 0 };
+    FRESULT result = fatfs_stat_cached(path, &fno);
+    if (result != FR_OK)
+    {
+        errno = fatfs_error_to_posix(result);
+        return -1;
+    }
+
+    fatfs_filinfo_to_stat(&fno, st);
+    return 0;
+}
+
+// This is what stat() does with NitroFS paths. nitrofs_stat() modifies the
+// path temporarily, so it can't be a string literal.
+static int nitro_stat(char *path, struct stat *st)
+{
+    return nitrofs_stat(path, st);
+}
+
+static bool is_dot_entry(const char *name)
+{
+    return (strcmp(name, ".") == 0) || (strcmp(name, "..") == 0);
+}
+
+// Subdirectories of FAT volumes start with the "." and ".." entries, which
+// FatFs lists (FF_WF_LIST_DOTDOT).
+#define FAT_DOT_ENTRIES     2
+
+static void test_fat(void)
+{
+    DIR *dirp = opendir("fat:/games/assets");
+    HOST_CHECK(dirp != NULL);
+    if (dirp == NULL)
+        return;
+
+    struct stat st;
+    struct dirent *ent;
+    uint32_t count = 0;
+    uint32_t files = 0;
+
+    struct stat st_sub;
+    memset(&st_sub, 0, sizeof(st_sub));
+    HOST_CHECK(fat_stat("fat:/games/assets/sub", &st_sub) == 0);
+    HOST_CHECK(S_ISDIR(st_sub.st_mode) && (st_sub.st_ino != 0));
+
+    while (1)
+    {
+        memset(&st, 0, sizeof(st));
+        ent = readdir_plus(dirp, &st);
+        if (ent == NULL)
+            break;
+
+        HOST_CHECK(ent->d_off == (off_t)count);
+        count++;
+
+        if (count <= FAT_DOT_ENTRIES)
+        {
+            HOST_CHECK(is_dot_entry(ent->d_name));
+            HOST_CHECK(ent->d_type == DT_DIR);
+            HOST_CHECK(S_ISDIR(st.st_mode));
+            continue;
+        }
+
+        if (files == NUM_ASSETS)
+        {
+            HOST_CHECK(strcmp(ent->d_name, "sub") == 0);
+            HOST_CHECK(ent->d_type == DT_DIR);
+            HOST_CHECK(S_ISDIR(st.st_mode));
+            HOST_CHECK(st.st_ino == st_sub.st_ino);
+            continue;
+        }
+
+        char expected[32];
+        snprintf(expected, sizeof(expected), "sprite_%04u.bin", files);
+
+        HOST_CHECK(strcmp(ent->d_name, expected) == 0);
+        HOST_CHECK(ent->d_type == DT_REG);
+        HOST_CHECK(ent->d_ino == st.st_ino);
+
+        HOST_CHECK(S_ISREG(st.st_mode));
+        HOST_CHECK(st.st_dev == DRIVE);
+        HOST_CHECK(st.st_size == asset_size(files));
+        HOST_CHECK(st.st_blocks == (asset_size(files) + SECTOR_SIZE - 1) / SECTOR_SIZE);
+        HOST_CHECK(st.st_mtim.tv_sec == asset_mtime(files));
+        HOST_CHECK(st.st_atim.tv_sec == asset_mtime(files));
+
+        // Empty files don't have any cluster
+        if (asset_size(files) == 0)
+            HOST_CHECK(st.st_ino == 0);
+        else
+            HOST_CHECK(st.st_ino >= 2);
+
+        // The result must be the same as the one of stat()
+        struct stat st_ref;
+        memset(&st_ref, 0, sizeof(st_ref));
+        char path[MAXNAMLEN + 32];
+        snprintf(path, sizeof(path), "fat:/games/assets/%s", ent->d_name);
+        HOST_CHECK(fat_stat(path, &st_ref) == 0);
+        HOST_CHECK(memcmp(&st, &st_ref, sizeof(st)) == 0);
+
+        files++;
+    }
+
+    HOST_CHECK(files == NUM_ASSETS);
+    HOST_CHECK(count == FAT_DOT_ENTRIES + NUM_ASSETS + 1);
+
+    // Reading again after the end of the directory is an error
+    errno = 0;
+    HOST_CHECK(readdir_plus(dirp, &st) == NULL);
+    HOST_CHECK(errno == EINVAL);
+
+    // Mixing readdir() and readdir_plus() after rewinding and seeking
+    rewinddir(dirp);
+    for (int i = 0; i < FAT_DOT_ENTRIES; i++)
+    {
+        ent = readdir(dirp);
+        HOST_CHECK((ent != NULL) && is_dot_entry(ent->d_name));
+    }
+    ent = readdir(dirp);
+    HOST_CHECK((ent != NULL) && (strcmp(ent->d_name, "sprite_0000.bin") == 0));
+    ent = readdir_plus(dirp, &st);
+    HOST_CHECK((ent != NULL) && (strcmp(ent->d_name, "sprite_0001.bin") == 0));
+    HOST_CHECK(st.st_size == asset_size(1));
+
+    seekdir(dirp, FAT_DOT_ENTRIES + 999);
+    HOST_CHECK(telldir(dirp) == FAT_DOT_ENTRIES + 999);
+    ent = readdir_plus(dirp, &st);
+    HOST_CHECK((ent != NULL) && (strcmp(ent->d_name, "sprite_1000.bin") == 0));
+    HOST_CHECK(st.st_size == asset_size(1000));
+
+    errno = 0;
+    HOST_CHECK(readdir_plus(dirp, NULL) == NULL);
+    HOST_CHECK(errno == EINVAL);
+
+    HOST_CHECK(closedir(dirp) == 0);
+
+    errno = 0;
+    HOST_CHECK(readdir_plus(NULL, &st) == NULL);
+    HOST_CHECK(errno == EBADF);
+
+    errno = 0;
+    HOST_CHECK(opendir("fat:/games/missing") == NULL);
+    HOST_CHECK(errno == ENOENT);
+
+    // The root directory doesn't have "." and ".." entries
+    dirp = opendir("fat:/");
+    HOST_CHECK(dirp != NULL);
+    ent = readdir_plus(dirp, &st);
+    HOST_CHECK((ent != NULL) && (strcmp(ent->d_name, "readme.txt") == 0));
+    HOST_CHECK(S_ISREG(st.st_mode) && (st.st_size == 100));
+    ent = readdir_plus(dirp, &st);
+    HOST_CHECK((ent != NULL) && (strcmp(ent->d_name, "games") == 0));
+    HOST_CHECK(S_ISDIR(st.st_mode) && (st.st_ino >= 2));
+    HOST_CHECK(closedir(dirp) == 0);
+
+    // Empty directories only have "." and ".."
+    dirp = opendir("fat:/games/assets/sub");
+    HOST_CHECK(dirp != NULL);
+    for (int i = 0; i < FAT_DOT_ENTRIES; i++)
+    {
+        ent = readdir_plus(dirp, &st);
+        HOST_CHECK((ent != NULL) && is_dot_entry(ent->d_name));
+    }
+    HOST_CHECK(readdir_plus(dirp, &st) == NULL);
+    HOST_CHECK(closedir(dirp) == 0);
+}
+
+static int filter_odd(const struct dirent *ent)
+{
+    unsigned int n;
+    if (sscanf(ent->d_name, "sprite_%u.bin", &n) != 1)
+        return 0;
+    return n & 1;
+}
+
+static int compare_reverse(const struct dirent **a, const struct dirent **b)
+{
+    return alphasort(b, a);
+}
+
+static void test_scandir(void)
+{
+    struct dirent **names;
+
+    int count = scandir("fat:/games/assets", &names, NULL, alphasort);
+    HOST_CHECK(count == FAT_DOT_ENTRIES + NUM_ASSETS + 1);
+    for (int i = 0; i < count; i++)
+    {
+        if (i == 0)
+        {
+            HOST_CHECK(strcmp(names[i]->d_name, ".") == 0);
+        }
+        else if (i == 1)
+        {
+            HOST_CHECK(strcmp(names[i]->d_name, "..") == 0);
+        }
+        else if (i < FAT_DOT_ENTRIES + NUM_ASSETS)
+        {
+            char expected[32];
+            snprintf(expected, sizeof(expected), "sprite_%04d.bin", i - FAT_DOT_ENTRIES);
+            HOST_CHECK(strcmp(names[i]->d_name, expected) == 0);
+        }
+        else
+        {
+            HOST_CHECK(strcmp(names[i]->d_name, "sub") == 0);
+        }
+        free(names[i]);
+    }
+    free(names);
+
+    count = scandir("fat:/games/assets", &names, filter_odd, compare_reverse);
+    HOST_CHECK(count == NUM_ASSETS / 2);
+    for (int i = 0; i < count; i++)
+    {
+        char expected[32];
+        snprintf(expected, sizeof(expected), "sprite_%04d.bin", NUM_ASSETS - 1 - 2 * i);
+        HOST_CHECK(strcmp(names[i]->d_name, expected) == 0);
+        free(names[i]);
+    }
+    free(names);
+
+    count = scandir("fat:/games/assets/sub", &names, NULL, NULL);
+    HOST_CHECK(count == FAT_DOT_ENTRIES);
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+
+    errno = 0;
+    HOST_CHECK(scandir("fat:/missing", &names, NULL, NULL) == -1);
+    HOST_CHECK(errno == ENOENT);
+}
+
+// nitro:/assets/tile_0000.bin ... tile_1499.bin
+// nitro:/assets/maps/
+// nitro:/big<N>/file_0000.bin ... for each size of the benchmark
+static bool create_nitrofs_image(const char *path)
+{
+    nitrofs_image_t *img = nitrofs_image_create();
+    if (img == NULL)
+        return false;
+
+    uint8_t *data = calloc(1, NUM_ASSETS);
+
+    uint16_t assets = nitrofs_image_add_dir(img, NITROFS_SIM_ROOT, "assets");
+    for (uint32_t i = 0; i < NUM_ASSETS; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "tile_%04u.bin", i);
+        nitrofs_image_add_file(img, assets, name, data, i);
+    }
+    nitrofs_image_add_dir(img, assets, "maps");
+
+    for (size_t b = 0; b < NUM_BENCH_SIZES; b++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "big%u", bench_sizes[b]);
+        uint16_t dir = nitrofs_image_add_dir(img, NITROFS_SIM_ROOT, name);
+
+        for (uint32_t i = 0; i < bench_sizes[b]; i++)
+        {
+            snprintf(name, sizeof(name), "file_%04u.bin", i);
+            nitrofs_image_add_file(img, dir, name, data, 16);
+        }
+    }
+
+    free(data);
+
+    bool ok = nitrofs_image_save(img, path);
+    nitrofs_image_free(img);
+    return ok;
+}
+
+static void test_nitrofs(void)
+{
+    DIR *dirp = opendir("nitro:/assets");
+    HOST_CHECK(dirp != NULL);
+    if (dirp == NULL)
+        return;
+
+    struct stat st;
+    struct dirent *ent;
+    uint32_t files = 0;
+    uint32_t dirs = 0;
+
+    while (1)
+    {
+        memset(&st, 0, sizeof(st));
+        ent = readdir_plus(dirp, &st);
+        if (ent == NULL)
+            break;
+
+        if (ent->d_type == DT_DIR)
+        {
+            // ".", ".." and "maps"
+            HOST_CHECK(S_ISDIR(st.st_mode));
+            HOST_CHECK(st.st_ino == ent->d_ino);
+            dirs++;
+            continue;
+        }
+
+        char expected[32];
+        snprintf(expected, sizeof(expected), "tile_%04u.bin", files);
+        HOST_CHECK(strcmp(ent->d_name, expected) == 0);
+
+        HOST_CHECK(S_ISREG(st.st_mode));
+        HOST_CHECK(st.st_ino == ent->d_ino);
+        HOST_CHECK(st.st_size == files);
+
+        // The result must be the same as the one of stat()
+        struct stat st_ref;
+        memset(&st_ref, 0, sizeof(st_ref));
+        char path[MAXNAMLEN + 32];
+        snprintf(path, sizeof(path), "nitro:/assets/%s", ent->d_name);
+        HOST_CHECK(nitro_stat(path, &st_ref) == 0);
+        HOST_CHECK(memcmp(&st, &st_ref, sizeof(st)) == 0);
+
+        files++;
+    }
+
+    HOST_CHECK(files == NUM_ASSETS);
+    HOST_CHECK(dirs == 3);
+    HOST_CHECK(closedir(dirp) == 0);
+
+    struct dirent **names;
+    int count = scandir("nitro:/assets", &names, NULL, versionsort);
+    HOST_CHECK(count == NUM_ASSETS + 3);
+    if (count == NUM_ASSETS + 3)
+    {
+        HOST_CHECK(strcmp(names[0]->d_name, ".") == 0);
+        HOST_CHECK(strcmp(names[1]->d_name, "..") == 0);
+        HOST_CHECK(strcmp(names[2]->d_name, "maps") == 0);
+        HOST_CHECK(strcmp(names[3]->d_name, "tile_0000.bin") == 0);
+    }
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+}
+
+typedef enum {
+    LIST_NAMES, // readdir()
+    LIST_STAT, // readdir() and stat()
+    LIST_PLUS, // readdir_plus()
+} list_mode_t;
+
+static const char *list_mode_names[] = { "readdir", "+ stat", "plus" };
+
+// Lists a directory and returns the number of entries, or 0 on error. The
+// files of the directories of the benchmark are 16 bytes long. The "." and ".."
+// entries aren't passed to stat().
+static uint32_t list_dir(const char *path, list_mode_t mode, bool nitro)
+{
+    DIR *dirp = opendir(path);
+    if (dirp == NULL)
+        return 0;
+
+    uint32_t count = 0;
+    uint32_t files = 0;
+    uint64_t total_size = 0;
+    struct dirent *ent;
+    struct stat st;
+
+    while (1)
+    {
+        if (mode == LIST_PLUS)
+        {
+            ent = readdir_plus(dirp, &st);
+        }
+        else
+        {
+            ent = readdir(dirp);
+            if ((ent != NULL) && (mode == LIST_STAT) && !is_dot_entry(ent->d_name))
+            {
+                char entry_path[MAXNAMLEN + 32];
+                snprintf(entry_path, sizeof(entry_path), "%s/%s", path, ent->d_name);
+                int ret = nitro ? nitro_stat(entry_path, &st) : fat_stat(entry_path, &st);
+                if (ret != 0)
+                    break;
+            }
+        }
+
+        if (ent == NULL)
+            break;
+
+        count++;
+
+        if (is_dot_entry(ent->d_name))
+            continue;
+
+        if (mode != LIST_NAMES)
+            total_size += st.st_size;
+        files++;
+    }
+
+    closedir(dirp);
+
+    if ((mode != LIST_NAMES) && (total_size != (uint64_t)files * 16))
+        return 0;
+
+    return count;
+}
+
+static void bench_fat(void)
+{
+    printf("Listing FAT directories (%u KiB clusters, 16 sector cache):\n",
+           CLUSTER_SIZE / 1024);
+    printf("  entries     mode  sector reads  dev reads     us/entry\n");
+
+    for (size_t b = 0; b < NUM_BENCH_SIZES; b++)
+    {
+        uint32_t size = bench_sizes[b];
+
+        char path[32];
+        snprintf(path, sizeof(path), "fat:/big%u", size);
+
+        for (list_mode_t mode = LIST_NAMES; mode <= LIST_PLUS; mode++)
+        {
+            HOST_CHECK(cache_init(16) == 0);
+            disk_reset_io_stats();
+            disc_sim_reset_stats(DRIVE);
+            uint64_t start = host_clock_ticks();
+
+            // Including "." and ".."
+            HOST_CHECK(list_dir(path, mode, false) == FAT_DOT_ENTRIES + size);
+
+            double us = host_ticks_to_ms(host_clock_ticks() - start) * 1000;
+
+            fat_io_stats_t io;
+            disk_get_io_stats(DRIVE, &io);
+            disc_sim_stats_t dev;
+            disc_sim_get_stats(DRIVE, &dev);
+
+            printf("  %7u  %7s  %12.2f  %9.2f  %11.1f\n", size, list_mode_names[mode],
+                   (double)io.read_requests / size, (double)dev.reads / size,
+                   us / size);
+
+            cache_deinit();
+        }
+    }
+}
+
+static void bench_nitrofs(void)
+{
+    printf("Listing NitroFS directories:\n");
+    printf("  entries     mode  reads/entry     us/entry\n");
+
+    for (size_t b = 0; b < NUM_BENCH_SIZES; b++)
+    {
+        uint32_t size = bench_sizes[b];
+
+        char path[32];
+        snprintf(path, sizeof(path), "nitro:/big%u", size);
+
+        for (list_mode_t mode = LIST_NAMES; mode <= LIST_PLUS; mode++)
+        {
+            nitrofs_sim_reset_stats();
+
+            // Including "." and ".."
+            HOST_CHECK(list_dir(path, mode, true) == size + 2);
+
+            nitrofs_sim_stats_t stats;
+            nitrofs_sim_get_stats(&stats);
+
+            printf("  %7u  %7s  %11.2f  %11.1f\n", size, list_mode_names[mode],
+                   (double)stats.reads / size,
+                   host_ticks_to_ms(stats.busy_ticks) * 1000 / size);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+
+    host_use_low_heap(argv);
+
+    if (disc_sim_attach(DRIVE, &disc_model_dldi, NULL, VOLUME_SECTORS) != 0)
+        return 1;
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s.nds", argv[0]);
+
+    if (!create_nitrofs_image(path))
+        return 1;
+    if (!nitroFSInit(path))
+        return 1;
+
+    // The directories are created with a big cache, FatFs looks for each new
+    // name in the whole directory.
+    HOST_CHECK(cache_init(1024) == 0);
+    create_fat_volume();
+    cache_deinit();
+
+    HOST_CHECK(cache_init(16) == 0);
+
+    test_fat();
+    test_scandir();
+    test_nitrofs();
+
+    cache_deinit();
+
+    bench_fat();
+    bench_nitrofs();
+
+    nitroFSExit();
+    fat_volume_unmount(DRIVE);
+    disc_sim_detach(DRIVE);
+
+    return host_test_result("test_readdir_plus");
+}
@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the hash table and the CLOCK eviction of the sector cache.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "cache.h"
+
+#include "disc_sim.h"
+#include "host.h"
+
+#define SECTOR_SIZE 512
+
+// Every cached sector is filled with a pattern that identifies it
+static void fill_sector(void *buffer, uint8_t pdrv, uint32_t sector)
+{
+    uint32_t *words = buffer;
+    for (uint32_t i = 0; i < SECTOR_SIZE / 4; i++)
+        words[i] = (sector * 0x01000193) ^ (pdrv << 28) ^ i;
+}
+
+static bool check_sector(const void *buffer, uint8_t pdrv, uint32_t sector)
+{
+    const uint32_t *words = buffer;
+    for (uint32_t i = 0; i < SECTOR_SIZE / 4; i++)
+    {
+        if (words[i] != ((sector * 0x01000193) ^ (pdrv << 28) ^ i))
+            return false;
+    }
+    return true;
+}
+
+static void *add_sector(uint8_t pdrv, uint32_t sector)
+{
+    void *buffer = cache_sector_add(pdrv, sector);
+    if (buffer != NULL)
+        fill_sector(buffer, pdrv, sector);
+    return buffer;
+}
+
+static void test_lookup(void)
+{
+    HOST_CHECK(cache_init(32) == 0);
+
+    // The same sector number in two drives must be two different entries
+    for (uint32_t s = 0; s < 16; s++)
+    {
+        HOST_CHECK(add_sector(0, s) != NULL);
+        HOST_CHECK(add_sector(1, s) != NULL);
+    }
+
+    for (uint32_t s = 0; s < 16; s++)
+    {
+        void *a = cache_sector_get(0, s);
+        void *b = cache_sector_get(1, s);
+
+        HOST_CHECK((a != NULL) && check_sector(a, 0, s));
+        HOST_CHECK((b != NULL) && check_sector(b, 1, s));
+        HOST_CHECK(a != b);
+    }
+
+    HOST_CHECK(cache_sector_get(0, 16) == NULL);
+    HOST_CHECK(!cache_sector_present(2, 0));
+
+    cache_deinit();
+
+    // An empty cache never returns entries
+    HOST_CHECK(cache_init(0) == 0);
+    HOST_CHECK(cache_sector_get(0, 0) == NULL);
+    HOST_CHECK(cache_sector_add(0, 0) == NULL);
+    cache_deinit();
+}
+
+static void test_invalidate(void)
+{
+    HOST_CHECK(cache_init(64) == 0);
+
+    for (uint32_t s = 100; s < 140; s++)
+        add_sector(0, s);
+    for (uint32_t s = 100; s < 110; s++)
+        add_sector(1, s);
+
+    // Small range: looked up in the hash table
+    cache_sector_invalidate(0, 105, 109);
+
+    for (uint32_t s = 100; s < 140; s++)
+        HOST_CHECK(cache_sector_present(0, s) == ((s < 105) || (s > 109)));
+    for (uint32_t s = 100; s < 110; s++)
+        HOST_CHECK(cache_sector_present(1, s));
+
+    // Range bigger than the cache: every entry is checked
+    cache_sector_invalidate(0, 0, 130);
+
+    for (uint32_t s = 100; s < 140; s++)
+        HOST_CHECK(cache_sector_present(0, s) == (s > 130));
+    for (uint32_t s = 100; s < 110; s++)
+        HOST_CHECK(cache_sector_present(1, s));
+
+    // Inverted ranges are ignored
+    cache_sector_invalidate(1, 109, 100);
+    HOST_CHECK(cache_sector_present(1, 100));
+
+    // Sectors can be added again after being invalidated
+    HOST_CHECK(add_sector(0, 105) != NULL);
+    void *buffer = cache_sector_get(0, 105);
+    HOST_CHECK((buffer != NULL) && check_sector(buffer, 0, 105));
+
+    cache_deinit();
+}
+
+static void test_clock(void)
+{
+    const uint32_t size = 16;
+
+    HOST_CHECK(cache_init(size) == 0);
+
+    for (uint32_t s = 0; s < size; s++)
+        add_sector(0, s);
+
+    // Sectors that are used get a second chance
+    for (uint32_t s = 0; s < size; s += 2)
+        HOST_CHECK(cache_sector_get(0, s) != NULL);
+
+    for (uint32_t s = size; s < size + size / 2; s++)
+        add_sector(0, s);
+
+    for (uint32_t s = 0; s < size; s++)
+        HOST_CHECK(cache_sector_present(0, s) == ((s & 1) == 0));
+
+    cache_deinit();
+}
+
+// Compare the cache with a model that knows which sectors can be present
+static void test_random(uint32_t size)
+{
+    const uint32_t range = size * 4;
+
+    HOST_CHECK(cache_init(size) == 0);
+
+    uint32_t state = 0xC0FFEE;
+    uint32_t entries_seen = 0;
+
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        uint8_t pdrv = state & 1;
+        uint32_t sector = (state >> 8) % range;
+        uint32_t op = (state >> 1) & 0xF;
+
+        if (op == 0)
+        {
+            uint32_t len = (state >> 28) * (size / 8 + 1);
+            cache_sector_invalidate(pdrv, sector, sector + len);
+            for (uint32_t s = sector; s <= sector + len; s++)
+                HOST_CHECK(!cache_sector_present(pdrv, s));
+            continue;
+        }
+
+        void *buffer = cache_sector_get(pdrv, sector);
+        if (buffer != NULL)
+        {
+            HOST_CHECK(check_sector(buffer, pdrv, sector));
+            entries_seen++;
+        }
+        else
+        {
+            HOST_CHECK(add_sector(pdrv, sector) != NULL);
+            HOST_CHECK(cache_sector_present(pdrv, sector));
+        }
+    }
+
+    // Never more entries than the size of the cache
+    uint32_t present = 0;
+    for (uint8_t pdrv = 0; pdrv < 2; pdrv++)
+    {
+        for (uint32_t s = 0; s < range; s++)
+            present += cache_sector_present(pdrv, s) ? 1 : 0;
+    }
+    HOST_CHECK(present <= size);
+    HOST_CHECK(entries_seen > 0);
+
+    cache_deinit();
+}
+
+// Reads through disk_read() must return the data of the device for any size
+// of the cache, with read-ahead and eviction happening at the same time.
+static void test_disk_read(uint32_t size)
+{
+    const uint32_t num_sectors = 4096;
+
+    uint8_t *sector_data = malloc(SECTOR_SIZE);
+    for (uint32_t s = 0; s < num_sectors; s++)
+    {
+        fill_sector(sector_data, 0, s);
+        disc_sim_poke(FAT_IO_DRIVE_DLDI, s, 1, sector_data);
+    }
+    free(sector_data);
+
+    HOST_CHECK(cache_init(size) == 0);
+
+    uint8_t *buffer = aligned_alloc(4, 16 * SECTOR_SIZE);
+    uint32_t state = 0xBEEF;
+    uint32_t sector = 0;
+
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        // Mix runs of sequential reads (read-ahead) and random jumps
+        if ((state & 7) == 0)
+            sector = (state >> 8) % (num_sectors - 16);
+
+        uint32_t count = 1 + ((state >> 4) & 15);
+        if (sector + count > num_sectors)
+            sector = 0;
+
+        HOST_CHECK(disk_read(FAT_IO_DRIVE_DLDI | 0x80, buffer, sector, count) == RES_OK);
+
+        for (uint32_t n = 0; n < count; n++)
+            HOST_CHECK(check_sector(buffer + n * SECTOR_SIZE, 0, sector + n));
+
+        sector += count;
+    }
+
+    free(buffer);
+    cache_deinit();
+}
+
+// Lookups must not get slower when the cache gets bigger
+static void bench_lookup(void)
+{
+    printf("Cost of a cache hit:\n");
+
+    for (uint32_t size = 8; size <= 1024; size *= 2)
+    {
+        cache_init(size);
+
+        for (uint32_t s = 0; s < size; s++)
+            add_sector(0, s * 7);
+
+        const uint32_t lookups = 1000000;
+        uint64_t start = host_wall_ns();
+
+        for (uint32_t i = 0; i < lookups; i++)
+        {
+            if (cache_sector_get(0, (i % size) * 7) == NULL)
+                host_checks_failed++;
+        }
+
+        uint64_t ns = host_wall_ns() - start;
+
+        printf("  %4" PRIu32 " sectors: %.1f ns\n", size, (double)ns / lookups);
+
+        cache_deinit();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    if (disc_sim_attach(FAT_IO_DRIVE_DLDI, &disc_model_dldi, NULL, 4096) != 0)
+        return 1;
+    if (disk_initialize(FAT_IO_DRIVE_DLDI) != 0)
+        return 1;
+
+    test_lookup();
+    test_invalidate();
+    test_clock();
+
+    for (uint32_t size = 8; size <= 1024; size *= 4)
+        test_random(size);
+
+    for (uint32_t size = 1; size <= 256; size *= 4)
+        test_disk_read(size);
+
+    bench_lookup();
+
+    disc_sim_detach(FAT_IO_DRIVE_DLDI);
+
+    return host_test_result("test_sector_cache");
+}
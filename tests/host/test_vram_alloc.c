@@ -0,0 +1,513 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Stress tests of the VRAM allocator of videoGL.c and glCompactTextures().
+// Textures and palettes are loaded and deleted at random, and the test checks
+// their data and the addresses sent to the GPU after every compaction. It
+// prints the fragmentation of texture VRAM during a streaming workload with
+// and without compaction.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/video.h>
+#include <nds/arm9/videoGL.h>
+
+#include "host.h"
+#include "video_sim.h"
+
+// Banks A to D are used for textures and bank E for palettes
+#define TEX_VRAM_START  0x06800000
+#define TEX_VRAM_SIZE   (512 * 1024)
+#define PAL_VRAM_START  0x06880000
+#define PAL_VRAM_SIZE   (64 * 1024)
+
+#define MAX_LOADED      1024
+
+typedef struct {
+    int name;
+    uint32_t size;
+    uint32_t num_colors; // 0 if the texture has no palette
+    uint32_t seed;
+} texture_t;
+
+static texture_t textures[MAX_LOADED];
+static size_t num_textures;
+
+static uint32_t rand_state = 0x2545F491;
+
+static uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+// Data of a texture or palette, generated from its seed
+static void fill_data(uint8_t *buffer, uint32_t size, uint32_t seed)
+{
+    uint32_t state = seed | 1;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        buffer[i] = state;
+    }
+}
+
+static bool check_data(const uint8_t *data, uint32_t size, uint32_t seed)
+{
+    static uint8_t expected[128 * 1024];
+
+    fill_data(expected, size, seed);
+    return memcmp(data, expected, size) == 0;
+}
+
+typedef enum {
+    LOAD_OK,
+    LOAD_NO_TEXTURE_VRAM,
+    LOAD_NO_PALETTE_VRAM,
+} load_result_t;
+
+// Loads a texture of the specified format and size in pixels. Paletted
+// formats get a palette with as many colors as the format can use.
+static load_result_t load_texture(GL_TEXTURE_TYPE_ENUM format, int width,
+                                  int height)
+{
+    static const uint8_t bits_per_pixel[] = {
+        [GL_RGB4] = 2, [GL_RGB16] = 4, [GL_RGB256] = 8, [GL_RGBA] = 16,
+    };
+    static const uint16_t colors[] = {
+        [GL_RGB4] = 4, [GL_RGB16] = 16, [GL_RGB256] = 256, [GL_RGBA] = 0,
+    };
+    static uint8_t buffer[128 * 1024];
+
+    if (num_textures == MAX_LOADED)
+    {
+        printf("too many textures\n");
+        abort();
+    }
+
+    texture_t *t = &textures[num_textures];
+    t->size = width * height * bits_per_pixel[format] / 8;
+    t->num_colors = colors[format];
+    t->seed = rand_next();
+
+    HOST_CHECK(glGenTextures(1, &t->name) == 1);
+    glBindTexture(0, t->name);
+
+    fill_data(buffer, t->size, t->seed);
+    if (glTexImage2D(0, 0, format, width, height, 0, TEXGEN_TEXCOORD, buffer) == 0)
+    {
+        glDeleteTextures(1, &t->name);
+        return LOAD_NO_TEXTURE_VRAM;
+    }
+
+    if (t->num_colors > 0)
+    {
+        fill_data(buffer, t->num_colors * 2, ~t->seed);
+        if (glColorTableNtr(t->num_colors, buffer) == 0)
+        {
+            glDeleteTextures(1, &t->name);
+            return LOAD_NO_PALETTE_VRAM;
+        }
+    }
+
+    num_textures++;
+    return LOAD_OK;
+}
+
+static void delete_texture(size_t index)
+{
+    HOST_CHECK(glDeleteTextures(1, &textures[index].name) == 1);
+    textures[index] = textures[--num_textures];
+}
+
+static void delete_all_textures(void)
+{
+    glResetTextures();
+    num_textures = 0;
+}
+
+// Fragmentation
+// -------------
+
+typedef struct {
+    uint32_t used;
+    uint32_t free;
+    uint32_t largest_free;
+} vram_usage_t;
+
+typedef struct {
+    uintptr_t start;
+    uint32_t size;
+} range_t;
+
+static int compare_ranges(const void *a, const void *b)
+{
+    const range_t *ra = a;
+    const range_t *rb = b;
+
+    return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+// Finds the free space between the ranges used in an area of VRAM. Ranges must
+// be inside the area and they can't overlap.
+static vram_usage_t measure_area(range_t *ranges, size_t count, uintptr_t start,
+                                 uint32_t size)
+{
+    vram_usage_t usage = { 0 };
+
+    qsort(ranges, count, sizeof(range_t), compare_ranges);
+
+    uintptr_t pos = start;
+    for (size_t i = 0; i <= count; i++)
+    {
+        uintptr_t next = (i < count) ? ranges[i].start : start + size;
+
+        HOST_CHECK(next >= pos);
+        if (next < pos)
+            break;
+
+        if (next - pos > usage.largest_free)
+            usage.largest_free = next - pos;
+        usage.free += next - pos;
+
+        if (i < count)
+        {
+            usage.used += ranges[i].size;
+            pos = ranges[i].start + ranges[i].size;
+        }
+    }
+
+    HOST_CHECK(usage.used + usage.free == size);
+
+    return usage;
+}
+
+// Measures texture and palette VRAM from the addresses of the loaded textures
+static void measure_vram(vram_usage_t *tex, vram_usage_t *pal)
+{
+    static range_t tex_ranges[MAX_LOADED];
+    static range_t pal_ranges[MAX_LOADED];
+    size_t num_pal = 0;
+
+    for (size_t i = 0; i < num_textures; i++)
+    {
+        const texture_t *t = &textures[i];
+
+        tex_ranges[i].start = (uintptr_t)glGetTexturePointer(t->name);
+        tex_ranges[i].size = t->size;
+
+        if (t->num_colors > 0)
+        {
+            pal_ranges[num_pal].start = (uintptr_t)glGetColorTablePointer(t->name);
+            pal_ranges[num_pal].size = t->num_colors * 2;
+            num_pal++;
+        }
+    }
+
+    *tex = measure_area(tex_ranges, num_textures, TEX_VRAM_START, TEX_VRAM_SIZE);
+    if (pal != NULL)
+        *pal = measure_area(pal_ranges, num_pal, PAL_VRAM_START, PAL_VRAM_SIZE);
+}
+
+// Checks the data of all textures and palettes, and the addresses that are
+// written to the GPU registers when they are bound.
+static void check_textures(void)
+{
+    for (size_t i = 0; i < num_textures; i++)
+    {
+        const texture_t *t = &textures[i];
+
+        const uint8_t *texels = glGetTexturePointer(t->name);
+        HOST_CHECK((texels != NULL) && check_data(texels, t->size, t->seed));
+
+        // Make sure that the texture is bound again
+        glBindTexture(0, 0);
+        glBindTexture(0, t->name);
+
+        uint32_t offset = (uintptr_t)texels - TEX_VRAM_START;
+        HOST_CHECK((GFX_TEX_FORMAT & 0xFFFF) == offset >> 3);
+
+        if (t->num_colors == 0)
+            continue;
+
+        const uint8_t *palette = glGetColorTablePointer(t->name);
+        HOST_CHECK((palette != NULL)
+                   && check_data(palette, t->num_colors * 2, ~t->seed));
+
+        offset = (uintptr_t)palette - PAL_VRAM_START;
+        HOST_CHECK(GFX_PAL_FORMAT == offset >> ((t->num_colors == 4) ? 3 : 4));
+    }
+}
+
+// Tests
+// -----
+
+// Holes left by deleted textures are too small for a bigger texture until
+// the textures are compacted.
+static void test_compact(void)
+{
+    // Fill texture VRAM with 8 KiB textures, with a palette each
+    while (load_texture(GL_RGB256, 128, 64) == LOAD_OK);
+
+    HOST_CHECK(num_textures == TEX_VRAM_SIZE / (8 * 1024));
+
+    for (size_t i = num_textures; i > 0; i -= 2)
+        delete_texture(i - 1);
+
+    vram_usage_t tex, pal;
+    measure_vram(&tex, &pal);
+    HOST_CHECK(tex.free == TEX_VRAM_SIZE / 2);
+    HOST_CHECK(tex.largest_free == 8 * 1024);
+
+    // 16 KiB don't fit anywhere
+    HOST_CHECK(load_texture(GL_RGB256, 128, 128) == LOAD_NO_TEXTURE_VRAM);
+
+    void *old_first = glGetTexturePointer(textures[0].name);
+
+    HOST_CHECK(glCompactTextures() == 1);
+    check_textures();
+
+    measure_vram(&tex, &pal);
+    HOST_CHECK(tex.largest_free == tex.free);
+    HOST_CHECK(pal.largest_free == pal.free);
+    HOST_CHECK(glGetTexturePointer(textures[0].name) == old_first);
+
+    // All free space is together now
+    HOST_CHECK(load_texture(GL_RGB256, 128, 128) == LOAD_OK);
+    while (load_texture(GL_RGBA, 64, 64) == LOAD_OK);
+
+    measure_vram(&tex, &pal);
+    HOST_CHECK(tex.free < 8 * 1024);
+    check_textures();
+
+    delete_all_textures();
+}
+
+// Textures in locked banks aren't moved
+static void test_locked_bank(void)
+{
+    while (load_texture(GL_RGB16, 64, 64) == LOAD_OK);
+
+    for (size_t i = num_textures; i > 0; i--)
+    {
+        if (rand_next() % 2)
+            delete_texture(i - 1);
+    }
+
+    void *before[MAX_LOADED];
+    for (size_t i = 0; i < num_textures; i++)
+        before[i] = glGetTexturePointer(textures[i].name);
+
+    HOST_CHECK(glLockVRAMBank(VRAM_B) == 1);
+    HOST_CHECK(glCompactTextures() == 1);
+    HOST_CHECK(glUnlockVRAMBank(VRAM_B) == 1);
+
+    check_textures();
+
+    uintptr_t bank_b = (uintptr_t)VRAM_B;
+    for (size_t i = 0; i < num_textures; i++)
+    {
+        uintptr_t addr = (uintptr_t)glGetTexturePointer(textures[i].name);
+        uintptr_t old = (uintptr_t)before[i];
+
+        if ((old >= bank_b) && (old < bank_b + 128 * 1024))
+            HOST_CHECK(addr == old);
+
+        // Nothing is moved into the locked bank either
+        if ((addr >= bank_b) && (addr < bank_b + 128 * 1024))
+            HOST_CHECK(addr == old);
+    }
+
+    delete_all_textures();
+}
+
+// Random loads and deletes of textures of all formats and sizes, compacting
+// from time to time.
+static void test_random(void)
+{
+    static const GL_TEXTURE_TYPE_ENUM formats[] = {
+        GL_RGB4, GL_RGB16, GL_RGB256, GL_RGBA
+    };
+
+    for (int step = 0; step < 3000; step++)
+    {
+        if ((num_textures > 0) && ((rand_next() % 5) < 2))
+        {
+            delete_texture(rand_next() % num_textures);
+        }
+        else
+        {
+            GL_TEXTURE_TYPE_ENUM format = formats[rand_next() % 4];
+            load_texture(format, 8 << (rand_next() % 5), 8 << (rand_next() % 5));
+        }
+
+        if ((step % 250) == 249)
+        {
+            check_textures();
+
+            HOST_CHECK(glCompactTextures() == 1);
+            check_textures();
+
+            vram_usage_t tex, pal;
+            measure_vram(&tex, &pal);
+            HOST_CHECK(tex.largest_free == tex.free);
+
+            // 4-color palettes are aligned to 8 bytes and the others to 16
+            // bytes, so there may be a gap after each 4-color palette.
+            uint32_t gaps = 0;
+            for (size_t i = 0; i < num_textures; i++)
+                gaps += (textures[i].num_colors == 4) ? 8 : 0;
+            HOST_CHECK(pal.free - pal.largest_free <= gaps);
+        }
+    }
+
+    delete_all_textures();
+}
+
+// Benchmark
+// ---------
+
+typedef struct {
+    uint32_t loads;
+    uint32_t failed;
+    uint32_t fragmented; // Failed with enough free VRAM in total
+    uint32_t compactions;
+    uint64_t bytes_moved;
+    uint64_t compact_ns;
+    double sum_fragmentation;
+    uint32_t samples;
+} stream_stats_t;
+
+// Fraction of the free VRAM that isn't part of the largest free block
+static double fragmentation(const vram_usage_t *usage)
+{
+    if (usage->free == 0)
+        return 0;
+
+    return 1.0 - (double)usage->largest_free / usage->free;
+}
+
+// Adds the size of the textures that have been moved since "before" was saved
+static uint64_t bytes_moved(void *const *before)
+{
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < num_textures; i++)
+    {
+        if (glGetTexturePointer(textures[i].name) != before[i])
+            bytes += textures[i].size;
+    }
+    return bytes;
+}
+
+// A game that streams textures of a level: it keeps VRAM about 80% full,
+// deletes random textures and loads new ones. If "compact" is true, failed
+// loads compact VRAM and try again.
+static void bench_stream(bool compact)
+{
+    static void *before[MAX_LOADED];
+    stream_stats_t s = { 0 };
+
+    rand_state = 0x1234;
+
+    for (int step = 0; step < 20000; step++)
+    {
+        vram_usage_t tex;
+        measure_vram(&tex, NULL);
+
+        s.sum_fragmentation += fragmentation(&tex);
+        s.samples++;
+
+        if ((num_textures > 0) && (tex.used > TEX_VRAM_SIZE * 8 / 10))
+        {
+            delete_texture(rand_next() % num_textures);
+            continue;
+        }
+
+        int width = 8 << (rand_next() % 5);
+        int height = 8 << (rand_next() % 5);
+        uint32_t size = width * height * 2;
+
+        s.loads++;
+
+        load_result_t ret = load_texture(GL_RGBA, width, height);
+        if (ret == LOAD_OK)
+            continue;
+
+        s.failed++;
+        if (size > tex.free)
+            continue;
+
+        s.fragmented++;
+
+        if (!compact)
+            continue;
+
+        for (size_t i = 0; i < num_textures; i++)
+            before[i] = glGetTexturePointer(textures[i].name);
+
+        uint64_t start = host_wall_ns();
+        HOST_CHECK(glCompactTextures() == 1);
+        s.compact_ns += host_wall_ns() - start;
+
+        s.compactions++;
+        s.bytes_moved += bytes_moved(before);
+
+        HOST_CHECK(load_texture(GL_RGBA, width, height) == LOAD_OK);
+
+        if (s.compactions % 16 == 0)
+            check_textures();
+    }
+
+    check_textures();
+
+    printf("  %-10s  %5u  %6u  %10u  %8u  %9.1f  %8.1f%%  %10.1f\n",
+           compact ? "compact" : "none", s.loads, s.failed, s.fragmented,
+           s.compactions, (double)s.bytes_moved / 1024,
+           100.0 * s.sum_fragmentation / s.samples,
+           s.compactions ? (double)s.compact_ns / s.compactions / 1000 : 0.0);
+
+    delete_all_textures();
+}
+
+static void bench(void)
+{
+    printf("Streaming 16-bit textures of 8x8 to 128x128 pixels, 80%% of 512 KiB used:\n");
+    printf("  on failure  loads  failed  fragmented  compacts  KiB moved  "
+           "avg frag  us/compact\n");
+
+    bench_stream(false);
+    bench_stream(true);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    video_sim_init();
+
+    glInit();
+
+    vramSetBankA(VRAM_A_TEXTURE);
+    vramSetBankB(VRAM_B_TEXTURE);
+    vramSetBankC(VRAM_C_TEXTURE);
+    vramSetBankD(VRAM_D_TEXTURE);
+    vramSetBankE(VRAM_E_TEX_PALETTE);
+
+    test_compact();
+    test_locked_bank();
+    test_random();
+
+    bench();
+
+    return host_test_result("test_vram_alloc");
+}
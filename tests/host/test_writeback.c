@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Tests of the write-back mode of the sector cache.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fat.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "cache.h"
+
+#include "disc_sim.h"
+#include "host.h"
+
+#define SECTOR_SIZE 512
+#define DRIVE       FAT_IO_DRIVE_DLDI
+
+static uint8_t *buffer;
+
+static void fill(void *ptr, uint32_t sector, uint32_t version)
+{
+    uint32_t *words = ptr;
+    for (uint32_t i = 0; i < SECTOR_SIZE / 4; i++)
+        words[i] = (sector << 16) ^ (version << 8) ^ i;
+}
+
+static bool check(const void *ptr, uint32_t sector, uint32_t version)
+{
+    uint8_t expected[SECTOR_SIZE];
+    fill(expected, sector, version);
+    return memcmp(ptr, expected, SECTOR_SIZE) == 0;
+}
+
+static bool check_device(uint32_t sector, uint32_t version)
+{
+    uint8_t data[SECTOR_SIZE];
+    if (!disc_sim_peek(DRIVE, sector, 1, data))
+        return false;
+    return check(data, sector, version);
+}
+
+static DRESULT write_sector(uint32_t sector, uint32_t version)
+{
+    fill(buffer, sector, version);
+    return disk_write(DRIVE, buffer, sector, 1);
+}
+
+static DRESULT sync_drive(void)
+{
+    return disk_ioctl(DRIVE, CTRL_SYNC, NULL);
+}
+
+static void reset(uint32_t cache_size, bool writeback)
+{
+    HOST_CHECK(cache_init(cache_size) == 0);
+    cache_set_writeback(writeback);
+    disc_sim_reset_stats(DRIVE);
+}
+
+// Writes stay in the cache until the drive is synced, and adjacent sectors are
+// written with a single command.
+static void test_coalescing(void)
+{
+    reset(64, true);
+
+    for (uint32_t s = 10; s < 14; s++)
+        HOST_CHECK(write_sector(s, 1) == RES_OK);
+
+    // Writing the same sector again doesn't create more work
+    for (uint32_t v = 2; v < 6; v++)
+        HOST_CHECK(write_sector(11, v) == RES_OK);
+
+    HOST_CHECK(write_sector(20, 1) == RES_OK);
+    HOST_CHECK(write_sector(22, 1) == RES_OK);
+
+    disc_sim_stats_t stats;
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.writes == 0);
+
+    HOST_CHECK(sync_drive() == RES_OK);
+
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.writes == 3); // 10-13, 20 and 22
+    HOST_CHECK(stats.sectors_written == 6);
+
+    HOST_CHECK(check_device(10, 1));
+    HOST_CHECK(check_device(11, 5));
+    HOST_CHECK(check_device(12, 1));
+    HOST_CHECK(check_device(13, 1));
+    HOST_CHECK(check_device(20, 1));
+    HOST_CHECK(check_device(21, 0) == false);
+    HOST_CHECK(check_device(22, 1));
+
+    // Syncing again doesn't write anything
+    HOST_CHECK(sync_drive() == RES_OK);
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.writes == 3);
+
+    cache_deinit();
+}
+
+// Reads must see the data of writes that haven't reached the device yet
+static void test_read_after_write(void)
+{
+    reset(64, true);
+
+    HOST_CHECK(write_sector(30, 1) == RES_OK);
+    HOST_CHECK(write_sector(31, 1) == RES_OK);
+
+    // Cacheable reads get the data from the cache
+    memset(buffer, 0, SECTOR_SIZE * 2);
+    HOST_CHECK(disk_read(DRIVE | 0x80, buffer, 30, 2) == RES_OK);
+    HOST_CHECK(check(buffer, 30, 1));
+    HOST_CHECK(check(buffer + SECTOR_SIZE, 31, 1));
+
+    disc_sim_stats_t stats;
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.reads == 0);
+    HOST_CHECK(stats.writes == 0);
+
+    // Other reads go to the device, so the dirty sectors are flushed first
+    memset(buffer, 0, SECTOR_SIZE * 2);
+    HOST_CHECK(disk_read(DRIVE, buffer, 30, 2) == RES_OK);
+    HOST_CHECK(check(buffer, 30, 1));
+    HOST_CHECK(check(buffer + SECTOR_SIZE, 31, 1));
+
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.writes == 1);
+
+    cache_deinit();
+}
+
+// Dirty sectors are written to the device when they are evicted
+static void test_eviction(void)
+{
+    const uint32_t size = 8;
+
+    reset(size, true);
+
+    for (uint32_t s = 40; s < 40 + size; s++)
+        HOST_CHECK(write_sector(s, 7) == RES_OK);
+
+    // Fill the cache with other sectors
+    for (uint32_t s = 100; s < 100 + size * 2; s++)
+        HOST_CHECK(disk_read(DRIVE | 0x80, buffer, s, 1) == RES_OK);
+
+    for (uint32_t s = 40; s < 40 + size; s++)
+        HOST_CHECK(check_device(s, 7));
+
+    disc_sim_stats_t stats;
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.sectors_written == size);
+    HOST_CHECK(stats.writes < size);
+
+    HOST_CHECK(sync_drive() == RES_OK);
+
+    cache_deinit();
+}
+
+// Big writes go straight to the device and replace any dirty sector
+static void test_big_write(void)
+{
+    const uint32_t size = 16;
+
+    reset(size, true);
+
+    HOST_CHECK(write_sector(51, 1) == RES_OK);
+
+    uint32_t count = size; // More than a quarter of the cache
+    for (uint32_t n = 0; n < count; n++)
+        fill(buffer + n * SECTOR_SIZE, 50 + n, 2);
+
+    HOST_CHECK(disk_write(DRIVE, buffer, 50, count) == RES_OK);
+
+    disc_sim_stats_t stats;
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.writes == 1);
+
+    HOST_CHECK(sync_drive() == RES_OK);
+
+    // The old dirty sector must not overwrite the new data
+    for (uint32_t n = 0; n < count; n++)
+        HOST_CHECK(check_device(50 + n, 2));
+
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.writes == 1);
+
+    cache_deinit();
+}
+
+// Errors writing dirty sectors are reported when the drive is synced
+static void test_errors(void)
+{
+    reset(8, true);
+
+    HOST_CHECK(write_sector(60, 1) == RES_OK);
+
+    disc_sim_fail_writes(DRIVE, true);
+    HOST_CHECK(sync_drive() == RES_ERROR);
+    disc_sim_fail_writes(DRIVE, false);
+
+    // The error has been reported, there is nothing else to write
+    HOST_CHECK(sync_drive() == RES_OK);
+
+    // Errors during evictions are reported by the next sync
+    HOST_CHECK(write_sector(61, 1) == RES_OK);
+
+    disc_sim_fail_writes(DRIVE, true);
+    for (uint32_t s = 200; s < 216; s++)
+        disk_read(DRIVE | 0x80, buffer, s, 1);
+    disc_sim_fail_writes(DRIVE, false);
+
+    HOST_CHECK(sync_drive() == RES_ERROR);
+    HOST_CHECK(sync_drive() == RES_OK);
+
+    cache_deinit();
+}
+
+// Without write-back mode every write reaches the device right away
+static void test_write_through(void)
+{
+    reset(64, false);
+
+    for (uint32_t v = 1; v < 5; v++)
+    {
+        HOST_CHECK(write_sector(70, v) == RES_OK);
+        HOST_CHECK(check_device(70, v));
+    }
+
+    disc_sim_stats_t stats;
+    disc_sim_get_stats(DRIVE, &stats);
+    HOST_CHECK(stats.writes == 4);
+
+    HOST_CHECK(sync_drive() == RES_OK);
+
+    cache_deinit();
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    if (disc_sim_attach(DRIVE, &disc_model_dldi, NULL, 4096) != 0)
+        return 1;
+    if (disk_initialize(DRIVE) != 0)
+        return 1;
+
+    buffer = aligned_alloc(4, 32 * SECTOR_SIZE);
+    if (buffer == NULL)
+        return 1;
+
+    test_coalescing();
+    test_read_after_write();
+    test_eviction();
+    test_big_write();
+    test_errors();
+    test_write_through();
+
+    free(buffer);
+    disc_sim_detach(DRIVE);
+
+    return host_test_result("test_writeback");
+}
@@ -0,0 +1,430 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Model of the geometry engine, software DMA and host versions of the system
+// functions used by videoGL.c. The memory map is in video_sim_mem.c.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nds/arm9/cp15.h>
+#include <nds/arm9/math.h>
+#include <nds/bios.h>
+#include <nds/cothread.h>
+#include <nds/dma.h>
+#include <nds/interrupts.h>
+#include <nds/system.h>
+
+#include "common/libnds_internal.h"
+
+#include "video_sim.h"
+#include "video_sim_mem.h"
+
+#define GX_FIFO_ADDR    0x04000400
+#define GX_PORTS_START  0x04000440
+#define GX_PORTS_END    0x040005CC
+
+// Geometry engine
+// ---------------
+
+// Number of parameters of each command, from the documentation of the hardware
+static const uint8_t gx_sim_num_params[0x80] = {
+    [0x10] = 1, [0x12] = 1, [0x13] = 1, [0x14] = 1,
+    [0x16] = 16, [0x17] = 12, [0x18] = 16, [0x19] = 12, [0x1A] = 9,
+    [0x1B] = 3, [0x1C] = 3,
+    [0x20] = 1, [0x21] = 1, [0x22] = 1, [0x23] = 2, [0x24] = 1, [0x25] = 1,
+    [0x26] = 1, [0x27] = 1, [0x28] = 1, [0x29] = 1, [0x2A] = 1, [0x2B] = 1,
+    [0x30] = 1, [0x31] = 1, [0x32] = 1, [0x33] = 1, [0x34] = 32,
+    [0x40] = 1, [0x50] = 1, [0x60] = 1,
+    [0x70] = 3, [0x71] = 2, [0x72] = 1,
+};
+
+static struct {
+    // Packed commands received through GXFIFO
+    uint8_t fifo_ids[4];
+    uint8_t fifo_num_ids;
+    uint8_t fifo_next;
+    bool fifo_dummy; // The next word is the parameter of a header without any
+
+    // Command whose parameters are being received
+    uint8_t cmd;
+    uint8_t num_params;
+    uint32_t params[32];
+
+    // State
+    uint32_t poly_attr;
+    uint32_t poly_attr_active;
+    uint32_t tex_format;
+    uint32_t pal_base;
+    uint32_t color;
+    uint32_t texcoord;
+    int16_t vx, vy, vz;
+    uint32_t prim_type;
+    bool in_begin;
+    gx_sim_polygon_t poly;
+
+    gx_sim_polygon_t *polygons;
+    size_t num_polygons;
+    size_t max_polygons;
+
+    gx_sim_stats_t stats;
+} gx;
+
+void gx_sim_get_stats(gx_sim_stats_t *stats)
+{
+    *stats = gx.stats;
+}
+
+void gx_sim_reset(void)
+{
+    memset(&gx.stats, 0, sizeof(gx.stats));
+    gx.num_polygons = 0;
+}
+
+const gx_sim_polygon_t *gx_sim_polygons(size_t *count)
+{
+    *count = gx.num_polygons;
+    return gx.polygons;
+}
+
+static void gx_sim_add_polygon(void)
+{
+    if (gx.num_polygons == gx.max_polygons)
+    {
+        gx.max_polygons = (gx.max_polygons == 0) ? 1024 : gx.max_polygons * 2;
+        gx.polygons = realloc(gx.polygons, gx.max_polygons * sizeof(gx_sim_polygon_t));
+        if (gx.polygons == NULL)
+        {
+            printf("gx_sim: out of memory\n");
+            abort();
+        }
+    }
+
+    gx.polygons[gx.num_polygons++] = gx.poly;
+    gx.stats.polygons++;
+}
+
+static void gx_sim_vertex(void)
+{
+    if (!gx.in_begin)
+        return;
+
+    // Only separate triangles and quads are recorded
+    uint32_t size = (gx.prim_type == 0) ? 3 : 4;
+    if (gx.prim_type > 1)
+        return;
+
+    uint32_t n = gx.poly.num_vertices;
+    if (n == 0)
+    {
+        gx.poly.tex_format = gx.tex_format;
+        gx.poly.pal_base = gx.pal_base;
+        gx.poly.poly_attr = gx.poly_attr_active;
+        gx.poly.color = gx.color;
+    }
+
+    gx.poly.x[n] = gx.vx;
+    gx.poly.y[n] = gx.vy;
+    gx.poly.z[n] = gx.vz;
+    gx.poly.texcoord[n] = gx.texcoord;
+    gx.poly.num_vertices = n + 1;
+
+    if (gx.poly.num_vertices == size)
+    {
+        gx_sim_add_polygon();
+        memset(&gx.poly, 0, sizeof(gx.poly));
+    }
+}
+
+static void gx_sim_execute(uint8_t cmd, const uint32_t *p)
+{
+    gx.stats.commands++;
+
+    switch (cmd)
+    {
+        case 0x20: // COLOR
+            gx.color = p[0] & 0x7FFF;
+            break;
+        case 0x22: // TEXCOORD
+            gx.texcoord = p[0];
+            break;
+        case 0x23: // VTX_16
+            gx.vx = p[0];
+            gx.vy = p[0] >> 16;
+            gx.vz = p[1];
+            gx_sim_vertex();
+            break;
+        case 0x24: // VTX_10
+            gx.vx = (int16_t)((p[0] & 0x3FF) << 6);
+            gx.vy = (int16_t)(((p[0] >> 10) & 0x3FF) << 6);
+            gx.vz = (int16_t)(((p[0] >> 20) & 0x3FF) << 6);
+            gx_sim_vertex();
+            break;
+        case 0x25: // VTX_XY
+            gx.vx = p[0];
+            gx.vy = p[0] >> 16;
+            gx_sim_vertex();
+            break;
+        case 0x26: // VTX_XZ
+            gx.vx = p[0];
+            gx.vz = p[0] >> 16;
+            gx_sim_vertex();
+            break;
+        case 0x27: // VTX_YZ
+            gx.vy = p[0];
+            gx.vz = p[0] >> 16;
+            gx_sim_vertex();
+            break;
+        case 0x29: // POLYGON_ATTR
+            gx.poly_attr = p[0];
+            break;
+        case 0x2A: // TEXIMAGE_PARAM
+            gx.tex_format = p[0];
+            gx.stats.tex_params++;
+            break;
+        case 0x2B: // PLTT_BASE
+            gx.pal_base = p[0];
+            break;
+        case 0x40: // BEGIN_VTXS
+            gx.prim_type = p[0] & 3;
+            gx.in_begin = true;
+            gx.poly_attr_active = gx.poly_attr;
+            memset(&gx.poly, 0, sizeof(gx.poly));
+            break;
+        case 0x41: // END_VTXS
+            gx.in_begin = false;
+            break;
+        default:
+            break;
+    }
+}
+
+// Starts receiving the parameters of a command, and executes it right away if
+// it doesn't have any.
+static void gx_sim_start_command(uint8_t cmd)
+{
+    gx.cmd = cmd;
+    gx.num_params = 0;
+
+    if (gx_sim_num_params[cmd & 0x7F] == 0)
+    {
+        gx_sim_execute(cmd, NULL);
+        gx.cmd = 0;
+    }
+}
+
+static bool gx_sim_add_param(uint32_t value)
+{
+    gx.params[gx.num_params++] = value;
+    if (gx.num_params < gx_sim_num_params[gx.cmd & 0x7F])
+        return false;
+
+    gx_sim_execute(gx.cmd, gx.params);
+    gx.cmd = 0;
+    return true;
+}
+
+// Starts the commands of the current header until one of them needs parameters
+static void gx_sim_fifo_advance(void)
+{
+    while ((gx.cmd == 0) && (gx.fifo_next < gx.fifo_num_ids))
+        gx_sim_start_command(gx.fifo_ids[gx.fifo_next++]);
+}
+
+static void gx_sim_fifo_word(uint32_t value)
+{
+    if (gx.fifo_dummy)
+    {
+        gx.fifo_dummy = false;
+        return;
+    }
+
+    if (gx.cmd != 0)
+    {
+        if (gx_sim_add_param(value))
+            gx_sim_fifo_advance();
+        return;
+    }
+
+    // New header. NOPs are skipped, and a header with commands that don't
+    // have parameters is followed by a dummy parameter.
+    gx.fifo_num_ids = 0;
+    gx.fifo_next = 0;
+
+    uint32_t total_params = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        uint8_t id = value >> (i * 8);
+        if (id == 0)
+            continue;
+
+        gx.fifo_ids[gx.fifo_num_ids++] = id;
+        total_params += gx_sim_num_params[id & 0x7F];
+    }
+
+    gx.fifo_dummy = (gx.fifo_num_ids > 0) && (total_params == 0);
+
+    gx_sim_fifo_advance();
+}
+
+static void gx_sim_port_write(uint32_t addr, uint32_t value)
+{
+    uint8_t cmd = (addr - GX_FIFO_ADDR) >> 2;
+
+    if (gx_sim_num_params[cmd & 0x7F] == 0)
+    {
+        gx_sim_execute(cmd, NULL);
+        return;
+    }
+
+    if (gx.cmd != cmd)
+    {
+        gx.cmd = cmd;
+        gx.num_params = 0;
+    }
+
+    gx_sim_add_param(value);
+}
+
+void video_sim_io_write(uint32_t addr, uint32_t value)
+{
+    if (addr == GX_FIFO_ADDR)
+    {
+        gx.stats.fifo_writes++;
+        gx_sim_fifo_word(value);
+    }
+    else if ((addr >= GX_PORTS_START) && (addr <= GX_PORTS_END))
+    {
+        gx.stats.port_writes++;
+        gx_sim_port_write(addr, value);
+    }
+}
+
+// DMA
+// ---
+
+void dmaSetParams(uint8_t channel, const void *src, void *dest, uint32_t ctrl)
+{
+    uint32_t count = ctrl & 0x1FFFFF;
+    uint32_t unit = (ctrl & DMA_32_BIT) ? 4 : 2;
+    uint32_t start = ctrl & (7 << 27);
+
+    const uint8_t *s = src;
+    uint8_t *d = dest;
+
+    if (start == DMA_START_FIFO)
+    {
+        // The words are only decoded while stores of the CPU are captured too,
+        // so the time of the model isn't measured with the rest.
+        gx.stats.dma_transfers++;
+        for (uint32_t i = 0; (i < count) && video_sim_capturing_gx(); i++)
+        {
+            uint32_t value;
+            memcpy(&value, s + i * 4, 4);
+            gx.stats.dma_words++;
+            gx_sim_fifo_word(value);
+        }
+    }
+    else if (start == DMA_START_NOW)
+    {
+        int src_step = (ctrl & DMA_SRC_FIX) ? 0 : (ctrl & DMA_SRC_DEC) ? -1 : 1;
+        int dst_step = ((ctrl & DMA_DST_RESET) == DMA_DST_FIX) ? 0
+                     : ((ctrl & DMA_DST_RESET) == DMA_DST_DEC) ? -1 : 1;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            memmove(d, s, unit);
+            s += src_step * (int)unit;
+            d += dst_step * (int)unit;
+        }
+    }
+    else
+    {
+        printf("video_sim: unsupported DMA start mode 0x%X\n", start);
+        abort();
+    }
+
+    // The transfer has finished
+    video_sim_io_poke32(0x040000B8 + channel * 12, ctrl & ~DMA_ENABLE);
+}
+
+// System functions used by videoGL.c
+// ----------------------------------
+
+static VoidFn irqTable[MAX_INTERRUPTS];
+
+void irqSet(u32 irq, VoidFn handler)
+{
+    for (int i = 0; i < MAX_INTERRUPTS; i++)
+    {
+        if (irq & BIT(i))
+            irqTable[i] = handler;
+    }
+}
+
+VoidFn irqSetGetPrevious(u32 irq, VoidFn handler)
+{
+    if (irq == 0)
+        return NULL;
+
+    VoidFn previous = irqTable[__builtin_ctz(irq)];
+    irqSet(irq, handler);
+    return previous;
+}
+
+void irqEnable(u32 irq)
+{
+}
+
+void irqDisable(u32 irq)
+{
+}
+
+void cothread_yield_irq(uint32_t flag)
+{
+    printf("video_sim: interrupts aren't simulated\n");
+    abort();
+}
+
+void powerOn(uint32_t bits)
+{
+}
+
+void powerOff(uint32_t bits)
+{
+}
+
+void swiDelay(uint32_t duration)
+{
+}
+
+void swiWaitForVBlank(void)
+{
+}
+
+void CP15_CleanAndFlushDCacheRange(const void *base, size_t size)
+{
+}
+
+void crossf32(const int32_t *a, const int32_t *b, int32_t *result)
+{
+    result[0] = ((int64_t)a[1] * b[2] - (int64_t)b[1] * a[2]) >> 12;
+    result[1] = ((int64_t)a[2] * b[0] - (int64_t)b[2] * a[0]) >> 12;
+    result[2] = ((int64_t)a[0] * b[1] - (int64_t)b[0] * a[1]) >> 12;
+}
+
+void normalizef32(int32_t *a)
+{
+    double x = a[0], y = a[1], z = a[2];
+    double len = __builtin_sqrt(x * x + y * y + z * z);
+    if (len == 0)
+        return;
+
+    a[0] = (int32_t)(x * 4096 / len);
+    a[1] = (int32_t)(y * 4096 / len);
+    a[2] = (int32_t)(z * 4096 / len);
+}
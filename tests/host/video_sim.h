@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Memory map of the video hardware, DMA and a model of the geometry engine.
+//
+// videoGL.c and gl2d.c access the I/O registers, VRAM and palettes through
+// their addresses on the DS, so this module maps memory at those addresses.
+// Programs that use it must be linked with "-no-pie" so that nothing else is
+// placed there.
+//
+// Stores to the geometry engine can be captured: the page of the I/O registers
+// is then read-only, every store to it faults, and the signal handlers execute
+// the store with the page writable and the trap flag set, so the value can be
+// decoded right after the instruction. This only works on x86-64 Linux. The
+// geometry engine model decodes commands written to the command ports and to
+// GXFIFO, and it keeps the polygons they define. It doesn't transform or draw
+// anything.
+//
+// dmaSetParams() copies the data right away. Transfers started by the GXFIFO
+// are sent to the model while stores are captured.
+
+#ifndef VIDEO_SIM_H__
+#define VIDEO_SIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Maps the memory used by the video hardware. It exits on error.
+void video_sim_init(void);
+
+// Enables or disables the capture of stores to the geometry engine. Capturing
+// them is very slow, disable it to measure the time used by the host.
+void video_sim_capture_gx(bool enable);
+
+// Polygon sent to the geometry engine. Vertices are the values sent by the
+// commands, before any transformation.
+typedef struct {
+    uint8_t num_vertices; // 3 or 4
+    uint32_t tex_format; // Last TEXIMAGE_PARAM
+    uint32_t pal_base; // Last PLTT_BASE
+    uint32_t poly_attr; // POLYGON_ATTR active at BEGIN_VTXS
+    uint32_t color;
+    int16_t x[4], y[4], z[4];
+    uint32_t texcoord[4];
+} gx_sim_polygon_t;
+
+typedef struct {
+    uint32_t port_writes; // Stores of the CPU to the command ports
+    uint32_t fifo_writes; // Stores of the CPU to GXFIFO
+    uint32_t dma_transfers; // DMA transfers to GXFIFO
+    uint32_t dma_words; // Words sent by DMA to GXFIFO
+    uint32_t commands; // Commands executed
+    uint32_t tex_params; // TEXIMAGE_PARAM commands
+    uint32_t polygons;
+} gx_sim_stats_t;
+
+void gx_sim_get_stats(gx_sim_stats_t *stats);
+
+// Clears the statistics and the list of polygons. The state of the geometry
+// engine is kept.
+void gx_sim_reset(void);
+
+// Polygons sent since the last call to gx_sim_reset()
+const gx_sim_polygon_t *gx_sim_polygons(size_t *count);
+
+#endif // VIDEO_SIM_H__
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Memory map of video_sim.c and capture of stores to the I/O registers. This
+// file includes the headers of the host only, because the "ucontext.h" of
+// libnds replaces the one needed by the signal handlers.
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "video_sim.h"
+#include "video_sim_mem.h"
+
+#define IO_BASE         0x04000000
+#define IO_PAGE_SIZE    0x1000 // Page with the registers of the main engine
+#define IO_SIZE         0x10000
+
+typedef struct {
+    uintptr_t base;
+    size_t size;
+} video_sim_region_t;
+
+static const video_sim_region_t video_sim_regions[] = {
+    { 0x04000000 + IO_PAGE_SIZE, IO_SIZE - IO_PAGE_SIZE }, // Other registers
+    { 0x05000000, 0x1000 }, // Palettes
+    { 0x06000000, 0x900000 }, // VRAM, including the LCD mapping
+    { 0x07000000, 0x1000 }, // OAM
+};
+
+// Writable mapping of the page of I/O registers. The page at IO_BASE is
+// read-only while stores are captured.
+static uint8_t *video_sim_io_alias;
+static bool video_sim_capturing;
+
+static void *video_sim_map_fixed(uintptr_t base, size_t size, int prot,
+                                 int flags, int fd)
+{
+    void *ptr = mmap((void *)base, size, prot, flags | MAP_FIXED_NOREPLACE, fd, 0);
+    if (ptr != (void *)base)
+    {
+        printf("video_sim: can't map 0x%08lX\n", (unsigned long)base);
+        exit(1);
+    }
+    return ptr;
+}
+
+// Address of the store being executed with the trap flag set
+static volatile uintptr_t video_sim_store_addr;
+
+#define X86_TRAP_FLAG   0x100
+
+static void video_sim_segv_handler(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+
+    if ((addr < IO_BASE) || (addr >= IO_BASE + IO_PAGE_SIZE))
+    {
+        // Not a register, crash with the default handler
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    // Let the store happen and stop right after it
+    video_sim_store_addr = addr;
+    mprotect((void *)IO_BASE, IO_PAGE_SIZE, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= X86_TRAP_FLAG;
+}
+
+static void video_sim_trap_handler(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~X86_TRAP_FLAG;
+    mprotect((void *)IO_BASE, IO_PAGE_SIZE, PROT_READ);
+
+    uintptr_t addr = video_sim_store_addr & ~3;
+    video_sim_io_write(addr, *(volatile uint32_t *)addr);
+}
+
+void video_sim_init(void)
+{
+    int fd = memfd_create("video_sim_io", 0);
+    if ((fd < 0) || (ftruncate(fd, IO_PAGE_SIZE) != 0))
+    {
+        printf("video_sim: can't create the I/O page\n");
+        exit(1);
+    }
+
+    video_sim_map_fixed(IO_BASE, IO_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd);
+    video_sim_io_alias = mmap(NULL, IO_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+    if (video_sim_io_alias == MAP_FAILED)
+    {
+        printf("video_sim: can't map the I/O page\n");
+        exit(1);
+    }
+    close(fd);
+
+    for (size_t i = 0; i < sizeof(video_sim_regions) / sizeof(video_sim_regions[0]); i++)
+    {
+        const video_sim_region_t *r = &video_sim_regions[i];
+        video_sim_map_fixed(r->base, r->size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+
+    sa.sa_sigaction = video_sim_segv_handler;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = video_sim_trap_handler;
+    sigaction(SIGTRAP, &sa, NULL);
+}
+
+void video_sim_capture_gx(bool enable)
+{
+    video_sim_capturing = enable;
+    mprotect((void *)IO_BASE, IO_PAGE_SIZE,
+             enable ? PROT_READ : PROT_READ | PROT_WRITE);
+}
+
+bool video_sim_capturing_gx(void)
+{
+    return video_sim_capturing;
+}
+
+void video_sim_io_poke32(uint32_t addr, uint32_t value)
+{
+    memcpy(video_sim_io_alias + (addr - IO_BASE), &value, sizeof(value));
+}
@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: Zlib
+//
+// Copyright (C) 2026 agent
+
+// Internal interface between video_sim.c and video_sim_mem.c
+
+#ifndef VIDEO_SIM_MEM_H__
+#define VIDEO_SIM_MEM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Called after each captured store to the page of I/O registers with the value
+// of the aligned word that contains the address.
+void video_sim_io_write(uint32_t addr, uint32_t value);
+
+// Returns true if stores to the geometry engine are being captured
+bool video_sim_capturing_gx(void);
+
+// Writes a register without triggering the capture
+void video_sim_io_poke32(uint32_t addr, uint32_t value);
+
+#endif // VIDEO_SIM_MEM_H__